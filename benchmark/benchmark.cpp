@@ -2,16 +2,25 @@
 
 #include <chrono>
 #include <memory>
+#include <vector>
 
 #include <benchmark/benchmark.h>
 #include <common/baseline.h>
+#include <common/dab_generated.h>
 #include <common/helper.h>
+#include <common/macros.h>
+#include <common/synthetic_model.h>
 #include <dabnn/bconv.h>
+#include <dabnn/bconv_direct.h>
 #include <dabnn/bgemm.h>
 #include <dabnn/bitpack.h>
+#include <dabnn/bitplane.h>
+#include <dabnn/fconv.h>
+#include <dabnn/gemv.h>
 #include <dabnn/layers/MaxPool.h>
 #include <dabnn/mat.h>
 #include <dabnn/net.h>
+#include <dabnn/qgemm.h>
 
 static void BM_pack_mat_64_small(benchmark::State &state) {
     const bnn::Mat a(1, 32, 32, 128, bnn::DataType::Float, false);
@@ -39,6 +48,15 @@ static void BM_pack_mat_64(benchmark::State &state) {
     }
 }
 
+// The binarization of an fp16 activation, which reads half of the bytes
+static void BM_pack_mat_64_half(benchmark::State &state) {
+    const bnn::Mat a(1, 64, 64, 128, bnn::DataType::Half);
+    bnn::Mat b(1, 64, 64, 128, bnn::DataType::Bit);
+    for (auto _ : state) {
+        pack_mat_64(a, b);
+    }
+}
+
 #ifdef __aarch64__
 static void BM_pack_mat_128(benchmark::State &state) {
     const bnn::Mat a(1, 64, 64, 128, bnn::DataType::Float);
@@ -199,6 +217,61 @@ static void BM_bnn_bconv_3x3_256_s2(benchmark::State &state) {
     }
 }
 
+static void BM_bnn_bconv_3x3_192(benchmark::State &state) {
+    SETUP_BCONV(30, 3, 192, 1);
+    for (auto _ : state) {
+        bnn::bconv_3x3(a, b, c);
+    }
+}
+
+static void BM_bnn_bconv_3x3_384(benchmark::State &state) {
+    SETUP_BCONV(16, 3, 384, 1);
+    for (auto _ : state) {
+        bnn::bconv_3x3(a, b, c);
+    }
+}
+
+static void BM_bnn_bconv_direct_3x3_256_s2(benchmark::State &state) {
+    SETUP_BCONV(16, 3, 256, 2);
+    for (auto _ : state) {
+        bnn::bconv_direct<3, 3, 2, 2>(a, b, c);
+    }
+}
+
+static void BM_bnn_bconv_direct_5x5_256(benchmark::State &state) {
+    SETUP_BCONV(18, 5, 256, 1);
+    for (auto _ : state) {
+        bnn::bconv_direct<5, 5, 1, 2>(a, b, c);
+    }
+}
+
+static void BM_bnn_bconv_direct_7x7_128_s2(benchmark::State &state) {
+    SETUP_BCONV(34, 7, 128, 2);
+    for (auto _ : state) {
+        bnn::bconv_direct<7, 7, 2, 2>(a, b, c);
+    }
+}
+
+static void BM_bnn_bconv_depthwise_3x3_256(benchmark::State &state) {
+    SETUP_BCONV(30, 3, 256, 1);
+    const bnn::Mat dw_weight(1, BHEIGHT, BWIDTH, NUM_OUTPUT, b_data,
+                             bnn::DataType::Bit, false);
+    for (auto _ : state) {
+        bnn::bconv_group(a, dw_weight, c, NUM_OUTPUT, 1, 1);
+    }
+}
+
+static void BM_bnn_bconv_group_3x3_256_g4(benchmark::State &state) {
+    SETUP_BCONV(30, 3, 256, 1);
+    const int group = 4;
+    const bnn::Mat group_weight(NUM_OUTPUT, BHEIGHT, BWIDTH,
+                                NUM_OUTPUT / group, b_data,
+                                bnn::DataType::Bit, false);
+    for (auto _ : state) {
+        bnn::bconv_group(a, group_weight, c, group, 1, 1);
+    }
+}
+
 static void BM_bnn_bconv_3x3_512(benchmark::State &state) {
     SETUP_BCONV(9, 3, 512, 1);
     for (auto _ : state) {
@@ -223,30 +296,38 @@ static void BM_bnn_bconv(benchmark::State &state) {
 
 #undef SETUP_BCONV
 
-#if 0
-static void BM_maxpool3x3(benchmark::State &state) {
-    const size_t AHEIGHT = 32;
-    const size_t AWIDTH = 32;
-    const size_t CHANNEL = 128;
-
-    const size_t CHEIGHT = 30;
-    const size_t CWIDTH = 30;
-
-    const size_t ALEN = AHEIGHT * AWIDTH * CHANNEL;
-
-    uint64_t a_data[ALEN];
-    FORZ(i, ALEN) { a_data[i] = 3 * i; }
-
-    const auto a = std::make_shared<bnn::Mat>(AHEIGHT, AWIDTH, CHANNEL, a_data, bnn::DataType::Float);
-
-    auto c = std::make_shared<bnn::Mat>(CHEIGHT, CWIDTH, CHANNEL, bnn::DataType::Float);
-
-    const auto m = bnn::MaxPool(a, a, c, 3, 3, 0, 0, 1, 1);
+// A net of a single max pool, so the time includes copying the input into
+// the net. Args: input size, channels, kernel size, stride.
+static void BM_maxpool(benchmark::State &state) {
+    const auto size = static_cast<uint32_t>(state.range(0));
+    const auto channels = static_cast<uint32_t>(state.range(1));
+    const auto kernel = static_cast<int32_t>(state.range(2));
+    const auto stride = static_cast<int32_t>(state.range(3));
+
+    flatbuffers::FlatBufferBuilder builder;
+    const std::vector<uint32_t> input_shape{1, size, size, channels};
+    std::vector<flatbuffers::Offset<flatbnn::Input>> inputs{
+        flatbnn::CreateInputDirect(builder, &input_shape, "input")};
+    const std::vector<int32_t> pads(4, (kernel - 1) / 2),
+        strides{stride, stride}, kernel_shape{kernel, kernel};
+    std::vector<flatbuffers::Offset<flatbnn::Layer>> layers{
+        flatbnn::CreateLayer(builder, flatbnn::LayerType::MaxPool, 0, 0, 0,
+                             flatbnn::CreateMaxPoolDirect(
+                                 builder, "input", &kernel_shape, &pads,
+                                 &strides, "pool"))};
+    const std::vector<flatbuffers::Offset<flatbnn::Tensor>> tensors;
+    builder.Finish(flatbnn::CreateModel(
+        builder, builder.CreateVector(layers), builder.CreateVector(tensors),
+        builder.CreateVector(inputs), BNN_LATEST_MODEL_VERSION));
+
+    std::vector<float> input(size * size * channels);
+    fill_rand_float(input.data(), input.size());
+    auto net = bnn::Net::create();
+    net->read_buf(builder.GetBufferPointer());
     for (auto _ : state) {
-        m.forward();
+        net->run(input.data());
     }
 }
-#endif
 
 #define SETUP_BGEMM     \
     uint64_t a[102400]; \
@@ -302,6 +383,13 @@ static void BM_bgemm_5x5_256(benchmark::State &state) {
     }
 }
 
+static void BM_bgemm_7x7_128_s2(benchmark::State &state) {
+    SETUP_BGEMM;
+    for (auto _ : state) {
+        bgemm(128, 14 * 14, 98, a, 128, b, 98, c, 128);
+    }
+}
+
 static void BM_bgemm_naive_256(benchmark::State &state) {
     SETUP_BGEMM;
     for (auto _ : state) {
@@ -309,6 +397,234 @@ static void BM_bgemm_naive_256(benchmark::State &state) {
     }
 }
 
+// The classifier of ResNet-18: 1000 units, 512 inputs
+static void BM_fgemv_1000x512(benchmark::State &state) {
+    const int m = 1000, k = 512;
+    std::vector<float> a(m * k), x(k), y(m);
+    fill_rand_float(a.data(), a.size());
+    fill_rand_float(x.data(), x.size());
+    for (auto _ : state) {
+        bnn::fgemv(m, k, a.data(), k, x.data(), nullptr, y.data());
+        benchmark::DoNotOptimize(y.data());
+    }
+}
+
+static void BM_bgemv_1000x512(benchmark::State &state) {
+    const int m = 1000, k = 512 / 64;
+    std::vector<uint64_t> a(m * k), x(k);
+    std::vector<float> y(m);
+    fill_rand_uint64(a.data(), a.size());
+    fill_rand_uint64(x.data(), x.size());
+    for (auto _ : state) {
+        bnn::bgemv(m, k, a.data(), k, x.data(), y.data());
+        benchmark::DoNotOptimize(y.data());
+    }
+}
+
+// Args: input size, input channels, output channels, kernel size, stride.
+// The weight is packed once as FloatConv does
+static void BM_fconv_packed(benchmark::State &state) {
+    const int size = state.range(0);
+    const int in_c = state.range(1);
+    const int out_c = state.range(2);
+    const int kernel = state.range(3);
+    const int stride = state.range(4);
+    const int pad = kernel / 2;
+    const int k = kernel * kernel * in_c;
+    bnn::Mat input(size, size, in_c, bnn::DataType::Float);
+    fill_rand_float(static_cast<float *>(input.data), input.total());
+    std::vector<float> weight(out_c * k);
+    fill_rand_float(weight.data(), weight.size());
+    std::vector<float> packed_weight(bnn::fgemm_packed_size(out_c, k));
+    bnn::fgemm_pack_weight(out_c, k, weight.data(), k, packed_weight.data());
+    const int output_size =
+        bnn::fconv_output_size(size, kernel, pad, stride, 1);
+    bnn::Mat output(output_size, output_size, out_c, bnn::DataType::Float);
+    bnn::FgemmEpilogue epilogue;
+    for (auto _ : state) {
+        bnn::fconv_packed(input, packed_weight.data(), kernel, kernel, pad,
+                          pad, stride, stride, 1, 1, out_c, epilogue, output);
+    }
+}
+
+// Args: as BM_fconv_packed. The int8 counterpart, the input is quantized in
+// every iteration as FloatConv does
+static void BM_fconv_packed_int8(benchmark::State &state) {
+    const int size = state.range(0);
+    const int in_c = state.range(1);
+    const int out_c = state.range(2);
+    const int kernel = state.range(3);
+    const int stride = state.range(4);
+    const int pad = kernel / 2;
+    const int k = kernel * kernel * in_c;
+    std::vector<float> input(size * size * in_c);
+    fill_rand_float(input.data(), input.size());
+    std::vector<int8_t> quantized(input.size());
+    std::vector<int8_t> weight(out_c * k);
+    FORZ(i, weight.size()) {
+        weight[i] = static_cast<int8_t>(i * 37 % 255 - 127);
+    }
+    std::vector<int8_t> packed_weight(bnn::qgemm_packed_size(out_c, k));
+    bnn::qgemm_pack_weight(out_c, k, weight.data(), k, packed_weight.data());
+    const std::vector<float> dequant(out_c, 1e-4f);
+    const float inv_scale =
+        127.f / bnn::max_abs(input.data(), input.size());
+    const int output_size =
+        bnn::fconv_output_size(size, kernel, pad, stride, 1);
+    bnn::Mat output(output_size, output_size, out_c, bnn::DataType::Float);
+    bnn::FgemmEpilogue epilogue;
+    for (auto _ : state) {
+        bnn::quantize_int8(input.data(), quantized.data(), input.size(),
+                           inv_scale);
+        bnn::fconv_packed_int8(quantized.data(), 1, size, size, in_c,
+                               packed_weight.data(), dequant.data(), kernel,
+                               kernel, pad, pad, stride, stride, 1, 1, out_c,
+                               epilogue, output);
+    }
+}
+
+static void BM_qgemv_1000x512(benchmark::State &state) {
+    const int m = 1000, k = 512;
+    std::vector<int8_t> a(m * k), x(k);
+    FORZ(i, a.size()) { a[i] = static_cast<int8_t>(i * 37 % 255 - 127); }
+    FORZ(i, x.size()) { x[i] = static_cast<int8_t>(i * 11 % 255 - 127); }
+    const std::vector<float> dequant(m, 1e-4f);
+    std::vector<float> y(m);
+    for (auto _ : state) {
+        bnn::qgemv(m, k, a.data(), k, x.data(), dequant.data(), nullptr,
+                   y.data());
+        benchmark::DoNotOptimize(y.data());
+    }
+}
+
+// Args: bits of the weight and the activation. A 3x3 128->128 conv on
+// 28x28, the cost grows with the product of the bits
+static void BM_multibit_conv_3x3_128(benchmark::State &state) {
+    bnn::BitplaneConv bs;
+    bs.n = 1;
+    bs.h = bs.w = bs.output_h = bs.output_w = 28;
+    bs.c = bs.m = 128;
+    bs.kernel_h = bs.kernel_w = 3;
+    bs.pad_h = bs.pad_w = 1;
+    bs.stride_h = bs.stride_w = bs.dilation_h = bs.dilation_w = 1;
+    bs.weight_bits = state.range(0);
+    bs.activation_bits = state.range(1);
+    const int top = bnn::max_level(bs.weight_bits);
+    std::vector<int8_t> levels(bs.m * bs.kernel_len() * bs.c);
+    FORZ(i, levels.size()) {
+        levels[i] = static_cast<int8_t>(2 * (i * 37 % (top + 1)) - top);
+    }
+    std::vector<uint64_t> weight_planes(bs.k() * bs.weight_bits * bs.m);
+    std::vector<float> wsum(bs.m * bs.kernel_len());
+    bnn::pack_weight_planes(levels.data(), bs.m, bs.kernel_len(), bs.c,
+                            bs.weight_bits, weight_planes.data(), wsum.data());
+    std::vector<float> input(bs.h * bs.w * bs.c);
+    fill_rand_float(input.data(), input.size());
+    std::vector<uint64_t> planes(bs.planes_size()), col(bs.col_size());
+    std::vector<float> popcount(bs.popcount_size());
+    const std::vector<float> scale(bs.m, 1e-3f);
+    bnn::Mat output(bs.output_w, bs.output_h, bs.m, bnn::DataType::Float);
+    for (auto _ : state) {
+        bs.pack_input(
+            [&](const int y) { return input.data() + y * bs.w * bs.c; }, 2.f,
+            planes.data());
+        bs.im2col(planes.data(), col.data());
+        bs.gemm(weight_planes.data(), col.data(), popcount.data());
+        bs.combine(popcount.data(), wsum.data(), scale.data(), nullptr,
+                   [&](const int p) {
+                       return output.point<float>(p / bs.output_w,
+                                                  p % bs.output_w);
+                   });
+    }
+}
+
+// Args: batch. A 3x3 64->64 float conv on 7x7 images, whose 49 pixels are
+// too few to fill the tiles alone. The time is per batch.
+static void BM_fconv_batch(benchmark::State &state) {
+    const int batch = state.range(0);
+    const int size = 7, in_c = 64, out_c = 64, kernel = 3;
+    const int k = kernel * kernel * in_c;
+    bnn::Mat input(batch, size, size, in_c, bnn::DataType::Float);
+    fill_rand_float(static_cast<float *>(input.data), input.total());
+    std::vector<float> weight(out_c * k);
+    fill_rand_float(weight.data(), weight.size());
+    std::vector<float> packed_weight(bnn::fgemm_packed_size(out_c, k));
+    bnn::fgemm_pack_weight(out_c, k, weight.data(), k, packed_weight.data());
+    bnn::Mat output(batch, size, size, out_c, bnn::DataType::Float);
+    bnn::FgemmEpilogue epilogue;
+    for (auto _ : state) {
+        bnn::fconv_packed(input, packed_weight.data(), kernel, kernel, 1, 1, 1,
+                          1, 1, 1, out_c, epilogue, output);
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+}
+
+// The 7x7 stride 2 stem of ResNet-18 on a uint8 image
+static void BM_fconv_stem_uint8(benchmark::State &state) {
+    const int size = 224, in_c = 3, out_c = 64, kernel = 7;
+    const int k = kernel * kernel * in_c;
+    std::vector<uint8_t> input(size * size * in_c);
+    FORZ(i, input.size()) { input[i] = static_cast<uint8_t>(i); }
+    const float mean[] = {124.f, 116.f, 104.f};
+    const float scale[] = {1 / 58.f, 1 / 57.f, 1 / 57.5f};
+    std::vector<float> weight(out_c * k);
+    fill_rand_float(weight.data(), weight.size());
+    std::vector<float> packed_weight(bnn::fgemm_packed_size(out_c, k));
+    bnn::fgemm_pack_weight(out_c, k, weight.data(), k, packed_weight.data());
+    bnn::Mat output(size / 2, size / 2, out_c, bnn::DataType::Float);
+    bnn::FgemmEpilogue epilogue;
+    for (auto _ : state) {
+        bnn::fconv_packed_uint8(input.data(), 1, size, size, in_c, mean,
+                                scale, packed_weight.data(), kernel, kernel, 3,
+                                3, 2, 2, 1, 1, out_c, epilogue, output);
+    }
+}
+
+// Args: m, n, k, kc, mc, nc. kc == 0 means the blocking derived from the
+// detected caches
+static void BM_bgemm_blocking(benchmark::State &state) {
+    const int m = state.range(0);
+    const int n = state.range(1);
+    const int k = state.range(2);
+    const auto blocking =
+        state.range(3) == 0
+            ? bgemm_blocking(m, n, k)
+            : BgemmBlocking{static_cast<int>(state.range(3)),
+                            static_cast<int>(state.range(4)),
+                            static_cast<int>(state.range(5))};
+    std::vector<uint64_t> a(m * k);
+    std::vector<uint64_t> b(k * n);
+    std::vector<float> c(m * n);
+    fill_rand_uint64(a.data(), a.size());
+    fill_rand_uint64(b.data(), b.size());
+    for (auto _ : state) {
+        bgemm(m, n, k, a.data(), m, b.data(), k, c.data(), m, blocking);
+    }
+    state.counters["kc"] = blocking.kc;
+    state.counters["mc"] = blocking.mc;
+    state.counters["nc"] = blocking.nc;
+    state.SetItemsProcessed(state.iterations() * m * n * k * 64);
+}
+
+static void bgemm_blocking_sweep(benchmark::internal::Benchmark *b) {
+    // The shapes of 3x3 and 5x5 binary convs in ResNet-18-like models
+    const std::vector<std::vector<int64_t>> shapes{{128, 28 * 28, 18},
+                                                   {256, 14 * 14, 36},
+                                                   {512, 7 * 7, 72},
+                                                   {256, 14 * 14, 100},
+                                                   {128, 112 * 112, 18}};
+    for (const auto &shape : shapes) {
+        b->Args({shape[0], shape[1], shape[2], 0, 0, 0});
+        for (const int64_t kc : {16, 32, 64, 128}) {
+            for (const int64_t mc : {32, 128, 512}) {
+                for (const int64_t nc : {96, 960}) {
+                    b->Args({shape[0], shape[1], shape[2], kc, mc, nc});
+                }
+            }
+        }
+    }
+}
+
 static void BM_bireal18_cifar(benchmark::State &state) {
     float input[3 * 32 * 32];
 
@@ -339,6 +655,17 @@ static void BM_bireal18_imagenet_stem(benchmark::State &state) {
     }
 }
 
+static void BM_bireal18_imagenet_half(benchmark::State &state) {
+    float input[3 * 224 * 224];
+
+    auto net = bnn::Net::create();
+    net->half_activations = true;
+    net->read("/data/local/tmp/model_imagenet.dab");
+    for (auto _ : state) {
+        net->run(input);
+    }
+}
+
 static void BM_bireal18_cifar_wo_fconv(benchmark::State &state) {
     float input[3 * 32 * 32];
 
@@ -363,23 +690,81 @@ static void BM_bireal18_imagenet_wo_fconv(benchmark::State &state) {
     }
 }
 
+static bnn::SyntheticModel synthetic_model(
+    const bnn::SyntheticModel::Arch arch, const int width, const bool binary) {
+    bnn::SyntheticModel model;
+    model.arch = arch;
+    model.width = width;
+    model.binary = binary;
+    if (arch == bnn::SyntheticModel::Arch::kShuffleNet) {
+        // The channels of a shuffle are at most 512
+        model.stages = 3;
+    }
+    return model;
+}
+
+// A model of random weights, which needs no downloaded model
+static void BM_synthetic(benchmark::State &state,
+                         const bnn::SyntheticModel &model) {
+    const auto buf = model.build();
+    std::vector<float> input(3 * model.resolution * model.resolution);
+    fill_rand_float(input.data(), input.size());
+
+    auto net = bnn::Net::create();
+    net->read_buf(buf.data());
+    for (auto _ : state) {
+        net->run(input.data());
+    }
+    state.SetLabel(model.name());
+}
+
 BENCHMARK_MAIN();
 
-// BENCHMARK(BM_pack_mat_64);
+BENCHMARK(BM_pack_mat_64);
 // BENCHMARK(BM_pack_mat_128);
 // BENCHMARK(BM_bnn_bconv_1x1_64);
 // BENCHMARK(BM_bnn_bconv_1x1_128);
 // BENCHMARK(BM_bnn_bconv_1x1_256);
 // BENCHMARK(BM_bnn_bconv_1x1_512);
 // BENCHMARK(BM_bgemm_128);
-// BENCHMARK(BM_bgemm_256);
+BENCHMARK(BM_bgemm_256);
 // BENCHMARK(BM_bgemm_256_s2);
+BENCHMARK(BM_pack_mat_64_half);
 BENCHMARK(BM_bgemm_5x5_256);
+BENCHMARK(BM_bnn_bconv_direct_5x5_256);
+BENCHMARK(BM_bgemm_7x7_128_s2);
+BENCHMARK(BM_bnn_bconv_direct_7x7_128_s2);
 // BENCHMARK(BM_bgemm_512);
+BENCHMARK(BM_bgemm_blocking)->Apply(bgemm_blocking_sweep);
+BENCHMARK(BM_fgemv_1000x512);
+// The stem, a downsample shortcut and a 3x3 float conv of ResNet-18
+BENCHMARK(BM_fconv_packed)
+    ->Args({224, 3, 64, 7, 2})
+    ->Args({56, 64, 128, 1, 2})
+    ->Args({56, 64, 64, 3, 1});
+BENCHMARK(BM_fconv_packed_int8)
+    ->Args({224, 3, 64, 7, 2})
+    ->Args({56, 64, 128, 1, 2})
+    ->Args({56, 64, 64, 3, 1});
+BENCHMARK(BM_fconv_stem_uint8);
+BENCHMARK(BM_multibit_conv_3x3_128)
+    ->Args({1, 1})
+    ->Args({2, 2})
+    ->Args({4, 4});
+BENCHMARK(BM_fconv_batch)->Arg(1)->Arg(4)->Arg(16);
+BENCHMARK(BM_bgemv_1000x512);
+// The max pool of the stem of ResNet-18, and a 2x2 one on a Bi-Real stage
+BENCHMARK(BM_maxpool)->Args({112, 64, 3, 2})->Args({28, 128, 2, 2});
+BENCHMARK(BM_qgemv_1000x512);
 BENCHMARK(BM_bnn_bconv_3x3_64);
 BENCHMARK(BM_bnn_bconv_3x3_128);
 BENCHMARK(BM_bnn_bconv_3x3_256);
 BENCHMARK(BM_bnn_bconv_3x3_256_s2);
+BENCHMARK(BM_bnn_bconv_direct_3x3_256_s2);
+BENCHMARK(BM_bnn_bconv_3x3_192);
+BENCHMARK(BM_bnn_bconv_3x3_384);
+BENCHMARK(BM_bnn_bconv_depthwise_3x3_256);
+BENCHMARK(BM_bnn_bconv_group_3x3_256_g4);
 BENCHMARK(BM_bnn_bconv_3x3_512);
 // BENCHMARK(BM_bnn_bconv_3x3_1024);
 // BENCHMARK(BM_bireal18_cifar_wo_fconv);
@@ -387,6 +772,22 @@ BENCHMARK(BM_bnn_bconv_3x3_512);
 // BENCHMARK(BM_bireal18_cifar);
 BENCHMARK(BM_bireal18_imagenet);
 BENCHMARK(BM_bireal18_imagenet_stem);
+BENCHMARK(BM_bireal18_imagenet_half);
+BENCHMARK_CAPTURE(BM_synthetic, bireal18,
+                  synthetic_model(bnn::SyntheticModel::Arch::kBiReal, 64,
+                                  true));
+BENCHMARK_CAPTURE(BM_synthetic, bireal18_float,
+                  synthetic_model(bnn::SyntheticModel::Arch::kBiReal, 64,
+                                  false));
+BENCHMARK_CAPTURE(BM_synthetic, resnet18,
+                  synthetic_model(bnn::SyntheticModel::Arch::kResNet, 64,
+                                  true));
+BENCHMARK_CAPTURE(BM_synthetic, resnet18_float,
+                  synthetic_model(bnn::SyntheticModel::Arch::kResNet, 64,
+                                  false));
+BENCHMARK_CAPTURE(BM_synthetic, shufflenet,
+                  synthetic_model(bnn::SyntheticModel::Arch::kShuffleNet, 128,
+                                  true));
 // BENCHMARK(BM_bnn_bconv_3x3_naive_128);
 // BENCHMARK(BM_bconv_float_1x1_128);
 // BENCHMARK(BM_bconv_float_3x3_128);
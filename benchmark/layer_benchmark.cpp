@@ -0,0 +1,548 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+// Every layer and some kernels of dabnn over the shapes of ResNet-18 and
+// Bi-Real Net on ImageNet. A layer is built by Net from a model of the
+// input, the layer named "layer" and the layers which make its input or read
+// its output as in a real model, e.g., the binarize before a shuffle. Only
+// the time of "layer" is reported, which the profiler of the net measures.
+// The items are the output values of the layer, a bit is a value, and the
+// bytes are those of its Layer::work().
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <common/dab_generated.h>
+#include <common/helper.h>
+#include <common/macros.h>
+#include <dabnn/fused_binarize_im2col.h>
+#include <dabnn/mat.h>
+#include <dabnn/net.h>
+#include <dabnn/pad.h>
+
+namespace {
+
+using Shape = std::vector<uint32_t>;
+
+/**
+ * A model of random weights, whose input is [1, size, size, c]
+ */
+class ModelBuilder {
+   public:
+    ModelBuilder(const int size, const int c)
+        : input_shape_{1, static_cast<uint32_t>(size),
+                       static_cast<uint32_t>(size),
+                       static_cast<uint32_t>(c)} {}
+
+    flatbuffers::FlatBufferBuilder fbb;
+
+    std::string float_tensor(const Shape &shape) {
+        std::vector<float> data(total(shape));
+        fill_rand_float(data.data(), data.size());
+        const auto name = "weight_" + std::to_string(tensors_.size());
+        tensors_.push_back(flatbnn::CreateTensorDirect(
+            fbb, flatbnn::DataType::Float32, nullptr, &data, &shape,
+            name.c_str()));
+        return name;
+    }
+    // The weight [n, h, w, c] of a binary conv
+    std::string bit_tensor(const Shape &shape) {
+        std::vector<uint64_t> data(total(shape) / 64);
+        fill_rand_uint64(data.data(), data.size());
+        const auto name = "weight_" + std::to_string(tensors_.size());
+        tensors_.push_back(flatbnn::CreateTensorDirect(
+            fbb, flatbnn::DataType::Bit, &data, nullptr, &shape, name.c_str(),
+            shape[3] != 64));
+        return name;
+    }
+    // The levels of the weight [n, h, w, c] of a multi-bit conv
+    std::string level_tensor(const Shape &shape, const int bits) {
+        const int top = (1 << bits) - 1;
+        std::vector<int8_t> levels(total(shape));
+        for (auto &v : levels) {
+            v = static_cast<int8_t>(2 * (random_uint64() % (top + 1)) - top);
+        }
+        const std::vector<float> scales(shape[0], 0.01f);
+        const auto name = "weight_" + std::to_string(tensors_.size());
+        tensors_.push_back(flatbnn::CreateTensorDirect(
+            fbb, flatbnn::DataType::Int8, nullptr, nullptr, &shape,
+            name.c_str(), false, &levels, &scales));
+        return name;
+    }
+    void push(const flatbnn::LayerType type, const std::string &name,
+              const std::function<void(flatbnn::LayerBuilder &)> &param) {
+        const auto name_offset = fbb.CreateString(name);
+        flatbnn::LayerBuilder builder(fbb);
+        builder.add_type(type);
+        builder.add_name(name_offset);
+        param(builder);
+        layers_.push_back(builder.Finish());
+    }
+    // The input binarized by a Binarize layer "bits"
+    std::string bits() {
+        const auto param = flatbnn::CreateBinarizeDirect(fbb, "input", "bits");
+        push(flatbnn::LayerType::Binarize, "bits",
+             [&](flatbnn::LayerBuilder &b) { b.add_binarize_param(param); });
+        return "bits";
+    }
+    // A binary conv with 64 outputs reading the blob, whose readers are all
+    // binary convs and so it is stored as bits
+    void bin_conv_reader(const std::string &input, const int c) {
+        const auto weight = bit_tensor({64, 1, 1, static_cast<uint32_t>(c)});
+        const std::vector<int32_t> pads{0, 0, 0, 0}, strides{1, 1},
+            dilations{1, 1};
+        const auto param = flatbnn::CreateBinConv2DDirect(
+            fbb, input.c_str(), weight.c_str(), nullptr, &pads, &strides,
+            &dilations, "reader");
+        push(flatbnn::LayerType::BinConv2D, "reader",
+             [&](flatbnn::LayerBuilder &b) { b.add_bin_conv2d_param(param); });
+    }
+    std::vector<uint8_t> finish() {
+        const std::vector<flatbuffers::Offset<flatbnn::Input>> inputs{
+            flatbnn::CreateInputDirect(fbb, &input_shape_, "input")};
+        fbb.Finish(flatbnn::CreateModel(
+            fbb, fbb.CreateVector(layers_), fbb.CreateVector(tensors_),
+            fbb.CreateVector(inputs), BNN_LATEST_MODEL_VERSION));
+        const auto *ptr = fbb.GetBufferPointer();
+        return std::vector<uint8_t>(ptr, ptr + fbb.GetSize());
+    }
+    size_t input_len() const { return total(input_shape_); }
+
+   private:
+    Shape input_shape_;
+    std::vector<flatbuffers::Offset<flatbnn::Tensor>> tensors_;
+    std::vector<flatbuffers::Offset<flatbnn::Layer>> layers_;
+
+    static size_t total(const Shape &shape) {
+        size_t n = 1;
+        for (const auto d : shape) {
+            n *= d;
+        }
+        return n;
+    }
+};
+
+/**
+ * Run the net of the model and report the time of its layer "layer"
+ */
+void run_layer(benchmark::State &state, ModelBuilder &model,
+               const bool optimize = true) {
+    const auto buf = model.finish();
+    std::vector<float> input(model.input_len());
+    fill_rand_float(input.data(), input.size());
+
+    auto net = bnn::Net::create();
+    net->optimize = optimize;
+    net->read_buf(buf.data());
+    net->profile = true;
+    net->profiler.max_events = 0;
+    net->run(input.data());
+    const auto &entries = net->profiler.entries();
+    size_t index = 0;
+    while (index < entries.size() && entries[index].name != "layer") {
+        index++;
+    }
+    BNN_ASSERT(index < entries.size(), "No layer named \"layer\"");
+
+    for (auto _ : state) {
+        const auto before = entries[index].total_ns;
+        net->run(input.data());
+        state.SetIterationTime((entries[index].total_ns - before) / 1e9);
+    }
+    const auto &entry = entries[index];
+    state.SetItemsProcessed(state.iterations() * entry.output_elems /
+                            entry.calls);
+    state.SetBytesProcessed(state.iterations() *
+                            (entry.work.bytes_read + entry.work.bytes_written));
+}
+
+/**
+ * The layers of the blocks of the four stages, as {size, channels}
+ */
+void stages(benchmark::internal::Benchmark *b) {
+    b->ArgNames({"size", "c"});
+    for (const auto &stage : std::vector<std::vector<int64_t>>{
+             {56, 64}, {28, 128}, {14, 256}, {7, 512}}) {
+        b->Args(stage);
+    }
+}
+
+// Args: size, input channels, output channels, stride, whether the input is
+// bits from a binarize instead of float, and optimize of the net. The
+// unoptimized net runs the portable kernels.
+void BM_layer_bconv(benchmark::State &state) {
+    const auto size = static_cast<int>(state.range(0));
+    const auto in_c = static_cast<uint32_t>(state.range(1));
+    const auto out_c = static_cast<uint32_t>(state.range(2));
+    const auto stride = static_cast<int32_t>(state.range(3));
+    ModelBuilder model(size, in_c);
+    const auto input = state.range(4) != 0 ? model.bits() : "input";
+    const auto weight = model.bit_tensor({out_c, 3, 3, in_c});
+    const std::vector<int32_t> pads{1, 1, 1, 1}, strides{stride, stride},
+        dilations{1, 1};
+    const auto param = flatbnn::CreateBinConv2DDirect(
+        model.fbb, input.c_str(), weight.c_str(), nullptr, &pads, &strides,
+        &dilations, "output");
+    model.push(
+        flatbnn::LayerType::BinConv2D, "layer",
+        [&](flatbnn::LayerBuilder &b) { b.add_bin_conv2d_param(param); });
+    run_layer(state, model, state.range(5) != 0);
+}
+
+void bconv_sweep(benchmark::internal::Benchmark *b) {
+    b->ArgNames({"size", "in_c", "out_c", "stride", "bits", "opt"});
+    for (const auto &stage : std::vector<std::vector<int64_t>>{
+             {56, 64}, {28, 128}, {14, 256}, {7, 512}}) {
+        const auto size = stage[0], c = stage[1];
+        for (const int64_t bits : {0, 1}) {
+            b->Args({size, c, c, 1, bits, 1});
+            if (c != 64) {
+                // The first conv of the stage
+                b->Args({2 * size, c / 2, c, 2, bits, 1});
+            }
+        }
+        b->Args({size, c, c, 1, 1, 0});
+    }
+}
+
+// Args: size, input channels, output channels, kernel, stride
+void BM_layer_fconv(benchmark::State &state) {
+    const auto size = static_cast<int>(state.range(0));
+    const auto in_c = static_cast<uint32_t>(state.range(1));
+    const auto out_c = static_cast<uint32_t>(state.range(2));
+    const auto kernel = static_cast<int32_t>(state.range(3));
+    const auto stride = static_cast<int32_t>(state.range(4));
+    ModelBuilder model(size, in_c);
+    const auto weight = model.float_tensor(
+        {out_c, static_cast<uint32_t>(kernel), static_cast<uint32_t>(kernel),
+         in_c});
+    const int32_t pad = kernel / 2;
+    const std::vector<int32_t> pads{pad, pad, pad, pad},
+        strides{stride, stride}, dilations{1, 1};
+    const auto param = flatbnn::CreateFpConv2DDirect(
+        model.fbb, "input", weight.c_str(), nullptr, &pads, &strides,
+        &dilations, "output");
+    model.push(flatbnn::LayerType::FpConv2D, "layer",
+               [&](flatbnn::LayerBuilder &b) { b.add_fp_conv2d_param(param); });
+    run_layer(state, model);
+}
+
+// Args: size, channels, bits of the weight and the activation. A 3x3 conv
+// with as many outputs as inputs.
+void BM_layer_multibit_conv(benchmark::State &state) {
+    const auto size = static_cast<int>(state.range(0));
+    const auto c = static_cast<uint32_t>(state.range(1));
+    const auto weight_bits = static_cast<int>(state.range(2));
+    const auto activation_bits = static_cast<int>(state.range(3));
+    ModelBuilder model(size, c);
+    const auto weight = model.level_tensor({c, 3, 3, c}, weight_bits);
+    const std::vector<int32_t> pads{1, 1, 1, 1}, strides{1, 1},
+        dilations{1, 1};
+    const auto param = flatbnn::CreateMultiBitConv2DDirect(
+        model.fbb, "input", weight.c_str(), nullptr, &pads, &strides,
+        &dilations, "output", weight_bits, activation_bits, 0.25f);
+    model.push(flatbnn::LayerType::MultiBitConv2D, "layer",
+               [&](flatbnn::LayerBuilder &b) {
+                   b.add_multibit_conv2d_param(param);
+               });
+    run_layer(state, model);
+}
+
+// Args: size, channels, kernel, stride, and whether the output is read by a
+// binary conv and so is stored as bits
+void BM_layer_maxpool(benchmark::State &state) {
+    const auto size = static_cast<int>(state.range(0));
+    const auto c = static_cast<int>(state.range(1));
+    const auto kernel = static_cast<int32_t>(state.range(2));
+    const auto stride = static_cast<int32_t>(state.range(3));
+    ModelBuilder model(size, c);
+    const int32_t pad = (kernel - 1) / 2;
+    const std::vector<int32_t> kernel_shape{kernel, kernel},
+        pads{pad, pad, pad, pad}, strides{stride, stride};
+    const auto param = flatbnn::CreateMaxPoolDirect(
+        model.fbb, "input", &kernel_shape, &pads, &strides, "output");
+    model.push(flatbnn::LayerType::MaxPool, "layer",
+               [&](flatbnn::LayerBuilder &b) { b.add_maxpool_param(param); });
+    if (state.range(4) != 0) {
+        model.bin_conv_reader("output", c);
+    }
+    run_layer(state, model);
+}
+
+// Args: size, channels, kernel, stride, pad
+void BM_layer_avepool(benchmark::State &state) {
+    const auto size = static_cast<int>(state.range(0));
+    const auto c = static_cast<int>(state.range(1));
+    const auto kernel = static_cast<int32_t>(state.range(2));
+    const auto stride = static_cast<int32_t>(state.range(3));
+    const auto pad = static_cast<int32_t>(state.range(4));
+    ModelBuilder model(size, c);
+    const std::vector<int32_t> kernel_shape{kernel, kernel},
+        pads{pad, pad, pad, pad}, strides{stride, stride};
+    const auto param = flatbnn::CreateAvePoolDirect(
+        model.fbb, "input", &kernel_shape, &pads, &strides, "output");
+    model.push(flatbnn::LayerType::AvePool, "layer",
+               [&](flatbnn::LayerBuilder &b) { b.add_avepool_param(param); });
+    run_layer(state, model);
+}
+
+// Args: size, channels. The float input is in place for all but Binarize.
+void BM_layer_eltwise(benchmark::State &state,
+                      const flatbnn::LayerType type) {
+    const auto size = static_cast<int>(state.range(0));
+    const auto c = static_cast<uint32_t>(state.range(1));
+    ModelBuilder model(size, c);
+    switch (type) {
+        case flatbnn::LayerType::Affine: {
+            const auto a = model.float_tensor({c});
+            const auto b = model.float_tensor({c});
+            const auto param = flatbnn::CreateAffineDirect(
+                model.fbb, "input", a.c_str(), b.c_str(), "output");
+            model.push(type, "layer", [&](flatbnn::LayerBuilder &lb) {
+                lb.add_affine_param(param);
+            });
+            break;
+        }
+        case flatbnn::LayerType::Add: {
+            const auto param =
+                flatbnn::CreateAddDirect(model.fbb, "input", "input", "output");
+            model.push(type, "layer", [&](flatbnn::LayerBuilder &b) {
+                b.add_add_param(param);
+            });
+            break;
+        }
+        case flatbnn::LayerType::Relu: {
+            const auto param =
+                flatbnn::CreateReluDirect(model.fbb, "input", "output");
+            model.push(type, "layer", [&](flatbnn::LayerBuilder &b) {
+                b.add_relu_param(param);
+            });
+            break;
+        }
+        case flatbnn::LayerType::PRelu: {
+            const auto slope = model.float_tensor({c});
+            const auto param = flatbnn::CreatePReluDirect(
+                model.fbb, "input", slope.c_str(), "output");
+            model.push(type, "layer", [&](flatbnn::LayerBuilder &b) {
+                b.add_prelu_param(param);
+            });
+            break;
+        }
+        case flatbnn::LayerType::Binarize: {
+            const auto param =
+                flatbnn::CreateBinarizeDirect(model.fbb, "input", "output");
+            model.push(type, "layer", [&](flatbnn::LayerBuilder &b) {
+                b.add_binarize_param(param);
+            });
+            break;
+        }
+        default:
+            BNN_ASSERT(false, "Not an elementwise layer");
+    }
+    run_layer(state, model);
+}
+
+// Args: size, channels. The layers of the binary blocks of ShuffleNet-like
+// models, on the input binarized by a Binarize layer.
+void BM_layer_shuffle_block(benchmark::State &state,
+                            const flatbnn::LayerType type) {
+    const auto size = static_cast<int>(state.range(0));
+    const auto c = static_cast<int>(state.range(1));
+    ModelBuilder model(size, c);
+    const auto input = model.bits();
+    switch (type) {
+        case flatbnn::LayerType::Concat: {
+            const std::vector<flatbuffers::Offset<flatbuffers::String>>
+                inputs{model.fbb.CreateString(input),
+                       model.fbb.CreateString(input)};
+            const auto param =
+                flatbnn::CreateConcatDirect(model.fbb, &inputs, 3, "output");
+            model.push(type, "layer", [&](flatbnn::LayerBuilder &b) {
+                b.add_concat_param(param);
+            });
+            break;
+        }
+        case flatbnn::LayerType::Split: {
+            const std::vector<flatbuffers::Offset<flatbuffers::String>>
+                outputs{model.fbb.CreateString("output1"),
+                        model.fbb.CreateString("output2")};
+            const auto param =
+                flatbnn::CreateSplitDirect(model.fbb, input.c_str(), &outputs);
+            model.push(type, "layer", [&](flatbnn::LayerBuilder &b) {
+                b.add_split_param(param);
+            });
+            break;
+        }
+        case flatbnn::LayerType::Shuffle: {
+            const auto param = flatbnn::CreateShuffleDirect(
+                model.fbb, input.c_str(), "output");
+            model.push(type, "layer", [&](flatbnn::LayerBuilder &b) {
+                b.add_shuffle_param(param);
+            });
+            break;
+        }
+        default:
+            BNN_ASSERT(false, "Not a layer of the shuffle blocks");
+    }
+    run_layer(state, model);
+}
+
+// Args: input channels, outputs
+void BM_layer_fc(benchmark::State &state) {
+    const auto in_c = static_cast<uint32_t>(state.range(0));
+    const auto out_c = static_cast<uint32_t>(state.range(1));
+    ModelBuilder model(1, in_c);
+    const auto weight = model.float_tensor({out_c, in_c});
+    const auto bias = model.float_tensor({out_c});
+    const auto param = flatbnn::CreateFCDirect(
+        model.fbb, "input", weight.c_str(), bias.c_str(), "output");
+    model.push(flatbnn::LayerType::FC, "layer",
+               [&](flatbnn::LayerBuilder &b) { b.add_fc_param(param); });
+    run_layer(state, model);
+}
+
+// Args: classes
+void BM_layer_softmax(benchmark::State &state) {
+    ModelBuilder model(1, static_cast<int>(state.range(0)));
+    const auto param =
+        flatbnn::CreateSoftmaxDirect(model.fbb, "input", "output");
+    model.push(flatbnn::LayerType::Softmax, "layer",
+               [&](flatbnn::LayerBuilder &b) { b.add_softmax_param(param); });
+    run_layer(state, model);
+}
+
+// Args: size, channels, whether the mat is bits. A padding of 1 as before a
+// 3x3 direct conv.
+void BM_pad(benchmark::State &state) {
+    const auto size = static_cast<int>(state.range(0));
+    const auto c = static_cast<int>(state.range(1));
+    const auto data_type =
+        state.range(2) != 0 ? bnn::DataType::Bit : bnn::DataType::Float;
+    const bnn::Mat input(1, size, size, c, data_type);
+    bnn::Mat output(1, size + 2, size + 2, c, data_type);
+    for (auto _ : state) {
+        bnn::pad(input, 1, 1, output);
+    }
+    state.SetItemsProcessed(state.iterations() * output.total() *
+                            (data_type == bnn::DataType::Bit ? 64 : 1));
+    state.SetBytesProcessed(state.iterations() *
+                            (input.total() + output.total()) *
+                            input.elemsize);
+}
+
+// Args: size, channels, stride, whether the input is bits. The im2col of a
+// 3x3 binary conv by bgemm.
+void BM_fused_binarize_im2col(benchmark::State &state) {
+    const auto size = static_cast<int>(state.range(0));
+    const auto c = static_cast<int>(state.range(1));
+    const auto stride = static_cast<int>(state.range(2));
+    const auto data_type =
+        state.range(3) != 0 ? bnn::DataType::Bit : bnn::DataType::Float;
+    bnn::Mat input(1, size, size, c, data_type);
+    if (data_type == bnn::DataType::Float) {
+        fill_rand_float(static_cast<float *>(input.data), input.total());
+    }
+    const int output_size = (size - 1) / stride + 1;
+    // The bits of a column are aligned to 128
+    bnn::Mat col(1, 1, output_size * output_size * ((9 * c + 127) / 128 * 128),
+                 bnn::DataType::Bit);
+    for (auto _ : state) {
+        bnn::fused_binarize_im2col(input, 3, 3, 1, 1, stride, stride, 1, 1,
+                                   col);
+    }
+    state.SetItemsProcessed(state.iterations() * col.total() * 64);
+    state.SetBytesProcessed(state.iterations() *
+                            (input.total() * input.elemsize +
+                             col.total() * col.elemsize));
+}
+
+}  // namespace
+
+BENCHMARK(BM_layer_bconv)->Apply(bconv_sweep)->UseManualTime();
+// The stem, the downsample shortcuts and a 3x3 conv of ResNet-18
+BENCHMARK(BM_layer_fconv)
+    ->ArgNames({"size", "in_c", "out_c", "kernel", "stride"})
+    ->Args({224, 3, 64, 7, 2})
+    ->Args({56, 64, 128, 1, 2})
+    ->Args({28, 128, 256, 1, 2})
+    ->Args({14, 256, 512, 1, 2})
+    ->Args({56, 64, 64, 3, 1})
+    ->UseManualTime();
+BENCHMARK(BM_layer_multibit_conv)
+    ->ArgNames({"size", "c", "w_bits", "a_bits"})
+    ->Args({28, 128, 1, 1})
+    ->Args({28, 128, 2, 2})
+    ->Args({14, 256, 2, 2})
+    ->UseManualTime();
+// The max pool of the stem, float and bits, and 2x2 ones of the stages
+BENCHMARK(BM_layer_maxpool)
+    ->ArgNames({"size", "c", "kernel", "stride", "bits"})
+    ->Args({112, 64, 3, 2, 0})
+    ->Args({112, 64, 3, 2, 1})
+    ->Args({56, 64, 2, 2, 0})
+    ->Args({28, 128, 2, 2, 1})
+    ->UseManualTime();
+// The downsample shortcuts of Bi-Real Net and the global pool of the head
+BENCHMARK(BM_layer_avepool)
+    ->ArgNames({"size", "c", "kernel", "stride", "pad"})
+    ->Args({56, 64, 3, 2, 1})
+    ->Args({28, 128, 3, 2, 1})
+    ->Args({14, 256, 3, 2, 1})
+    ->Args({7, 512, 7, 1, 0})
+    ->UseManualTime();
+BENCHMARK_CAPTURE(BM_layer_eltwise, affine, flatbnn::LayerType::Affine)
+    ->Apply(stages)
+    ->UseManualTime();
+BENCHMARK_CAPTURE(BM_layer_eltwise, add, flatbnn::LayerType::Add)
+    ->Apply(stages)
+    ->UseManualTime();
+BENCHMARK_CAPTURE(BM_layer_eltwise, relu, flatbnn::LayerType::Relu)
+    ->Apply(stages)
+    ->UseManualTime();
+BENCHMARK_CAPTURE(BM_layer_eltwise, prelu, flatbnn::LayerType::PRelu)
+    ->Apply(stages)
+    ->UseManualTime();
+BENCHMARK_CAPTURE(BM_layer_eltwise, binarize, flatbnn::LayerType::Binarize)
+    ->Apply(stages)
+    ->UseManualTime();
+// A shuffle handles 128, 256 or 512 channels
+BENCHMARK_CAPTURE(BM_layer_shuffle_block, concat, flatbnn::LayerType::Concat)
+    ->ArgNames({"size", "c"})
+    ->Args({28, 128})
+    ->Args({14, 256})
+    ->Args({7, 512})
+    ->UseManualTime();
+BENCHMARK_CAPTURE(BM_layer_shuffle_block, split, flatbnn::LayerType::Split)
+    ->ArgNames({"size", "c"})
+    ->Args({28, 128})
+    ->Args({14, 256})
+    ->Args({7, 512})
+    ->UseManualTime();
+BENCHMARK_CAPTURE(BM_layer_shuffle_block, shuffle,
+                  flatbnn::LayerType::Shuffle)
+    ->ArgNames({"size", "c"})
+    ->Args({28, 128})
+    ->Args({14, 256})
+    ->Args({7, 512})
+    ->UseManualTime();
+BENCHMARK(BM_layer_fc)
+    ->ArgNames({"in_c", "out_c"})
+    ->Args({512, 1000})
+    ->UseManualTime();
+BENCHMARK(BM_layer_softmax)->ArgNames({"classes"})->Arg(1000)->UseManualTime();
+BENCHMARK(BM_pad)
+    ->ArgNames({"size", "c", "bits"})
+    ->Args({56, 64, 0})
+    ->Args({56, 64, 1})
+    ->Args({14, 256, 1});
+BENCHMARK(BM_fused_binarize_im2col)
+    ->ArgNames({"size", "c", "stride", "bits"})
+    ->Args({56, 64, 1, 0})
+    ->Args({56, 64, 1, 1})
+    ->Args({28, 128, 1, 0})
+    ->Args({28, 64, 2, 0})
+    ->Args({14, 256, 1, 1});
+
+BENCHMARK_MAIN();
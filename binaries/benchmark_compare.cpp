@@ -0,0 +1,319 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+// Compare the benchmarks of a run of dabnn_benchmark with a stored baseline,
+// and fail if any of them is slower beyond the threshold and the noise
+//
+// Usage: dabnn_benchmark_compare baseline.json current.json [--threshold 5]
+//            [--noise 3] [--json report.json or stdout]
+//
+// Both files are the output of --benchmark_out_format=json, better with
+// --benchmark_repetitions of 5 or more. The repetitions of a benchmark are
+// summarized by their median and their median absolute deviation (MAD)
+// instead of the mean and the standard deviation, so that a run disturbed by
+// another process does not move them. A benchmark regresses when its median
+// is more than --threshold percent slower than the baseline, and the
+// slowdown is more than --noise times the MADs of the two runs. The exit
+// code is 1 if any benchmark regresses.
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <common/argh.h>
+
+namespace {
+
+struct Summary {
+    double median_ns = 0.;
+    // Scaled by 1.4826 to be comparable with a standard deviation
+    double mad_ns = 0.;
+    size_t repetitions = 0;
+};
+
+struct Comparison {
+    std::string name;
+    Summary baseline;
+    Summary current;
+    double change_percent = 0.;
+    bool regression = false;
+    bool improvement = false;
+};
+
+void usage(const std::string &filename) {
+    std::cout << "Usage:" << std::endl;
+    std::cout << "  " << filename
+              << " baseline.json current.json [--threshold 5] [--noise 3] "
+                 "[--json report.json]"
+              << std::endl;
+}
+
+double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    const auto n = values.size();
+    return n % 2 == 1 ? values[n / 2]
+                      : (values[n / 2 - 1] + values[n / 2]) / 2.;
+}
+
+Summary summarize(const std::vector<double> &times_ns) {
+    Summary s;
+    s.repetitions = times_ns.size();
+    s.median_ns = median(times_ns);
+    std::vector<double> deviations;
+    for (const auto t : times_ns) {
+        deviations.push_back(std::abs(t - s.median_ns));
+    }
+    s.mad_ns = 1.4826 * median(deviations);
+    return s;
+}
+
+double ns_per_unit(const std::string &unit) {
+    if (unit == "us") {
+        return 1e3;
+    }
+    if (unit == "ms") {
+        return 1e6;
+    }
+    if (unit == "s") {
+        return 1e9;
+    }
+    return 1.;
+}
+
+/**
+ * The value of a line like `"key": value,` of Google Benchmark's json,
+ * which puts every field of a run on its own line
+ */
+bool field(const std::string &line, const std::string &key,
+           std::string &value) {
+    const auto quoted = "\"" + key + "\":";
+    const auto pos = line.find(quoted);
+    if (pos == std::string::npos) {
+        return false;
+    }
+    value = line.substr(pos + quoted.size());
+    const auto begin = value.find_first_not_of(" \t");
+    auto end = value.find_last_not_of(" \t\r,");
+    if (begin == std::string::npos || end < begin) {
+        value.clear();
+        return true;
+    }
+    if (value[begin] == '"' && end > begin && value[end] == '"') {
+        value = value.substr(begin + 1, end - begin - 1);
+    } else {
+        value = value.substr(begin, end - begin + 1);
+    }
+    return true;
+}
+
+/**
+ * The times of the repetitions of every benchmark in ns, without the
+ * aggregates like mean and stddev and the runs which failed
+ */
+bool read_runs(const std::string &path,
+               std::map<std::string, std::vector<double>> &runs) {
+    std::ifstream ifs(path);
+    if (!ifs.is_open()) {
+        std::cout << "Cannot open " << path << std::endl;
+        return false;
+    }
+    std::string line, value;
+    bool in_benchmarks = false;
+    std::string name, run_name, run_type, unit;
+    double real_time = -1.;
+    bool error = false;
+    while (std::getline(ifs, line)) {
+        if (line.find("\"benchmarks\":") != std::string::npos) {
+            in_benchmarks = true;
+            continue;
+        }
+        if (!in_benchmarks) {
+            continue;
+        }
+        if (line.find('{') != std::string::npos) {
+            name.clear();
+            run_name.clear();
+            run_type.clear();
+            unit = "ns";
+            real_time = -1.;
+            error = false;
+        } else if (line.find('}') != std::string::npos) {
+            const auto &key = run_name.empty() ? name : run_name;
+            if (!key.empty() && run_type != "aggregate" && !error &&
+                real_time >= 0.) {
+                runs[key].push_back(real_time * ns_per_unit(unit));
+            }
+        } else if (field(line, "name", value)) {
+            name = value;
+        } else if (field(line, "run_name", value)) {
+            run_name = value;
+        } else if (field(line, "run_type", value)) {
+            run_type = value;
+        } else if (field(line, "real_time", value)) {
+            real_time = std::stod(value);
+        } else if (field(line, "time_unit", value)) {
+            unit = value;
+        } else if (field(line, "error_occurred", value)) {
+            error = value == "true";
+        }
+    }
+    if (runs.empty()) {
+        std::cout << "No benchmarks in " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::string format_ns(const double ns) {
+    std::stringstream ss;
+    ss << std::fixed;
+    if (ns >= 1e6) {
+        ss << std::setprecision(3) << ns / 1e6 << "ms";
+    } else if (ns >= 1e3) {
+        ss << std::setprecision(2) << ns / 1e3 << "us";
+    } else {
+        ss << std::setprecision(1) << ns << "ns";
+    }
+    return ss.str();
+}
+
+std::string to_json(const std::vector<Comparison> &comparisons,
+                    const std::vector<std::string> &missing,
+                    const double threshold, const double noise) {
+    std::stringstream ss;
+    ss << std::setprecision(6);
+    ss << "{\n";
+    ss << "  \"threshold_percent\": " << threshold << ",\n";
+    ss << "  \"noise\": " << noise << ",\n";
+    ss << "  \"benchmarks\": [";
+    for (size_t i = 0; i < comparisons.size(); i++) {
+        const auto &c = comparisons[i];
+        ss << (i == 0 ? "\n" : ",\n");
+        ss << "    {\"name\": \"" << c.name
+           << "\", \"baseline_median_ns\": " << c.baseline.median_ns
+           << ", \"baseline_mad_ns\": " << c.baseline.mad_ns
+           << ", \"current_median_ns\": " << c.current.median_ns
+           << ", \"current_mad_ns\": " << c.current.mad_ns
+           << ", \"change_percent\": " << c.change_percent
+           << ", \"regression\": " << (c.regression ? "true" : "false")
+           << "}";
+    }
+    ss << "\n  ],\n";
+    ss << "  \"missing\": [";
+    for (size_t i = 0; i < missing.size(); i++) {
+        ss << (i == 0 ? "" : ", ") << "\"" << missing[i] << "\"";
+    }
+    ss << "]\n}\n";
+    return ss.str();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    argh::parser cmdl;
+    cmdl.add_params({"--threshold", "--noise", "--json"});
+    cmdl.parse(argc, argv);
+    if (!cmdl(2)) {
+        usage(cmdl[0]);
+        return -1;
+    }
+    if (!cmdl.flags().empty()) {
+        std::cout << "Invalid flag: " << *cmdl.flags().begin() << std::endl;
+        usage(cmdl[0]);
+        return -2;
+    }
+    double threshold = 5.;
+    double noise = 3.;
+    cmdl("threshold", threshold) >> threshold;
+    cmdl("noise", noise) >> noise;
+    const auto json = cmdl("json").str();
+
+    std::map<std::string, std::vector<double>> baseline_runs, current_runs;
+    if (!read_runs(cmdl[1], baseline_runs) ||
+        !read_runs(cmdl[2], current_runs)) {
+        return -3;
+    }
+
+    std::vector<Comparison> comparisons;
+    // The benchmarks in only one of the files
+    std::vector<std::string> missing;
+    for (const auto &pair : baseline_runs) {
+        if (current_runs.find(pair.first) == current_runs.end()) {
+            missing.push_back(pair.first);
+        }
+    }
+    for (const auto &pair : current_runs) {
+        const auto it = baseline_runs.find(pair.first);
+        if (it == baseline_runs.end()) {
+            missing.push_back(pair.first);
+            continue;
+        }
+        Comparison c;
+        c.name = pair.first;
+        c.baseline = summarize(it->second);
+        c.current = summarize(pair.second);
+        const auto diff = c.current.median_ns - c.baseline.median_ns;
+        const auto spread = noise * (c.baseline.mad_ns + c.current.mad_ns);
+        c.change_percent = 100. * diff / std::max(c.baseline.median_ns, 1e-9);
+        c.regression = c.change_percent > threshold && diff > spread;
+        c.improvement = c.change_percent < -threshold && -diff > spread;
+        comparisons.push_back(c);
+    }
+
+    size_t regressions = 0;
+    for (const auto &c : comparisons) {
+        regressions += c.regression;
+    }
+    if (json != "stdout") {
+        size_t width = 9;
+        for (const auto &c : comparisons) {
+            width = std::max(width, c.name.size());
+        }
+        std::cout << std::left << std::setw(width + 2) << "benchmark"
+                  << std::right << std::setw(12) << "baseline"
+                  << std::setw(10) << "mad" << std::setw(12) << "current"
+                  << std::setw(10) << "mad" << std::setw(10) << "change"
+                  << std::endl;
+        for (const auto &c : comparisons) {
+            std::stringstream change;
+            change << std::showpos << std::fixed << std::setprecision(1)
+                   << c.change_percent << "%";
+            std::cout << std::left << std::setw(width + 2) << c.name
+                      << std::right << std::setw(12)
+                      << format_ns(c.baseline.median_ns) << std::setw(10)
+                      << format_ns(c.baseline.mad_ns) << std::setw(12)
+                      << format_ns(c.current.median_ns) << std::setw(10)
+                      << format_ns(c.current.mad_ns) << std::setw(10)
+                      << change.str()
+                      << (c.regression
+                              ? "  REGRESSION"
+                              : c.improvement ? "  improvement" : "")
+                      << std::endl;
+        }
+        for (const auto &name : missing) {
+            std::cout << "Only in one of the files: " << name << std::endl;
+        }
+        std::cout << regressions << " of " << comparisons.size()
+                  << " benchmarks regressed by more than " << threshold
+                  << "% and " << noise << " MADs" << std::endl;
+    }
+    if (!json.empty()) {
+        const auto report = to_json(comparisons, missing, threshold, noise);
+        if (json == "stdout") {
+            std::cout << report;
+        } else {
+            std::ofstream ofs(json);
+            if (!ofs.is_open()) {
+                std::cout << "Cannot open " << json << std::endl;
+                return -4;
+            }
+            ofs << report;
+        }
+    }
+    return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,356 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+// Measure the end to end latency of a model on random inputs of the shape
+// of its input
+//
+// Usage: dabnn_benchmark_model model.dab [--warmup 10] [--iterations 50]
+//            [--threads 1] [--batch 1] [--cold] [--flush-mb n] [--layers]
+//            [--counters] [--peak-gflops x] [--peak-gbops x] [--peak-gbps x]
+//            [--memory-trace trace.csv] [--json out.json or stdout]
+//
+// dabnn runs a net on the calling thread, so --threads runs a net per
+// thread at the same time and the throughput is of all of them. --cold
+// writes a buffer of twice the last level cache before every run, or of
+// --flush-mb MB.
+// --layers profiles the layers of the first net in more runs after the
+// timed ones, so the profiler does not slow down the timed runs.
+// --memory-trace traces the memory of another net over its prepare and 3
+// runs, prints the peak and the allocations of the runs, and writes the
+// timeline of the live memory.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <common/argh.h>
+#include <common/helper.h>
+#include <dabnn/cpu_info.h>
+#include <dabnn/net.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string model;
+    int warmup = 10;
+    int iterations = 50;
+    int threads = 1;
+    int batch = 1;
+    bool cold = false;
+    // 0 for twice the last level cache
+    size_t flush_mb = 0;
+    bool layers = false;
+    bool counters = false;
+    double peak_gflops = 0.;
+    double peak_gbops = 0.;
+    double peak_gbps = 0.;
+    std::string memory_trace;
+    // "stdout" prints it instead of the summary
+    std::string json;
+};
+
+struct Stats {
+    double min = 0.;
+    double mean = 0.;
+    double p50 = 0.;
+    double p90 = 0.;
+    double p99 = 0.;
+    double max = 0.;
+};
+
+/**
+ * Evict the model from the caches by writing a buffer larger than the last
+ * level cache
+ */
+class CacheFlusher {
+   public:
+    explicit CacheFlusher(const size_t bytes) : buf_(bytes) {}
+    void flush() {
+        volatile char *p = buf_.data();
+        // A write per cache line
+        for (size_t i = 0; i < buf_.size(); i += 64) {
+            p[i] = p[i] + 1;
+        }
+    }
+
+   private:
+    std::vector<char> buf_;
+};
+
+struct Worker {
+    std::shared_ptr<bnn::Net> net;
+    std::vector<float> input;
+    std::vector<double> times_ms;
+};
+
+void usage(const std::string &filename) {
+    std::cout << "Usage:" << std::endl;
+    std::cout << "  " << filename
+              << " model.dab [--warmup 10] [--iterations 50] [--threads 1] "
+                 "[--batch 1] [--cold] [--flush-mb n] [--layers] "
+                 "[--counters] [--peak-gflops x] [--peak-gbops x] "
+                 "[--peak-gbps x] [--memory-trace trace.csv] "
+                 "[--json out.json]"
+              << std::endl;
+}
+
+/**
+ * The bytes written before every run by --cold, 0 without it
+ */
+size_t flush_bytes(const Options &opts) {
+    if (!opts.cold) {
+        return 0;
+    }
+    if (opts.flush_mb > 0) {
+        return opts.flush_mb << 20;
+    }
+    const auto &cache = bnn::cache_info();
+    return 2 * std::max(cache.l3, cache.l2);
+}
+
+/**
+ * The nearest rank percentile of sorted values
+ */
+double percentile(const std::vector<double> &sorted, const double p) {
+    const auto rank =
+        static_cast<size_t>(std::ceil(p / 100. * sorted.size()));
+    return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+Stats stats(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    Stats s;
+    s.min = values.front();
+    s.max = values.back();
+    double sum = 0.;
+    for (const auto v : values) {
+        sum += v;
+    }
+    s.mean = sum / values.size();
+    s.p50 = percentile(values, 50.);
+    s.p90 = percentile(values, 90.);
+    s.p99 = percentile(values, 99.);
+    return s;
+}
+
+double to_ms(const Clock::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+std::string to_json(const Options &opts, const Stats &latency,
+                    const double throughput, const bnn::Profiler *profiler) {
+    std::stringstream ss;
+    ss << std::setprecision(6);
+    ss << "{\n";
+    ss << "  \"model\": \"" << json_escape(opts.model) << "\",\n";
+    ss << "  \"warmup\": " << opts.warmup << ",\n";
+    ss << "  \"iterations\": " << opts.iterations << ",\n";
+    ss << "  \"threads\": " << opts.threads << ",\n";
+    ss << "  \"batch\": " << opts.batch << ",\n";
+    ss << "  \"cold_cache\": " << (opts.cold ? "true" : "false") << ",\n";
+    ss << "  \"flush_bytes\": " << flush_bytes(opts) << ",\n";
+    ss << "  \"latency_ms\": {\"min\": " << latency.min
+       << ", \"mean\": " << latency.mean << ", \"p50\": " << latency.p50
+       << ", \"p90\": " << latency.p90 << ", \"p99\": " << latency.p99
+       << ", \"max\": " << latency.max << "},\n";
+    ss << "  \"images_per_second\": " << throughput;
+    if (profiler != nullptr) {
+        ss << ",\n  \"layers\": [";
+        const auto &entries = profiler->entries();
+        FORZ(i, entries.size()) {
+            const auto &entry = entries[i];
+            const auto calls = std::max<int64_t>(entry.calls, 1);
+            ss << (i == 0 ? "\n" : ",\n");
+            ss << "    {\"index\": " << entry.index << ", \"name\": \""
+               << json_escape(entry.name) << "\", \"type\": \""
+               << json_escape(entry.type) << "\", \"calls\": " << entry.calls
+               << ", \"mean_ms\": " << entry.total_ns / 1e6 / calls
+               << ", \"min_ms\": " << entry.min_ns / 1e6
+               << ", \"max_ms\": " << entry.max_ns / 1e6
+               << ", \"flops\": " << entry.work.flops
+               << ", \"bit_ops\": " << entry.work.bit_ops
+               << ", \"bytes\": "
+               << entry.work.bytes_read + entry.work.bytes_written << "}";
+        }
+        ss << "\n  ]";
+    }
+    ss << "\n}\n";
+    return ss.str();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    argh::parser cmdl;
+    cmdl.add_params({"--warmup", "--iterations", "--threads", "--batch",
+                     "--flush-mb", "--peak-gflops", "--peak-gbops",
+                     "--peak-gbps", "--memory-trace", "--json"});
+    cmdl.parse(argc, argv);
+    google::InitGoogleLogging(cmdl[0].c_str());
+    FLAGS_alsologtostderr = true;
+    if (!cmdl(1)) {
+        usage(cmdl[0]);
+        return -1;
+    }
+    for (const auto &flag : cmdl.flags()) {
+        if (flag != "cold" && flag != "layers" && flag != "counters") {
+            std::cout << "Invalid flag: " << flag << std::endl;
+            usage(cmdl[0]);
+            return -2;
+        }
+    }
+
+    Options opts;
+    opts.model = cmdl[1];
+    cmdl("warmup", opts.warmup) >> opts.warmup;
+    cmdl("iterations", opts.iterations) >> opts.iterations;
+    cmdl("threads", opts.threads) >> opts.threads;
+    cmdl("batch", opts.batch) >> opts.batch;
+    cmdl("flush-mb", opts.flush_mb) >> opts.flush_mb;
+    cmdl("peak-gflops", opts.peak_gflops) >> opts.peak_gflops;
+    cmdl("peak-gbops", opts.peak_gbops) >> opts.peak_gbops;
+    cmdl("peak-gbps", opts.peak_gbps) >> opts.peak_gbps;
+    opts.memory_trace = cmdl("memory-trace").str();
+    opts.json = cmdl("json").str();
+    opts.cold = cmdl["cold"];
+    opts.layers = cmdl["layers"];
+    opts.counters = cmdl["counters"];
+    if (opts.warmup < 0 || opts.iterations < 1 || opts.threads < 1 ||
+        opts.batch < 1) {
+        std::cout << "Invalid warmup, iterations, threads or batch"
+                  << std::endl;
+        return -3;
+    }
+
+    std::vector<Worker> workers(opts.threads);
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> dist(-1.f, 1.f);
+    size_t image_len = 0;
+    for (auto &worker : workers) {
+        worker.net = bnn::Net::create();
+        worker.net->max_batch = opts.batch;
+        worker.net->read(opts.model);
+        const auto *shape = worker.net->model_->inputs()->Get(0)->shape();
+        image_len =
+            static_cast<size_t>(shape->Get(1)) * shape->Get(2) * shape->Get(3);
+        worker.input.resize(image_len * opts.batch);
+        for (auto &v : worker.input) {
+            v = dist(rng);
+        }
+    }
+
+    std::atomic<int> ready(0);
+    const auto run_worker = [&](Worker &worker) {
+        CacheFlusher flusher(flush_bytes(opts));
+        FORZ(i, opts.warmup) {
+            worker.net->run(worker.input.data(), opts.batch);
+        }
+        // Start the timed runs of all threads together
+        ready++;
+        while (ready.load() < opts.threads) {
+            std::this_thread::yield();
+        }
+        FORZ(i, opts.iterations) {
+            if (opts.cold) {
+                flusher.flush();
+            }
+            const auto t1 = Clock::now();
+            worker.net->run(worker.input.data(), opts.batch);
+            worker.times_ms.push_back(to_ms(Clock::now() - t1));
+        }
+    };
+    std::vector<std::thread> threads;
+    for (auto &worker : workers) {
+        threads.emplace_back(run_worker, std::ref(worker));
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    std::vector<double> times_ms;
+    for (const auto &worker : workers) {
+        times_ms.insert(times_ms.end(), worker.times_ms.begin(),
+                        worker.times_ms.end());
+    }
+    const auto latency = stats(times_ms);
+    // Of the runs at the same time, without the flushes of --cold
+    const double throughput =
+        1e3 * opts.threads * opts.batch / std::max(latency.mean, 1e-9);
+
+    const bnn::Profiler *profiler = nullptr;
+    if (opts.layers) {
+        auto &net = *workers[0].net;
+        net.profile = true;
+        net.profile_counters = opts.counters;
+        net.profiler.peak_gflops = opts.peak_gflops;
+        net.profiler.peak_gbops = opts.peak_gbops;
+        net.profiler.peak_gbps = opts.peak_gbps;
+        CacheFlusher flusher(flush_bytes(opts));
+        FORZ(i, opts.iterations) {
+            if (opts.cold) {
+                flusher.flush();
+            }
+            net.run(workers[0].input.data(), opts.batch);
+        }
+        profiler = &net.profiler;
+    }
+
+    std::string memory_summary;
+    if (!opts.memory_trace.empty()) {
+        auto net = bnn::Net::create();
+        net->max_batch = opts.batch;
+        net->trace_memory = true;
+        net->read(opts.model);
+        // The first run may allocate, the later ones should not
+        FORZ(i, 3) { net->run(workers[0].input.data(), opts.batch); }
+        memory_summary = net->memory_trace.summary();
+        std::ofstream ofs(opts.memory_trace);
+        if (!ofs.is_open()) {
+            std::cout << "Cannot open " << opts.memory_trace << std::endl;
+            return -4;
+        }
+        ofs << net->memory_trace.timeline_csv();
+    }
+
+    if (opts.json != "stdout") {
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << opts.model << ": input " << image_len << " values x "
+                  << opts.batch << ", " << opts.threads << " threads, "
+                  << opts.warmup << " warmup and " << opts.iterations
+                  << " iterations" << (opts.cold ? ", cold cache" : "")
+                  << std::endl;
+        std::cout << "latency(ms): min " << latency.min << ", mean "
+                  << latency.mean << ", p50 " << latency.p50 << ", p90 "
+                  << latency.p90 << ", p99 " << latency.p99 << ", max "
+                  << latency.max << std::endl;
+        std::cout << "throughput: " << throughput << " images/s" << std::endl;
+        if (profiler != nullptr) {
+            std::cout << profiler->table();
+        }
+        std::cout << memory_summary;
+    }
+    if (!opts.json.empty()) {
+        const auto json = to_json(opts, latency, throughput, profiler);
+        if (opts.json == "stdout") {
+            std::cout << json;
+        } else {
+            std::ofstream ofs(opts.json);
+            if (!ofs.is_open()) {
+                std::cout << "Cannot open " << opts.json << std::endl;
+                return -4;
+            }
+            ofs << json;
+        }
+    }
+    return 0;
+}
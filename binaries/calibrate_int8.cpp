@@ -0,0 +1,51 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+// Record the input ranges of the float convs and fcs of a float model for
+// onnx2bnn --int8-ranges
+//
+// Usage: calibrate_int8 model.dab images.bin ranges.txt
+// images.bin holds the preprocessed images as raw float32 NHWC, one after
+// another
+
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <common/helper.h>
+#include <dabnn/net.h>
+
+int main(int argc, char **argv) {
+    if (argc != 4) {
+        std::cout << "Usage: " << argv[0]
+                  << " model.dab images.bin ranges.txt" << std::endl;
+        return -1;
+    }
+    auto net = bnn::Net::create();
+    net->calibrate_int8 = true;
+    net->read(argv[1]);
+
+    const auto *shape = net->model_->inputs()->Get(0)->shape();
+    const size_t image_len =
+        static_cast<size_t>(shape->Get(1)) * shape->Get(2) * shape->Get(3);
+    std::ifstream ifs(argv[2], std::ios::binary);
+    if (!ifs.is_open()) {
+        std::cout << "Cannot open " << argv[2] << std::endl;
+        return -2;
+    }
+    std::vector<float> image(image_len);
+    int images = 0;
+    while (ifs.read(reinterpret_cast<char *>(image.data()),
+                    image_len * sizeof(float))) {
+        net->run(image.data());
+        images++;
+    }
+    BNN_ASSERT(images > 0, "No complete image in ", argv[2]);
+
+    std::ofstream ofs(argv[3]);
+    for (const auto &range : net->int8_ranges) {
+        ofs << range.first << " " << range.second << std::endl;
+    }
+    std::cout << "Calibrated " << net->int8_ranges.size() << " layers on "
+              << images << " images" << std::endl;
+    return 0;
+}
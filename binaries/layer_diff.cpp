@@ -0,0 +1,388 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+// Run a model with the reference kernels (optimize off) and with the
+// optimized ones on the same random inputs, compare every blob and report
+// the first layer whose output differs
+//
+// Usage: dabnn_layer_diff model.dab [--seeds 10] [--first-seed 0]
+//            [--atol 1e-4] [--rtol 1e-4] [--json out.json or stdout]
+//
+// The input of a seed is uniform in [-1, 1). A float value differs when
+// |optimized - reference| > atol + rtol * |reference|, and a bit differs
+// when the signs do, the reference blob is packed like the optimized one
+// when only the optimized one is binary (e.g., the output of a max pool
+// read by binary convs). A blob written in place (e.g., by bn, relu or a
+// residual add) is compared after the last of them, at the layer
+// allocating it. A float blob before a binary conv may differ in the last
+// bits only, and still flip the bits of values close to 0 after it. The
+// exit code is 1 if any blob differs.
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <common/argh.h>
+#include <common/helper.h>
+#include <dabnn/bitpack.h>
+#include <dabnn/net.h>
+
+namespace {
+
+struct Options {
+    std::string model;
+    int seeds = 10;
+    int first_seed = 0;
+    double atol = 1e-4;
+    double rtol = 1e-4;
+    // "stdout" prints it instead of the table
+    std::string json;
+};
+
+/**
+ * The differences of a blob over all seeds
+ */
+struct BlobDiff {
+    bnn::BlobSource source;
+    std::string shape;
+    std::string data_types;
+    // The optimized layer writing the blob, with its method
+    std::string method;
+    int64_t values = 0;
+    int64_t mismatches = 0;
+    int seeds_differing = 0;
+    double max_abs_diff = 0.;
+    // The first differing value of the first seed with one
+    int first_seed = -1;
+    std::string first;
+};
+
+void usage(const std::string &filename) {
+    std::cout << "Usage:" << std::endl;
+    std::cout << "  " << filename
+              << " model.dab [--seeds 10] [--first-seed 0] [--atol 1e-4] "
+                 "[--rtol 1e-4] [--json out.json]"
+              << std::endl;
+}
+
+const char *data_type_str(const bnn::DataType data_type) {
+    switch (data_type) {
+        case bnn::DataType::Float:
+            return "float";
+        case bnn::DataType::Half:
+            return "half";
+        case bnn::DataType::Bit:
+            return "bit";
+        case bnn::DataType::Int8:
+            return "int8";
+    }
+    return "";
+}
+
+std::string shape_str(const bnn::Mat &mat) {
+    std::stringstream ss;
+    ss << "[" << mat.n << ", " << mat.h << ", " << mat.w << ", "
+       << mat.elem_c << "]";
+    return ss.str();
+}
+
+std::string position(const int n, const int h, const int w, const int c) {
+    std::stringstream ss;
+    ss << "[" << n << ", " << h << ", " << w << ", " << c << "]";
+    return ss.str();
+}
+
+float value(const bnn::Mat &mat, const int n, const int h, const int w,
+            const int c) {
+    const size_t i = (static_cast<size_t>(n) * mat.h + h) * mat.hstep +
+                     static_cast<size_t>(w) * mat.c + c;
+    if (mat.data_type == bnn::DataType::Half) {
+        const auto *data = static_cast<const bnn::half_t *>(mat.data);
+        return bnn::half_to_float(data[i]);
+    }
+    return static_cast<const float *>(mat.data)[i];
+}
+
+/**
+ * Compare two float or fp16 blobs
+ */
+void compare_floats(const bnn::Mat &reference, const bnn::Mat &optimized,
+                    const Options &opts, const int seed, BlobDiff &diff) {
+    int64_t mismatches = 0;
+    FORZ(n, reference.n) {
+        FORZ(h, reference.h) {
+            FORZ(w, reference.w) {
+                FORZ(c, reference.c) {
+                    const float r = value(reference, n, h, w, c);
+                    const float o = value(optimized, n, h, w, c);
+                    const double d = std::abs(static_cast<double>(o) - r);
+                    diff.max_abs_diff = std::max(diff.max_abs_diff, d);
+                    // NaN differs as well
+                    if (!(d <= opts.atol + opts.rtol * std::abs(r))) {
+                        if (mismatches == 0 && diff.first_seed < 0) {
+                            std::stringstream ss;
+                            ss << position(n, h, w, c)
+                               << ": reference " << r << " vs optimized "
+                               << o;
+                            diff.first = ss.str();
+                            diff.first_seed = seed;
+                        }
+                        mismatches++;
+                    }
+                }
+            }
+        }
+    }
+    diff.values += static_cast<int64_t>(reference.n) * reference.h *
+                   reference.w * reference.c;
+    diff.mismatches += mismatches;
+    diff.seeds_differing += mismatches > 0;
+}
+
+/**
+ * Compare two binary blobs, or a float reference packed like the binary
+ * optimized blob
+ */
+void compare_bits(const bnn::Mat &reference, const bnn::Mat &optimized,
+                  const int seed, BlobDiff &diff) {
+    std::shared_ptr<bnn::Mat> packed;
+    const bnn::Mat *bits = &reference;
+    if (reference.data_type != bnn::DataType::Bit) {
+        packed = std::make_shared<bnn::Mat>(
+            optimized.n, optimized.w, optimized.h, optimized.elem_c,
+            bnn::DataType::Bit,
+            optimized.hstep != static_cast<size_t>(optimized.w) * optimized.c);
+        bnn::pack_mat(reference, *packed);
+        bits = packed.get();
+    }
+    int64_t mismatches = 0;
+    FORZ(n, optimized.n) {
+        FORZ(h, optimized.h) {
+            const auto *r = bits->point<uint64_t>(n, h, 0);
+            const auto *o = optimized.point<uint64_t>(n, h, 0);
+            FORZ(i, optimized.w * optimized.c) {
+                const uint64_t x = r[i] ^ o[i];
+                if (x == 0) {
+                    continue;
+                }
+                if (mismatches == 0 && diff.first_seed < 0) {
+                    const int bit = __builtin_ctzll(x);
+                    std::stringstream ss;
+                    ss << position(n, h, i / optimized.c,
+                                   i % optimized.c * 64 + bit)
+                       << ": reference " << ((r[i] >> bit) & 1)
+                       << " vs optimized " << ((o[i] >> bit) & 1);
+                    diff.first = ss.str();
+                    diff.first_seed = seed;
+                }
+                mismatches += __builtin_popcountll(x);
+            }
+        }
+    }
+    diff.values += static_cast<int64_t>(optimized.n) * optimized.h *
+                   optimized.w * optimized.elem_c;
+    diff.mismatches += mismatches;
+    diff.seeds_differing += mismatches > 0;
+}
+
+void compare(const bnn::Mat &reference, const bnn::Mat &optimized,
+             const Options &opts, const int seed, BlobDiff &diff) {
+    BNN_ASSERT(reference.n == optimized.n && reference.h == optimized.h &&
+                   reference.w == optimized.w &&
+                   reference.elem_c == optimized.elem_c,
+               "The shapes of ", diff.source.blob, " differ: ",
+               shape_str(reference), " vs ", shape_str(optimized));
+    const bool reference_bits = reference.data_type == bnn::DataType::Bit;
+    const bool optimized_bits = optimized.data_type == bnn::DataType::Bit;
+    BNN_ASSERT(!reference_bits || optimized_bits,
+               "A binary reference blob needs a binary optimized one, ",
+               diff.source.blob);
+    BNN_ASSERT(reference.data_type != bnn::DataType::Int8 &&
+                   optimized.data_type != bnn::DataType::Int8,
+               "int8 blobs are not compared, ", diff.source.blob);
+    if (optimized_bits) {
+        compare_bits(reference, optimized, seed, diff);
+    } else {
+        compare_floats(reference, optimized, opts, seed, diff);
+    }
+}
+
+/**
+ * Layer::to_str() of the optimized layer with the name of the source layer,
+ * which tells the method of a conv
+ */
+std::string method(const bnn::Net &net, const bnn::BlobSource &source) {
+    if (source.layer.empty() || source.type == "Input") {
+        return "";
+    }
+    for (const auto &layer : net.get_layers()) {
+        if (layer->name_ == source.layer) {
+            return layer->to_str();
+        }
+    }
+    return "fused into another layer";
+}
+
+std::string to_json(const Options &opts, const std::vector<BlobDiff> &diffs,
+                    const int first_divergent) {
+    std::stringstream ss;
+    ss << std::setprecision(6);
+    ss << "{\n";
+    ss << "  \"model\": \"" << json_escape(opts.model) << "\",\n";
+    ss << "  \"seeds\": " << opts.seeds << ",\n";
+    ss << "  \"first_seed\": " << opts.first_seed << ",\n";
+    ss << "  \"atol\": " << opts.atol << ",\n";
+    ss << "  \"rtol\": " << opts.rtol << ",\n";
+    ss << "  \"first_divergent\": " << first_divergent << ",\n";
+    ss << "  \"blobs\": [";
+    FORZ(i, diffs.size()) {
+        const auto &d = diffs[i];
+        ss << (i == 0 ? "\n" : ",\n");
+        ss << "    {\"index\": " << i << ", \"blob\": \""
+           << json_escape(d.source.blob) << "\", \"layer\": \""
+           << json_escape(d.source.layer) << "\", \"type\": \""
+           << json_escape(d.source.type) << "\", \"shape\": \"" << d.shape
+           << "\", \"data_types\": \"" << d.data_types << "\", \"method\": \""
+           << json_escape(d.method) << "\", \"values\": " << d.values
+           << ", \"mismatches\": " << d.mismatches
+           << ", \"seeds_differing\": " << d.seeds_differing
+           << ", \"max_abs_diff\": " << d.max_abs_diff
+           << ", \"first_mismatch\": \"" << json_escape(d.first) << "\"}";
+    }
+    ss << "\n  ]\n}\n";
+    return ss.str();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    argh::parser cmdl;
+    cmdl.add_params({"--seeds", "--first-seed", "--atol", "--rtol", "--json"});
+    cmdl.parse(argc, argv);
+    google::InitGoogleLogging(cmdl[0].c_str());
+    FLAGS_alsologtostderr = true;
+    if (!cmdl(1)) {
+        usage(cmdl[0]);
+        return -1;
+    }
+    if (!cmdl.flags().empty()) {
+        std::cout << "Invalid flag: " << *cmdl.flags().begin() << std::endl;
+        usage(cmdl[0]);
+        return -2;
+    }
+
+    Options opts;
+    opts.model = cmdl[1];
+    cmdl("seeds", opts.seeds) >> opts.seeds;
+    cmdl("first-seed", opts.first_seed) >> opts.first_seed;
+    cmdl("atol", opts.atol) >> opts.atol;
+    cmdl("rtol", opts.rtol) >> opts.rtol;
+    opts.json = cmdl("json").str();
+    if (opts.seeds < 1 || opts.atol < 0 || opts.rtol < 0) {
+        std::cout << "Invalid seeds, atol or rtol" << std::endl;
+        return -3;
+    }
+
+    auto reference = bnn::Net::create();
+    reference->optimize = false;
+    reference->read(opts.model);
+    auto optimized = bnn::Net::create();
+    optimized->read(opts.model);
+
+    const auto *shape = reference->model_->inputs()->Get(0)->shape();
+    const int batch = static_cast<int>(shape->Get(0));
+    std::vector<float> input(static_cast<size_t>(batch) * shape->Get(1) *
+                             shape->Get(2) * shape->Get(3));
+    std::vector<BlobDiff> diffs;
+    for (const auto &source : reference->blob_sources()) {
+        BlobDiff diff;
+        diff.source = source;
+        diff.method = method(*optimized, source);
+        diffs.push_back(diff);
+    }
+    FORZ(i, opts.seeds) {
+        const int seed = opts.first_seed + static_cast<int>(i);
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> dist(-1.f, 1.f);
+        for (auto &v : input) {
+            v = dist(rng);
+        }
+        reference->run(input.data(), batch);
+        optimized->run(input.data(), batch);
+        for (auto &diff : diffs) {
+            const auto &r = *reference->get_blob(diff.source.blob);
+            const auto &o = *optimized->get_blob(diff.source.blob);
+            diff.shape = shape_str(r);
+            diff.data_types = std::string(data_type_str(r.data_type)) + "/" +
+                              data_type_str(o.data_type);
+            compare(r, o, opts, seed, diff);
+        }
+    }
+
+    int first_divergent = -1;
+    FORZ(i, diffs.size()) {
+        if (diffs[i].mismatches > 0) {
+            first_divergent = static_cast<int>(i);
+            break;
+        }
+    }
+    if (opts.json != "stdout") {
+        size_t width = 5;
+        for (const auto &d : diffs) {
+            width = std::max(width, d.source.blob.size());
+        }
+        std::cout << opts.model << ": " << opts.seeds << " seeds from "
+                  << opts.first_seed << ", atol " << opts.atol << ", rtol "
+                  << opts.rtol << std::endl;
+        std::cout << std::left << std::setw(width + 2) << "blob"
+                  << std::setw(14) << "type" << std::setw(22) << "shape"
+                  << std::setw(12) << "ref/opt" << std::right
+                  << std::setw(14) << "max_abs_diff" << std::setw(12)
+                  << "mismatched" << std::setw(8) << "seeds" << std::endl;
+        for (const auto &d : diffs) {
+            std::stringstream mismatched;
+            mismatched << std::fixed << std::setprecision(4)
+                       << 100. * d.mismatches / std::max<int64_t>(d.values, 1)
+                       << "%";
+            std::cout << std::left << std::setw(width + 2) << d.source.blob
+                      << std::setw(14) << d.source.type << std::setw(22)
+                      << d.shape << std::setw(12) << d.data_types
+                      << std::right << std::setw(14) << d.max_abs_diff
+                      << std::setw(12) << mismatched.str() << std::setw(8)
+                      << d.seeds_differing << std::endl;
+        }
+        if (first_divergent < 0) {
+            std::cout << "No blob differs" << std::endl;
+        } else {
+            const auto &d = diffs[first_divergent];
+            std::cout << "First divergent layer: "
+                      << (d.source.layer.empty() ? "(unnamed)"
+                                                 : d.source.layer)
+                      << " (" << d.source.type << "), blob " << d.source.blob
+                      << " " << d.shape << " " << d.data_types << std::endl;
+            std::cout << "  optimized: " << d.method << std::endl;
+            std::cout << "  seed " << d.first_seed << ", at " << d.first
+                      << std::endl;
+        }
+    }
+    if (!opts.json.empty()) {
+        const auto json = to_json(opts, diffs, first_divergent);
+        if (opts.json == "stdout") {
+            std::cout << json;
+        } else {
+            std::ofstream ofs(opts.json);
+            if (!ofs.is_open()) {
+                std::cout << "Cannot open " << opts.json << std::endl;
+                return -4;
+            }
+            ofs << json;
+        }
+    }
+    return first_divergent < 0 ? 0 : 1;
+}
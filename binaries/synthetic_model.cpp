@@ -0,0 +1,77 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+// Write a model of random weights, e.g., for dabnn_benchmark_model on a
+// machine without the downloaded models
+//
+// Usage: dabnn_synthetic_model model.dab [--arch bireal|resnet|shufflenet]
+//            [--stages 4] [--blocks 2] [--width 64] [--resolution 224]
+//            [--classes 1000] [--seed 0] [--float]
+
+#include <iostream>
+#include <string>
+
+#include <common/argh.h>
+#include <common/helper.h>
+#include <common/synthetic_model.h>
+
+namespace {
+
+void usage(const std::string &filename) {
+    std::cout << "Usage:" << std::endl;
+    std::cout << "  " << filename
+              << " model.dab [--arch bireal|resnet|shufflenet] [--stages 4] "
+                 "[--blocks 2] [--width 64] [--resolution 224] "
+                 "[--classes 1000] [--seed 0] [--float]"
+              << std::endl;
+    std::cout << "The blocks of a stage are basic blocks for resnet and "
+                 "shufflenet, and two units of a conv and a shortcut for "
+                 "bireal. --float makes the 3x3 convs of the blocks float."
+              << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    argh::parser cmdl;
+    cmdl.add_params({"--arch", "--stages", "--blocks", "--width",
+                     "--resolution", "--classes", "--seed"});
+    cmdl.parse(argc, argv);
+    google::InitGoogleLogging(cmdl[0].c_str());
+    FLAGS_alsologtostderr = true;
+    if (!cmdl(1)) {
+        usage(cmdl[0]);
+        return -1;
+    }
+    for (const auto &flag : cmdl.flags()) {
+        if (flag != "float") {
+            std::cout << "Invalid flag: " << flag << std::endl;
+            usage(cmdl[0]);
+            return -2;
+        }
+    }
+
+    bnn::SyntheticModel model;
+    const auto arch = cmdl("arch", "bireal").str();
+    if (arch == "bireal") {
+        model.arch = bnn::SyntheticModel::Arch::kBiReal;
+    } else if (arch == "resnet") {
+        model.arch = bnn::SyntheticModel::Arch::kResNet;
+    } else if (arch == "shufflenet") {
+        model.arch = bnn::SyntheticModel::Arch::kShuffleNet;
+    } else {
+        std::cout << "Invalid arch: " << arch << std::endl;
+        usage(cmdl[0]);
+        return -3;
+    }
+    cmdl("stages", model.stages) >> model.stages;
+    cmdl("blocks", model.blocks_per_stage) >> model.blocks_per_stage;
+    cmdl("width", model.width) >> model.width;
+    cmdl("resolution", model.resolution) >> model.resolution;
+    cmdl("classes", model.classes) >> model.classes;
+    cmdl("seed", model.seed) >> model.seed;
+    model.binary = !cmdl["float"];
+
+    model.save(cmdl[1]);
+    std::cout << "Wrote " << model.name() << " to " << cmdl[1] << std::endl;
+    return 0;
+}
@@ -0,0 +1,37 @@
+#! /usr/bin/env bash
+# Run the benchmarks and compare them with a stored baseline, fail if any of
+# them regresses. --update stores the run as the new baseline instead.
+#
+# Usage: ci/benchmark_regression.sh build_dir baseline.json [--update]
+#
+# The environment variables REPETITIONS, THRESHOLD (percent), NOISE (MADs)
+# and FILTER (a regex of the benchmarks) override the defaults. The baseline
+# is only meaningful on the machine which stored it.
+set -e
+
+if [[ $# -lt 2 ]]; then
+    echo "Usage: $0 build_dir baseline.json [--update]"
+    exit 2
+fi
+build_dir=$1
+baseline=$2
+repetitions=${REPETITIONS:-5}
+threshold=${THRESHOLD:-5}
+noise=${NOISE:-3}
+# The bitpack, bgemm, bconv and pooling kernels, and the whole models which
+# need no downloaded model
+filter=${FILTER:-"BM_pack_mat_64$|BM_bgemm_256$|BM_bnn_bconv_3x3_(64|128|256)$|BM_maxpool|BM_synthetic"}
+
+current=$(mktemp /tmp/dabnn_benchmark.XXXXXX.json)
+trap 'rm -f $current' EXIT
+$build_dir/benchmark/dabnn_benchmark --benchmark_filter="$filter" \
+    --benchmark_repetitions=$repetitions \
+    --benchmark_out=$current --benchmark_out_format=json
+
+if [[ "$3" == "--update" ]]; then
+    cp $current $baseline
+    echo "Stored the baseline in $baseline"
+    exit 0
+fi
+$build_dir/binaries/dabnn_benchmark_compare $baseline $current \
+    --threshold $threshold --noise $noise
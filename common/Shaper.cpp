@@ -88,6 +88,23 @@ void Shaper::DepthwiseConv(const std::string &input_name, int32_t strideX,
     shape_map_[output_name] = outputDimen;
 }
 
+void Shaper::GroupConv(const std::string &input_name,
+                       const std::vector<int32_t> strides,
+                       const std::vector<int32_t> dilations,
+                       const std::vector<int32_t> paddings,
+                       const std::string &weight_name, int32_t group,
+                       const std::string &output_name) {
+    const auto &weightDimen = shape_map_.at(weight_name);
+    if (group != 1 && weightDimen[0] == 1 &&
+        static_cast<int32_t>(weightDimen[3]) == group) {
+        Shaper::DepthwiseConv(input_name, strides, dilations, paddings,
+                              weight_name, output_name);
+    } else {
+        Shaper::Conv(input_name, strides, dilations, paddings, weight_name,
+                     output_name);
+    }
+}
+
 void Shaper::StridedSlice(const std::string &input_name,
                           const std::vector<int32_t> &starts,
                           const std::vector<int32_t> &ends,
@@ -186,10 +203,17 @@ void Shaper::FC(const std::string &input_name, const std::string &weight_name,
                 const std::string &output_name) {
     Shape weightDimen = shape_map_.at(weight_name);  // num_units, input_size
     auto input_dimen = shape_map_.at(input_name);
-    Shape outputDimen{input_dimen[0], weightDimen[0]};
+    // NHWC
+    Shape outputDimen{input_dimen[0], 1, 1, weightDimen[0]};
     shape_map_[output_name] = outputDimen;
 }
 
+void Shaper::FC(const std::string &input_name, const std::string &weight_name,
+                const std::string &bias_name, const std::string &output_name) {
+    (void)bias_name;
+    Shaper::FC(input_name, weight_name, output_name);
+}
+
 void Shaper::Eltwise(const std::string &input1_name,
                      const std::string &input2_name,
                      const std::string &output_name) {
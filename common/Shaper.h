@@ -55,6 +55,16 @@ class Shaper {
                        int32_t paddingTop, int32_t paddingBottom,
                        const std::string &weight_name,
                        const std::string &output_name);
+    /**
+     * Conv with groups, the weight is [num_output, kh, kw, num_input / group]
+     * or [1, kh, kw, num_output] for depthwise conv
+     */
+    void GroupConv(const std::string &input_name,
+                   const std::vector<int32_t> strides,
+                   const std::vector<int32_t> dilations,
+                   const std::vector<int32_t> paddings,
+                   const std::string &weight_name, int32_t group,
+                   const std::string &output_name);
     void StridedSlice(const std::string &input_name,
                       const std::vector<int32_t> &starts,
                       const std::vector<int32_t> &ends,
@@ -76,6 +86,8 @@ class Shaper {
     void LRN(const std::string &input_name, const std::string &output_name);
     void FC(const std::string &input_name, const std::string &weight_name,
             const std::string &output_name);
+    void FC(const std::string &input_name, const std::string &weight_name,
+            const std::string &bias_name, const std::string &output_name);
     void Eltwise(const std::string &input1_name, const std::string &input2_name,
                  const std::string &output_name);
     void Eltwise(const std::string &input1_name,
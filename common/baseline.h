@@ -115,6 +115,61 @@ inline void baseline_bconv(const Mat &input, const Mat &weight,
     }
 }
 
+/**
+ * Grouped binary conv computed bit by bit, the weight is
+ * [output_channels, kernel_h, kernel_w, input_channels / group], or
+ * [1, kernel_h, kernel_w, input_channels] for depthwise conv
+ */
+inline void baseline_bconv_group(const Mat &input, const Mat &weight,
+                                 const int kernel_h, const int kernel_w,
+                                 const int pad_h, const int pad_w,
+                                 const int stride_h, const int stride_w,
+                                 const int dilation_h, const int dilation_w,
+                                 const int group, Mat &output) {
+    const int input_channels = input.c * 64;
+    const int output_channels = output.c;
+    BNN_ASSERT(input_channels % group == 0 && output_channels % group == 0,
+               input_channels, output_channels, group);
+    const bool depthwise = weight.n == 1 && group == input_channels &&
+                           group == output_channels;
+    const int group_c = input_channels / group;
+    const int group_n = output_channels / group;
+    const auto HWC = weight.total() / weight.n * 64;
+    const auto *weight_ptr = static_cast<const uint64_t *>(weight.data);
+    const auto bit = [](const uint64_t *ptr, const size_t idx) {
+        return (ptr[idx / 64] >> (idx % 64)) & 1;
+    };
+    FORZ(th, output.h) {
+        FORZ(tw, output.w) {
+            FORZ(tc, output_channels) {
+                const int g = tc / group_n;
+                uint32_t acc = 0;
+                FORZ(wh, kernel_h) {
+                    const int y = th * stride_h - pad_h + wh * dilation_h;
+                    FORZ(ww, kernel_w) {
+                        const int x = tw * stride_w - pad_w + ww * dilation_w;
+                        const bool out =
+                            y < 0 || y >= input.h || x < 0 || x >= input.w;
+                        FORZ(wc, group_c) {
+                            const size_t idx =
+                                depthwise
+                                    ? (wh * kernel_w + ww) * input_channels + tc
+                                    : tc * HWC +
+                                          (wh * kernel_w + ww) * group_c + wc;
+                            const auto bottom_value =
+                                out ? 0
+                                    : bit(input.point<uint64_t>(y, x),
+                                          g * group_c + wc);
+                            acc += bit(weight_ptr, idx) ^ bottom_value;
+                        }
+                    }
+                }
+                *(output.point<float>(th, tw) + tc) = static_cast<float>(acc);
+            }
+        }
+    }
+}
+
 inline void baseline_bconv_float(const Mat &input, Mat &binary_input,
                                  const Mat &weight, const int kernel_h,
                                  const int kernel_w, const int pad_h,
@@ -40,6 +40,8 @@ struct Affine;
 
 struct PRelu;
 
+struct MultiBitConv2D;
+
 struct Layer;
 
 struct Model;
@@ -47,14 +49,16 @@ struct Model;
 enum class DataType : int8_t {
   Float32 = 0,
   Bit = 1,
+  Int8 = 2,
   MIN = Float32,
-  MAX = Bit
+  MAX = Int8
 };
 
-inline const DataType (&EnumValuesDataType())[2] {
+inline const DataType (&EnumValuesDataType())[3] {
   static const DataType values[] = {
     DataType::Float32,
-    DataType::Bit
+    DataType::Bit,
+    DataType::Int8
   };
   return values;
 }
@@ -63,13 +67,14 @@ inline const char * const *EnumNamesDataType() {
   static const char * const names[] = {
     "Float32",
     "Bit",
+    "Int8",
     nullptr
   };
   return names;
 }
 
 inline const char *EnumNameDataType(DataType e) {
-  if (e < DataType::Float32 || e > DataType::Bit) return "";
+  if (e < DataType::Float32 || e > DataType::Int8) return "";
   const size_t index = static_cast<size_t>(e);
   return EnumNamesDataType()[index];
 }
@@ -89,11 +94,12 @@ enum class LayerType : int8_t {
   Split = 11,
   Shuffle = 12,
   PRelu = 13,
+  MultiBitConv2D = 14,
   MIN = FpConv2D,
-  MAX = PRelu
+  MAX = MultiBitConv2D
 };
 
-inline const LayerType (&EnumValuesLayerType())[14] {
+inline const LayerType (&EnumValuesLayerType())[15] {
   static const LayerType values[] = {
     LayerType::FpConv2D,
     LayerType::AvePool,
@@ -108,7 +114,8 @@ inline const LayerType (&EnumValuesLayerType())[14] {
     LayerType::Binarize,
     LayerType::Split,
     LayerType::Shuffle,
-    LayerType::PRelu
+    LayerType::PRelu,
+    LayerType::MultiBitConv2D
   };
   return values;
 }
@@ -129,13 +136,14 @@ inline const char * const *EnumNamesLayerType() {
     "Split",
     "Shuffle",
     "PRelu",
+    "MultiBitConv2D",
     nullptr
   };
   return names;
 }
 
 inline const char *EnumNameLayerType(LayerType e) {
-  if (e < LayerType::FpConv2D || e > LayerType::PRelu) return "";
+  if (e < LayerType::FpConv2D || e > LayerType::MultiBitConv2D) return "";
   const size_t index = static_cast<size_t>(e);
   return EnumNamesLayerType()[index];
 }
@@ -147,7 +155,9 @@ struct Tensor FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
     VT_FLOAT32_DATA = 8,
     VT_SHAPE = 10,
     VT_NAME = 12,
-    VT_ALIGN_HWC_TO_128 = 14
+    VT_ALIGN_HWC_TO_128 = 14,
+    VT_INT8_DATA = 16,
+    VT_SCALES = 18
   };
   DataType data_type() const {
     return static_cast<DataType>(GetField<int8_t>(VT_DATA_TYPE, 0));
@@ -167,6 +177,13 @@ struct Tensor FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   bool align_hwc_to_128() const {
     return GetField<uint8_t>(VT_ALIGN_HWC_TO_128, 0) != 0;
   }
+  const flatbuffers::Vector<int8_t> *int8_data() const {
+    return GetPointer<const flatbuffers::Vector<int8_t> *>(VT_INT8_DATA);
+  }
+  /// the float weight of output channel i is about int8_data * scales[i]
+  const flatbuffers::Vector<float> *scales() const {
+    return GetPointer<const flatbuffers::Vector<float> *>(VT_SCALES);
+  }
   bool Verify(flatbuffers::Verifier &verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyField<int8_t>(verifier, VT_DATA_TYPE) &&
@@ -179,6 +196,10 @@ struct Tensor FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
            VerifyOffset(verifier, VT_NAME) &&
            verifier.VerifyString(name()) &&
            VerifyField<uint8_t>(verifier, VT_ALIGN_HWC_TO_128) &&
+           VerifyOffset(verifier, VT_INT8_DATA) &&
+           verifier.VerifyVector(int8_data()) &&
+           VerifyOffset(verifier, VT_SCALES) &&
+           verifier.VerifyVector(scales()) &&
            verifier.EndTable();
   }
 };
@@ -204,6 +225,12 @@ struct TensorBuilder {
   void add_align_hwc_to_128(bool align_hwc_to_128) {
     fbb_.AddElement<uint8_t>(Tensor::VT_ALIGN_HWC_TO_128, static_cast<uint8_t>(align_hwc_to_128), 0);
   }
+  void add_int8_data(flatbuffers::Offset<flatbuffers::Vector<int8_t>> int8_data) {
+    fbb_.AddOffset(Tensor::VT_INT8_DATA, int8_data);
+  }
+  void add_scales(flatbuffers::Offset<flatbuffers::Vector<float>> scales) {
+    fbb_.AddOffset(Tensor::VT_SCALES, scales);
+  }
   explicit TensorBuilder(flatbuffers::FlatBufferBuilder &_fbb)
         : fbb_(_fbb) {
     start_ = fbb_.StartTable();
@@ -223,8 +250,12 @@ inline flatbuffers::Offset<Tensor> CreateTensor(
     flatbuffers::Offset<flatbuffers::Vector<float>> float32_data = 0,
     flatbuffers::Offset<flatbuffers::Vector<uint32_t>> shape = 0,
     flatbuffers::Offset<flatbuffers::String> name = 0,
-    bool align_hwc_to_128 = false) {
+    bool align_hwc_to_128 = false,
+    flatbuffers::Offset<flatbuffers::Vector<int8_t>> int8_data = 0,
+    flatbuffers::Offset<flatbuffers::Vector<float>> scales = 0) {
   TensorBuilder builder_(_fbb);
+  builder_.add_scales(scales);
+  builder_.add_int8_data(int8_data);
   builder_.add_name(name);
   builder_.add_shape(shape);
   builder_.add_float32_data(float32_data);
@@ -241,11 +272,15 @@ inline flatbuffers::Offset<Tensor> CreateTensorDirect(
     const std::vector<float> *float32_data = nullptr,
     const std::vector<uint32_t> *shape = nullptr,
     const char *name = nullptr,
-    bool align_hwc_to_128 = false) {
+    bool align_hwc_to_128 = false,
+    const std::vector<int8_t> *int8_data = nullptr,
+    const std::vector<float> *scales = nullptr) {
   auto bin_data__ = bin_data ? _fbb.CreateVector<uint64_t>(*bin_data) : 0;
   auto float32_data__ = float32_data ? _fbb.CreateVector<float>(*float32_data) : 0;
   auto shape__ = shape ? _fbb.CreateVector<uint32_t>(*shape) : 0;
   auto name__ = name ? _fbb.CreateString(name) : 0;
+  auto int8_data__ = int8_data ? _fbb.CreateVector<int8_t>(*int8_data) : 0;
+  auto scales__ = scales ? _fbb.CreateVector<float>(*scales) : 0;
   return flatbnn::CreateTensor(
       _fbb,
       data_type,
@@ -253,7 +288,9 @@ inline flatbuffers::Offset<Tensor> CreateTensorDirect(
       float32_data__,
       shape__,
       name__,
-      align_hwc_to_128);
+      align_hwc_to_128,
+      int8_data__,
+      scales__);
 }
 
 struct Input FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
@@ -392,7 +429,10 @@ struct BinConv2D FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
     VT_PADS = 10,
     VT_STRIDES = 12,
     VT_DILATIONS = 14,
-    VT_OUTPUT = 16
+    VT_OUTPUT = 16,
+    VT_GROUP = 18,
+    VT_SCALE = 20,
+    VT_OFFSET = 22
   };
   const flatbuffers::String *input() const {
     return GetPointer<const flatbuffers::String *>(VT_INPUT);
@@ -418,6 +458,20 @@ struct BinConv2D FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   const flatbuffers::String *output() const {
     return GetPointer<const flatbuffers::String *>(VT_OUTPUT);
   }
+  /// the input channels and output channels are divided into group groups
+  int32_t group() const {
+    return GetField<int32_t>(VT_GROUP, 1);
+  }
+  /// optional per output channel float tensors, the output is
+  /// scale * (k - 2 * popcount) + offset where k is the number of the bits
+  /// of a filter, i.e. the xnor dot product scaled. Without scale the
+  /// output is the popcount
+  const flatbuffers::String *scale() const {
+    return GetPointer<const flatbuffers::String *>(VT_SCALE);
+  }
+  const flatbuffers::String *offset() const {
+    return GetPointer<const flatbuffers::String *>(VT_OFFSET);
+  }
   bool Verify(flatbuffers::Verifier &verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyOffset(verifier, VT_INPUT) &&
@@ -434,6 +488,11 @@ struct BinConv2D FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
            verifier.VerifyVector(dilations()) &&
            VerifyOffset(verifier, VT_OUTPUT) &&
            verifier.VerifyString(output()) &&
+           VerifyField<int32_t>(verifier, VT_GROUP) &&
+           VerifyOffset(verifier, VT_SCALE) &&
+           verifier.VerifyString(scale()) &&
+           VerifyOffset(verifier, VT_OFFSET) &&
+           verifier.VerifyString(offset()) &&
            verifier.EndTable();
   }
 };
@@ -462,6 +521,15 @@ struct BinConv2DBuilder {
   void add_output(flatbuffers::Offset<flatbuffers::String> output) {
     fbb_.AddOffset(BinConv2D::VT_OUTPUT, output);
   }
+  void add_group(int32_t group) {
+    fbb_.AddElement<int32_t>(BinConv2D::VT_GROUP, group, 1);
+  }
+  void add_scale(flatbuffers::Offset<flatbuffers::String> scale) {
+    fbb_.AddOffset(BinConv2D::VT_SCALE, scale);
+  }
+  void add_offset(flatbuffers::Offset<flatbuffers::String> offset) {
+    fbb_.AddOffset(BinConv2D::VT_OFFSET, offset);
+  }
   explicit BinConv2DBuilder(flatbuffers::FlatBufferBuilder &_fbb)
         : fbb_(_fbb) {
     start_ = fbb_.StartTable();
@@ -482,8 +550,14 @@ inline flatbuffers::Offset<BinConv2D> CreateBinConv2D(
     flatbuffers::Offset<flatbuffers::Vector<int32_t>> pads = 0,
     flatbuffers::Offset<flatbuffers::Vector<int32_t>> strides = 0,
     flatbuffers::Offset<flatbuffers::Vector<int32_t>> dilations = 0,
-    flatbuffers::Offset<flatbuffers::String> output = 0) {
+    flatbuffers::Offset<flatbuffers::String> output = 0,
+    int32_t group = 1,
+    flatbuffers::Offset<flatbuffers::String> scale = 0,
+    flatbuffers::Offset<flatbuffers::String> offset = 0) {
   BinConv2DBuilder builder_(_fbb);
+  builder_.add_offset(offset);
+  builder_.add_scale(scale);
+  builder_.add_group(group);
   builder_.add_output(output);
   builder_.add_dilations(dilations);
   builder_.add_strides(strides);
@@ -502,7 +576,10 @@ inline flatbuffers::Offset<BinConv2D> CreateBinConv2DDirect(
     const std::vector<int32_t> *pads = nullptr,
     const std::vector<int32_t> *strides = nullptr,
     const std::vector<int32_t> *dilations = nullptr,
-    const char *output = nullptr) {
+    const char *output = nullptr,
+    int32_t group = 1,
+    const char *scale = nullptr,
+    const char *offset = nullptr) {
   auto input__ = input ? _fbb.CreateString(input) : 0;
   auto weight__ = weight ? _fbb.CreateString(weight) : 0;
   auto bias__ = bias ? _fbb.CreateString(bias) : 0;
@@ -510,6 +587,8 @@ inline flatbuffers::Offset<BinConv2D> CreateBinConv2DDirect(
   auto strides__ = strides ? _fbb.CreateVector<int32_t>(*strides) : 0;
   auto dilations__ = dilations ? _fbb.CreateVector<int32_t>(*dilations) : 0;
   auto output__ = output ? _fbb.CreateString(output) : 0;
+  auto scale__ = scale ? _fbb.CreateString(scale) : 0;
+  auto offset__ = offset ? _fbb.CreateString(offset) : 0;
   return flatbnn::CreateBinConv2D(
       _fbb,
       input__,
@@ -518,7 +597,10 @@ inline flatbuffers::Offset<BinConv2D> CreateBinConv2DDirect(
       pads__,
       strides__,
       dilations__,
-      output__);
+      output__,
+      group,
+      scale__,
+      offset__);
 }
 
 struct FpConv2D FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
@@ -529,7 +611,8 @@ struct FpConv2D FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
     VT_PADS = 10,
     VT_STRIDES = 12,
     VT_DILATIONS = 14,
-    VT_OUTPUT = 16
+    VT_OUTPUT = 16,
+    VT_INT8_SCALE = 18
   };
   const flatbuffers::String *input() const {
     return GetPointer<const flatbuffers::String *>(VT_INPUT);
@@ -555,6 +638,10 @@ struct FpConv2D FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   const flatbuffers::String *output() const {
     return GetPointer<const flatbuffers::String *>(VT_OUTPUT);
   }
+  /// the int8 input of an int8 weight is round(input / int8_scale)
+  float int8_scale() const {
+    return GetField<float>(VT_INT8_SCALE, 0.0f);
+  }
   bool Verify(flatbuffers::Verifier &verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyOffset(verifier, VT_INPUT) &&
@@ -571,6 +658,7 @@ struct FpConv2D FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
            verifier.VerifyVector(dilations()) &&
            VerifyOffset(verifier, VT_OUTPUT) &&
            verifier.VerifyString(output()) &&
+           VerifyField<float>(verifier, VT_INT8_SCALE) &&
            verifier.EndTable();
   }
 };
@@ -599,6 +687,9 @@ struct FpConv2DBuilder {
   void add_output(flatbuffers::Offset<flatbuffers::String> output) {
     fbb_.AddOffset(FpConv2D::VT_OUTPUT, output);
   }
+  void add_int8_scale(float int8_scale) {
+    fbb_.AddElement<float>(FpConv2D::VT_INT8_SCALE, int8_scale, 0.0f);
+  }
   explicit FpConv2DBuilder(flatbuffers::FlatBufferBuilder &_fbb)
         : fbb_(_fbb) {
     start_ = fbb_.StartTable();
@@ -619,8 +710,10 @@ inline flatbuffers::Offset<FpConv2D> CreateFpConv2D(
     flatbuffers::Offset<flatbuffers::Vector<int32_t>> pads = 0,
     flatbuffers::Offset<flatbuffers::Vector<int32_t>> strides = 0,
     flatbuffers::Offset<flatbuffers::Vector<int32_t>> dilations = 0,
-    flatbuffers::Offset<flatbuffers::String> output = 0) {
+    flatbuffers::Offset<flatbuffers::String> output = 0,
+    float int8_scale = 0.0f) {
   FpConv2DBuilder builder_(_fbb);
+  builder_.add_int8_scale(int8_scale);
   builder_.add_output(output);
   builder_.add_dilations(dilations);
   builder_.add_strides(strides);
@@ -639,7 +732,8 @@ inline flatbuffers::Offset<FpConv2D> CreateFpConv2DDirect(
     const std::vector<int32_t> *pads = nullptr,
     const std::vector<int32_t> *strides = nullptr,
     const std::vector<int32_t> *dilations = nullptr,
-    const char *output = nullptr) {
+    const char *output = nullptr,
+    float int8_scale = 0.0f) {
   auto input__ = input ? _fbb.CreateString(input) : 0;
   auto weight__ = weight ? _fbb.CreateString(weight) : 0;
   auto bias__ = bias ? _fbb.CreateString(bias) : 0;
@@ -655,7 +749,8 @@ inline flatbuffers::Offset<FpConv2D> CreateFpConv2DDirect(
       pads__,
       strides__,
       dilations__,
-      output__);
+      output__,
+      int8_scale);
 }
 
 struct AvePool FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
@@ -1009,7 +1104,8 @@ struct FC FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
     VT_INPUT = 4,
     VT_WEIGHT = 6,
     VT_BIAS = 8,
-    VT_OUTPUT = 10
+    VT_OUTPUT = 10,
+    VT_INT8_SCALE = 12
   };
   const flatbuffers::String *input() const {
     return GetPointer<const flatbuffers::String *>(VT_INPUT);
@@ -1023,6 +1119,10 @@ struct FC FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   const flatbuffers::String *output() const {
     return GetPointer<const flatbuffers::String *>(VT_OUTPUT);
   }
+  /// the int8 input of an int8 weight is round(input / int8_scale)
+  float int8_scale() const {
+    return GetField<float>(VT_INT8_SCALE, 0.0f);
+  }
   bool Verify(flatbuffers::Verifier &verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyOffset(verifier, VT_INPUT) &&
@@ -1033,6 +1133,7 @@ struct FC FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
            verifier.VerifyString(bias()) &&
            VerifyOffset(verifier, VT_OUTPUT) &&
            verifier.VerifyString(output()) &&
+           VerifyField<float>(verifier, VT_INT8_SCALE) &&
            verifier.EndTable();
   }
 };
@@ -1052,6 +1153,9 @@ struct FCBuilder {
   void add_output(flatbuffers::Offset<flatbuffers::String> output) {
     fbb_.AddOffset(FC::VT_OUTPUT, output);
   }
+  void add_int8_scale(float int8_scale) {
+    fbb_.AddElement<float>(FC::VT_INT8_SCALE, int8_scale, 0.0f);
+  }
   explicit FCBuilder(flatbuffers::FlatBufferBuilder &_fbb)
         : fbb_(_fbb) {
     start_ = fbb_.StartTable();
@@ -1069,8 +1173,10 @@ inline flatbuffers::Offset<FC> CreateFC(
     flatbuffers::Offset<flatbuffers::String> input = 0,
     flatbuffers::Offset<flatbuffers::String> weight = 0,
     flatbuffers::Offset<flatbuffers::String> bias = 0,
-    flatbuffers::Offset<flatbuffers::String> output = 0) {
+    flatbuffers::Offset<flatbuffers::String> output = 0,
+    float int8_scale = 0.0f) {
   FCBuilder builder_(_fbb);
+  builder_.add_int8_scale(int8_scale);
   builder_.add_output(output);
   builder_.add_bias(bias);
   builder_.add_weight(weight);
@@ -1083,7 +1189,8 @@ inline flatbuffers::Offset<FC> CreateFCDirect(
     const char *input = nullptr,
     const char *weight = nullptr,
     const char *bias = nullptr,
-    const char *output = nullptr) {
+    const char *output = nullptr,
+    float int8_scale = 0.0f) {
   auto input__ = input ? _fbb.CreateString(input) : 0;
   auto weight__ = weight ? _fbb.CreateString(weight) : 0;
   auto bias__ = bias ? _fbb.CreateString(bias) : 0;
@@ -1093,7 +1200,8 @@ inline flatbuffers::Offset<FC> CreateFCDirect(
       input__,
       weight__,
       bias__,
-      output__);
+      output__,
+      int8_scale);
 }
 
 struct Add FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
@@ -1550,6 +1658,185 @@ inline flatbuffers::Offset<PRelu> CreatePReluDirect(
       output__);
 }
 
+/// A conv on the bit planes of k-bit weights and activations. The levels
+/// of k bits are the odd integers in [1 - 2^k, 2^k - 1], whose bits are
+/// the +1/-1 planes of sum_i 2^i * plane_i.
+struct MultiBitConv2D FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
+  enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
+    VT_INPUT = 4,
+    VT_WEIGHT = 6,
+    VT_BIAS = 8,
+    VT_PADS = 10,
+    VT_STRIDES = 12,
+    VT_DILATIONS = 14,
+    VT_OUTPUT = 16,
+    VT_WEIGHT_BITS = 18,
+    VT_ACTIVATION_BITS = 20,
+    VT_ACTIVATION_SCALE = 22
+  };
+  const flatbuffers::String *input() const {
+    return GetPointer<const flatbuffers::String *>(VT_INPUT);
+  }
+  /// an int8 tensor of the weight levels and the scale of every output
+  /// channel
+  const flatbuffers::String *weight() const {
+    return GetPointer<const flatbuffers::String *>(VT_WEIGHT);
+  }
+  const flatbuffers::String *bias() const {
+    return GetPointer<const flatbuffers::String *>(VT_BIAS);
+  }
+  /// the order is top, right, bottom, left, the input is padded with 0
+  const flatbuffers::Vector<int32_t> *pads() const {
+    return GetPointer<const flatbuffers::Vector<int32_t> *>(VT_PADS);
+  }
+  /// the order is stride_h, stride_w
+  const flatbuffers::Vector<int32_t> *strides() const {
+    return GetPointer<const flatbuffers::Vector<int32_t> *>(VT_STRIDES);
+  }
+  /// the order is dilation_h, dilation_w
+  const flatbuffers::Vector<int32_t> *dilations() const {
+    return GetPointer<const flatbuffers::Vector<int32_t> *>(VT_DILATIONS);
+  }
+  const flatbuffers::String *output() const {
+    return GetPointer<const flatbuffers::String *>(VT_OUTPUT);
+  }
+  int32_t weight_bits() const {
+    return GetField<int32_t>(VT_WEIGHT_BITS, 2);
+  }
+  int32_t activation_bits() const {
+    return GetField<int32_t>(VT_ACTIVATION_BITS, 2);
+  }
+  /// the input is quantized to the nearest level * activation_scale
+  float activation_scale() const {
+    return GetField<float>(VT_ACTIVATION_SCALE, 0.0f);
+  }
+  bool Verify(flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyOffset(verifier, VT_INPUT) &&
+           verifier.VerifyString(input()) &&
+           VerifyOffset(verifier, VT_WEIGHT) &&
+           verifier.VerifyString(weight()) &&
+           VerifyOffset(verifier, VT_BIAS) &&
+           verifier.VerifyString(bias()) &&
+           VerifyOffset(verifier, VT_PADS) &&
+           verifier.VerifyVector(pads()) &&
+           VerifyOffset(verifier, VT_STRIDES) &&
+           verifier.VerifyVector(strides()) &&
+           VerifyOffset(verifier, VT_DILATIONS) &&
+           verifier.VerifyVector(dilations()) &&
+           VerifyOffset(verifier, VT_OUTPUT) &&
+           verifier.VerifyString(output()) &&
+           VerifyField<int32_t>(verifier, VT_WEIGHT_BITS) &&
+           VerifyField<int32_t>(verifier, VT_ACTIVATION_BITS) &&
+           VerifyField<float>(verifier, VT_ACTIVATION_SCALE) &&
+           verifier.EndTable();
+  }
+};
+
+struct MultiBitConv2DBuilder {
+  flatbuffers::FlatBufferBuilder &fbb_;
+  flatbuffers::uoffset_t start_;
+  void add_input(flatbuffers::Offset<flatbuffers::String> input) {
+    fbb_.AddOffset(MultiBitConv2D::VT_INPUT, input);
+  }
+  void add_weight(flatbuffers::Offset<flatbuffers::String> weight) {
+    fbb_.AddOffset(MultiBitConv2D::VT_WEIGHT, weight);
+  }
+  void add_bias(flatbuffers::Offset<flatbuffers::String> bias) {
+    fbb_.AddOffset(MultiBitConv2D::VT_BIAS, bias);
+  }
+  void add_pads(flatbuffers::Offset<flatbuffers::Vector<int32_t>> pads) {
+    fbb_.AddOffset(MultiBitConv2D::VT_PADS, pads);
+  }
+  void add_strides(flatbuffers::Offset<flatbuffers::Vector<int32_t>> strides) {
+    fbb_.AddOffset(MultiBitConv2D::VT_STRIDES, strides);
+  }
+  void add_dilations(flatbuffers::Offset<flatbuffers::Vector<int32_t>> dilations) {
+    fbb_.AddOffset(MultiBitConv2D::VT_DILATIONS, dilations);
+  }
+  void add_output(flatbuffers::Offset<flatbuffers::String> output) {
+    fbb_.AddOffset(MultiBitConv2D::VT_OUTPUT, output);
+  }
+  void add_weight_bits(int32_t weight_bits) {
+    fbb_.AddElement<int32_t>(MultiBitConv2D::VT_WEIGHT_BITS, weight_bits, 2);
+  }
+  void add_activation_bits(int32_t activation_bits) {
+    fbb_.AddElement<int32_t>(MultiBitConv2D::VT_ACTIVATION_BITS, activation_bits, 2);
+  }
+  void add_activation_scale(float activation_scale) {
+    fbb_.AddElement<float>(MultiBitConv2D::VT_ACTIVATION_SCALE, activation_scale, 0.0f);
+  }
+  explicit MultiBitConv2DBuilder(flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  MultiBitConv2DBuilder &operator=(const MultiBitConv2DBuilder &);
+  flatbuffers::Offset<MultiBitConv2D> Finish() {
+    const auto end = fbb_.EndTable(start_);
+    auto o = flatbuffers::Offset<MultiBitConv2D>(end);
+    return o;
+  }
+};
+
+inline flatbuffers::Offset<MultiBitConv2D> CreateMultiBitConv2D(
+    flatbuffers::FlatBufferBuilder &_fbb,
+    flatbuffers::Offset<flatbuffers::String> input = 0,
+    flatbuffers::Offset<flatbuffers::String> weight = 0,
+    flatbuffers::Offset<flatbuffers::String> bias = 0,
+    flatbuffers::Offset<flatbuffers::Vector<int32_t>> pads = 0,
+    flatbuffers::Offset<flatbuffers::Vector<int32_t>> strides = 0,
+    flatbuffers::Offset<flatbuffers::Vector<int32_t>> dilations = 0,
+    flatbuffers::Offset<flatbuffers::String> output = 0,
+    int32_t weight_bits = 2,
+    int32_t activation_bits = 2,
+    float activation_scale = 0.0f) {
+  MultiBitConv2DBuilder builder_(_fbb);
+  builder_.add_activation_scale(activation_scale);
+  builder_.add_activation_bits(activation_bits);
+  builder_.add_weight_bits(weight_bits);
+  builder_.add_output(output);
+  builder_.add_dilations(dilations);
+  builder_.add_strides(strides);
+  builder_.add_pads(pads);
+  builder_.add_bias(bias);
+  builder_.add_weight(weight);
+  builder_.add_input(input);
+  return builder_.Finish();
+}
+
+inline flatbuffers::Offset<MultiBitConv2D> CreateMultiBitConv2DDirect(
+    flatbuffers::FlatBufferBuilder &_fbb,
+    const char *input = nullptr,
+    const char *weight = nullptr,
+    const char *bias = nullptr,
+    const std::vector<int32_t> *pads = nullptr,
+    const std::vector<int32_t> *strides = nullptr,
+    const std::vector<int32_t> *dilations = nullptr,
+    const char *output = nullptr,
+    int32_t weight_bits = 2,
+    int32_t activation_bits = 2,
+    float activation_scale = 0.0f) {
+  auto input__ = input ? _fbb.CreateString(input) : 0;
+  auto weight__ = weight ? _fbb.CreateString(weight) : 0;
+  auto bias__ = bias ? _fbb.CreateString(bias) : 0;
+  auto pads__ = pads ? _fbb.CreateVector<int32_t>(*pads) : 0;
+  auto strides__ = strides ? _fbb.CreateVector<int32_t>(*strides) : 0;
+  auto dilations__ = dilations ? _fbb.CreateVector<int32_t>(*dilations) : 0;
+  auto output__ = output ? _fbb.CreateString(output) : 0;
+  return flatbnn::CreateMultiBitConv2D(
+      _fbb,
+      input__,
+      weight__,
+      bias__,
+      pads__,
+      strides__,
+      dilations__,
+      output__,
+      weight_bits,
+      activation_bits,
+      activation_scale);
+}
+
 struct Layer FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
     VT_TYPE = 4,
@@ -1567,7 +1854,8 @@ struct Layer FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
     VT_SPLIT_PARAM = 28,
     VT_SHUFFLE_PARAM = 30,
     VT_NAME = 32,
-    VT_PRELU_PARAM = 34
+    VT_PRELU_PARAM = 34,
+    VT_MULTIBIT_CONV2D_PARAM = 36
   };
   LayerType type() const {
     return static_cast<LayerType>(GetField<int8_t>(VT_TYPE, 0));
@@ -1617,6 +1905,9 @@ struct Layer FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   const PRelu *prelu_param() const {
     return GetPointer<const PRelu *>(VT_PRELU_PARAM);
   }
+  const MultiBitConv2D *multibit_conv2d_param() const {
+    return GetPointer<const MultiBitConv2D *>(VT_MULTIBIT_CONV2D_PARAM);
+  }
   bool Verify(flatbuffers::Verifier &verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyField<int8_t>(verifier, VT_TYPE) &&
@@ -1650,6 +1941,8 @@ struct Layer FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
            verifier.VerifyString(name()) &&
            VerifyOffset(verifier, VT_PRELU_PARAM) &&
            verifier.VerifyTable(prelu_param()) &&
+           VerifyOffset(verifier, VT_MULTIBIT_CONV2D_PARAM) &&
+           verifier.VerifyTable(multibit_conv2d_param()) &&
            verifier.EndTable();
   }
 };
@@ -1705,6 +1998,9 @@ struct LayerBuilder {
   void add_prelu_param(flatbuffers::Offset<PRelu> prelu_param) {
     fbb_.AddOffset(Layer::VT_PRELU_PARAM, prelu_param);
   }
+  void add_multibit_conv2d_param(flatbuffers::Offset<MultiBitConv2D> multibit_conv2d_param) {
+    fbb_.AddOffset(Layer::VT_MULTIBIT_CONV2D_PARAM, multibit_conv2d_param);
+  }
   explicit LayerBuilder(flatbuffers::FlatBufferBuilder &_fbb)
         : fbb_(_fbb) {
     start_ = fbb_.StartTable();
@@ -1734,8 +2030,10 @@ inline flatbuffers::Offset<Layer> CreateLayer(
     flatbuffers::Offset<Split> split_param = 0,
     flatbuffers::Offset<Shuffle> shuffle_param = 0,
     flatbuffers::Offset<flatbuffers::String> name = 0,
-    flatbuffers::Offset<PRelu> prelu_param = 0) {
+    flatbuffers::Offset<PRelu> prelu_param = 0,
+    flatbuffers::Offset<MultiBitConv2D> multibit_conv2d_param = 0) {
   LayerBuilder builder_(_fbb);
+  builder_.add_multibit_conv2d_param(multibit_conv2d_param);
   builder_.add_prelu_param(prelu_param);
   builder_.add_name(name);
   builder_.add_shuffle_param(shuffle_param);
@@ -1772,7 +2070,8 @@ inline flatbuffers::Offset<Layer> CreateLayerDirect(
     flatbuffers::Offset<Split> split_param = 0,
     flatbuffers::Offset<Shuffle> shuffle_param = 0,
     const char *name = nullptr,
-    flatbuffers::Offset<PRelu> prelu_param = 0) {
+    flatbuffers::Offset<PRelu> prelu_param = 0,
+    flatbuffers::Offset<MultiBitConv2D> multibit_conv2d_param = 0) {
   auto name__ = name ? _fbb.CreateString(name) : 0;
   return flatbnn::CreateLayer(
       _fbb,
@@ -1791,7 +2090,8 @@ inline flatbuffers::Offset<Layer> CreateLayerDirect(
       split_param,
       shuffle_param,
       name__,
-      prelu_param);
+      prelu_param,
+      multibit_conv2d_param);
 }
 
 struct Model FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
@@ -31,10 +31,7 @@
             const auto &output_shape = shaper[output];                      \
             const auto &input_mat =                                         \
                 *mat_map_[get_input(FIRST_ARG(__VA_ARGS__))];               \
-            add_mat(output,                                                 \
-                    std::make_shared<Mat>(output_shape[1], output_shape[2], \
-                                          output_shape[3],                  \
-                                          input_mat.data_type, output));    \
+            add_activation(output, output_shape, input_mat.data_type);      \
         }                                                                   \
     }
 
@@ -46,10 +43,8 @@
         shaper.shape_func(__VA_ARGS__);                                       \
         const auto &output_shape = shaper[LAST_ARG(__VA_ARGS__)];             \
         const auto &input_mat = *mat_map_[get_input(FIRST_ARG(__VA_ARGS__))]; \
-        add_mat(LAST_ARG(__VA_ARGS__),                                        \
-                std::make_shared<Mat>(output_shape[1], output_shape[2],       \
-                                      output_shape[3], input_mat.data_type,   \
-                                      LAST_ARG(__VA_ARGS__)));                \
+        add_activation(LAST_ARG(__VA_ARGS__), output_shape,                   \
+                       input_mat.data_type);                                  \
     }
 
 #define ADD_LAYER_WITH_DATA_TYPE(name, shape_func, mat_data_type, ...)  \
@@ -59,10 +54,8 @@
     if (mat_map_.find(LAST_ARG(__VA_ARGS__)) == mat_map_.end()) {       \
         shaper.shape_func(__VA_ARGS__);                                 \
         const auto &output_shape = shaper[LAST_ARG(__VA_ARGS__)];       \
-        add_mat(LAST_ARG(__VA_ARGS__),                                  \
-                std::make_shared<Mat>(output_shape[1], output_shape[2], \
-                                      output_shape[3], mat_data_type,   \
-                                      LAST_ARG(__VA_ARGS__)));          \
+        add_activation(LAST_ARG(__VA_ARGS__), output_shape,             \
+                       mat_data_type);                                  \
     }
 
 #define ADD_INPLACE_LAYER(name, shape_func, ...)                      \
@@ -152,6 +145,8 @@ inline std::string layer_type_to_str(flatbnn::LayerType type) {
             return "shuffle";
         case flatbnn::LayerType::PRelu:
             return "prelu";
+        case flatbnn::LayerType::MultiBitConv2D:
+            return "multibitconv";
         default:
             BNN_ASSERT(false, "Missing type in this function");
     }
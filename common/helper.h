@@ -5,9 +5,11 @@
 
 #include <bitset>
 #include <climits>
+#include <iomanip>
 #include <numeric>
 #include <random>
 #include <sstream>
+#include <string>
 #include <vector>
 
 #include "log_helper.h"
@@ -139,6 +141,24 @@ inline std::string binrep(const void *a, const size_t size, bool reverse) {
     return ss.str();
 }
 
+/**
+ * Escape s to be put between the quotes of a JSON string
+ */
+inline std::string json_escape(const std::string &s) {
+    std::stringstream ss;
+    for (const char ch : s) {
+        if (ch == '"' || ch == '\\') {
+            ss << '\\' << ch;
+        } else if (static_cast<unsigned char>(ch) < 0x20) {
+            ss << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+               << static_cast<int>(ch) << std::dec;
+        } else {
+            ss << ch;
+        }
+    }
+    return ss.str();
+}
+
 template <typename T>
 T Product(const std::vector<T> &v) {
     return static_cast<T>(
@@ -0,0 +1,385 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#include "synthetic_model.h"
+
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <random>
+
+#include <common/dab_generated.h>
+#include <common/helper.h>
+#include <common/macros.h>
+
+namespace bnn {
+
+namespace {
+
+using Shape = std::vector<uint32_t>;
+
+class Generator {
+   public:
+    explicit Generator(const SyntheticModel &model)
+        : model_(model), rng_(model.seed) {}
+
+    std::vector<uint8_t> build();
+
+   private:
+    const SyntheticModel &model_;
+    std::mt19937 rng_;
+    flatbuffers::FlatBufferBuilder fbb_;
+    std::vector<flatbuffers::Offset<flatbnn::Tensor>> tensors_;
+    std::vector<flatbuffers::Offset<flatbnn::Layer>> layers_;
+    int blobs_ = 0;
+    // The h and w of the current blob
+    int size_ = 0;
+
+    std::string blob(const std::string &prefix) {
+        return prefix + "_" + std::to_string(blobs_++);
+    }
+    std::vector<float> uniform(size_t n, float lo, float hi);
+    std::string float_tensor(const std::vector<float> &data,
+                             const Shape &shape);
+    void push(flatbnn::LayerType type, const std::string &name,
+              const std::function<void(flatbnn::LayerBuilder &)> &param);
+
+    std::string fp_conv(const std::string &input, int in_c, int out_c,
+                        int kernel, int stride);
+    std::string bin_conv(const std::string &input, int in_c, int out_c,
+                         int stride);
+    std::string conv3x3(const std::string &input, int in_c, int out_c,
+                        int stride);
+    // The bits of a filter of a 3x3 conv, 0 for a float conv
+    int filter_bits(const int in_c) const {
+        return model_.binary ? 9 * in_c : 0;
+    }
+    std::string affine(const std::string &input, int c, int bits);
+    std::string relu(const std::string &input);
+    std::string add(const std::string &input1, const std::string &input2);
+    std::string pool(flatbnn::LayerType type, const std::string &input,
+                     int kernel, int stride, int pad);
+
+    std::string resnet_block(const std::string &input, int in_c, int out_c,
+                             int stride);
+    std::string bireal_unit(const std::string &input, int in_c, int out_c,
+                            int stride);
+    std::string shuffle_block(const std::string &input, int c);
+};
+
+std::vector<float> Generator::uniform(const size_t n, const float lo,
+                                      const float hi) {
+    std::uniform_real_distribution<float> dist(lo, hi);
+    std::vector<float> data(n);
+    for (auto &v : data) {
+        v = dist(rng_);
+    }
+    return data;
+}
+
+std::string Generator::float_tensor(const std::vector<float> &data,
+                                    const Shape &shape) {
+    const auto name = blob("weight");
+    tensors_.push_back(flatbnn::CreateTensorDirect(
+        fbb_, flatbnn::DataType::Float32, nullptr, &data, &shape,
+        name.c_str()));
+    return name;
+}
+
+void Generator::push(
+    const flatbnn::LayerType type, const std::string &name,
+    const std::function<void(flatbnn::LayerBuilder &)> &param) {
+    const auto name_offset = fbb_.CreateString(name);
+    flatbnn::LayerBuilder builder(fbb_);
+    builder.add_type(type);
+    builder.add_name(name_offset);
+    param(builder);
+    layers_.push_back(builder.Finish());
+}
+
+std::string Generator::fp_conv(const std::string &input, const int in_c,
+                               const int out_c, const int kernel,
+                               const int stride) {
+    // The outputs keep about the variance of the inputs
+    const float bound = std::sqrt(3.f / (kernel * kernel * in_c));
+    const auto weight = float_tensor(
+        uniform(static_cast<size_t>(out_c) * kernel * kernel * in_c, -bound,
+                bound),
+        {static_cast<uint32_t>(out_c), static_cast<uint32_t>(kernel),
+         static_cast<uint32_t>(kernel), static_cast<uint32_t>(in_c)});
+    const auto output = blob("conv");
+    const int pad = kernel / 2;
+    const std::vector<int32_t> pads{pad, pad, pad, pad},
+        strides{stride, stride}, dilations{1, 1};
+    const auto param = flatbnn::CreateFpConv2DDirect(
+        fbb_, input.c_str(), weight.c_str(), nullptr, &pads, &strides,
+        &dilations, output.c_str());
+    push(flatbnn::LayerType::FpConv2D, output,
+         [&](flatbnn::LayerBuilder &b) { b.add_fp_conv2d_param(param); });
+    size_ = (size_ + 2 * pad - kernel) / stride + 1;
+    return output;
+}
+
+std::string Generator::bin_conv(const std::string &input, const int in_c,
+                                const int out_c, const int stride) {
+    BNN_ASSERT(in_c % 64 == 0, "The input channels of a binary conv ", in_c,
+               " are not a multiple of 64");
+    std::vector<uint64_t> data(static_cast<size_t>(out_c) * 3 * 3 * in_c /
+                               64);
+    std::uniform_int_distribution<uint64_t> dist;
+    for (auto &v : data) {
+        v = dist(rng_);
+    }
+    const Shape shape{static_cast<uint32_t>(out_c), 3, 3,
+                      static_cast<uint32_t>(in_c)};
+    const auto weight = blob("weight");
+    tensors_.push_back(flatbnn::CreateTensorDirect(
+        fbb_, flatbnn::DataType::Bit, &data, nullptr, &shape, weight.c_str(),
+        in_c != 64));
+    const auto output = blob("bconv");
+    const std::vector<int32_t> pads{1, 1, 1, 1}, strides{stride, stride},
+        dilations{1, 1};
+    const auto param = flatbnn::CreateBinConv2DDirect(
+        fbb_, input.c_str(), weight.c_str(), nullptr, &pads, &strides,
+        &dilations, output.c_str());
+    push(flatbnn::LayerType::BinConv2D, output,
+         [&](flatbnn::LayerBuilder &b) { b.add_bin_conv2d_param(param); });
+    size_ = (size_ - 1) / stride + 1;
+    return output;
+}
+
+std::string Generator::conv3x3(const std::string &input, const int in_c,
+                               const int out_c, const int stride) {
+    return model_.binary ? bin_conv(input, in_c, out_c, stride)
+                         : fp_conv(input, in_c, out_c, 3, stride);
+}
+
+/**
+ * The bn after a conv, which centers and scales down the popcount of the
+ * bits of the filters of a binary conv
+ */
+std::string Generator::affine(const std::string &input, const int c,
+                              const int bits) {
+    const Shape shape{static_cast<uint32_t>(c)};
+    const float scale = bits == 0 ? 1.f : 1.f / std::sqrt(bits);
+    auto a = uniform(c, 0.5f * scale, 1.5f * scale);
+    auto b = uniform(c, -0.1f, 0.1f);
+    FORZ(i, c) { b[i] -= a[i] * bits / 2; }
+    const auto a_name = float_tensor(a, shape);
+    const auto b_name = float_tensor(b, shape);
+    const auto output = blob("bn");
+    const auto param = flatbnn::CreateAffineDirect(
+        fbb_, input.c_str(), a_name.c_str(), b_name.c_str(), output.c_str());
+    push(flatbnn::LayerType::Affine, output,
+         [&](flatbnn::LayerBuilder &lb) { lb.add_affine_param(param); });
+    return output;
+}
+
+std::string Generator::relu(const std::string &input) {
+    const auto output = blob("relu");
+    const auto param =
+        flatbnn::CreateReluDirect(fbb_, input.c_str(), output.c_str());
+    push(flatbnn::LayerType::Relu, output,
+         [&](flatbnn::LayerBuilder &b) { b.add_relu_param(param); });
+    return output;
+}
+
+std::string Generator::add(const std::string &input1,
+                           const std::string &input2) {
+    const auto output = blob("add");
+    const auto param = flatbnn::CreateAddDirect(
+        fbb_, input1.c_str(), input2.c_str(), output.c_str());
+    push(flatbnn::LayerType::Add, output,
+         [&](flatbnn::LayerBuilder &b) { b.add_add_param(param); });
+    return output;
+}
+
+std::string Generator::pool(const flatbnn::LayerType type,
+                            const std::string &input, const int kernel,
+                            const int stride, const int pad) {
+    const auto output = blob("pool");
+    const std::vector<int32_t> kernel_shape{kernel, kernel},
+        pads{pad, pad, pad, pad}, strides{stride, stride};
+    if (type == flatbnn::LayerType::MaxPool) {
+        const auto param = flatbnn::CreateMaxPoolDirect(
+            fbb_, input.c_str(), &kernel_shape, &pads, &strides,
+            output.c_str());
+        push(type, output,
+             [&](flatbnn::LayerBuilder &b) { b.add_maxpool_param(param); });
+    } else {
+        const auto param = flatbnn::CreateAvePoolDirect(
+            fbb_, input.c_str(), &kernel_shape, &pads, &strides,
+            output.c_str());
+        push(type, output,
+             [&](flatbnn::LayerBuilder &b) { b.add_avepool_param(param); });
+    }
+    size_ = (size_ + 2 * pad - kernel) / stride + 1;
+    return output;
+}
+
+std::string Generator::resnet_block(const std::string &input, const int in_c,
+                                    const int out_c, const int stride) {
+    const int size = size_;
+    auto x = relu(affine(conv3x3(input, in_c, out_c, stride), out_c,
+                         filter_bits(in_c)));
+    x = affine(conv3x3(x, out_c, out_c, 1), out_c, filter_bits(out_c));
+    auto shortcut = input;
+    if (stride != 1 || in_c != out_c) {
+        const int out_size = size_;
+        size_ = size;
+        shortcut = affine(fp_conv(input, in_c, out_c, 1, stride), out_c, 0);
+        BNN_ASSERT(size_ == out_size, size_, out_size);
+    }
+    return relu(add(x, shortcut));
+}
+
+std::string Generator::bireal_unit(const std::string &input, const int in_c,
+                                   const int out_c, const int stride) {
+    const int size = size_;
+    const auto x = affine(conv3x3(input, in_c, out_c, stride), out_c,
+                          filter_bits(in_c));
+    auto shortcut = input;
+    if (stride != 1 || in_c != out_c) {
+        const int out_size = size_;
+        size_ = size;
+        // A padded 3x3 pool has the output size of the padded 3x3 conv
+        const auto pooled =
+            stride == 1
+                ? input
+                : pool(flatbnn::LayerType::AvePool, input, 3, stride, 1);
+        shortcut = affine(fp_conv(pooled, in_c, out_c, 1, 1), out_c, 0);
+        BNN_ASSERT(size_ == out_size, size_, out_size);
+    }
+    return add(x, shortcut);
+}
+
+std::string Generator::shuffle_block(const std::string &input, const int c) {
+    BNN_ASSERT(c % 128 == 0 && c <= 512, "The channels of a shuffle block ",
+               c, " should be a multiple of 128 and at most 512");
+    const auto binarized = blob("binarized");
+    const auto binarize_param = flatbnn::CreateBinarizeDirect(
+        fbb_, input.c_str(), binarized.c_str());
+    push(flatbnn::LayerType::Binarize, binarized,
+         [&](flatbnn::LayerBuilder &b) {
+             b.add_binarize_param(binarize_param);
+         });
+    const auto shuffled = blob("shuffle");
+    const auto shuffle_param = flatbnn::CreateShuffleDirect(
+        fbb_, binarized.c_str(), shuffled.c_str());
+    push(flatbnn::LayerType::Shuffle, shuffled,
+         [&](flatbnn::LayerBuilder &b) { b.add_shuffle_param(shuffle_param); });
+    const auto half1 = blob("split"), half2 = blob("split");
+    const std::vector<flatbuffers::Offset<flatbuffers::String>> halves{
+        fbb_.CreateString(half1), fbb_.CreateString(half2)};
+    const auto split_param =
+        flatbnn::CreateSplitDirect(fbb_, shuffled.c_str(), &halves);
+    push(flatbnn::LayerType::Split, half1,
+         [&](flatbnn::LayerBuilder &b) { b.add_split_param(split_param); });
+
+    const auto conv1 = bin_conv(half1, c / 2, c / 2, 1);
+    const auto conv2 = bin_conv(half2, c / 2, c / 2, 1);
+    const auto concat = blob("concat");
+    const std::vector<flatbuffers::Offset<flatbuffers::String>> inputs{
+        fbb_.CreateString(conv1), fbb_.CreateString(conv2)};
+    const auto concat_param =
+        flatbnn::CreateConcatDirect(fbb_, &inputs, 3, concat.c_str());
+    push(flatbnn::LayerType::Concat, concat,
+         [&](flatbnn::LayerBuilder &b) { b.add_concat_param(concat_param); });
+    return add(affine(concat, c, 9 * c / 2), input);
+}
+
+std::vector<uint8_t> Generator::build() {
+    const auto &m = model_;
+    BNN_ASSERT(m.stages >= 1 && m.blocks_per_stage >= 1 && m.width >= 1 &&
+                   m.resolution >= 1 && m.classes >= 1,
+               "Invalid synthetic model ", m.name());
+    BNN_ASSERT(m.arch != SyntheticModel::Arch::kShuffleNet || m.binary,
+               "The shuffle blocks are binary");
+    const Shape input_shape{1, static_cast<uint32_t>(m.resolution),
+                            static_cast<uint32_t>(m.resolution), 3};
+    const std::vector<flatbuffers::Offset<flatbnn::Input>> inputs{
+        flatbnn::CreateInputDirect(fbb_, &input_shape, "input")};
+
+    size_ = m.resolution;
+    auto x = fp_conv("input", 3, m.width, 7, 2);
+    x = relu(affine(x, m.width, 0));
+    x = pool(flatbnn::LayerType::MaxPool, x, 3, 2, 1);
+    int c = m.width;
+    FORZ(stage, m.stages) {
+        FORZ(block, m.blocks_per_stage) {
+            const int stride = stage > 0 && block == 0 ? 2 : 1;
+            const int out_c = stride == 2 ? 2 * c : c;
+            switch (m.arch) {
+                case SyntheticModel::Arch::kResNet:
+                    x = resnet_block(x, c, out_c, stride);
+                    break;
+                case SyntheticModel::Arch::kBiReal:
+                    x = bireal_unit(x, c, out_c, stride);
+                    x = bireal_unit(x, out_c, out_c, 1);
+                    break;
+                case SyntheticModel::Arch::kShuffleNet:
+                    x = stride == 1 ? shuffle_block(x, c)
+                                    : bireal_unit(x, c, out_c, stride);
+                    break;
+            }
+            c = out_c;
+        }
+    }
+
+    x = pool(flatbnn::LayerType::AvePool, x, size_, 1, 0);
+    const float bound = std::sqrt(3.f / c);
+    const auto fc_weight =
+        float_tensor(uniform(static_cast<size_t>(m.classes) * c, -bound, bound),
+                     {static_cast<uint32_t>(m.classes),
+                      static_cast<uint32_t>(c)});
+    const auto fc_bias = float_tensor(uniform(m.classes, -0.1f, 0.1f),
+                                      {static_cast<uint32_t>(m.classes)});
+    const auto logits = blob("fc");
+    const auto fc_param = flatbnn::CreateFCDirect(
+        fbb_, x.c_str(), fc_weight.c_str(), fc_bias.c_str(), logits.c_str());
+    push(flatbnn::LayerType::FC, logits,
+         [&](flatbnn::LayerBuilder &b) { b.add_fc_param(fc_param); });
+    const auto softmax_param =
+        flatbnn::CreateSoftmaxDirect(fbb_, logits.c_str(), "prob");
+    push(flatbnn::LayerType::Softmax, "prob",
+         [&](flatbnn::LayerBuilder &b) { b.add_softmax_param(softmax_param); });
+
+    fbb_.Finish(flatbnn::CreateModel(
+        fbb_, fbb_.CreateVector(layers_), fbb_.CreateVector(tensors_),
+        fbb_.CreateVector(inputs), BNN_LATEST_MODEL_VERSION));
+    const auto *ptr = fbb_.GetBufferPointer();
+    return std::vector<uint8_t>(ptr, ptr + fbb_.GetSize());
+}
+
+}  // namespace
+
+std::string SyntheticModel::name() const {
+    std::string s;
+    switch (arch) {
+        case Arch::kResNet:
+            s = "resnet";
+            break;
+        case Arch::kBiReal:
+            s = "bireal";
+            break;
+        case Arch::kShuffleNet:
+            s = "shufflenet";
+            break;
+    }
+    s += "_" + std::to_string(stages) + "x" +
+         std::to_string(blocks_per_stage) + "_w" + std::to_string(width) +
+         "_r" + std::to_string(resolution);
+    return binary ? s : s + "_float";
+}
+
+std::vector<uint8_t> SyntheticModel::build() const {
+    return Generator(*this).build();
+}
+
+void SyntheticModel::save(const std::string &path) const {
+    const auto buf = build();
+    std::ofstream ofs(path, std::ios::binary);
+    BNN_ASSERT(ofs.is_open(), "Cannot open ", path);
+    ofs.write(reinterpret_cast<const char *>(buf.data()), buf.size());
+}
+
+}  // namespace bnn
@@ -0,0 +1,55 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#ifndef BNN_SYNTHETIC_MODEL_H
+#define BNN_SYNTHETIC_MODEL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace bnn {
+
+/**
+ * A model of random weights in the shape of a common network, so that whole
+ * networks can be benchmarked without the downloaded models. The stem is a
+ * float 7x7/2 conv, bn, relu and a 3x3/2 max pool. The first block of every
+ * stage after the first halves the resolution and doubles the channels. The
+ * head is a global average pool, a float fc and a softmax.
+ */
+struct SyntheticModel {
+    enum class Arch {
+        // Basic blocks of two 3x3 convs with bn, and a relu after the
+        // residual add. The downsampling shortcut is a float 1x1/2 conv.
+        kResNet,
+        // A residual add around every 3x3 conv and its bn. The
+        // downsampling shortcut is a 3x3/2 average pool and a float 1x1
+        // conv.
+        kBiReal,
+        // The binarized input is shuffled and split into two 3x3 binary
+        // convs, whose outputs are concatenated, normalized and added to
+        // the input. It downsamples like Bi-Real. The channels of the
+        // stages must be multiples of 128 and at most 512.
+        kShuffleNet
+    };
+    Arch arch = Arch::kBiReal;
+    int stages = 4;
+    int blocks_per_stage = 2;
+    // The channels of the first stage
+    int width = 64;
+    int resolution = 224;
+    int classes = 1000;
+    // Whether the 3x3 convs of the blocks are binary, the stem, the
+    // shortcuts and the fc are float anyway
+    bool binary = true;
+    uint32_t seed = 0;
+
+    // e.g., "bireal_4x2_w64_r224"
+    std::string name() const;
+    // The flatbuffers of the model, for Net::read_buf
+    std::vector<uint8_t> build() const;
+    void save(const std::string &path) const;
+};
+
+}  // namespace bnn
+
+#endif /* BNN_SYNTHETIC_MODEL_H */
@@ -21,6 +21,9 @@
 
 namespace ncnn {
 
+thread_local size_t malloc_bytes = 0;
+thread_local MemoryObserver *memory_observer = nullptr;
+
 PoolAllocator::PoolAllocator() {
     size_compare_ratio = 192;  // 0.75f * 256
 }
@@ -47,17 +47,56 @@ static inline _Tp *alignPtr(_Tp *ptr, int n = (int)sizeof(_Tp)) {
 // of two
 static inline size_t alignSize(size_t sz, int n) { return (sz + n - 1) & -n; }
 
+// The bytes fastMalloc has allocated in the calling thread, a net reads it
+// before and after a run to find the allocations of the run
+extern thread_local size_t malloc_bytes;
+
+// Observes the buffers of the calling thread, e.g., the memory trace of a net
+class MemoryObserver {
+   public:
+    // name is nullptr for an anonymous buffer like that of a Mat
+    virtual void on_alloc(const void *ptr, size_t size, const char *name) = 0;
+    virtual void on_free(const void *ptr) = 0;
+    // A buffer allocated and freed within one call
+    virtual void on_scratch(size_t size, const char *name) = 0;
+    // A write over a whole buffer (e.g., a fill), which commits its pages
+    virtual void on_touch(const void *ptr, size_t size) = 0;
+};
+
+// nullptr unless the memory of the calling thread is traced
+extern thread_local MemoryObserver *memory_observer;
+
+static inline void observe_alloc(const void *ptr, size_t size,
+                                 const char *name = nullptr) {
+    if (memory_observer) memory_observer->on_alloc(ptr, size, name);
+}
+
+static inline void observe_free(const void *ptr) {
+    if (memory_observer && ptr) memory_observer->on_free(ptr);
+}
+
+static inline void observe_scratch(size_t size, const char *name) {
+    if (memory_observer) memory_observer->on_scratch(size, name);
+}
+
+static inline void observe_touch(const void *ptr, size_t size) {
+    if (memory_observer) memory_observer->on_touch(ptr, size);
+}
+
 static inline void *fastMalloc(size_t size) {
+    malloc_bytes += size;
     unsigned char *udata =
         (unsigned char *)malloc(size + sizeof(void *) + MALLOC_ALIGN);
     if (!udata) return 0;
     unsigned char **adata = alignPtr((unsigned char **)udata + 1, MALLOC_ALIGN);
     adata[-1] = udata;
+    observe_alloc(adata, size);
     return adata;
 }
 
 static inline void fastFree(void *ptr) {
     if (ptr) {
+        observe_free(ptr);
         unsigned char *udata = ((unsigned char **)ptr)[-1];
         free(udata);
     }
@@ -11,6 +11,7 @@
 #include <common/baseline.h>
 #endif
 #include <common/helper.h>
+#include <dabnn/bconv_direct.h>
 #include <dabnn/im2col.h>
 #include "mat.h"
 
@@ -885,8 +886,10 @@ inline void bnn::bconv_3x3(const Mat &bottom_blob, const Mat &weight,
                 static_cast<float *>(top_blob.data), top_blob.h, top_blob.w,
                 stride);
         }
+    } else if (bottom_blob.c % 2 != 0 || top_blob.c % 128 != 0) {
+        // e.g. 192 or 384 channels
+        bconv_3x3_direct<2>(bottom_blob, weight, top_blob, stride);
     } else {
-        BNN_ASSERT(top_blob.c % 128 == 0, top_blob.c);
         pack_weight_3x3(weight.n, weight.c,
                         static_cast<uint64_t *>(weight.data), packed_weight);
         pack_input_3x3(static_cast<uint64_t *>(bottom_blob.data), bottom_blob.w,
@@ -925,8 +928,7 @@ inline void bnn::bconv_3x3(const Mat &bottom_blob, const Mat &weight,
                       top_blob.w, top_blob.h, top_blob.c);
     }
 #else   // __aarch64__
-    baseline_bconv(bottom_blob, weight, 3, 3, 0, 0, stride, stride, 1, 1,
-                   top_blob.c, top_blob);
+    bconv_3x3_direct<2>(bottom_blob, weight, top_blob, stride);
 #endif  // __aarch64__
 }
 
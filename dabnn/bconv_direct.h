@@ -0,0 +1,425 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#ifndef BNN_BCONV_DIRECT_H
+#define BNN_BCONV_DIRECT_H
+
+#if __ARM_NEON
+#include <arm_neon.h>
+#endif  // __ARM_NEON
+
+#include <algorithm>
+#include <vector>
+
+#include <common/baseline.h>
+#include <common/helper.h>
+#include "mat.h"
+
+namespace bnn {
+
+/**
+ * Direct binary convolution generated from templates, which covers the shapes
+ * without hand-written kernels in bconv.h (e.g. 192, 384 or 768 channels,
+ * 5x5 and 7x7 kernels, stride 2).
+ *
+ * In NHWC layout, a row of the kernel window (KW pixels * c uint64_t) is
+ * contiguous in both the padded input and the weight, so each output value is
+ * KH xor-popcount reductions over contiguous memory. The reductions are done
+ * in channel blocks of CB uint64_t (1 for 64 channels, 2 for 128 channels),
+ * and the tail shorter than a block is handled one uint64_t at a time.
+ *
+ * The bottom_blob should be binarized and padded, the output is the raw
+ * popcount of xor like the other binary kernels. Dilation and groups split a
+ * kernel row into KW segments, which are gathered into window, a scratch of
+ * bconv_window_len(weight, group, dilation_w) uint64_t. A window is allocated
+ * by every call if it is null.
+ */
+template <int KH, int KW, int STRIDE, int CB>
+inline void bconv_direct(const Mat &bottom_blob, const Mat &weight,
+                         Mat &top_blob, const int dilation_h = 1,
+                         const int dilation_w = 1, uint64_t *window = nullptr);
+template <int CB>
+inline void bconv_3x3_direct(const Mat &bottom_blob, const Mat &weight,
+                             Mat &top_blob, const int stride = 1);
+/**
+ * Whether bconv_direct has an instantiation for the kernel size and stride
+ */
+inline bool bconv_direct_compatible(const int kernel_h, const int kernel_w,
+                                    const int stride_h, const int stride_w);
+/**
+ * The uint64_t of the window of bconv_direct and bconv_group, 0 if the
+ * kernel rows are read in place
+ */
+inline size_t bconv_window_len(const Mat &weight, const int group,
+                               const int dilation_w);
+/**
+ * Dispatch to the bconv_direct instantiation by the weight shape and stride
+ */
+inline void bconv_direct(const Mat &bottom_blob, const Mat &weight,
+                         Mat &top_blob, const int stride,
+                         const int dilation_h = 1, const int dilation_w = 1,
+                         uint64_t *window = nullptr);
+/**
+ * Depthwise binary convolution, the weight is [1, kh, kw, c]. A uint64_t
+ * holds 64 channels, so the popcount of each channel is accumulated in
+ * bit-sliced counters (one uint64_t per bit of the count) for 64 channels at
+ * once, instead of 64 convs with 1 channel.
+ */
+inline void bconv_depthwise(const Mat &bottom_blob, const Mat &weight,
+                            Mat &top_blob, const int stride_h,
+                            const int stride_w, const int dilation_h = 1,
+                            const int dilation_w = 1);
+/**
+ * Grouped binary convolution, the weight is [num_output, kh, kw, c / group],
+ * or [1, kh, kw, c] for depthwise conv. Every group should have a multiple of
+ * 64 input channels unless it is depthwise.
+ */
+inline void bconv_group(const Mat &bottom_blob, const Mat &weight,
+                        Mat &top_blob, const int group, const int stride_h,
+                        const int stride_w, const int dilation_h = 1,
+                        const int dilation_w = 1, uint64_t *window = nullptr);
+
+namespace bconv_direct_detail {
+
+// The number of output channels computed together, the input is loaded once
+// for all of them
+constexpr int kOutputTile = 4;
+
+template <int CB, int NUM_OUTPUT>
+inline void xor_popcount_rows(const uint64_t *bottom, const uint64_t *const *w,
+                              const int len, uint32_t *acc) {
+    const int blocks = len / CB;
+#if __ARM_NEON
+    if (CB == 2) {
+        // Each uint16 lane gains at most 16 in a block
+        BNN_ASSERT(blocks < 4096, "Too many channels, blocks =", blocks);
+        uint16x8_t sum[NUM_OUTPUT];
+        FORZ(j, NUM_OUTPUT) { sum[j] = vdupq_n_u16(0); }
+        FORZ(b, blocks) {
+            const uint64x2_t x = vld1q_u64(bottom + b * 2);
+            FORZ(j, NUM_OUTPUT) {
+                const uint64x2_t y = vld1q_u64(w[j] + b * 2);
+                sum[j] = vpadalq_u8(
+                    sum[j], vcntq_u8(vreinterpretq_u8_u64(veorq_u64(x, y))));
+            }
+        }
+        FORZ(j, NUM_OUTPUT) {
+            const uint64x2_t s = vpaddlq_u32(vpaddlq_u16(sum[j]));
+            acc[j] += vgetq_lane_u64(s, 0) + vgetq_lane_u64(s, 1);
+        }
+    } else
+#endif  // __ARM_NEON
+    {
+        FORZ(b, blocks) {
+            FORZ(j, NUM_OUTPUT) {
+                FORZ(i, CB) {
+                    acc[j] += bitcount(bottom[b * CB + i] ^ w[j][b * CB + i]);
+                }
+            }
+        }
+    }
+    FOR(i, blocks * CB, len) {
+        FORZ(j, NUM_OUTPUT) { acc[j] += bitcount(bottom[i] ^ w[j][i]); }
+    }
+}
+
+/**
+ * The strides (in uint64_t) to walk a kernel window. Without dilation a
+ * kernel row is one contiguous segment of KW * c, otherwise it is KW segments
+ * of c which are dilation_w * c apart in the input.
+ */
+struct Window {
+    int kh;
+    int segments;
+    int len;
+    size_t bottom_row_step;
+    size_t bottom_segment_step;
+    size_t weight_row_step;
+    size_t weight_n_step;
+};
+
+template <int CB, int NUM_OUTPUT>
+inline void bconv_direct_pixel(const uint64_t *bottom, const uint64_t *weight,
+                               const Window &win, float *top) {
+    uint32_t acc[NUM_OUTPUT] = {};
+    FORZ(i, win.kh) {
+        FORZ(s, win.segments) {
+            const uint64_t *w[NUM_OUTPUT];
+            FORZ(j, NUM_OUTPUT) {
+                w[j] = weight + j * win.weight_n_step +
+                       i * win.weight_row_step + s * win.len;
+            }
+            xor_popcount_rows<CB, NUM_OUTPUT>(
+                bottom + i * win.bottom_row_step + s * win.bottom_segment_step,
+                w, win.len, acc);
+        }
+    }
+    FORZ(j, NUM_OUTPUT) { top[j] = static_cast<float>(acc[j]); }
+}
+
+/**
+ * KH and KW can be 0, which means the kernel size is read from the weight,
+ * and STRIDE can be 0, which means stride_h and stride_w are used
+ */
+template <int KH, int KW, int STRIDE, int CB>
+inline void bconv_direct_impl(const Mat &bottom_blob, const Mat &weight,
+                              Mat &top_blob, const int stride_h,
+                              const int stride_w, const int dilation_h,
+                              const int dilation_w, const int group = 1,
+                              uint64_t *window = nullptr) {
+    static_assert(CB == 1 || CB == 2, "CB should be 1 or 2");
+    BNN_ASSERT(bottom_blob.data_type == DataType::Bit &&
+                   weight.data_type == DataType::Bit,
+               "bconv_direct only supports binary input and weight");
+    const int kh = KH > 0 ? KH : weight.h;
+    const int kw = KW > 0 ? KW : weight.w;
+    const int sh = STRIDE > 0 ? STRIDE : stride_h;
+    const int sw = STRIDE > 0 ? STRIDE : stride_w;
+    BNN_ASSERT(weight.h == kh && weight.w == kw, weight.h, weight.w);
+    BNN_ASSERT(bottom_blob.c == weight.c * group, bottom_blob.c, weight.c,
+               group);
+    BNN_ASSERT(weight.n % group == 0, weight.n, group);
+    BNN_ASSERT(top_blob.c == weight.n, top_blob.c, weight.n);
+    BNN_ASSERT((top_blob.h - 1) * sh + dilation_h * (kh - 1) + 1 <=
+                       bottom_blob.h &&
+                   (top_blob.w - 1) * sw + dilation_w * (kw - 1) + 1 <=
+                       bottom_blob.w,
+               "The bottom_blob is too small");
+
+    constexpr int tile = kOutputTile;
+    const int c = bottom_blob.c;
+    // The channels of a group are a slice of every input pixel
+    const int group_c = weight.c;
+    const int group_n = weight.n / group;
+    const bool contiguous = dilation_w == 1 && group == 1;
+    const size_t window_len = bconv_window_len(weight, group, dilation_w);
+    Window win;
+    win.kh = kh;
+    win.segments = contiguous ? 1 : kw;
+    win.len = contiguous ? kw * c : group_c;
+    win.bottom_row_step = dilation_h * bottom_blob.hstep;
+    win.bottom_segment_step = dilation_w * c;
+    win.weight_row_step = weight.hstep;
+    // The converted weight may pad every output channel to 128 bits
+    win.weight_n_step = weight.total() / weight.n;
+    // Short segments are gathered into one contiguous window, which is
+    // reused by all outputs of the group
+    const bool gather = window_len > 0;
+    std::vector<uint64_t> own_window;
+    Window gathered_win = win;
+    if (gather) {
+        if (window == nullptr) {
+            own_window.resize(window_len);
+            ncnn::observe_scratch(window_len * sizeof(uint64_t), "window");
+            window = own_window.data();
+        }
+        gathered_win.kh = 1;
+        gathered_win.segments = 1;
+        gathered_win.len = kh * kw * group_c;
+    }
+
+    const auto *bottom_ptr = static_cast<const uint64_t *>(bottom_blob.data);
+    const auto *weight_ptr = static_cast<const uint64_t *>(weight.data);
+    auto *top_ptr = static_cast<float *>(top_blob.data);
+
+    FORZ(th, top_blob.h) {
+        FORZ(tw, top_blob.w) {
+            const auto *bottom =
+                bottom_ptr + th * sh * bottom_blob.hstep + tw * sw * c;
+            auto *top = top_ptr + th * top_blob.hstep + tw * top_blob.c;
+            FORZ(g, group) {
+                const auto *bottom_g = bottom + g * group_c;
+                if (gather) {
+                    auto *dst = window;
+                    FORZ(i, kh) {
+                        FORZ(j, kw) {
+                            const auto *src = bottom_g +
+                                              i * win.bottom_row_step +
+                                              j * win.bottom_segment_step;
+                            std::copy(src, src + group_c, dst);
+                            dst += group_c;
+                        }
+                    }
+                    bottom_g = window;
+                }
+                const auto &w = gather ? gathered_win : win;
+                const int end = (g + 1) * group_n;
+                int o = g * group_n;
+                for (; o + tile <= end; o += tile) {
+                    bconv_direct_pixel<CB, tile>(
+                        bottom_g, weight_ptr + o * w.weight_n_step, w,
+                        top + o);
+                }
+                for (; o < end; o++) {
+                    bconv_direct_pixel<CB, 1>(
+                        bottom_g, weight_ptr + o * w.weight_n_step, w,
+                        top + o);
+                }
+            }
+        }
+    }
+}
+
+// The counters of bconv_depthwise, 8 bits cover kernels up to 15x15
+constexpr int kMaxCounterBits = 8;
+
+inline int counter_bits(const int n) {
+    int bits = 0;
+    while ((1 << bits) <= n) {
+        bits++;
+    }
+    return bits;
+}
+
+}  // namespace bconv_direct_detail
+
+template <int KH, int KW, int STRIDE, int CB>
+inline void bconv_direct(const Mat &bottom_blob, const Mat &weight,
+                         Mat &top_blob, const int dilation_h,
+                         const int dilation_w, uint64_t *window) {
+    bconv_direct_detail::bconv_direct_impl<KH, KW, STRIDE, CB>(
+        bottom_blob, weight, top_blob, STRIDE, STRIDE, dilation_h, dilation_w,
+        1, window);
+}
+
+template <int CB>
+inline void bconv_3x3_direct(const Mat &bottom_blob, const Mat &weight,
+                             Mat &top_blob, const int stride) {
+    if (stride == 1) {
+        bconv_direct<3, 3, 1, CB>(bottom_blob, weight, top_blob);
+    } else if (stride == 2) {
+        bconv_direct<3, 3, 2, CB>(bottom_blob, weight, top_blob);
+    } else {
+        bconv_direct_detail::bconv_direct_impl<3, 3, 0, CB>(
+            bottom_blob, weight, top_blob, stride, stride, 1, 1);
+    }
+}
+
+inline bool bconv_direct_compatible(const int kernel_h, const int kernel_w,
+                                    const int stride_h, const int stride_w) {
+    if (kernel_h != kernel_w || stride_h != stride_w) {
+        return false;
+    }
+    if (kernel_h != 1 && kernel_h != 3 && kernel_h != 5 && kernel_h != 7) {
+        return false;
+    }
+    return stride_h == 1 || stride_h == 2;
+}
+
+inline size_t bconv_window_len(const Mat &weight, const int group,
+                               const int dilation_w) {
+    if (dilation_w == 1 && group == 1) {
+        return 0;
+    }
+    // A weight padded to 128 bits is not contiguous after gathering either
+    const size_t len = static_cast<size_t>(weight.w) * weight.c;
+    return weight.hstep == len ? weight.h * len : 0;
+}
+
+inline void bconv_direct(const Mat &bottom_blob, const Mat &weight,
+                         Mat &top_blob, const int stride, const int dilation_h,
+                         const int dilation_w, uint64_t *window) {
+    BNN_ASSERT(bconv_direct_compatible(weight.h, weight.w, stride, stride),
+               "No direct binary conv for kernel", weight.h, "x", weight.w,
+               ", stride", stride);
+#define BNN_BCONV_DIRECT_CASE(k)                                      \
+    if (weight.h == k) {                                              \
+        if (stride == 1) {                                            \
+            bconv_direct<k, k, 1, 2>(bottom_blob, weight, top_blob,   \
+                                     dilation_h, dilation_w, window); \
+        } else {                                                      \
+            bconv_direct<k, k, 2, 2>(bottom_blob, weight, top_blob,   \
+                                     dilation_h, dilation_w, window); \
+        }                                                             \
+        return;                                                       \
+    }
+    BNN_BCONV_DIRECT_CASE(1);
+    BNN_BCONV_DIRECT_CASE(3);
+    BNN_BCONV_DIRECT_CASE(5);
+    BNN_BCONV_DIRECT_CASE(7);
+#undef BNN_BCONV_DIRECT_CASE
+}
+
+inline void bconv_depthwise(const Mat &bottom_blob, const Mat &weight,
+                            Mat &top_blob, const int stride_h,
+                            const int stride_w, const int dilation_h,
+                            const int dilation_w) {
+    BNN_ASSERT(bottom_blob.data_type == DataType::Bit &&
+                   weight.data_type == DataType::Bit,
+               "bconv_depthwise only supports binary input and weight");
+    BNN_ASSERT(weight.n == 1, weight.n);
+    BNN_ASSERT(bottom_blob.c == weight.c, bottom_blob.c, weight.c);
+    BNN_ASSERT(top_blob.c == weight.c * 64, top_blob.c, weight.c);
+    const int kh = weight.h;
+    const int kw = weight.w;
+    BNN_ASSERT((top_blob.h - 1) * stride_h + dilation_h * (kh - 1) + 1 <=
+                       bottom_blob.h &&
+                   (top_blob.w - 1) * stride_w + dilation_w * (kw - 1) + 1 <=
+                       bottom_blob.w,
+               "The bottom_blob is too small");
+    const int bits = bconv_direct_detail::counter_bits(kh * kw);
+    BNN_ASSERT(bits <= bconv_direct_detail::kMaxCounterBits, "Kernel", kh,
+               "x", kw, "is too large");
+
+    const int c = bottom_blob.c;
+    const auto *bottom_ptr = static_cast<const uint64_t *>(bottom_blob.data);
+    const auto *weight_ptr = static_cast<const uint64_t *>(weight.data);
+    auto *top_ptr = static_cast<float *>(top_blob.data);
+
+    FORZ(th, top_blob.h) {
+        FORZ(tw, top_blob.w) {
+            const auto *bottom = bottom_ptr +
+                                 th * stride_h * bottom_blob.hstep +
+                                 tw * stride_w * c;
+            auto *top = top_ptr + th * top_blob.hstep + tw * top_blob.c;
+            FORZ(k, c) {
+                // counter[b] is the b-th bit of the popcount of 64 channels
+                uint64_t counter[bconv_direct_detail::kMaxCounterBits] = {};
+                FORZ(i, kh) {
+                    FORZ(j, kw) {
+                        uint64_t carry =
+                            bottom[i * dilation_h * bottom_blob.hstep +
+                                   j * dilation_w * c + k] ^
+                            weight_ptr[i * weight.hstep + j * c + k];
+                        // Ripple-carry add one to the channels in carry
+                        FORZ(b, bits) {
+                            const uint64_t next = counter[b] & carry;
+                            counter[b] ^= carry;
+                            carry = next;
+                        }
+                    }
+                }
+                FORZ(ch, 64) {
+                    uint32_t count = 0;
+                    FORZ(b, bits) {
+                        count |= static_cast<uint32_t>((counter[b] >> ch) & 1)
+                                 << b;
+                    }
+                    top[k * 64 + ch] = static_cast<float>(count);
+                }
+            }
+        }
+    }
+}
+
+inline void bconv_group(const Mat &bottom_blob, const Mat &weight,
+                        Mat &top_blob, const int group, const int stride_h,
+                        const int stride_w, const int dilation_h,
+                        const int dilation_w, uint64_t *window) {
+    if (group != 1 && weight.n == 1 && group == top_blob.c &&
+        group == bottom_blob.c * 64) {
+        bconv_depthwise(bottom_blob, weight, top_blob, stride_h, stride_w,
+                        dilation_h, dilation_w);
+    } else if (weight.h == 3 && weight.w == 3) {
+        bconv_direct_detail::bconv_direct_impl<3, 3, 0, 2>(
+            bottom_blob, weight, top_blob, stride_h, stride_w, dilation_h,
+            dilation_w, group, window);
+    } else {
+        bconv_direct_detail::bconv_direct_impl<0, 0, 0, 2>(
+            bottom_blob, weight, top_blob, stride_h, stride_w, dilation_h,
+            dilation_w, group, window);
+    }
+}
+
+}  // namespace bnn
+
+#endif /* BNN_BCONV_DIRECT_H */
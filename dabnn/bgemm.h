@@ -6,8 +6,11 @@
 #if __ARM_NEON
 #include <arm_neon.h>
 #endif  // __ARM_NEON
+#include <algorithm>
+
 #include <common/baseline.h>
 #include <common/helper.h>
+#include <dabnn/cpu_info.h>
 
 #if __ARM_NEON
 #ifdef __aarch64__
@@ -17,14 +20,78 @@
 #define P 4
 #define R 4
 #endif  // __aarch64__
+#else
+// Only used to align the blocks of the naive fallback
+#define P 8
+#define R 6
 #endif  // __ARM_NEON
 
+// The capacity (in uint64_t) of the static packing buffers in inner_kernel
+#define PACK_SIZE 128000
+
 #define A(i, j) a[(j)*lda + (i)]  // A(y, x)
 #define B(i, j) b[(j)*ldb + (i)]  // B(y, x)
 #define C(i, j) c[(j)*ldc + (i)]  // C(y, x)
 
 #define min(i, j) ((i) < (j) ? (i) : (j))
 
+/**
+ * kc: the depth of a block (in uint64_t), a P*kc panel of A and a kc*R panel
+ * of B are expected to stay in L1
+ * mc: the rows of a packed mc*kc block of A, which stays in L2
+ * nc: the columns of a packed kc*nc block of B, which stays in L3 (or in the
+ * other half of L2 when there is no L3)
+ */
+struct BgemmBlocking {
+    int kc;
+    int mc;
+    int nc;
+};
+
+inline int bgemm_round_down(const int a, const int b) {
+    return std::max(a / b * b, b);
+}
+
+/**
+ * Derive the blocking from the cache sizes and the gemm shape
+ */
+inline BgemmBlocking bgemm_blocking(const bnn::CacheInfo &cache, const int m,
+                                    const int n, const int k) {
+    BgemmBlocking blocking;
+    const int elemsize = sizeof(uint64_t);
+    // The micro kernel consumes two uint64_t (one 128-bit vector) at a time
+    blocking.kc = bgemm_round_down(
+        static_cast<int>(cache.l1d / 2 / ((P + R) * elemsize)), 2);
+    blocking.kc = min(blocking.kc, PACK_SIZE / std::max(P, R) - 2);
+    const int kc = min(blocking.kc, k + k % 2);
+
+    blocking.mc = bgemm_round_down(
+        static_cast<int>(cache.l2 / 2 / (kc * elemsize)), P);
+    blocking.mc = min(blocking.mc, bgemm_round_down(PACK_SIZE / kc, P));
+
+    const size_t b_cache = cache.l3 > 0 ? cache.l3 / 2 : cache.l2 / 2;
+    blocking.nc = bgemm_round_down(
+        static_cast<int>(min(b_cache / (kc * elemsize),
+                             static_cast<size_t>(PACK_SIZE))),
+        R);
+    blocking.nc = min(blocking.nc, bgemm_round_down(PACK_SIZE / kc, R));
+
+    // Avoid a tiny tail block when a dimension is slightly larger than a block
+    if (m > blocking.mc && m < 2 * blocking.mc) {
+        blocking.mc =
+            min(blocking.mc, bgemm_round_down((m + 1) / 2 + P - 1, P));
+    }
+    if (n > blocking.nc && n < 2 * blocking.nc) {
+        blocking.nc =
+            min(blocking.nc, bgemm_round_down((n + 1) / 2 + R - 1, R));
+    }
+    return blocking;
+}
+
+inline BgemmBlocking bgemm_blocking(const int m, const int n, const int k) {
+    return bgemm_blocking(bnn::cache_info(), m, n, k);
+}
+
 #ifdef __ARM_NEON
 inline void pack_a(const int kc, const uint64_t *a, const int lda,
                    uint64_t *a_to);
@@ -45,24 +112,40 @@ inline void bgemm_naive(const int m, const int n, const int k,
 
 inline void bgemm(const int m, const int n, const int k, const uint64_t *a,
                   int lda, const uint64_t *b, const int ldb, float *c,
-                  const int ldc) {
-#ifdef __ARM_NEON
-    int kc = 32;
-    int mc = 32;
-    int i, q, qb, ib;
+                  const int ldc, const BgemmBlocking &blocking) {
+    const int kc = blocking.kc;
+    const int mc = blocking.mc;
+    const int nc = blocking.nc;
+    BNN_ASSERT(kc > 0 && kc % 2 == 0,
+               "kc should be a positive even number, kc =", kc);
+    BNN_ASSERT(mc > 0 && nc > 0, "mc =", mc, ", nc =", nc);
+    int i, j, q, qb, ib, jb;
 
     for (q = 0; q < k; q += kc) {
         qb = min(k - q, kc);
 
-        for (i = 0; i < m; i += mc) {
-            ib = min(m - i, mc);
-            inner_kernel(ib, n, qb, &A(i, q), lda, &B(q, 0), ldb, &C(i, 0), ldc,
-                         i == 0);
-        }
-    }
+        for (j = 0; j < n; j += nc) {
+            jb = min(n - j, nc);
+
+            for (i = 0; i < m; i += mc) {
+                ib = min(m - i, mc);
+#ifdef __ARM_NEON
+                // B is packed only once for each kc*nc block
+                inner_kernel(ib, jb, qb, &A(i, q), lda, &B(q, j), ldb,
+                             &C(i, j), ldc, i == 0);
 #else
-    bgemm_naive(m, n, k, a, lda, b, ldb, c, ldc);
+                bgemm_naive(ib, jb, qb, &A(i, q), lda, &B(q, j), ldb, &C(i, j),
+                            ldc);
 #endif  // __ARM_NEON
+            }
+        }
+    }
+}
+
+inline void bgemm(const int m, const int n, const int k, const uint64_t *a,
+                  int lda, const uint64_t *b, const int ldb, float *c,
+                  const int ldc) {
+    bgemm(m, n, k, a, lda, b, ldb, c, ldc, bgemm_blocking(m, n, k));
 }
 
 #if __ARM_NEON
@@ -71,13 +154,15 @@ inline void inner_kernel(const int m, const int n, const int k,
                          const int ldb, float *c, const int ldc,
                          const int first_time) {
     BNN_ASSERT(k % 2 == 0, "k % 2 should be 0, k =", k);
-    BNN_ASSERT(k * P < 128000, "");
-    BNN_ASSERT(k * R < 128000, "");
+    BNN_ASSERT(k * P < PACK_SIZE, "");
+    BNN_ASSERT(k * R < PACK_SIZE, "");
+    BNN_ASSERT(m * k <= PACK_SIZE, "m =", m, ", k =", k);
+    BNN_ASSERT(n * k <= PACK_SIZE, "n =", n, ", k =", k);
 
     int i = 0, j = 0;
     // TODO: more elegant way
-    alignas(128) static uint64_t packedA[128000];
-    alignas(128) static uint64_t packedB[128000];
+    alignas(128) static uint64_t packedA[PACK_SIZE];
+    alignas(128) static uint64_t packedB[PACK_SIZE];
     alignas(128) static float packedC[P * R];
 
     for (j = 0; j + R <= n; j += R) {
@@ -596,6 +681,7 @@ inline void bgemm_naive(const int m, const int n, const int k,
     }
 }
 
+#undef PACK_SIZE
 #undef R
 #undef P
 #undef A
@@ -26,6 +26,30 @@
 #include "mat.h"
 
 namespace bnn {
+/**
+ * The fp16 counterpart of pack_64_bitfield, bit i is set if half_ptr[i] > 0,
+ * which is read from the sign and the magnitude without a conversion
+ */
+inline void pack_64_half(const half_t *half_ptr, uint64_t *buf) {
+    uint64_t bits = 0;
+    FORZ(i, 64) {
+        bits |= static_cast<uint64_t>(static_cast<int16_t>(half_ptr[i]) > 0)
+                << i;
+    }
+    *buf = bits;
+}
+
+inline void pack_64_half(const half_t *half_ptr, void *binary_ptr,
+                         size_t size) {
+    BNN_ASSERT(size % 64 == 0, "");
+    uint64_t *u64_bptr = static_cast<uint64_t *>(binary_ptr);
+    FORZS(_, size, 64) {
+        pack_64_half(half_ptr, u64_bptr);
+        half_ptr += 64;
+        u64_bptr++;
+    }
+}
+
 inline void pack_64(const float *float_ptr, void *binary_ptr, size_t size) {
     BNN_ASSERT(size % 64 == 0, "");
     uint64_t *u64_bptr = static_cast<uint64_t *>(binary_ptr);
@@ -263,8 +287,13 @@ inline void pack_mat_64(const bnn::Mat &float_mat, bnn::Mat &binary_mat) {
 
     FORZ(n, float_mat.n) {
         FORZ(h, float_mat.h) {
-            auto *fptr = float_mat.point<float>(n, h, 0);
             auto *bptr = binary_mat.point<uint64_t>(n, h, 0);
+            if (float_mat.data_type == DataType::Half) {
+                pack_64_half(float_mat.point<half_t>(n, h, 0), bptr,
+                             float_mat.w * float_mat.c);
+                continue;
+            }
+            auto *fptr = float_mat.point<float>(n, h, 0);
             FORZ(i, float_mat.w * float_mat.c / 64) {
                 pack_64_bitfield(fptr, bptr);
                 fptr += 64;
@@ -274,8 +303,12 @@ inline void pack_mat_64(const bnn::Mat &float_mat, bnn::Mat &binary_mat) {
     }
 }
 
+/**
+ * float_mat can also be fp16 (DataType::Half)
+ */
 inline void pack_mat(const bnn::Mat &float_mat, bnn::Mat &binary_mat) {
-    BNN_ASSERT(float_mat.data_type == DataType::Float,
+    BNN_ASSERT(float_mat.data_type == DataType::Float ||
+                   float_mat.data_type == DataType::Half,
                "float_mat has wrong data type");
     BNN_ASSERT(binary_mat.data_type == DataType::Bit,
                "binary_mat has wrong data type");
@@ -0,0 +1,259 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#ifndef BNN_BITPLANE_H
+#define BNN_BITPLANE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <common/helper.h>
+#include <dabnn/allocator.h>
+#include <dabnn/bgemm.h>
+
+namespace bnn {
+
+// The levels of k bits are the odd integers in [1 - 2^k, 2^k - 1]. Level
+// 2u - (2^k - 1) is sum_i 2^i * (2 * bit_i(u) - 1), so bit i of u is a
+// +1/-1 plane and the dot product of two levels is
+// sum_ij 2^(i + j) * (1 - 2 * (bit_i(x) ^ bit_j(w))).
+constexpr int kMaxPlaneBits = 4;
+
+inline int max_level(const int bits) { return (1 << bits) - 1; }
+
+/**
+ * The u of the level nearest to v * inv_scale
+ */
+inline int quantize_level(const float v, const float inv_scale,
+                          const int bits) {
+    const int top = max_level(bits);
+    const float u = std::nearbyint((v * inv_scale + top) * 0.5f);
+    return static_cast<int>(std::max(0.f, std::min<float>(top, u)));
+}
+
+/**
+ * The words of the planes of a pixel (or a tap of the weight) with c
+ * channels, c / 64 words for every plane
+ */
+inline int plane_words(const int c) { return c / 64; }
+
+/**
+ * Set the planes of c levels given by u(ch), plane i of channel ch is bit
+ * ch % 64 of word i * plane_words(c) + ch / 64
+ */
+template <typename UFn>
+inline void pack_planes(const int c, const int bits, UFn &&u,
+                        uint64_t *planes) {
+    const int words = plane_words(c);
+    std::fill(planes, planes + bits * words, 0);
+    FORZ(ch, c) {
+        const int v = u(ch);
+        FORZ(i, bits) {
+            planes[i * words + ch / 64] |=
+                static_cast<uint64_t>((v >> i) & 1) << (ch % 64);
+        }
+    }
+}
+
+/**
+ * The depth (in uint64_t) of the gemm of the bit planes, an even number of
+ * words as bgemm requires
+ */
+inline int bitplane_k(const int kernel_len, const int c) {
+    return (kernel_len * plane_words(c) + 1) / 2 * 2;
+}
+
+/**
+ * Pack the [m, kernel_len, c] weight levels for bgemm. Row j * m + o of the
+ * column-major a is plane j of output channel o, whose taps follow each
+ * other. wsum[o * kernel_len + t] is the sum of the levels of tap t, which
+ * corrects the padded taps.
+ */
+inline void pack_weight_planes(const int8_t *levels, const int m,
+                               const int kernel_len, const int c,
+                               const int bits, uint64_t *a, float *wsum) {
+    const int k = bitplane_k(kernel_len, c);
+    const int words = plane_words(c);
+    const int lda = bits * m;
+    const int top = max_level(bits);
+    std::vector<uint64_t> planes(bits * words);
+    ncnn::observe_scratch(planes.size() * sizeof(uint64_t), "planes");
+    std::fill(a, a + static_cast<size_t>(k) * lda, 0);
+    FORZ(o, m) {
+        FORZ(t, kernel_len) {
+            const int8_t *tap = levels + (o * kernel_len + t) * c;
+            int sum = 0;
+            FORZ(ch, c) {
+                BNN_ASSERT(tap[ch] % 2 != 0 && std::abs(tap[ch]) <= top,
+                           "The weight level ", static_cast<int>(tap[ch]),
+                           " is not one of ", bits, " bits");
+                sum += tap[ch];
+            }
+            wsum[o * kernel_len + t] = static_cast<float>(sum);
+            pack_planes(c, bits, [&](const int ch) {
+                return (tap[ch] + top) / 2;
+            }, planes.data());
+            FORZ(j, bits) {
+                FORZ(w, words) {
+                    a[static_cast<size_t>(t * words + w) * lda + j * m + o] =
+                        planes[j * words + w];
+                }
+            }
+        }
+    }
+}
+
+/**
+ * The bit planes of a quantized nhwc input and the gemm of them with the
+ * weight planes
+ */
+struct BitplaneConv {
+    int n, h, w, c;
+    int kernel_h, kernel_w, pad_h, pad_w, stride_h, stride_w;
+    int dilation_h, dilation_w;
+    int output_h, output_w;
+    int activation_bits;
+    int weight_bits;
+    int m;
+
+    int kernel_len() const { return kernel_h * kernel_w; }
+    int k() const { return bitplane_k(kernel_len(), c); }
+    int pixels() const { return n * output_h * output_w; }
+
+    size_t planes_size() const {
+        return static_cast<size_t>(n) * h * w * activation_bits *
+               plane_words(c);
+    }
+    size_t col_size() const {
+        return static_cast<size_t>(pixels()) * activation_bits * k();
+    }
+    size_t popcount_size() const {
+        return static_cast<size_t>(pixels()) * activation_bits *
+               weight_bits * m;
+    }
+
+    /**
+     * Pack the planes of every pixel of the images once, row(y) returns the
+     * w * c float values of row y of the n * h rows
+     */
+    template <typename RowFn>
+    void pack_input(RowFn &&row, const float inv_scale,
+                    uint64_t *planes) const {
+        const int pixel_len = activation_bits * plane_words(c);
+        FORZ(y, n * h) {
+            const float *ptr = row(y);
+            FORZ(x, w) {
+                pack_planes(c, activation_bits, [&](const int ch) {
+                    return quantize_level(ptr[ch], inv_scale,
+                                          activation_bits);
+                }, planes + (static_cast<size_t>(y) * w + x) * pixel_len);
+                ptr += c;
+            }
+        }
+    }
+
+    /**
+     * Column p * activation_bits + i of col is plane i of the window of
+     * pixel p, the padded taps are zero (all planes -1)
+     */
+    void im2col(const uint64_t *planes, uint64_t *col) const {
+        const int words = plane_words(c);
+        const int pixel_len = activation_bits * words;
+        const int kk = k();
+        FORZ(b, n) {
+            FORZ(oy, output_h) {
+                FORZ(ox, output_w) {
+                    const int p = (b * output_h + oy) * output_w + ox;
+                    uint64_t *dst =
+                        col + static_cast<size_t>(p) * activation_bits * kk;
+                    std::fill(dst, dst + activation_bits * kk, 0);
+                    FORZ(ky, kernel_h) {
+                        const int y = oy * stride_h - pad_h + ky * dilation_h;
+                        FORZ(kx, kernel_w) {
+                            const int x =
+                                ox * stride_w - pad_w + kx * dilation_w;
+                            if (y < 0 || y >= h || x < 0 || x >= w) {
+                                continue;
+                            }
+                            const uint64_t *src =
+                                planes +
+                                ((static_cast<size_t>(b) * h + y) * w + x) *
+                                    pixel_len;
+                            const int t = ky * kernel_w + kx;
+                            FORZ(i, activation_bits) {
+                                memcpy(dst + i * kk + t * words,
+                                       src + i * words,
+                                       words * sizeof(uint64_t));
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * popcount[(p * activation_bits + i) * ldc + j * m + o] is the number of
+     * the different bits of plane i of pixel p and plane j of channel o
+     */
+    void gemm(const uint64_t *weight_planes, const uint64_t *col,
+              float *popcount) const {
+        const int rows = weight_bits * m;
+        const int cols = pixels() * activation_bits;
+        std::fill(popcount, popcount + popcount_size(), 0.f);
+        bgemm(rows, cols, k(), weight_planes, rows, col, k(), popcount, rows);
+    }
+
+    /**
+     * out(p)[o] = scale[o] * sum of level products + bias[o], scale[o] is
+     * the product of the scales of the input and the weight
+     */
+    template <typename OutFn>
+    void combine(const float *popcount, const float *wsum, const float *scale,
+                 const float *bias, OutFn &&out) const {
+        const int ldc = weight_bits * m;
+        const float bits_k = static_cast<float>(kernel_len() * c);
+        const float top_x = static_cast<float>(max_level(activation_bits));
+        // sum_ij 2^(i + j) * k, the dot product of no different bits
+        const float full =
+            bits_k * top_x * static_cast<float>(max_level(weight_bits));
+        std::vector<float> acc(m);
+        ncnn::observe_scratch(acc.size() * sizeof(float), "acc");
+        FORZ(p, pixels()) {
+            std::fill(acc.begin(), acc.end(), full);
+            FORZ(i, activation_bits) {
+                const float *row = popcount + (p * activation_bits + i) * ldc;
+                FORZ(j, weight_bits) {
+                    const float f = -2.f * static_cast<float>(1 << (i + j));
+                    FORZ(o, m) { acc[o] += f * row[j * m + o]; }
+                }
+            }
+            // The padded taps are level -top_x rather than 0
+            const int oy = p / output_w % output_h;
+            const int ox = p % output_w;
+            FORZ(ky, kernel_h) {
+                const int y = oy * stride_h - pad_h + ky * dilation_h;
+                FORZ(kx, kernel_w) {
+                    const int x = ox * stride_w - pad_w + kx * dilation_w;
+                    if (y >= 0 && y < h && x >= 0 && x < w) {
+                        continue;
+                    }
+                    const int t = ky * kernel_w + kx;
+                    FORZ(o, m) {
+                        acc[o] += top_x * wsum[o * kernel_len() + t];
+                    }
+                }
+            }
+            float *dst = out(p);
+            FORZ(o, m) {
+                dst[o] = acc[o] * scale[o] + (bias == nullptr ? 0.f : bias[o]);
+            }
+        }
+    }
+};
+
+}  // namespace bnn
+
+#endif /* BNN_BITPLANE_H */
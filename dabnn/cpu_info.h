@@ -0,0 +1,109 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#ifndef BNN_CPU_INFO_H
+#define BNN_CPU_INFO_H
+
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+
+namespace bnn {
+
+/**
+ * Data cache sizes (in bytes) of the core running the process. A size of 0
+ * means the level does not exist or could not be detected.
+ */
+struct CacheInfo {
+    size_t l1d = 0;
+    size_t l2 = 0;
+    size_t l3 = 0;
+};
+
+/**
+ * Parse sysfs cache size strings like "32K", "2048K" or "8M"
+ */
+inline size_t parse_cache_size(const std::string &str) {
+    size_t pos = 0;
+    size_t size = 0;
+    try {
+        size = std::stoul(str, &pos);
+    } catch (const std::exception &) {
+        return 0;
+    }
+    if (pos < str.size()) {
+        switch (str[pos]) {
+            case 'K':
+            case 'k':
+                size *= 1024;
+                break;
+            case 'M':
+            case 'm':
+                size *= 1024 * 1024;
+                break;
+            case 'G':
+            case 'g':
+                size *= 1024 * 1024 * 1024;
+                break;
+            default:
+                break;
+        }
+    }
+    return size;
+}
+
+inline CacheInfo detect_cache_info() {
+    CacheInfo info;
+    const std::string dir = "/sys/devices/system/cpu/cpu0/cache/index";
+    for (int i = 0;; i++) {
+        const auto prefix = dir + std::to_string(i) + "/";
+        std::ifstream level_file(prefix + "level");
+        if (!level_file) {
+            break;
+        }
+        int level = 0;
+        std::string type, size_str;
+        level_file >> level;
+        std::ifstream(prefix + "type") >> type;
+        std::ifstream(prefix + "size") >> size_str;
+        if (type == "Instruction") {
+            continue;
+        }
+        const auto size = parse_cache_size(size_str);
+        if (level == 1) {
+            info.l1d = size;
+        } else if (level == 2) {
+            info.l2 = size;
+        } else if (level == 3) {
+            info.l3 = size;
+        }
+    }
+    // sysfs cache entries are missing on many Android kernels, glibc gets
+    // them from cpuid on x86
+#if defined(_SC_LEVEL1_DCACHE_SIZE) && defined(_SC_LEVEL2_CACHE_SIZE) && \
+    defined(_SC_LEVEL3_CACHE_SIZE)
+    const auto sc_size = [](int name) -> size_t {
+        const auto ret = sysconf(name);
+        return ret > 0 ? static_cast<size_t>(ret) : 0;
+    };
+    if (info.l1d == 0) info.l1d = sc_size(_SC_LEVEL1_DCACHE_SIZE);
+    if (info.l2 == 0) info.l2 = sc_size(_SC_LEVEL2_CACHE_SIZE);
+    if (info.l3 == 0) info.l3 = sc_size(_SC_LEVEL3_CACHE_SIZE);
+#endif
+    // Conservative defaults of a little core (e.g. Cortex-A53)
+    if (info.l1d == 0) info.l1d = 32 * 1024;
+    if (info.l2 == 0) info.l2 = 512 * 1024;
+    return info;
+}
+
+/**
+ * The cache sizes are detected only once
+ */
+inline const CacheInfo &cache_info() {
+    static const CacheInfo info = detect_cache_info();
+    return info;
+}
+
+}  // namespace bnn
+
+#endif /* BNN_CPU_INFO_H */
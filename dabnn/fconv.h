@@ -3,76 +3,333 @@
 #ifndef BNN_FCONV_HPP
 #define BNN_FCONV_HPP
 
-#include <Eigen/Dense>
+#include <cstdint>
+#include <vector>
 
 #include <common/helper.h>
-#include "glog/logging.h"
-#include "im2col.h"
+#include "fgemm.h"
 #include "mat.h"
+#include "qgemm.h"
 
 namespace bnn {
-void fconv(const Mat &input, const Mat &weight, const int kernel_h,
-           const int kernel_w, const int pad_h, const int pad_w,
-           const int stride_h, const int stride_w, const int dilation_h,
-           const int dilation_w, const int output_channels, Mat &output) {
-    using namespace Eigen;
+
+inline int fconv_output_size(const int input, const int kernel, const int pad,
+                             const int stride, const int dilation) {
+    return (input + 2 * pad - (dilation * (kernel - 1) + 1)) / stride + 1;
+}
+
+namespace fconv_detail {
+
+/**
+ * out(p) of fgemm, the output floats of pixel p. The images of a batch follow
+ * each other, so pixel p of the whole batch is in row p / output_w.
+ */
+struct OutputRows {
+    float *data;
+    size_t hstep;
+    int output_w;
+    int c;
+
+    OutputRows(Mat &output, const int output_h, const int output_w,
+               const int c)
+        : data(static_cast<float *>(output.data)),
+          // A flat output (e.g. in tests) has no row padding
+          hstep(output.h == output_h && output.w == output_w
+                    ? output.hstep
+                    : static_cast<size_t>(output_w) * c),
+          output_w(output_w),
+          c(c) {}
+
+    float *operator()(const int p) const {
+        return data + (p / output_w) * hstep + (p % output_w) * c;
+    }
+};
+
+inline float load(const float v, const int, const float *, const float *) {
+    return v;
+}
+
+inline float load(const uint8_t v, const int c, const float *mean,
+                  const float *scale) {
+    return (static_cast<float>(v) - mean[c]) * scale[c];
+}
+
+/**
+ * Gather the conv windows of the pixels straight from NHWC images into the
+ * packed panel of a gemm, so that no im2col buffer is written. The padding is
+ * zero, a uint8 image is normalized by (v - mean[c]) * scale[c] on the fly.
+ * The pixels of all the images of the batch are one gemm dimension, the
+ * images are image_size elements apart.
+ */
+template <typename T>
+struct WindowPacker {
+    const T *data;
+    int h, w, c;
+    size_t hstep;
+    size_t image_size;
+    int kernel_h, kernel_w, pad_h, pad_w, stride_h, stride_w, dilation_h,
+        dilation_w;
+    int output_h, output_w;
+    const float *mean;
+    const float *scale;
+
+    /**
+     * Visit the [k0, k0 + kc) slice of the windows of the NR pixels from p0
+     * as segments, put(i, j, src, len, ch) receives the len values of pixel
+     * i from depth k0 + j, which are src (starting at channel ch) or zero
+     * if src is nullptr (the padding and the pixels beyond nr).
+     */
+    template <int NR, typename PutFn>
+    void gather(const int p0, const int nr, const int k0, const int kc,
+                PutFn &&put) const {
+        const int row_len = kernel_w * c;
+        FORZ(i, NR) {
+            if (i >= nr) {
+                put(i, 0, nullptr, kc, 0);
+                continue;
+            }
+            const int row = (p0 + i) / output_w;
+            const T *image = data + row / output_h * image_size;
+            const int y0 = row % output_h * stride_h - pad_h;
+            const int x0 = (p0 + i) % output_w * stride_w - pad_w;
+            // A kernel row inside the image is one contiguous segment, which
+            // is the common case of small channel stems
+            const bool row_inside =
+                dilation_w == 1 && x0 >= 0 && x0 + kernel_w <= w;
+            for (int j = k0; j < k0 + kc;) {
+                const int off = j % row_len;
+                const int y = y0 + j / row_len * dilation_h;
+                const T *src = nullptr;
+                int len;
+                if (row_inside) {
+                    len = std::min<int>(row_len - off, k0 + kc - j);
+                    if (y >= 0 && y < h) {
+                        src = image + y * hstep + x0 * c + off;
+                    }
+                } else {
+                    const int x = x0 + off / c * dilation_w;
+                    len = std::min<int>(c - off % c, k0 + kc - j);
+                    if (y >= 0 && y < h && x >= 0 && x < w) {
+                        src = image + y * hstep + x * c + off % c;
+                    }
+                }
+                put(i, j - k0, src, len, off % c);
+                j += len;
+            }
+        }
+    }
+
+    void operator()(const int p0, const int nr, const int k0, const int kc,
+                    float *packed) const {
+        gather<kFgemmNR>(p0, nr, k0, kc,
+                         [&](const int i, const int j, const T *src,
+                             const int len, int ch) {
+                             float *d = packed + j * kFgemmNR + i;
+                             if (src == nullptr) {
+                                 FORZ(l, len) { d[l * kFgemmNR] = 0.f; }
+                                 return;
+                             }
+                             FORZ(l, len) {
+                                 d[l * kFgemmNR] =
+                                     load(src[l], ch, mean, scale);
+                                 if (++ch == c) {
+                                     ch = 0;
+                                 }
+                             }
+                         });
+    }
+};
+
+/**
+ * WindowPacker on an int8 image for qgemm
+ */
+struct Int8WindowPacker {
+    WindowPacker<int8_t> windows;
+
+    void operator()(const int p0, const int nr, const int k0, const int kc,
+                    int8_t *packed) const {
+        windows.gather<kQgemmNR>(
+            p0, nr, k0, kc,
+            [packed](const int i, const int j, const int8_t *src,
+                     const int len, int) {
+                FORZ(l, len) {
+                    packed[qgemm_detail::panel_index(j + l, i)] =
+                        src != nullptr ? src[l] : 0;
+                }
+            });
+    }
+};
+
+template <typename T>
+inline void fconv_image(const T *data, const int n, const int h, const int w,
+                        const int c, const size_t hstep,
+                        const size_t image_size, const float *mean,
+                        const float *scale, const float *packed_weight,
+                        const int kernel_h, const int kernel_w,
+                        const int pad_h, const int pad_w, const int stride_h,
+                        const int stride_w, const int dilation_h,
+                        const int dilation_w, const int output_channels,
+                        const FgemmEpilogue &epilogue, Mat &output) {
     const int output_h =
-        (input.h + 2 * pad_h - (dilation_h * (kernel_h - 1) + 1)) / stride_h +
-        1;
+        fconv_output_size(h, kernel_h, pad_h, stride_h, dilation_h);
     const int output_w =
-        (input.w + 2 * pad_w - (dilation_w * (kernel_w - 1) + 1)) / stride_w +
-        1;
-    const int a = output_h * output_w * kernel_h * kernel_w * input.c;
-    Mat input_col(a, input.data_type);
-
-    VLOG(5) << "im2col";
-    im2col(input, kernel_h, kernel_w, pad_h, pad_w, stride_h, stride_w,
-           dilation_h, dilation_w, input_col);
-    VLOG(5) << "im2col end";
+        fconv_output_size(w, kernel_w, pad_w, stride_w, dilation_w);
     const int M = output_channels;
-    const int N = output_h * output_w;
-    const int K = kernel_h * kernel_w * input.c;
-    Map<Matrix<float, Dynamic, Dynamic, RowMajor>> weight_eg(
-        static_cast<float *>(weight.data), M, K);
-    Map<Matrix<float, Dynamic, Dynamic, RowMajor>> input_notrans_eg(
-        static_cast<float *>(input_col.data), N, K);
-    Map<Matrix<float, Dynamic, Dynamic, ColMajor>> output_eg(
-        static_cast<float *>(output.data), M, N);
-    output_eg.noalias() = weight_eg * input_notrans_eg.transpose();
+    const int N = n * output_h * output_w;
+    const int K = kernel_h * kernel_w * c;
+    const OutputRows out(output, output_h, output_w, M);
+    const WindowPacker<T> packer{data,       h,          w,        c,
+                                 hstep,      image_size, kernel_h, kernel_w,
+                                 pad_h,      pad_w,      stride_h, stride_w,
+                                 dilation_h, dilation_w, output_h, output_w,
+                                 mean,       scale};
+    fgemm_packed_gather(M, N, K, packed_weight, packer, out, epilogue);
+}
+
+}  // namespace fconv_detail
+
+/**
+ * Float conv on a weight packed by fgemm_pack_weight. The input is read in
+ * place, a 1x1 conv without padding uses the pixels as the rows of the gemm
+ * and the other convs gather their windows while packing. The input.n images
+ * are folded into the pixel dimension of a single gemm.
+ */
+inline void fconv_packed(const Mat &input, const float *packed_weight,
+                         const int kernel_h, const int kernel_w,
+                         const int pad_h, const int pad_w, const int stride_h,
+                         const int stride_w, const int dilation_h,
+                         const int dilation_w, const int output_channels,
+                         const FgemmEpilogue &epilogue, Mat &output) {
+    const auto *input_ptr = static_cast<const float *>(input.data);
+    const size_t image_size = static_cast<size_t>(input.h) * input.hstep;
+    if (kernel_h == 1 && kernel_w == 1 && pad_h == 0 && pad_w == 0) {
+        const int output_h = fconv_output_size(input.h, 1, 0, stride_h, 1);
+        const int output_w = fconv_output_size(input.w, 1, 0, stride_w, 1);
+        fgemm_packed(output_channels, input.n * output_h * output_w, input.c,
+                     packed_weight,
+                     [&](const int p) {
+                         const int row = p / output_w;
+                         return input_ptr + row / output_h * image_size +
+                                row % output_h * stride_h * input.hstep +
+                                (p % output_w) * stride_w * input.c;
+                     },
+                     fconv_detail::OutputRows(output, output_h, output_w,
+                                              output_channels),
+                     epilogue);
+        return;
+    }
+    fconv_detail::fconv_image(input_ptr, input.n, input.h, input.w, input.c,
+                              input.hstep, image_size, nullptr, nullptr,
+                              packed_weight,
+                              kernel_h, kernel_w, pad_h, pad_w, stride_h,
+                              stride_w, dilation_h, dilation_w,
+                              output_channels, epilogue, output);
+}
+
+/**
+ * fconv_packed on n h*w*c uint8 images (e.g. decoded photos), every value is
+ * normalized by (v - mean[c]) * scale[c] when it is packed. It is meant for
+ * the stem, which then needs no float copy of the images.
+ */
+inline void fconv_packed_uint8(const uint8_t *input, const int n, const int h,
+                               const int w, const int c, const float *mean,
+                               const float *scale, const float *packed_weight,
+                               const int kernel_h, const int kernel_w,
+                               const int pad_h, const int pad_w,
+                               const int stride_h, const int stride_w,
+                               const int dilation_h, const int dilation_w,
+                               const int output_channels,
+                               const FgemmEpilogue &epilogue, Mat &output) {
+    BNN_ASSERT(mean != nullptr && scale != nullptr, "");
+    const size_t hstep = static_cast<size_t>(w) * c;
+    fconv_detail::fconv_image(input, n, h, w, c, hstep, h * hstep, mean,
+                              scale, packed_weight, kernel_h, kernel_w,
+                              pad_h, pad_w, stride_h, stride_w, dilation_h,
+                              dilation_w, output_channels, epilogue, output);
 }
 
-void fconv(const Mat &input, const Mat &weight, const Mat &bias,
-           const int kernel_h, const int kernel_w, const int pad_h,
-           const int pad_w, const int stride_h, const int stride_w,
-           const int dilation_h, const int dilation_w,
-           const int output_channels, Mat &output) {
-    using namespace Eigen;
+/**
+ * The int8 counterpart of fconv_packed on n contiguous h*w*c int8 images
+ * (the input quantized by quantize_int8). packed_weight is packed by
+ * qgemm_pack_weight, dequant[i] is the product of the scales of output
+ * channel i of the weight and of the input.
+ */
+inline void fconv_packed_int8(const int8_t *input, const int n, const int h,
+                              const int w, const int c,
+                              const int8_t *packed_weight,
+                              const float *dequant, const int kernel_h,
+                              const int kernel_w, const int pad_h,
+                              const int pad_w, const int stride_h,
+                              const int stride_w, const int dilation_h,
+                              const int dilation_w, const int output_channels,
+                              const FgemmEpilogue &epilogue, Mat &output) {
+    const size_t hstep = static_cast<size_t>(w) * c;
+    const size_t image_size = h * hstep;
     const int output_h =
-        (input.h + 2 * pad_h - (dilation_h * (kernel_h - 1) + 1)) / stride_h +
-        1;
+        fconv_output_size(h, kernel_h, pad_h, stride_h, dilation_h);
     const int output_w =
-        (input.w + 2 * pad_w - (dilation_w * (kernel_w - 1) + 1)) / stride_w +
-        1;
-    const int a = output_h * output_w * kernel_h * kernel_w * input.c;
-    Mat input_col(a, input.data_type);
-
-    VLOG(5) << "im2col";
-    im2col(input, kernel_h, kernel_w, pad_h, pad_w, stride_h, stride_w,
-           dilation_h, dilation_w, input_col);
-    VLOG(5) << "im2col end";
-    // PNT(input_col);
-    const int M = output_channels;
-    const int N = output_h * output_w;
+        fconv_output_size(w, kernel_w, pad_w, stride_w, dilation_w);
+    const fconv_detail::OutputRows out(output, output_h, output_w,
+                                       output_channels);
+    const int N = n * output_h * output_w;
+    if (kernel_h == 1 && kernel_w == 1 && pad_h == 0 && pad_w == 0) {
+        qgemm_packed(output_channels, N, c, packed_weight, dequant,
+                     [&](const int p) {
+                         const int row = p / output_w;
+                         return input + row / output_h * image_size +
+                                row % output_h * stride_h * hstep +
+                                (p % output_w) * stride_w * c;
+                     },
+                     out, epilogue);
+        return;
+    }
+    const fconv_detail::Int8WindowPacker packer{
+        {input, h, w, c, hstep, image_size, kernel_h, kernel_w, pad_h, pad_w,
+         stride_h, stride_w, dilation_h, dilation_w, output_h, output_w,
+         nullptr, nullptr}};
+    qgemm_packed_gather(output_channels, N, kernel_h * kernel_w * c,
+                        packed_weight, dequant, packer, out, epilogue);
+}
+
+/**
+ * Pack the weight and run fconv_packed, the layer packs the weight only once
+ * instead
+ */
+inline void fconv(const Mat &input, const Mat &weight, const float *bias,
+                  const int kernel_h, const int kernel_w, const int pad_h,
+                  const int pad_w, const int stride_h, const int stride_w,
+                  const int dilation_h, const int dilation_w,
+                  const int output_channels, Mat &output) {
     const int K = kernel_h * kernel_w * input.c;
-    Map<Matrix<float, Dynamic, Dynamic, RowMajor>> weight_eg(
-        static_cast<float *>(weight.data), M, K);
-    Map<VectorXf> bias_eg(static_cast<float *>(bias.data), M);
-    Map<Matrix<float, Dynamic, Dynamic, RowMajor>> input_notrans_eg(
-        static_cast<float *>(input_col.data), N, K);
-    Map<Matrix<float, Dynamic, Dynamic, ColMajor>> output_eg(
-        static_cast<float *>(output.data), M, N);
-    output_eg.noalias() = weight_eg * input_notrans_eg.transpose();
-    output_eg.colwise() += bias_eg;
+    std::vector<float> packed_weight(fgemm_packed_size(output_channels, K));
+    ncnn::observe_scratch(packed_weight.size() * sizeof(float),
+                          "packed_weight");
+    fgemm_pack_weight(output_channels, K, static_cast<float *>(weight.data),
+                      K, packed_weight.data());
+    FgemmEpilogue epilogue;
+    epilogue.bias = bias;
+    fconv_packed(input, packed_weight.data(), kernel_h, kernel_w, pad_h, pad_w,
+                 stride_h, stride_w, dilation_h, dilation_w, output_channels,
+                 epilogue, output);
+}
+
+inline void fconv(const Mat &input, const Mat &weight, const int kernel_h,
+                  const int kernel_w, const int pad_h, const int pad_w,
+                  const int stride_h, const int stride_w, const int dilation_h,
+                  const int dilation_w, const int output_channels,
+                  Mat &output) {
+    fconv(input, weight, nullptr, kernel_h, kernel_w, pad_h, pad_w, stride_h,
+          stride_w, dilation_h, dilation_w, output_channels, output);
+}
+
+inline void fconv(const Mat &input, const Mat &weight, const Mat &bias,
+                  const int kernel_h, const int kernel_w, const int pad_h,
+                  const int pad_w, const int stride_h, const int stride_w,
+                  const int dilation_h, const int dilation_w,
+                  const int output_channels, Mat &output) {
+    fconv(input, weight, static_cast<const float *>(bias.data), kernel_h,
+          kernel_w, pad_h, pad_w, stride_h, stride_w, dilation_h, dilation_w,
+          output_channels, output);
 }
 }  // namespace bnn
 
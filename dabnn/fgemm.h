@@ -0,0 +1,232 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#ifndef BNN_FGEMM_H
+#define BNN_FGEMM_H
+
+#if __ARM_NEON
+#include <arm_neon.h>
+#endif  // __ARM_NEON
+#include <algorithm>
+
+#include <common/helper.h>
+#include <dabnn/cpu_info.h>
+
+namespace bnn {
+
+// A micro tile is kFgemmNR pixels * kFgemmMR output channels, the
+// accumulators take 16 of the 32 neon registers of aarch64 and 8 of the 16
+// of armv7
+constexpr int kFgemmMR = 8;
+#ifdef __aarch64__
+constexpr int kFgemmNR = 8;
+#else
+constexpr int kFgemmNR = 4;
+#endif  // __aarch64__
+// The capacity (in depth) of the packed pixel panel on the stack
+constexpr int kFgemmMaxKC = 512;
+
+/**
+ * Applied to every output value on its last store, in this order:
+ * v += bias[m], v = v * scale[m] + shift[m], v = max(v, 0). The pointers
+ * can be nullptr.
+ */
+struct FgemmEpilogue {
+    const float *bias = nullptr;
+    const float *scale = nullptr;
+    const float *shift = nullptr;
+    bool relu = false;
+};
+
+/**
+ * The number of floats fgemm_pack_weight writes
+ */
+inline size_t fgemm_packed_size(const int m, const int k) {
+    return static_cast<size_t>((m + kFgemmMR - 1) / kFgemmMR) * kFgemmMR * k;
+}
+
+/**
+ * Pack the row-major m*k weight into panels of kFgemmMR rows. Each panel is
+ * k*kFgemmMR so that the micro kernel reads it sequentially, the rows beyond
+ * m are zero.
+ */
+inline void fgemm_pack_weight(const int m, const int k, const float *w,
+                              const int ldw, float *packed) {
+    for (int m0 = 0; m0 < m; m0 += kFgemmMR) {
+        FORZ(j, k) {
+            FORZ(r, kFgemmMR) {
+                *packed++ = m0 + r < m ? w[(m0 + r) * ldw + j] : 0.f;
+            }
+        }
+    }
+}
+
+/**
+ * A kc*kFgemmMR panel of the weight and a kc*kFgemmNR panel of the pixels are
+ * expected to stay in L1
+ */
+inline int fgemm_kc(const CacheInfo &cache) {
+    const int kc = static_cast<int>(cache.l1d / 2 /
+                                    ((kFgemmMR + kFgemmNR) * sizeof(float))) /
+                   8 * 8;
+    return std::max(8, kc < kFgemmMaxKC ? kc : kFgemmMaxKC);
+}
+
+namespace fgemm_detail {
+
+/**
+ * Pack the [k0, k0 + kc) slice of nr pixels into kc*kFgemmNR, row(p) returns
+ * the k floats of pixel p. The missing pixels are zero.
+ */
+template <typename RowFn>
+inline void pack_pixels(const int kc, const int nr, RowFn &&row, const int p0,
+                        const int k0, float *packed) {
+    FORZ(i, kFgemmNR) {
+        if (i < nr) {
+            const float *src = row(p0 + i) + k0;
+            FORZ(j, kc) { packed[j * kFgemmNR + i] = src[j]; }
+        } else {
+            FORZ(j, kc) { packed[j * kFgemmNR + i] = 0.f; }
+        }
+    }
+}
+
+/**
+ * acc[i * kFgemmMR + r] = sum_j b[j][i] * a[j][r]
+ */
+inline void micro_kernel(const int kc, const float *a, const float *b,
+                         float *acc) {
+#if __ARM_NEON
+    float32x4_t c[kFgemmNR][2];
+    FORZ(i, kFgemmNR) {
+        c[i][0] = vdupq_n_f32(0.f);
+        c[i][1] = vdupq_n_f32(0.f);
+    }
+    FORZ(j, kc) {
+        const float32x4_t a0 = vld1q_f32(a);
+        const float32x4_t a1 = vld1q_f32(a + 4);
+        for (int i = 0; i < kFgemmNR; i += 4) {
+            const float32x4_t _b = vld1q_f32(b + i);
+            const float32x2_t b01 = vget_low_f32(_b);
+            const float32x2_t b23 = vget_high_f32(_b);
+            c[i][0] = vmlaq_lane_f32(c[i][0], a0, b01, 0);
+            c[i][1] = vmlaq_lane_f32(c[i][1], a1, b01, 0);
+            c[i + 1][0] = vmlaq_lane_f32(c[i + 1][0], a0, b01, 1);
+            c[i + 1][1] = vmlaq_lane_f32(c[i + 1][1], a1, b01, 1);
+            c[i + 2][0] = vmlaq_lane_f32(c[i + 2][0], a0, b23, 0);
+            c[i + 2][1] = vmlaq_lane_f32(c[i + 2][1], a1, b23, 0);
+            c[i + 3][0] = vmlaq_lane_f32(c[i + 3][0], a0, b23, 1);
+            c[i + 3][1] = vmlaq_lane_f32(c[i + 3][1], a1, b23, 1);
+        }
+        a += kFgemmMR;
+        b += kFgemmNR;
+    }
+    FORZ(i, kFgemmNR) {
+        vst1q_f32(acc + i * kFgemmMR, c[i][0]);
+        vst1q_f32(acc + i * kFgemmMR + 4, c[i][1]);
+    }
+#else
+    float c[kFgemmNR][kFgemmMR] = {};
+    FORZ(j, kc) {
+        FORZ(i, kFgemmNR) {
+            FORZ(r, kFgemmMR) { c[i][r] += b[i] * a[r]; }
+        }
+        a += kFgemmMR;
+        b += kFgemmNR;
+    }
+    FORZ(i, kFgemmNR) {
+        FORZ(r, kFgemmMR) { acc[i * kFgemmMR + r] = c[i][r]; }
+    }
+#endif  // __ARM_NEON
+}
+
+/**
+ * Store the valid nr*mr part of a tile, adding the partial sums of the
+ * previous depth blocks when accumulate is set
+ */
+template <typename OutFn>
+inline void store_tile(const float *acc, const int nr, const int mr,
+                       const bool accumulate, const bool last, const int p0,
+                       const int m0, const FgemmEpilogue &epilogue,
+                       OutFn &&out) {
+    FORZ(i, nr) {
+        float *dst = out(p0 + i) + m0;
+        const float *src = acc + i * kFgemmMR;
+        FORZ(r, mr) {
+            float v = src[r];
+            if (accumulate) {
+                v += dst[r];
+            }
+            if (last) {
+                if (epilogue.bias != nullptr) {
+                    v += epilogue.bias[m0 + r];
+                }
+                if (epilogue.scale != nullptr) {
+                    v = v * epilogue.scale[m0 + r] + epilogue.shift[m0 + r];
+                }
+                if (epilogue.relu) {
+                    v = std::max(v, 0.f);
+                }
+            }
+            dst[r] = v;
+        }
+    }
+}
+
+}  // namespace fgemm_detail
+
+/**
+ * out(p)[i] = epilogue(sum_j x(p)[j] * w[i][j]), p in [0, n), i in [0, m)
+ *
+ * packed_a is the weight packed by fgemm_pack_weight. pack(p0, nr, k0, kc,
+ * packed) writes the [k0, k0 + kc) slice of the nr pixels from p0 as
+ * kc*kFgemmNR floats (zero for the pixels beyond nr), so the pixels can be
+ * gathered from anywhere (e.g. an image with padding) without im2col. out(p)
+ * returns the m output floats of pixel p.
+ */
+template <typename PackFn, typename OutFn>
+inline void fgemm_packed_gather(const int m, const int n, const int k,
+                                const float *packed_a, PackFn &&pack,
+                                OutFn &&out, const FgemmEpilogue &epilogue) {
+    BNN_ASSERT(m > 0 && k > 0, m, k);
+    const int kc = fgemm_kc(cache_info());
+    alignas(16) float packed_b[kFgemmMaxKC * kFgemmNR];
+    alignas(16) float acc[kFgemmNR * kFgemmMR];
+    for (int k0 = 0; k0 < k; k0 += kc) {
+        const int kb = k - k0 < kc ? k - k0 : kc;
+        const bool first = k0 == 0;
+        const bool last = k0 + kb == k;
+        for (int p0 = 0; p0 < n; p0 += kFgemmNR) {
+            const int nr = n - p0 < kFgemmNR ? n - p0 : kFgemmNR;
+            // The pixels are packed once and shared by all output channels
+            pack(p0, nr, k0, kb, packed_b);
+            for (int m0 = 0; m0 < m; m0 += kFgemmMR) {
+                const int mr = m - m0 < kFgemmMR ? m - m0 : kFgemmMR;
+                const float *a = packed_a + m0 * k + k0 * kFgemmMR;
+                fgemm_detail::micro_kernel(kb, a, packed_b, acc);
+                fgemm_detail::store_tile(acc, nr, mr, !first, last, p0, m0,
+                                         epilogue, out);
+            }
+        }
+    }
+}
+
+/**
+ * fgemm_packed_gather on pixels stored as rows, row(p) returns the k input
+ * floats of pixel p
+ */
+template <typename RowFn, typename OutFn>
+inline void fgemm_packed(const int m, const int n, const int k,
+                         const float *packed_a, RowFn &&row, OutFn &&out,
+                         const FgemmEpilogue &epilogue) {
+    fgemm_packed_gather(
+        m, n, k, packed_a,
+        [&](const int p0, const int nr, const int k0, const int kc,
+            float *packed) {
+            fgemm_detail::pack_pixels(kc, nr, row, p0, k0, packed);
+        },
+        out, epilogue);
+}
+
+}  // namespace bnn
+
+#endif /* BNN_FGEMM_H */
@@ -0,0 +1,143 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#ifndef BNN_FP16_H
+#define BNN_FP16_H
+
+#if __ARM_NEON
+#include <arm_neon.h>
+#endif  // __ARM_NEON
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif  // __F16C__
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <common/helper.h>
+
+namespace bnn {
+
+/**
+ * IEEE 754 half precision, only used to store activations. The arithmetic is
+ * always done in fp32.
+ */
+using half_t = uint16_t;
+
+/**
+ * Round to the nearest even, the values beyond the range of fp16 become inf
+ */
+inline half_t float_to_half(const float f) {
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    const uint32_t sign = (x >> 16) & 0x8000;
+    uint32_t abs = x & 0x7fffffff;
+    if (abs >= 0x7f800000) {
+        // inf or nan
+        return sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0);
+    }
+    if (abs >= 0x477ff000) {
+        // 65520 and larger are rounded to inf
+        return sign | 0x7c00;
+    }
+    if (abs < 0x38800000) {
+        // A subnormal half, adding 0.5 lets the fpu round the mantissa to the
+        // ulp of fp16 subnormals (2^-24)
+        float v;
+        memcpy(&v, &abs, sizeof(v));
+        v += 0.5f;
+        uint32_t r;
+        memcpy(&r, &v, sizeof(r));
+        return sign | (r - 0x3f000000);
+    }
+    const uint32_t odd = (abs >> 13) & 1;
+    // Rebias the exponent from 127 to 15 and round the dropped 13 bits
+    abs += 0xc8000fff + odd;
+    return sign | (abs >> 13);
+}
+
+inline float half_to_float(const half_t h) {
+    const uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+    const uint32_t exp = (h >> 10) & 0x1f;
+    const uint32_t mant = h & 0x3ff;
+    uint32_t x;
+    if (exp == 0) {
+        // zero or subnormal, mant * 2^-24
+        float v = static_cast<float>(mant) * (1.f / 16777216.f);
+        memcpy(&x, &v, sizeof(x));
+        x |= sign;
+    } else if (exp == 0x1f) {
+        x = sign | 0x7f800000 | (mant << 13);
+    } else {
+        x = sign | ((exp + 112) << 23) | (mant << 13);
+    }
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+inline void float_to_half(const float *src, half_t *dst, const size_t n) {
+    size_t i = 0;
+#if defined(__F16C__)
+    for (; i + 8 <= n; i += 8) {
+        const __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i),
+                                          _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), h);
+    }
+#elif defined(__aarch64__)
+    for (; i + 4 <= n; i += 4) {
+        const float16x4_t h = vcvt_f16_f32(vld1q_f32(src + i));
+        vst1_u16(dst + i, vreinterpret_u16_f16(h));
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = float_to_half(src[i]);
+    }
+}
+
+inline void half_to_float(const half_t *src, float *dst, const size_t n) {
+    size_t i = 0;
+#if defined(__F16C__)
+    for (; i + 8 <= n; i += 8) {
+        const __m128i h =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+    }
+#elif defined(__aarch64__)
+    for (; i + 4 <= n; i += 4) {
+        const float16x4_t h = vreinterpret_f16_u16(vld1_u16(src + i));
+        vst1q_f32(dst + i, vcvt_f32_f16(h));
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = half_to_float(src[i]);
+    }
+}
+
+// The layers on fp16 activations convert them in blocks of this many values
+// on the stack
+constexpr int kHalfBlock = 256;
+
+/**
+ * x = f(x, channel) for the n fp16 values of a row whose pixels have c
+ * channels, the values are converted to fp32 and back block by block
+ */
+template <typename F>
+inline void half_row_inplace(half_t *row, const int n, const int c, F &&f) {
+    float buf[kHalfBlock];
+    int ch = 0;
+    for (int i = 0; i < n; i += kHalfBlock) {
+        const int len = n - i < kHalfBlock ? n - i : kHalfBlock;
+        half_to_float(row + i, buf, len);
+        FORZ(j, len) {
+            buf[j] = f(buf[j], ch);
+            if (++ch == c) {
+                ch = 0;
+            }
+        }
+        float_to_half(buf, row + i, len);
+    }
+}
+
+}  // namespace bnn
+
+#endif /* BNN_FP16_H */
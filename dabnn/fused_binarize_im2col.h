@@ -1,15 +1,61 @@
+#include <algorithm>
+
 #include <dabnn/bitpack.h>
 #include <dabnn/im2col.h>
 #include <dabnn/mat.h>
 
 namespace bnn {
+/**
+ * The im2col of a bit im, the padded taps and the alignment to 128 bits are
+ * zero words as fused_binarize_im2col binarizes zeros
+ */
+inline void bit_im2col(const Mat &im, const int kernel_h, const int kernel_w,
+                       const int pad_h, const int pad_w, const int stride_h,
+                       const int stride_w, const int dilation_h,
+                       const int dilation_w, Mat &col) {
+    const int output_h =
+        (im.h + 2 * pad_h - (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
+    const int output_w =
+        (im.w + 2 * pad_w - (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
+    const int words = (kernel_h * kernel_w * im.c + 1) / 2 * 2;
+
+    const auto *data_im = static_cast<const uint64_t *>(im.data);
+    auto *data_col = static_cast<uint64_t *>(col.data);
+    FORZ(output_y, output_h) {
+        FORZ(output_x, output_w) {
+            std::fill(data_col, data_col + words, 0);
+            auto *col_ptr = data_col;
+            FORZ(kh, kernel_h) {
+                const int y = output_y * stride_h - pad_h + kh * dilation_h;
+                FORZ(kw, kernel_w) {
+                    const int x =
+                        output_x * stride_w - pad_w + kw * dilation_w;
+                    if (y >= 0 && y < im.h && x >= 0 && x < im.w) {
+                        memcpy(col_ptr, data_im + y * im.hstep + x * im.c,
+                               im.c * sizeof(uint64_t));
+                    }
+                    col_ptr += im.c;
+                }
+            }
+            data_col += words;
+        }
+    }
+}
+
 inline void fused_binarize_im2col(const Mat &im, const int kernel_h,
                                   const int kernel_w, const int pad_h,
                                   const int pad_w, const int stride_h,
                                   const int stride_w, const int dilation_h,
                                   const int dilation_w, Mat &col) {
-    BNN_ASSERT(im.data_type == DataType::Float, "Input of fused_binarize_im2col should be float");
     BNN_ASSERT(col.data_type == DataType::Bit, "Output of fused_binarize_im2col should be bit");
+    if (im.data_type == DataType::Bit) {
+        bit_im2col(im, kernel_h, kernel_w, pad_h, pad_w, stride_h, stride_w,
+                   dilation_h, dilation_w, col);
+        return;
+    }
+    BNN_ASSERT(im.data_type == DataType::Float ||
+                   im.data_type == DataType::Half,
+               "Input of fused_binarize_im2col should be float, fp16 or bit");
 
     BNN_ASSERT(kernel_h * kernel_w * im.c < 60000,
                "kernel_h * kernel_w * im.c must be smaller than 60000");
@@ -45,15 +91,19 @@ inline void fused_binarize_im2col(const Mat &im, const int kernel_h,
                 }
             }
 
-            BNN_ASSERT(im.elemsize == 4, "");
             // len: the number of elements in one column
             const size_t len = (buf_ptr - buf) / im.elemsize;
             const size_t len_aligned_128 = (len + 127) / 128 * 128;
             // pad the buffer so that its length aligns to 128
             memset(buf_ptr, 0, (len_aligned_128 - len) * im.elemsize);
 
-            auto *fbuf = reinterpret_cast<float *>(buf);
-            pack_64(fbuf, data_col, len_aligned_128);
+            if (im.data_type == DataType::Half) {
+                pack_64_half(reinterpret_cast<half_t *>(buf), data_col,
+                             len_aligned_128);
+            } else {
+                auto *fbuf = reinterpret_cast<float *>(buf);
+                pack_64(fbuf, data_col, len_aligned_128);
+            }
 
             // `len_aligned_128` is the number of appended __bits__ in
             // mat `col`, so divide here
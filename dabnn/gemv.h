@@ -0,0 +1,133 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#ifndef BNN_GEMV_H
+#define BNN_GEMV_H
+
+#if __ARM_NEON
+#include <arm_neon.h>
+#endif  // __ARM_NEON
+#include <algorithm>
+
+#include <common/baseline.h>
+#include <common/helper.h>
+
+namespace bnn {
+
+/**
+ * y[i] = dot(a + i * lda, x) + bias[i], i in [0, m), a is row-major and bias
+ * can be nullptr. The rows are computed four at a time so that every load of
+ * x is shared by four rows.
+ */
+inline void fgemv(const int m, const int k, const float *a, const int lda,
+                  const float *x, const float *bias, float *y);
+
+/**
+ * y[i] = popcount(a_i ^ x), i in [0, m), where a_i = a + i * lda and both a_i
+ * and x are k uint64_t. It is the counterpart of bgemm for a single column.
+ */
+inline void bgemv(const int m, const int k, const uint64_t *a, const int lda,
+                  const uint64_t *x, float *y);
+
+namespace gemv_detail {
+
+template <int ROWS>
+inline void fgemv_rows(const int k, const float *a, const int lda,
+                       const float *x, float *sum) {
+    int j = 0;
+#if __ARM_NEON
+    float32x4_t acc[ROWS];
+    FORZ(r, ROWS) { acc[r] = vdupq_n_f32(0.f); }
+    for (; j + 4 <= k; j += 4) {
+        const float32x4_t _x = vld1q_f32(x + j);
+        FORZ(r, ROWS) {
+            acc[r] = vmlaq_f32(acc[r], vld1q_f32(a + r * lda + j), _x);
+        }
+    }
+    FORZ(r, ROWS) {
+        const float32x2_t s =
+            vadd_f32(vget_low_f32(acc[r]), vget_high_f32(acc[r]));
+        sum[r] = vget_lane_f32(vpadd_f32(s, s), 0);
+    }
+#else
+    // Independent partial sums let the compiler vectorize without reordering
+    // a single floating point reduction
+    float acc[ROWS][4] = {};
+    for (; j + 4 <= k; j += 4) {
+        FORZ(r, ROWS) {
+            FORZ(l, 4) { acc[r][l] += a[r * lda + j + l] * x[j + l]; }
+        }
+    }
+    FORZ(r, ROWS) {
+        sum[r] = (acc[r][0] + acc[r][1]) + (acc[r][2] + acc[r][3]);
+    }
+#endif  // __ARM_NEON
+    for (; j < k; j++) {
+        FORZ(r, ROWS) { sum[r] += a[r * lda + j] * x[j]; }
+    }
+}
+
+template <int ROWS>
+inline void bgemv_rows(const int k, const uint64_t *a, const int lda,
+                       const uint64_t *x, float *y) {
+    uint32_t acc[ROWS] = {};
+    int j = 0;
+#if __ARM_NEON
+    // Each uint16 lane gains at most 16 in an iteration
+    while (j + 2 <= k) {
+        const int end = std::min(k, j + 2 * 4096) & ~1;
+        uint16x8_t sum[ROWS];
+        FORZ(r, ROWS) { sum[r] = vdupq_n_u16(0); }
+        for (; j < end; j += 2) {
+            const uint64x2_t _x = vld1q_u64(x + j);
+            FORZ(r, ROWS) {
+                const uint64x2_t _a = vld1q_u64(a + r * lda + j);
+                sum[r] = vpadalq_u8(
+                    sum[r], vcntq_u8(vreinterpretq_u8_u64(veorq_u64(_a, _x))));
+            }
+        }
+        FORZ(r, ROWS) {
+            const uint64x2_t s = vpaddlq_u32(vpaddlq_u16(sum[r]));
+            acc[r] += vgetq_lane_u64(s, 0) + vgetq_lane_u64(s, 1);
+        }
+    }
+#endif  // __ARM_NEON
+    for (; j < k; j++) {
+        FORZ(r, ROWS) { acc[r] += bitcount(a[r * lda + j] ^ x[j]); }
+    }
+    FORZ(r, ROWS) { y[r] = static_cast<float>(acc[r]); }
+}
+
+}  // namespace gemv_detail
+
+inline void fgemv(const int m, const int k, const float *a, const int lda,
+                  const float *x, const float *bias, float *y) {
+    int i = 0;
+    for (; i + 4 <= m; i += 4) {
+        gemv_detail::fgemv_rows<4>(k, a + static_cast<size_t>(i) * lda, lda,
+                                   x, y + i);
+    }
+    for (; i < m; i++) {
+        gemv_detail::fgemv_rows<1>(k, a + static_cast<size_t>(i) * lda, lda,
+                                   x, y + i);
+    }
+    if (bias != nullptr) {
+        FORZ(j, m) { y[j] += bias[j]; }
+    }
+}
+
+inline void bgemv(const int m, const int k, const uint64_t *a, const int lda,
+                  const uint64_t *x, float *y) {
+    int i = 0;
+    for (; i + 4 <= m; i += 4) {
+        gemv_detail::bgemv_rows<4>(k, a + static_cast<size_t>(i) * lda, lda,
+                                   x, y + i);
+    }
+    for (; i < m; i++) {
+        gemv_detail::bgemv_rows<1>(k, a + static_cast<size_t>(i) * lda, lda,
+                                   x, y + i);
+    }
+}
+
+}  // namespace bnn
+
+#endif /* BNN_GEMV_H */
@@ -3,6 +3,7 @@
 #ifndef BNN_LAYER_H
 #define BNN_LAYER_H
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
@@ -19,8 +20,30 @@ class Layer {
     using MatCP = const std::shared_ptr<Mat>;
     using MatP = std::shared_ptr<Mat>;
     MatCP mat(const std::string &name) const;
+    // The values of all images of a blob, 64 per uint64_t of a bit blob
+    static size_t elems(const Mat &mat) {
+        return static_cast<size_t>(mat.n) * mat.h * mat.w *
+               (mat.data_type == DataType::Bit ? mat.c * 64 : mat.c);
+    }
+    // The bytes of the values of a blob or a weight, without the padding of
+    // the rows
+    static int64_t bytes(const Mat &mat) {
+        return static_cast<int64_t>(mat.total() * mat.elemsize);
+    }
 
    public:
+    /**
+     * The theoretical work of a forward of all images, from the shapes of
+     * the blobs of the plan. A multiply-add is two flops, and the xnor and
+     * the popcount of a pair of bits are two bit ops.
+     */
+    struct Work {
+        int64_t flops = 0;
+        int64_t bit_ops = 0;
+        int64_t bytes_read = 0;
+        int64_t bytes_written = 0;
+    };
+
     Layer(NetCP net, const std::string &name, const std::string &type)
         : net_(net), name_(name), type_(type) {}
     // virtual destructor
@@ -31,6 +54,17 @@ class Layer {
     void forward();
     virtual void forward_impl() const = 0;
     virtual std::string to_str() const;
+    /**
+     * Whether forward_impl handles all the n images of its blobs, otherwise
+     * Net runs the layer once per image of the batch
+     */
+    virtual bool batch_aware() const { return false; }
+    /**
+     * The number of the values the layer writes, which the profiler divides
+     * the counters by
+     */
+    virtual size_t output_elems() const { return 0; }
+    virtual Work work() const { return Work(); }
 
     // layer name
     std::string name_;
@@ -2,9 +2,46 @@
 
 #include "Add.h"
 
+#include <algorithm>
+
 namespace bnn {
 
+/**
+ * a += b where either of them can be fp16, e.g. the residual stream
+ */
+inline void add_inplace_half(bnn::Mat &a, const bnn::Mat &b) {
+    const int len = a.w * a.c;
+    float a_buf[kHalfBlock], b_buf[kHalfBlock];
+    FORZ(n, a.n) {
+        FORZ(h, a.h) {
+            for (int i = 0; i < len; i += kHalfBlock) {
+                const int block = std::min<int>(len - i, kHalfBlock);
+                float *a_ptr = a_buf;
+                const float *b_ptr = b_buf;
+                if (a.data_type == DataType::Half) {
+                    half_to_float(a.point<half_t>(n, h, 0) + i, a_buf, block);
+                } else {
+                    a_ptr = a.point<float>(n, h, 0) + i;
+                }
+                if (b.data_type == DataType::Half) {
+                    half_to_float(b.point<half_t>(n, h, 0) + i, b_buf, block);
+                } else {
+                    b_ptr = b.point<float>(n, h, 0) + i;
+                }
+                FORZ(j, block) { a_ptr[j] += b_ptr[j]; }
+                if (a.data_type == DataType::Half) {
+                    float_to_half(a_buf, a.point<half_t>(n, h, 0) + i, block);
+                }
+            }
+        }
+    }
+}
+
 inline void add_inplace(bnn::Mat &a, const bnn::Mat &b) {
+    if (a.data_type == DataType::Half || b.data_type == DataType::Half) {
+        add_inplace_half(a, b);
+        return;
+    }
     FORZ(n, a.n) {
         FORZ(h, a.h) {
             auto *a_ptr = a.point<float>(n, h, 0);
@@ -37,4 +74,12 @@ void Add::forward_impl() const {
 #endif
 }
 
+Layer::Work Add::work() const {
+    Work work;
+    work.flops = static_cast<int64_t>(elems(*input1_mat));
+    work.bytes_read = bytes(*input1_mat) + bytes(*input2_mat);
+    work.bytes_written = bytes(*input1_mat);
+    return work;
+}
+
 }  // namespace bnn
@@ -26,6 +26,8 @@ class Add : public Layer {
           input2_mat(mat(input2)) {}
 #endif
     virtual void forward_impl() const;
+    virtual size_t output_elems() const { return elems(*input1_mat); }
+    virtual Work work() const;
     ~Add() {}
 };
 }  // namespace bnn
@@ -9,6 +9,17 @@ namespace bnn {
  */
 inline void affine_inplace(bnn::Mat &data, const bnn::Mat &a,
                            const bnn::Mat &b) {
+    if (data.data_type == DataType::Half) {
+        FORZ(n, data.n) {
+            FORZ(h, data.h) {
+                half_row_inplace(data.point<half_t>(n, h, 0), data.w * data.c,
+                                 data.c, [&](const float v, const int c) {
+                                     return a[c] * v + b[c];
+                                 });
+            }
+        }
+        return;
+    }
     FORZ(n, data.n) {
         FORZ(h, data.h) {
             auto ptr = data.point<float>(n, h, 0);
@@ -47,4 +58,12 @@ void Affine::forward_impl() const {
 #endif
 }
 
+Layer::Work Affine::work() const {
+    Work work;
+    work.flops = 2 * static_cast<int64_t>(elems(*data_mat));
+    work.bytes_read = bytes(*data_mat) + bytes(*a_mat) + bytes(*b_mat);
+    work.bytes_written = bytes(*data_mat);
+    return work;
+}
+
 }  // namespace bnn
@@ -30,6 +30,9 @@ class Affine : public Layer {
           b_mat(mat(b)) {}
 #endif
     virtual void forward_impl() const;
+    virtual size_t output_elems() const { return elems(*data_mat); }
+    virtual Work work() const;
+    virtual bool batch_aware() const { return true; }
 };
 }  // namespace bnn
 
@@ -139,7 +139,7 @@ AvePool::AvePool(NetCP net, const std::string &name, css input, css output,
     if (mat_map.find(pad_name) == mat_map.end()) {
         auto &input_mat = *mat_map[input];
         mat_map[pad_name] = std::make_shared<Mat>(
-            input_mat.h + pad_h * 2, input_mat.w + pad_w * 2, input_mat.c,
+            input_mat.w + pad_w * 2, input_mat.h + pad_h * 2, input_mat.c,
             input_mat.data_type, pad_name);
     }
     padded_mat = mat_map[pad_name];
@@ -161,4 +161,14 @@ void AvePool::forward_impl() const {
 #endif  // __ARM_NEON
 }
 
+Layer::Work AvePool::work() const {
+    Work work;
+    // The sum of the window and the division
+    work.flops = static_cast<int64_t>(elems(*output_mat)) *
+                 (kernel_h * kernel_w + 1);
+    work.bytes_read = bytes(*input_mat);
+    work.bytes_written = bytes(*output_mat);
+    return work;
+}
+
 }  // namespace bnn
@@ -22,6 +22,8 @@ class AvePool : public Layer {
             int kernel_h, int kernel_w, int pad_h, int pad_w, int stride_h,
             int stride_w);
     virtual void forward_impl() const;
+    virtual size_t output_elems() const { return elems(*output_mat); }
+    virtual Work work() const;
 };
 }  // namespace bnn
 
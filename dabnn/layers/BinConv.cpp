@@ -4,6 +4,7 @@
 
 #include <common/baseline.h>
 #include <dabnn/bconv.h>
+#include <dabnn/bconv_direct.h>
 #include <dabnn/bgemm.h>
 #include <dabnn/bitpack.h>
 #include <dabnn/fused_binarize_im2col.h>
@@ -15,7 +16,8 @@ namespace bnn {
 int align_to(int a, int b) { return ((a + (b - 1)) / b) * b; }
 
 BinConv::BinConv(NetCP net, const std::string &name, css input, css weight,
-                 css output, int pad_h, int pad_w, int stride_h, int stride_w)
+                 css output, int pad_h, int pad_w, int stride_h, int stride_w,
+                 int dilation_h, int dilation_w, int group)
     : Layer(net, name, "Bin Conv"),
       input_mat(mat(input)),
       weight_mat(mat(weight)),
@@ -23,14 +25,21 @@ BinConv::BinConv(NetCP net, const std::string &name, css input, css weight,
       pad_h(pad_h),
       pad_w(pad_w),
       stride_h(stride_h),
-      stride_w(stride_w) {
+      stride_w(stride_w),
+      dilation_h(dilation_h),
+      dilation_w(dilation_w),
+      group(group) {
     auto &mat_map = net.lock()->mat_map_;
-    if (method() == Method::DIRECT_CONV || method() == Method::BCONV_NAIVE) {
+    // A bit input (e.g., of a bit max pool) is used as it is
+    if (input_mat->data_type != DataType::Bit &&
+        (method() == Method::DIRECT_CONV || method() == Method::BCONV_NAIVE ||
+         method() == Method::GROUP_CONV ||
+         method() == Method::GROUP_CONV_NAIVE)) {
         const auto binaized_name = "binaized_for_" + output + "_cal";
         if (mat_map.find(binaized_name) == mat_map.end()) {
             auto &input_mat = *mat_map[input];
             mat_map[binaized_name] = std::make_shared<Mat>(
-                input_mat.h, input_mat.w, input_mat.elem_c, DataType::Bit,
+                input_mat.w, input_mat.h, input_mat.elem_c, DataType::Bit,
                 binaized_name);
         }
         binarized_mat = mat(binaized_name);
@@ -40,16 +49,32 @@ BinConv::BinConv(NetCP net, const std::string &name, css input, css weight,
     if (mat_map.find(pad_name) == mat_map.end()) {
         auto &input_mat = *mat_map[input];
         mat_map[pad_name] = std::make_shared<Mat>(
-            input_mat.h + pad_h * 2, input_mat.w + pad_w * 2, input_mat.elem_c,
+            input_mat.w + pad_w * 2, input_mat.h + pad_h * 2, input_mat.elem_c,
             DataType::Bit, pad_name);
     }
     padded_mat = mat(pad_name);
 
+    const auto window_len =
+        method() == Method::DIRECT_CONV || method() == Method::GROUP_CONV
+            ? bconv_window_len(*weight_mat, group, dilation_w)
+            : 0;
+    if (window_len > 0) {
+        const auto window_name = "window_for_" + output + "_cal";
+        if (mat_map.find(window_name) == mat_map.end()) {
+            mat_map[window_name] = std::make_shared<Mat>(
+                1, 1, static_cast<int>(window_len * 64), DataType::Bit,
+                window_name);
+        }
+        window_mat = mat(window_name);
+    }
+
     if (method() == Method::BGEMM || method() == Method::BGEMM_NAIVE) {
         const auto col_mat_name = "col_for_" + output + "_cal";
         if (mat_map.find(col_mat_name) == mat_map.end()) {
+            // One im2col per image of the batch, they are multiplied by a
+            // single bgemm
             const auto len =
-                output_mat->h * output_mat->w *
+                input_mat->n * output_mat->h * output_mat->w *
                 align_to(weight_mat->h * weight_mat->w * input_mat->elem_c,
                          128);
             mat_map[col_mat_name] =
@@ -57,6 +82,11 @@ BinConv::BinConv(NetCP net, const std::string &name, css input, css weight,
         }
         col_mat = mat(col_mat_name);
         const auto trans_weight_mat_name = "trans_" + weight;
+        if (mat_map.find(trans_weight_mat_name) != mat_map.end()) {
+            // Transposed by the plan of another resolution
+            transposed_weight_mat = mat(trans_weight_mat_name);
+            return;
+        }
         // transpose the weight for bgemm
         const int m = weight_mat->n;
         BNN_ASSERT(weight_mat->total() % m == 0, "");
@@ -73,11 +103,16 @@ BinConv::BinConv(NetCP net, const std::string &name, css input, css weight,
                 trans_data_ptr[i * m + j] = data_ptr[j * k + i];
             }
         }
-        net_.lock()->add_mat(trans_weight_mat_name, transposed_weight_mat);
+        net_.lock()->add_weight(trans_weight_mat_name, transposed_weight_mat);
     }
 }
 
 BinConv::Method BinConv::method() const {
+    if (group != 1) {
+        // The groups are batched in one kernel instead of a bgemm per group
+        return net_.lock()->optimize ? Method::GROUP_CONV
+                                     : Method::GROUP_CONV_NAIVE;
+    }
     if (net_.lock()->optimize) {
         if (direct_conv_compatible()) {
             return Method::DIRECT_CONV;
@@ -99,6 +134,12 @@ BinConv::Method BinConv::method() const {
 
 bool BinConv::direct_conv_compatible() const {
 #ifdef __aarch64__
+    if (dilation_h != 1 || dilation_w != 1) {
+        // Only bconv_direct handles dilation
+        return weight_mat->h != 1 &&
+               bconv_direct_compatible(weight_mat->h, weight_mat->w, stride_h,
+                                       stride_w);
+    }
     if (weight_mat->h == 3 && weight_mat->w == 3 && input_mat->elem_c == 64 &&
         stride_h == stride_w) {
         return true;
@@ -119,7 +160,22 @@ bool BinConv::direct_conv_compatible() const {
         stride_h == stride_w) {
         return true;
     }
+    // Other multiples of 64 (e.g. 192, 384 and 768) go to bconv_3x3_direct
+    if (weight_mat->h == 3 && weight_mat->w == 3 &&
+        input_mat->elem_c % 64 == 0 && stride_h == stride_w) {
+        return true;
+    }
+    // 5x5 and 7x7 go to bconv_direct instead of the 25x/49x im2col
+    if ((weight_mat->h == 5 || weight_mat->h == 7) &&
+        bconv_direct_compatible(weight_mat->h, weight_mat->w, stride_h,
+                                stride_w)) {
+        return true;
+    }
     return false;
+#elif !defined(__ARM_NEON)
+    // bconv_direct is much faster than the naive bgemm
+    return bconv_direct_compatible(weight_mat->h, weight_mat->w, stride_h,
+                                   stride_w);
 #else
     return false;
 #endif
@@ -141,50 +197,178 @@ bool BinConv::gemm_compatible() const {
 #endif
 }
 
+bool BinConv::batch_aware() const {
+    // The images are folded into the n of bgemm, whose output is contiguous
+    return (method() == Method::BGEMM || method() == Method::BGEMM_NAIVE) &&
+           output_mat->hstep ==
+               static_cast<size_t>(output_mat->w) * output_mat->c;
+}
+
+void BinConv::binarize_im2col_batch() const {
+    // bgemm reads k uint64_t per pixel
+    const int image_len = output_mat->h * output_mat->w *
+                          (weight_mat->total() / weight_mat->n);
+    FORZ(i, input_mat->n) {
+        const auto input = input_mat->image(i);
+        Mat col(image_len,
+                static_cast<uint64_t *>(col_mat->data) + i * image_len,
+                DataType::Bit);
+        bnn::fused_binarize_im2col(input, weight_mat->h, weight_mat->w, pad_h,
+                                   pad_w, stride_h, stride_w, dilation_h,
+                                   dilation_w, col);
+    }
+}
+
+const Mat &BinConv::binarized_input() const {
+    if (input_mat->data_type == DataType::Bit) {
+        return *input_mat;
+    }
+    pack_mat(*input_mat, *binarized_mat);
+    return *binarized_mat;
+}
+
+uint64_t *BinConv::window() const {
+    return window_mat == nullptr ? nullptr
+                                 : static_cast<uint64_t *>(window_mat->data);
+}
+
+int BinConv::filter_bits() const {
+    if (group != 1 && weight_mat->n == 1) {
+        // The depthwise weight [1, kh, kw, c] has a filter per channel
+        return weight_mat->h * weight_mat->w;
+    }
+    return weight_mat->h * weight_mat->w * weight_mat->elem_c;
+}
+
+void BinConv::set_scale(MatCP scale, MatCP offset) {
+    const int m = output_mat->c;
+    BNN_ASSERT(scale->total() == static_cast<size_t>(m) &&
+                   (offset == nullptr ||
+                    offset->total() == static_cast<size_t>(m)),
+               "The scale and offset of ", name_,
+               " should have a value per output channel");
+    BNN_ASSERT(scale_mat == nullptr, "The scale of ", name_,
+               " must be set before fusing an affine");
+    // scale * (k - 2 * popcount) + offset
+    const float k = static_cast<float>(filter_bits());
+    scale_mat = std::make_shared<Mat>(m, DataType::Float);
+    shift_mat = std::make_shared<Mat>(m, DataType::Float);
+    FORZ(i, m) {
+        const float s = (*scale)[i];
+        (*scale_mat)[i] = -2 * s;
+        (*shift_mat)[i] = k * s + (offset == nullptr ? 0.f : (*offset)[i]);
+    }
+}
+
+void BinConv::fuse_affine(MatCP a, MatCP b) {
+    const int m = output_mat->c;
+    if (scale_mat == nullptr) {
+        scale_mat = std::make_shared<Mat>(m, DataType::Float);
+        shift_mat = std::make_shared<Mat>(m, DataType::Float);
+        FORZ(i, m) {
+            (*scale_mat)[i] = (*a)[i];
+            (*shift_mat)[i] = (*b)[i];
+        }
+        return;
+    }
+    FORZ(i, m) {
+        (*scale_mat)[i] *= (*a)[i];
+        (*shift_mat)[i] = (*a)[i] * (*shift_mat)[i] + (*b)[i];
+    }
+}
+
+void BinConv::apply_scale(Mat &output) const {
+    const auto *scale = static_cast<const float *>(scale_mat->data);
+    const auto *shift = static_cast<const float *>(shift_mat->data);
+    FORZ(n, output.n) {
+        FORZ(h, output.h) {
+            auto *ptr = output.point<float>(n, h, 0);
+            FORZ(w, output.w) {
+                FORZ(c, output.c) { ptr[c] = scale[c] * ptr[c] + shift[c]; }
+                ptr += output.c;
+            }
+        }
+    }
+}
+
 void BinConv::forward_impl() const {
+    if (output_mat->data_type == DataType::Half) {
+        // The kernels write fp32, which is stored as fp16 afterwards
+        auto &output = *output_mat;
+        const size_t len = output.total();
+        Mat float_output(output.n, output.w, output.h, output.c,
+                         net_.lock()->float_scratch(len), DataType::Float);
+        forward_float(float_output);
+        if (scale_mat != nullptr) {
+            apply_scale(float_output);
+        }
+        float_to_half(static_cast<const float *>(float_output.data),
+                      static_cast<half_t *>(output.data), len);
+        return;
+    }
+    forward_float(*output_mat);
+    if (scale_mat != nullptr) {
+        apply_scale(*output_mat);
+    }
+}
+
+void BinConv::forward_float(Mat &output) const {
     switch (method()) {
         case Method::DIRECT_CONV: {
-            pack_mat(*input_mat, *binarized_mat);
-            pad(*binarized_mat, pad_h, pad_w, *padded_mat);
-            bconv_3x3(*padded_mat, *weight_mat, *output_mat, stride_h);
+            pad(binarized_input(), pad_h, pad_w, *padded_mat);
+            if (weight_mat->h == 3 && weight_mat->w == 3 && dilation_h == 1 &&
+                dilation_w == 1) {
+                bconv_3x3(*padded_mat, *weight_mat, output, stride_h);
+            } else {
+                bconv_direct(*padded_mat, *weight_mat, output, stride_h,
+                             dilation_h, dilation_w, window());
+            }
             break;
         }
         case Method::BGEMM: {
-            output_mat->fill<float>(0.f);
+            output.fill<float>(0.f);
 
-            bnn::fused_binarize_im2col(*input_mat, weight_mat->h, weight_mat->w,
-                                       pad_h, pad_w, stride_h, stride_w, 1, 1,
-                                       *col_mat);
+            binarize_im2col_batch();
 
             const int m = weight_mat->n;
-            const int n = output_mat->h * output_mat->w;
+            const int n = input_mat->n * output.h * output.w;
             const int k = weight_mat->total() / weight_mat->n;
             bgemm(m, n, k, static_cast<uint64_t *>(transposed_weight_mat->data),
                   m, static_cast<uint64_t *>(col_mat->data), k,
-                  static_cast<float *>(output_mat->data), m);
+                  static_cast<float *>(output.data), m);
             break;
         }
         case Method::BGEMM_NAIVE: {
-            output_mat->fill<float>(0.f);
+            output.fill<float>(0.f);
 
-            bnn::fused_binarize_im2col(*input_mat, weight_mat->h, weight_mat->w,
-                                       pad_h, pad_w, stride_h, stride_w, 1, 1,
-                                       *col_mat);
+            binarize_im2col_batch();
 
             const int m = weight_mat->n;
-            const int n = output_mat->h * output_mat->w;
+            const int n = input_mat->n * output.h * output.w;
             const int k = weight_mat->total() / weight_mat->n;
             bgemm_naive(m, n, k,
                         static_cast<uint64_t *>(transposed_weight_mat->data), m,
                         static_cast<uint64_t *>(col_mat->data), k,
-                        static_cast<float *>(output_mat->data), m);
+                        static_cast<float *>(output.data), m);
+            break;
+        }
+        case Method::GROUP_CONV: {
+            pad(binarized_input(), pad_h, pad_w, *padded_mat);
+            bconv_group(*padded_mat, *weight_mat, output, group, stride_h,
+                        stride_w, dilation_h, dilation_w, window());
             break;
         }
         case Method::BCONV_NAIVE: {
-            pack_mat(*input_mat, *binarized_mat);
-            baseline_bconv(*binarized_mat, *weight_mat, weight_mat->h,
-                           weight_mat->w, pad_h, pad_w, stride_h, stride_w, 1,
-                           1, output_mat->c, *output_mat);
+            baseline_bconv(binarized_input(), *weight_mat, weight_mat->h,
+                           weight_mat->w, pad_h, pad_w, stride_h, stride_w,
+                           dilation_h, dilation_w, output.c, output);
+            break;
+        }
+        case Method::GROUP_CONV_NAIVE: {
+            baseline_bconv_group(binarized_input(), *weight_mat,
+                                 weight_mat->h, weight_mat->w, pad_h, pad_w,
+                                 stride_h, stride_w, dilation_h, dilation_w,
+                                 group, output);
             break;
         }
     }
@@ -194,9 +378,28 @@ std::string BinConv::to_str() const {
     std::stringstream ss;
     ss << type_ << ", ";
     PNT_TO(ss, input_mat->h, input_mat->w, input_mat->elem_c, weight_mat->h,
-           weight_mat->w, weight_mat->n, pad_h, pad_w);
+           weight_mat->w, weight_mat->n, pad_h, pad_w, dilation_h, dilation_w,
+           group);
+    ss << ", scaled: " << (scale_mat != nullptr);
+    const char *methods[] = {"direct", "bgemm", "bconv naive",
+                             "bgemm naive", "group", "group naive"};
+    ss << ", method: " << methods[method()];
 
     return ss.str();
 }
 
+Layer::Work BinConv::work() const {
+    Work work;
+    const auto outputs = static_cast<int64_t>(elems(*output_mat));
+    work.bit_ops = 2 * outputs * filter_bits();
+    if (scale_mat != nullptr) {
+        work.flops = 2 * outputs;
+    }
+    // The binarized input and the cols are not counted, they are the
+    // overhead of the method
+    work.bytes_read = bytes(*input_mat) + bytes(*weight_mat);
+    work.bytes_written = bytes(*output_mat);
+    return work;
+}
+
 }  // namespace bnn
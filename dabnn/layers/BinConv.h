@@ -12,29 +12,65 @@ class BinConv : public Layer {
     MatP binarized_mat;
     MatP padded_mat;
     MatP col_mat;
+    // The kernel window gathered by a grouped or dilated bconv_direct
+    MatP window_mat;
     MatCP weight_mat;
     MatP transposed_weight_mat;
     MatCP output_mat;
+    // output = scale * popcount + shift per output channel, from the scale
+    // and offset of the model and a following affine (e.g. bn) fused by the
+    // net. The output is the popcount if they are not set.
+    MatP scale_mat;
+    MatP shift_mat;
     const int pad_h;
     const int pad_w;
     const int stride_h;
     const int stride_w;
+    const int dilation_h;
+    const int dilation_w;
+    const int group;
 
     BinConv(NetCP net, const std::string &name, css input, css weight,
-            css output, int pad_h, int pad_w, int stride_h, int stride_w);
+            css output, int pad_h, int pad_w, int stride_h, int stride_w,
+            int dilation_h, int dilation_w, int group);
+    /**
+     * Make the output scale * (k - 2 * popcount) + offset, the xnor dot
+     * product scaled. offset can be null.
+     */
+    void set_scale(MatCP scale, MatCP offset);
+    /**
+     * Apply x = a * x + b to the output before storing it
+     */
+    void fuse_affine(MatCP a, MatCP b);
     virtual void forward_impl() const;
+    virtual size_t output_elems() const { return elems(*output_mat); }
+    virtual Work work() const;
     virtual std::string to_str() const;
+    virtual bool batch_aware() const;
 
    private:
     enum Method {
         DIRECT_CONV = 0,
         BGEMM,
         BCONV_NAIVE,
-        BGEMM_NAIVE
+        BGEMM_NAIVE,
+        GROUP_CONV,
+        GROUP_CONV_NAIVE
     };
     bool direct_conv_compatible() const;
     bool gemm_compatible() const;
     Method method() const;
+    // fused_binarize_im2col of every image into its part of col_mat
+    void binarize_im2col_batch() const;
+    // The signs of the input, packed into binarized_mat unless it is bits
+    const Mat &binarized_input() const;
+    // The data of window_mat, or null if the kernel reads in place
+    uint64_t *window() const;
+    // The conv with an fp32 output
+    void forward_float(Mat &output) const;
+    // The number of the bits of a filter, k of the xnor dot product
+    int filter_bits() const;
+    void apply_scale(Mat &output) const;
 };
 }  // namespace bnn
 
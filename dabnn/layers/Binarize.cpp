@@ -8,4 +8,13 @@
 namespace bnn {
 void Binarize::forward_impl() const { pack_mat(*input_mat, *output_mat); }
 
+Layer::Work Binarize::work() const {
+    Work work;
+    // A comparison per value
+    work.flops = static_cast<int64_t>(elems(*input_mat));
+    work.bytes_read = bytes(*input_mat);
+    work.bytes_written = bytes(*output_mat);
+    return work;
+}
+
 }  // namespace bnn
@@ -16,6 +16,8 @@ class Binarize : public Layer {
           input_mat(mat(input)),
           output_mat(mat(output)) {}
     virtual void forward_impl() const;
+    virtual size_t output_elems() const { return elems(*output_mat); }
+    virtual Work work() const;
 };
 }  // namespace bnn
 
@@ -0,0 +1,50 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#include "ClassifierHead.h"
+
+#include <dabnn/softmax.h>
+
+namespace bnn {
+
+void ClassifierHead::forward_impl() const {
+    const auto &input = *input_mat;
+    auto &pooled = *fc->input_mat;
+    BNN_ASSERT(pooled.total() == static_cast<size_t>(input.c), pooled.total(),
+               input.c);
+    auto *pooled_ptr = static_cast<float *>(pooled);
+    std::fill(pooled_ptr, pooled_ptr + input.c, 0.f);
+    FORZ(h, input.h) {
+        const auto *ptr = static_cast<const float *>(input) + h * input.hstep;
+        FORZ(w, input.w) {
+            FORZ(c, input.c) { pooled_ptr[c] += ptr[c]; }
+            ptr += input.c;
+        }
+    }
+    const float scale = 1.f / (input.h * input.w);
+    FORZ(c, input.c) { pooled_ptr[c] *= scale; }
+
+    fc->forward_impl();
+
+    softmax(static_cast<const float *>(*fc->output_mat), output_mat->c,
+            static_cast<float *>(*output_mat));
+}
+
+std::string ClassifierHead::to_str() const {
+    std::stringstream ss;
+    ss << type_ << ", ";
+    PNT_TO(ss, input_mat->h, input_mat->w, input_mat->c, output_mat->c);
+
+    return ss.str();
+}
+
+Layer::Work ClassifierHead::work() const {
+    // The fc reads the pooled values in registers instead of a blob
+    auto work = fc->work();
+    work.flops += static_cast<int64_t>(elems(*input_mat)) +
+                  3 * static_cast<int64_t>(elems(*output_mat));
+    work.bytes_read += bytes(*input_mat) - bytes(*fc->input_mat);
+    work.bytes_written = bytes(*output_mat);
+    return work;
+}
+
+}  // namespace bnn
@@ -0,0 +1,36 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#ifndef BNN_CLASSIFIERHEAD_H
+#define BNN_CLASSIFIERHEAD_H
+
+#include <dabnn/layer.h>
+#include <dabnn/layers/AvePool.h>
+#include <dabnn/layers/FC.h>
+#include <dabnn/layers/Softmax.h>
+
+namespace bnn {
+/**
+ * Global average pooling, FC and softmax fused into one layer. The pooled
+ * features are written to the input of fc and the logits to the output of fc,
+ * so all blobs of the original layers are still valid after run().
+ */
+class ClassifierHead : public Layer {
+   public:
+    MatCP input_mat;
+    const std::shared_ptr<FC> fc;
+    MatCP output_mat;
+
+    ClassifierHead(NetCP net, const std::string &name, const AvePool &pool,
+                   std::shared_ptr<FC> fc, const Softmax &softmax)
+        : Layer(net, name, "Classifier Head"),
+          input_mat(pool.input_mat),
+          fc(fc),
+          output_mat(softmax.output_mat) {}
+    virtual void forward_impl() const;
+    virtual size_t output_elems() const { return elems(*output_mat); }
+    virtual Work work() const;
+    virtual std::string to_str() const;
+};
+}  // namespace bnn
+
+#endif /* BNN_CLASSIFIERHEAD_H */
@@ -2,9 +2,45 @@
 
 #include "Concat.h"
 
+#include <dabnn/bitpack.h>
+
 namespace bnn {
 
+/**
+ * Write the signs of input to the words of every pixel of output from word
+ * offset on, a bit input is copied
+ */
+void concat_bits(const Mat &input, Mat &output, const int offset) {
+    const int words = input.elem_c / 64;
+    FORZ(h, input.h) {
+        const auto *row = static_cast<const char *>(input.data) +
+                          h * input.hstep * input.elemsize;
+        auto *out_ptr =
+            static_cast<uint64_t *>(output.data) + h * output.hstep + offset;
+        FORZ(w, input.w) {
+            if (input.data_type == DataType::Bit) {
+                memcpy(out_ptr,
+                       reinterpret_cast<const uint64_t *>(row) + w * input.c,
+                       words * sizeof(uint64_t));
+            } else if (input.data_type == DataType::Half) {
+                pack_64_half(reinterpret_cast<const half_t *>(row) +
+                                 w * input.c,
+                             out_ptr, input.c);
+            } else {
+                pack_64(reinterpret_cast<const float *>(row) + w * input.c,
+                        out_ptr, input.c);
+            }
+            out_ptr += output.c;
+        }
+    }
+}
+
 void Concat::forward_impl() const {
+    if (output_mat->data_type == DataType::Bit) {
+        concat_bits(*input1_mat, *output_mat, 0);
+        concat_bits(*input2_mat, *output_mat, input1_mat->elem_c / 64);
+        return;
+    }
     const auto *in_ptr1 = static_cast<float *>(*input1_mat);
     const auto *in_ptr2 = static_cast<float *>(*input2_mat);
     auto *out_ptr = static_cast<float *>(*output_mat);
@@ -21,4 +57,11 @@ void Concat::forward_impl() const {
     }
 }
 
+Layer::Work Concat::work() const {
+    Work work;
+    work.bytes_read = bytes(*input1_mat) + bytes(*input2_mat);
+    work.bytes_written = bytes(*output_mat);
+    return work;
+}
+
 }  // namespace bnn
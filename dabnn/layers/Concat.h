@@ -18,14 +18,23 @@ class Concat : public Layer {
           input1_mat(mat(input1)),
           input2_mat(mat(input2)),
           output_mat(mat(output)) {
-        BNN_ASSERT(input1_mat->c == input2_mat->c,
+        BNN_ASSERT(input1_mat->elem_c == input2_mat->elem_c,
                    "channels of two inputs should equal");
+        if (output_mat->data_type == DataType::Bit) {
+            // The signs of the inputs are packed into the words of the
+            // output
+            BNN_ASSERT(input1_mat->elem_c % 64 == 0,
+                       "channels of bit concat should be a multiple of 64");
+            return;
+        }
         BNN_ASSERT(input1_mat->data_type == DataType::Float,
                    "input1 data type should be float");
         BNN_ASSERT(input2_mat->data_type == DataType::Float,
                    "input2 data type should be float");
     }
     virtual void forward_impl() const;
+    virtual size_t output_elems() const { return elems(*output_mat); }
+    virtual Work work() const;
 };
 }  // namespace bnn
 
@@ -0,0 +1,135 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#include "FC.h"
+
+#include <algorithm>
+
+#include <dabnn/bitpack.h>
+#include <dabnn/gemv.h>
+#include <dabnn/net.h>
+#include <dabnn/qgemm.h>
+
+namespace bnn {
+
+FC::FC(NetCP net, const std::string &name, css input, css weight, css bias,
+       css output)
+    : Layer(net, name, "FC"),
+      input_mat(mat(input)),
+      weight_mat(mat(weight)),
+      bias_mat(bias.empty() ? nullptr : mat(bias)),
+      output_mat(mat(output)) {
+    const auto &in = *input_mat;
+    // The input is flattened without a copy
+    BNN_ASSERT(in.h == 1 || in.hstep == static_cast<size_t>(in.w * in.c),
+               "The input of FC should be contiguous");
+    BNN_ASSERT(output_mat->c == weight_mat->n, output_mat->c, weight_mat->n);
+    if (weight_mat->data_type == DataType::Bit) {
+        auto &mat_map = net.lock()->mat_map_;
+        const auto binaized_name = "binaized_for_" + output + "_cal";
+        if (mat_map.find(binaized_name) == mat_map.end()) {
+            // The flattened input
+            mat_map[binaized_name] = std::make_shared<Mat>(
+                1, 1, in.h * in.w * in.elem_c, DataType::Bit, binaized_name);
+        }
+        binarized_mat = mat(binaized_name);
+        BNN_ASSERT(static_cast<size_t>(binarized_mat->c) <=
+                       weight_mat->total() / weight_mat->n,
+                   "The weight of FC does not match the input");
+    } else {
+        BNN_ASSERT(static_cast<size_t>(in.h * in.w * in.c) ==
+                       weight_mat->total() / weight_mat->n,
+                   "The weight of FC does not match the input");
+    }
+    if (weight_mat->data_type == DataType::Int8) {
+        auto &mat_map = net.lock()->mat_map_;
+        const auto quantized_name = "quantized_for_" + output;
+        if (mat_map.find(quantized_name) == mat_map.end()) {
+            mat_map[quantized_name] =
+                std::make_shared<Mat>(in.h * in.w * in.c, DataType::Int8);
+        }
+        quantized_mat = mat(quantized_name);
+        weight_scales_mat = mat(weight + "_scales");
+    }
+}
+
+void FC::set_int8_scale(const float scale) {
+    BNN_ASSERT(weight_mat->data_type == DataType::Int8 && scale > 0,
+               "An int8 weight needs the scale of its input, got ", scale);
+    int8_scale = scale;
+    const int m = weight_mat->n;
+    dequant_mat = std::make_shared<Mat>(m, DataType::Float);
+    FORZ(i, m) {
+        static_cast<float *>(dequant_mat->data)[i] =
+            static_cast<const float *>(weight_scales_mat->data)[i] * scale;
+    }
+}
+
+void FC::forward_impl() const {
+    const auto net = net_.lock();
+    if (net->calibrate_int8) {
+        net->record_int8_range(output_mat->name, *input_mat);
+    }
+    const int m = weight_mat->n;
+    const int lda = weight_mat->total() / weight_mat->n;
+    const auto *bias =
+        bias_mat == nullptr ? nullptr : static_cast<const float *>(*bias_mat);
+    auto *output = static_cast<float *>(*output_mat);
+    if (weight_mat->data_type == DataType::Bit) {
+        pack_64(static_cast<const float *>(*input_mat), binarized_mat->data,
+                binarized_mat->elem_c);
+        const int k = binarized_mat->c;
+        bgemv(m, k, static_cast<const uint64_t *>(*weight_mat), lda,
+              static_cast<const uint64_t *>(*binarized_mat), output);
+        // popcount of xor to the dot product of +1/-1
+        const int input_size = k * 64;
+        FORZ(i, m) {
+            output[i] = input_size - 2 * output[i] +
+                        (bias == nullptr ? 0.f : bias[i]);
+        }
+    } else if (weight_mat->data_type == DataType::Int8) {
+        BNN_ASSERT(dequant_mat != nullptr, "The int8 scale of ", name_,
+                   " is not set");
+        const int k = input_mat->h * input_mat->w * input_mat->c;
+        auto *quantized = static_cast<int8_t *>(quantized_mat->data);
+        quantize_int8(static_cast<const float *>(*input_mat), quantized, k,
+                      1.f / int8_scale);
+        qgemv(m, k, static_cast<const int8_t *>(weight_mat->data), lda,
+              quantized, static_cast<const float *>(dequant_mat->data), bias,
+              output);
+    } else {
+        const int k = input_mat->h * input_mat->w * input_mat->c;
+        fgemv(m, k, static_cast<const float *>(*weight_mat), lda,
+              static_cast<const float *>(*input_mat), bias, output);
+    }
+}
+
+std::string FC::to_str() const {
+    std::stringstream ss;
+    ss << type_ << ", ";
+    PNT_TO(ss, input_mat->h, input_mat->w, input_mat->elem_c, weight_mat->n,
+           weight_mat->data_type == DataType::Bit,
+           weight_mat->data_type == DataType::Int8);
+
+    return ss.str();
+}
+
+Layer::Work FC::work() const {
+    Work work;
+    const auto outputs = static_cast<int64_t>(elems(*output_mat));
+    const auto k =
+        static_cast<int64_t>(elems(*input_mat)) / std::max(input_mat->n, 1);
+    if (weight_mat->data_type == DataType::Bit) {
+        work.bit_ops = 2 * outputs * k;
+    } else {
+        work.flops = 2 * outputs * k;
+    }
+    work.bytes_read = bytes(*input_mat) + bytes(*weight_mat);
+    if (bias_mat != nullptr) {
+        work.flops += outputs;
+        work.bytes_read += bytes(*bias_mat);
+    }
+    work.bytes_written = bytes(*output_mat);
+    return work;
+}
+
+}  // namespace bnn
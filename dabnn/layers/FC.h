@@ -0,0 +1,43 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#ifndef BNN_FC_H
+#define BNN_FC_H
+
+#include <dabnn/layer.h>
+
+namespace bnn {
+/**
+ * Fully-connected layer. The weight is [num_output, 1, 1, input_size] and
+ * input_size is the flattened (NHWC) input. A binary weight makes it a binary
+ * FC, whose output is the dot product of the binarized input and weight
+ * (input_size - 2 * popcount) like a float FC. An int8 weight runs on the
+ * quantized input and dequantizes the int32 sums.
+ */
+class FC : public Layer {
+   public:
+    MatCP input_mat;
+    MatP binarized_mat;
+    MatCP weight_mat;
+    MatCP bias_mat;
+    MatCP output_mat;
+    // The int8 weight runs on the input quantized by int8_scale, dequant_mat
+    // holds the scale of every output of the int32 sums
+    float int8_scale = 0.f;
+    MatP weight_scales_mat;
+    MatP dequant_mat;
+    MatP quantized_mat;
+
+    FC(NetCP net, const std::string &name, css input, css weight, css bias,
+       css output);
+    /**
+     * Set the scale of the int8 input of an int8 weight
+     */
+    void set_int8_scale(float scale);
+    virtual void forward_impl() const;
+    virtual size_t output_elems() const { return elems(*output_mat); }
+    virtual Work work() const;
+    virtual std::string to_str() const;
+};
+}  // namespace bnn
+
+#endif /* BNN_FC_H */
@@ -3,18 +3,126 @@
 #include "FloatConv.h"
 
 #include <dabnn/fconv.h>
+#include <dabnn/net.h>
 
 namespace bnn {
 
+void FloatConv::init(const std::string &weight) {
+    auto &mat_map = net_.lock()->mat_map_;
+    const int m = weight_mat->n;
+    const int k = weight_mat->h * weight_mat->w * weight_mat->c;
+    BNN_ASSERT(weight_mat->total() % m == 0, "");
+    const auto packed_name = "packed_" + weight;
+    if (weight_mat->data_type == DataType::Int8) {
+        if (mat_map.find(packed_name) == mat_map.end()) {
+            auto packed = std::make_shared<Mat>(
+                static_cast<int>(qgemm_packed_size(m, k)), DataType::Int8);
+            qgemm_pack_weight(m, k, static_cast<int8_t *>(weight_mat->data),
+                              weight_mat->total() / m,
+                              static_cast<int8_t *>(packed->data));
+            net_.lock()->add_weight(packed_name, packed);
+        }
+        packed_weight_mat = mat(packed_name);
+        weight_scales_mat = mat(weight + "_scales");
+        // The input of every image of the batch is quantized at once
+        const auto quantized_name = "quantized_for_" + output_mat->name;
+        if (mat_map.find(quantized_name) == mat_map.end()) {
+            mat_map[quantized_name] = std::make_shared<Mat>(
+                static_cast<int>(input_mat->n * input_mat->h * input_mat->w *
+                                 input_mat->c),
+                DataType::Int8);
+        }
+        quantized_mat = mat(quantized_name);
+        return;
+    }
+    if (mat_map.find(packed_name) == mat_map.end()) {
+        auto packed = std::make_shared<Mat>(
+            static_cast<int>(fgemm_packed_size(m, k)), DataType::Float);
+        fgemm_pack_weight(m, k, static_cast<float *>(weight_mat->data),
+                          weight_mat->total() / m,
+                          static_cast<float *>(packed->data));
+        net_.lock()->add_weight(packed_name, packed);
+    }
+    packed_weight_mat = mat(packed_name);
+}
+
+void FloatConv::fuse_affine(MatCP a, MatCP b) {
+    BNN_ASSERT(scale_mat == nullptr && !relu,
+               "The affine must come before relu and be fused only once");
+    scale_mat = a;
+    shift_mat = b;
+}
+
+void FloatConv::fuse_relu() { relu = true; }
+
+void FloatConv::set_int8_scale(const float scale) {
+    BNN_ASSERT(weight_mat->data_type == DataType::Int8 && scale > 0,
+               "An int8 weight needs the scale of its input, got ", scale);
+    int8_scale = scale;
+    const int m = weight_mat->n;
+    dequant_mat = std::make_shared<Mat>(m, DataType::Float);
+    FORZ(i, m) {
+        static_cast<float *>(dequant_mat->data)[i] =
+            static_cast<const float *>(weight_scales_mat->data)[i] * scale;
+    }
+}
+
+void FloatConv::forward_int8(const FgemmEpilogue &epilogue) const {
+    BNN_ASSERT(dequant_mat != nullptr, "The int8 scale of ", name_,
+               " is not set");
+    const auto &input = *input_mat;
+    auto *quantized = static_cast<int8_t *>(quantized_mat->data);
+    const float inv_scale = 1.f / int8_scale;
+    const int row_len = input.w * input.c;
+    if (uint8_input != nullptr) {
+        quantize_int8(uint8_input, quantized, input.n * input.h * input.w,
+                      input.c, input_mean, input_scale, inv_scale);
+    } else {
+        FORZ(i, input.n * input.h) {
+            quantize_int8(static_cast<const float *>(input.data) +
+                              i * input.hstep,
+                          quantized + i * row_len, row_len, inv_scale);
+        }
+    }
+    fconv_packed_int8(quantized, input.n, input.h, input.w, input.c,
+                      static_cast<const int8_t *>(packed_weight_mat->data),
+                      static_cast<const float *>(dequant_mat->data),
+                      weight_mat->h, weight_mat->w, pad_h, pad_w, stride_h,
+                      stride_w, dilation, dilation, output_mat->c, epilogue,
+                      *output_mat);
+}
+
 void FloatConv::forward_impl() const {
-    if (bias_mat == nullptr) {
-        fconv(*input_mat, *weight_mat, weight_mat->h, weight_mat->w, pad_h,
-              pad_w, stride_h, stride_w, dilation, dilation, output_mat->c,
-              *output_mat);
+    const auto net = net_.lock();
+    if (net->calibrate_int8) {
+        net->record_int8_range(output_mat->name, *input_mat);
+    }
+    FgemmEpilogue epilogue;
+    if (bias_mat != nullptr) {
+        epilogue.bias = static_cast<const float *>(bias_mat->data);
+    }
+    if (scale_mat != nullptr) {
+        epilogue.scale = static_cast<const float *>(scale_mat->data);
+        epilogue.shift = static_cast<const float *>(shift_mat->data);
+    }
+    epilogue.relu = relu;
+    if (weight_mat->data_type == DataType::Int8) {
+        forward_int8(epilogue);
+        return;
+    }
+    const auto *packed_weight =
+        static_cast<const float *>(packed_weight_mat->data);
+    if (uint8_input != nullptr) {
+        fconv_packed_uint8(uint8_input, input_mat->n, input_mat->h,
+                           input_mat->w, input_mat->c, input_mean,
+                           input_scale, packed_weight, weight_mat->h,
+                           weight_mat->w, pad_h, pad_w, stride_h, stride_w,
+                           dilation, dilation, output_mat->c, epilogue,
+                           *output_mat);
     } else {
-        fconv(*input_mat, *weight_mat, *bias_mat, weight_mat->h, weight_mat->w,
-              pad_h, pad_w, stride_h, stride_w, dilation, dilation,
-              output_mat->c, *output_mat);
+        fconv_packed(*input_mat, packed_weight, weight_mat->h, weight_mat->w,
+                     pad_h, pad_w, stride_h, stride_w, dilation, dilation,
+                     output_mat->c, epilogue, *output_mat);
     }
 }
 
@@ -25,9 +133,33 @@ std::string FloatConv::to_str() const {
        << ", input_c: " << std::to_string(input_mat->c)
        << ", weight_h: " << std::to_string(weight_mat->h)
        << ", weight_w: " << std::to_string(weight_mat->w)
-       << ", weight_n: " << std::to_string(weight_mat->n);
+       << ", weight_n: " << std::to_string(weight_mat->n)
+       << ", fused affine: " << (scale_mat != nullptr)
+       << ", fused relu: " << relu
+       << ", int8: " << (weight_mat->data_type == DataType::Int8);
 
     return ss.str();
 }
 
+Layer::Work FloatConv::work() const {
+    Work work;
+    const auto outputs = static_cast<int64_t>(elems(*output_mat));
+    work.flops = 2 * outputs *
+                 static_cast<int64_t>(weight_mat->total() / weight_mat->n);
+    // The stem reads a uint8 image instead of the input blob
+    work.bytes_read =
+        (uint8_input != nullptr ? static_cast<int64_t>(elems(*input_mat))
+                                : bytes(*input_mat)) +
+        bytes(*weight_mat);
+    if (bias_mat != nullptr) {
+        work.flops += outputs;
+        work.bytes_read += bytes(*bias_mat);
+    }
+    if (scale_mat != nullptr) {
+        work.flops += 2 * outputs;
+    }
+    work.bytes_written = bytes(*output_mat);
+    return work;
+}
+
 }  // namespace bnn
@@ -3,6 +3,7 @@
 #ifndef BNN_FLOATCONV_H
 #define BNN_FLOATCONV_H
 
+#include <dabnn/fgemm.h>
 #include <dabnn/layer.h>
 
 namespace bnn {
@@ -12,6 +13,23 @@ class FloatConv : public Layer {
     MatCP weight_mat;
     MatCP bias_mat;
     MatCP output_mat;
+    // The weight packed for fgemm (or qgemm if it is int8) when the net is
+    // prepared
+    MatP packed_weight_mat;
+    // The int8 weight runs on the input quantized by int8_scale, dequant_mat
+    // holds the scale of every output channel of the int32 sums
+    float int8_scale = 0.f;
+    MatP weight_scales_mat;
+    MatP dequant_mat;
+    MatP quantized_mat;
+    // A following per channel affine (e.g. bn) and relu fused by the net
+    MatP scale_mat;
+    MatP shift_mat;
+    bool relu = false;
+    // A uint8 image read instead of input_mat, set by Net::run for the stem
+    const uint8_t *uint8_input = nullptr;
+    const float *input_mean = nullptr;
+    const float *input_scale = nullptr;
     const int pad_h;
     const int pad_w;
     const int stride_h;
@@ -29,7 +47,9 @@ class FloatConv : public Layer {
           pad_w(pad_w),
           stride_h(stride_h),
           stride_w(stride_w),
-          dilation(dilation) {}
+          dilation(dilation) {
+        init(weight);
+    }
 
     FloatConv(NetCP net, const std::string &name, css input, css weight,
               css bias, css output, int pad_h, int pad_w, int stride_h,
@@ -43,10 +63,29 @@ class FloatConv : public Layer {
           pad_w(pad_w),
           stride_h(stride_h),
           stride_w(stride_w),
-          dilation(dilation) {}
+          dilation(dilation) {
+        init(weight);
+    }
+
+    /**
+     * Apply x = a * x + b (and then relu) to the output before storing it
+     */
+    void fuse_affine(MatCP a, MatCP b);
+    void fuse_relu();
+    /**
+     * Set the scale of the int8 input of an int8 weight
+     */
+    void set_int8_scale(float scale);
 
     virtual void forward_impl() const;
+    virtual size_t output_elems() const { return elems(*output_mat); }
+    virtual Work work() const;
     virtual std::string to_str() const;
+    virtual bool batch_aware() const { return true; }
+
+   private:
+    void init(const std::string &weight);
+    void forward_int8(const FgemmEpilogue &epilogue) const;
 };
 }  // namespace bnn
 
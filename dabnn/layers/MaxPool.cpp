@@ -2,8 +2,10 @@
 
 #include "MaxPool.h"
 
+#include <algorithm>
 #include <limits>
 
+#include <dabnn/bitpack.h>
 #include <dabnn/net.h>
 #include <dabnn/pad.h>
 
@@ -245,6 +247,59 @@ void max_pool_fallback(const bnn::Mat &input, const size_t pad_h,
     }
 }
 
+/**
+ * The bit max pool, the max is positive if any value is, so the signs are
+ * pooled by or. The padded taps are skipped as in max_pool_fallback.
+ */
+void max_pool_bit(const bnn::Mat &input, const int pad_h, const int pad_w,
+                  const int stride_h, const int stride_w, const int kernel_h,
+                  const int kernel_w, bnn::Mat &output) {
+    BNN_ASSERT(input.data_type == DataType::Bit &&
+                   output.data_type == DataType::Bit && input.c == output.c,
+               "The input and output of max_pool_bit should be bits");
+    const auto *input_ptr = static_cast<const uint64_t *>(input.data);
+    FORZ(output_y, output.h) {
+        auto *output_ptr =
+            static_cast<uint64_t *>(output.data) + output_y * output.hstep;
+        FORZ(output_x, output.w) {
+            std::fill(output_ptr, output_ptr + output.c, 0);
+            FORZ(kh, kernel_h) {
+                const int y = output_y * stride_h - pad_h + kh;
+                if (y < 0 || y >= input.h) {
+                    continue;
+                }
+                FORZ(kw, kernel_w) {
+                    const int x = output_x * stride_w - pad_w + kw;
+                    if (x < 0 || x >= input.w) {
+                        continue;
+                    }
+                    const auto *ptr = input_ptr + y * input.hstep + x * input.c;
+                    FORZ(i, input.c) { output_ptr[i] |= ptr[i]; }
+                }
+            }
+            output_ptr += output.c;
+        }
+    }
+}
+
+/**
+ * pack_mat without its alignment requirement, the rows of a bit mat may
+ * have an odd number of words
+ */
+void pack_rows(const bnn::Mat &float_mat, bnn::Mat &binary_mat) {
+    BNN_ASSERT(float_mat.c % 64 == 0, float_mat.c);
+    const size_t len = float_mat.w * float_mat.c;
+    FORZ(h, float_mat.h) {
+        auto *bptr =
+            static_cast<uint64_t *>(binary_mat.data) + h * binary_mat.hstep;
+        if (float_mat.data_type == DataType::Half) {
+            pack_64_half(float_mat.point<half_t>(h, 0), bptr, len);
+        } else {
+            pack_64(float_mat.point<float>(h, 0), bptr, len);
+        }
+    }
+}
+
 MaxPool::MaxPool(NetCP net, const std::string &name, css input, css output,
                  int kernel_h, int kernel_w, int pad_h, int pad_w, int stride_h,
                  int stride_w)
@@ -258,16 +313,38 @@ MaxPool::MaxPool(NetCP net, const std::string &name, css input, css output,
       stride_h(stride_h),
       stride_w(stride_w) {
     auto &mat_map = net.lock()->mat_map_;
+    if (output_mat->data_type == DataType::Bit) {
+        if (input_mat->data_type == DataType::Bit) {
+            return;
+        }
+        const auto binarized_name = "binarized_for_" + output + "_cal";
+        if (mat_map.find(binarized_name) == mat_map.end()) {
+            mat_map[binarized_name] = std::make_shared<Mat>(
+                input_mat->w, input_mat->h, input_mat->c, DataType::Bit,
+                binarized_name);
+        }
+        binarized_mat = mat_map[binarized_name];
+        return;
+    }
     const auto &pad_name = "pad_for_" + output + "_cal";
     if (mat_map.find(pad_name) == mat_map.end()) {
         auto &input_mat = *mat_map[input];
         mat_map[pad_name] = std::make_shared<Mat>(
-            input_mat.h + pad_h * 2, input_mat.w + pad_w * 2, input_mat.c,
+            input_mat.w + pad_w * 2, input_mat.h + pad_h * 2, input_mat.c,
             input_mat.data_type, pad_name);
     }
     padded_mat = mat_map[pad_name];
 }
 void MaxPool::forward_impl() const {
+    if (output_mat->data_type == DataType::Bit) {
+        if (binarized_mat != nullptr) {
+            pack_rows(*input_mat, *binarized_mat);
+        }
+        max_pool_bit(binarized_mat != nullptr ? *binarized_mat : *input_mat,
+                     pad_h, pad_w, stride_h, stride_w, kernel_h, kernel_w,
+                     *output_mat);
+        return;
+    }
 #ifdef __ARM_NEON
     if (kernel_h == 3 && kernel_w == 3) {
         // std::numeric_limits<float>::min() is the closest value to 0, so we
@@ -296,4 +373,19 @@ std::string MaxPool::to_str() const {
     return ss.str();
 }
 
+Layer::Work MaxPool::work() const {
+    Work work;
+    // A comparison (or an or of the signs) per value of the window
+    const auto ops =
+        static_cast<int64_t>(elems(*output_mat)) * kernel_h * kernel_w;
+    if (output_mat->data_type == DataType::Bit) {
+        work.bit_ops = ops;
+    } else {
+        work.flops = ops;
+    }
+    work.bytes_read = bytes(*input_mat);
+    work.bytes_written = bytes(*output_mat);
+    return work;
+}
+
 }  // namespace bnn
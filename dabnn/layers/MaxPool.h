@@ -10,6 +10,8 @@ class MaxPool : public Layer {
    public:
     MatCP input_mat;
     std::shared_ptr<Mat> padded_mat;
+    // The signs of a float input of a bit output
+    std::shared_ptr<Mat> binarized_mat;
     MatCP output_mat;
     int kernel_h;
     int kernel_w;
@@ -22,6 +24,8 @@ class MaxPool : public Layer {
             int kernel_h, int kernel_w, int pad_h, int pad_w, int stride_h,
             int stride_w);
     virtual void forward_impl() const;
+    virtual size_t output_elems() const { return elems(*output_mat); }
+    virtual Work work() const;
     virtual std::string to_str() const;
 };
 }  // namespace bnn
@@ -0,0 +1,176 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#include "MultiBitConv.h"
+
+#include <dabnn/fp16.h>
+#include <dabnn/net.h>
+
+namespace bnn {
+
+MultiBitConv::MultiBitConv(NetCP net, const std::string &name, css input,
+                           css weight, css bias, css output, int pad_h,
+                           int pad_w, int stride_h, int stride_w,
+                           int dilation_h, int dilation_w, int weight_bits,
+                           int activation_bits, float activation_scale)
+    : Layer(net, name, "MultiBit Conv"),
+      input_mat(mat(input)),
+      weight_mat(mat(weight)),
+      bias_mat(bias == "" ? nullptr : mat(bias)),
+      output_mat(mat(output)),
+      pad_h(pad_h),
+      pad_w(pad_w),
+      stride_h(stride_h),
+      stride_w(stride_w),
+      dilation_h(dilation_h),
+      dilation_w(dilation_w),
+      weight_bits(weight_bits),
+      activation_bits(activation_bits),
+      activation_scale(activation_scale) {
+    BNN_ASSERT(weight_mat->data_type == DataType::Int8,
+               "The levels of a multi-bit weight are int8");
+    BNN_ASSERT(weight_bits >= 1 && weight_bits <= kMaxPlaneBits &&
+                   activation_bits >= 1 && activation_bits <= kMaxPlaneBits,
+               "Only 1 to ", kMaxPlaneBits, " bits are supported, got ",
+               weight_bits, " and ", activation_bits);
+    BNN_ASSERT(activation_scale > 0, "The activation scale of ", name,
+               " is not set");
+    BNN_ASSERT(input_mat->c % 64 == 0, "The input channels of ", name,
+               " should be a multiple of 64, got ", input_mat->c);
+
+    auto &mat_map = net_.lock()->mat_map_;
+    const int m = weight_mat->n;
+    const int kernel_len = weight_mat->h * weight_mat->w;
+    const auto planes_name = "planes_" + weight;
+    const auto wsum_name = "wsum_" + weight;
+    if (mat_map.find(planes_name) == mat_map.end()) {
+        const auto bs = shape();
+        auto planes = std::make_shared<Mat>(
+            static_cast<int>(bs.k() * weight_bits * m), DataType::Bit);
+        auto wsum = std::make_shared<Mat>(m * kernel_len, DataType::Float);
+        pack_weight_planes(static_cast<const int8_t *>(weight_mat->data), m,
+                           kernel_len, weight_mat->c, weight_bits,
+                           static_cast<uint64_t *>(planes->data),
+                           static_cast<float *>(wsum->data));
+        net_.lock()->add_weight(planes_name, planes);
+        net_.lock()->add_weight(wsum_name, wsum);
+    }
+    weight_planes_mat = mat(planes_name);
+    wsum_mat = mat(wsum_name);
+
+    const auto &weight_scales = *mat(weight + "_scales");
+    scale_mat = std::make_shared<Mat>(m, DataType::Float);
+    FORZ(i, m) {
+        static_cast<float *>(scale_mat->data)[i] =
+            static_cast<const float *>(weight_scales.data)[i] *
+            activation_scale;
+    }
+
+    // The scratch of every image of the batch, kept for the plan
+    const auto bs = shape();
+    const auto scratch = [&](const std::string &prefix, const size_t len,
+                             const DataType data_type) {
+        const auto scratch_name = prefix + output;
+        if (mat_map.find(scratch_name) == mat_map.end()) {
+            mat_map[scratch_name] =
+                std::make_shared<Mat>(static_cast<int>(len), data_type);
+        }
+        return mat(scratch_name);
+    };
+    planes_mat = scratch("planes_for_", bs.planes_size(), DataType::Bit);
+    col_mat = scratch("col_for_", bs.col_size(), DataType::Bit);
+    popcount_mat =
+        scratch("popcount_for_", bs.popcount_size(), DataType::Float);
+}
+
+BitplaneConv MultiBitConv::shape() const {
+    BitplaneConv bs;
+    bs.n = input_mat->n;
+    bs.h = input_mat->h;
+    bs.w = input_mat->w;
+    bs.c = input_mat->c;
+    bs.kernel_h = weight_mat->h;
+    bs.kernel_w = weight_mat->w;
+    bs.pad_h = pad_h;
+    bs.pad_w = pad_w;
+    bs.stride_h = stride_h;
+    bs.stride_w = stride_w;
+    bs.dilation_h = dilation_h;
+    bs.dilation_w = dilation_w;
+    bs.output_h = output_mat->h;
+    bs.output_w = output_mat->w;
+    bs.activation_bits = activation_bits;
+    bs.weight_bits = weight_bits;
+    bs.m = weight_mat->n;
+    return bs;
+}
+
+void MultiBitConv::forward_impl() const {
+    const auto bs = shape();
+    const auto &input = *input_mat;
+    const int row_len = input.w * input.c;
+    float *half_row = input.data_type == DataType::Half
+                          ? net_.lock()->float_scratch(row_len)
+                          : nullptr;
+    auto *planes = static_cast<uint64_t *>(planes_mat->data);
+    bs.pack_input(
+        [&](const int y) -> const float * {
+            if (half_row != nullptr) {
+                half_to_float(input.point<half_t>(y / input.h, y % input.h, 0),
+                              half_row, row_len);
+                return half_row;
+            }
+            return input.point<float>(y / input.h, y % input.h, 0);
+        },
+        1.f / activation_scale, planes);
+    auto *col = static_cast<uint64_t *>(col_mat->data);
+    bs.im2col(planes, col);
+    auto *popcount = static_cast<float *>(popcount_mat->data);
+    bs.gemm(static_cast<const uint64_t *>(weight_planes_mat->data), col,
+            popcount);
+    auto &output = *output_mat;
+    bs.combine(popcount, static_cast<const float *>(wsum_mat->data),
+               static_cast<const float *>(scale_mat->data),
+               bias_mat == nullptr
+                   ? nullptr
+                   : static_cast<const float *>(bias_mat->data),
+               [&](const int p) {
+                   const int image_len = output.h * output.w;
+                   const int b = p / image_len;
+                   const int i = p % image_len;
+                   return output.point<float>(b, i / output.w, i % output.w);
+               });
+}
+
+std::string MultiBitConv::to_str() const {
+    std::stringstream ss;
+    ss << "input_h: " << std::to_string(input_mat->h)
+       << ", input_w: " << std::to_string(input_mat->w)
+       << ", input_c: " << std::to_string(input_mat->c)
+       << ", weight_h: " << std::to_string(weight_mat->h)
+       << ", weight_w: " << std::to_string(weight_mat->w)
+       << ", weight_n: " << std::to_string(weight_mat->n)
+       << ", weight_bits: " << weight_bits
+       << ", activation_bits: " << activation_bits;
+
+    return ss.str();
+}
+
+Layer::Work MultiBitConv::work() const {
+    Work work;
+    const auto bs = shape();
+    // Every pair of an activation plane and a weight plane
+    const int64_t planes =
+        static_cast<int64_t>(bs.pixels()) * bs.m * activation_bits *
+        weight_bits;
+    work.bit_ops = 2 * planes * bs.kernel_len() * bs.c;
+    work.flops = 2 * planes;
+    work.bytes_read = bytes(*input_mat) + bytes(*weight_mat);
+    if (bias_mat != nullptr) {
+        work.flops += static_cast<int64_t>(elems(*output_mat));
+        work.bytes_read += bytes(*bias_mat);
+    }
+    work.bytes_written = bytes(*output_mat);
+    return work;
+}
+
+}  // namespace bnn
@@ -0,0 +1,55 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#ifndef BNN_MULTIBITCONV_H
+#define BNN_MULTIBITCONV_H
+
+#include <dabnn/bitplane.h>
+#include <dabnn/layer.h>
+
+namespace bnn {
+/**
+ * The conv of weight_bits bits weights and activation_bits bits
+ * activations, every pair of their bit planes is a binary gemm
+ */
+class MultiBitConv : public Layer {
+   public:
+    MatCP input_mat;
+    MatCP weight_mat;
+    MatCP bias_mat;
+    MatCP output_mat;
+    // The bit planes of the weight and the sums of the levels of its taps
+    MatP weight_planes_mat;
+    MatP wsum_mat;
+    // The scale of every output channel of the sums of the level products
+    MatP scale_mat;
+    MatP planes_mat;
+    MatP col_mat;
+    MatP popcount_mat;
+    const int pad_h;
+    const int pad_w;
+    const int stride_h;
+    const int stride_w;
+    const int dilation_h;
+    const int dilation_w;
+    const int weight_bits;
+    const int activation_bits;
+    const float activation_scale;
+
+    MultiBitConv(NetCP net, const std::string &name, css input, css weight,
+                 css bias, css output, int pad_h, int pad_w, int stride_h,
+                 int stride_w, int dilation_h, int dilation_w,
+                 int weight_bits, int activation_bits,
+                 float activation_scale);
+
+    virtual void forward_impl() const;
+    virtual size_t output_elems() const { return elems(*output_mat); }
+    virtual Work work() const;
+    virtual std::string to_str() const;
+    virtual bool batch_aware() const { return true; }
+
+   private:
+    BitplaneConv shape() const;
+};
+}  // namespace bnn
+
+#endif /* BNN_MULTIBITCONV_H */
@@ -7,6 +7,15 @@ void PRelu::forward_impl() const {
     BNN_ASSERT(slope_mat->total() == 1 ||
                    slope_mat->total() == static_cast<size_t>(data_mat->c),
                "slope must have size 1 or input.channels");
+    if (data_mat->data_type == DataType::Half) {
+        const bool shared = slope_mat->total() == 1;
+        const auto &slope = *slope_mat;
+        half_row_inplace(static_cast<half_t *>(*data_mat), data_mat->total(),
+                         data_mat->c, [&](const float v, const int c) {
+                             return v < 0 ? v * slope[shared ? 0 : c] : v;
+                         });
+        return;
+    }
     float *ptr = static_cast<float *>(*data_mat);
     float *slope_ptr = static_cast<float *>(*slope_mat);
     if (slope_mat->total() == 1) {
@@ -29,4 +38,13 @@ void PRelu::forward_impl() const {
         }
     }
 }
+
+Layer::Work PRelu::work() const {
+    Work work;
+    work.flops = 2 * static_cast<int64_t>(elems(*data_mat));
+    work.bytes_read = bytes(*data_mat) + bytes(*slope_mat);
+    work.bytes_written = bytes(*data_mat);
+    return work;
+}
+
 }  // namespace bnn
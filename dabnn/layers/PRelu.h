@@ -14,6 +14,8 @@ class PRelu : public Layer {
     PRelu(NetCP net, const std::string &name, css data, css slope)
         : Layer(net, name, "PRelu"), data_mat(mat(data)), slope_mat(mat(slope)) {}
     virtual void forward_impl() const;
+    virtual size_t output_elems() const { return elems(*data_mat); }
+    virtual Work work() const;
 };
 }  // namespace bnn
 
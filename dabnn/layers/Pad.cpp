@@ -8,4 +8,11 @@
 namespace bnn {
 void Pad::forward_impl() const { pad(*input_mat, pad_h, pad_w, *output_mat); }
 
+Layer::Work Pad::work() const {
+    Work work;
+    work.bytes_read = bytes(*input_mat);
+    work.bytes_written = bytes(*output_mat);
+    return work;
+}
+
 }  // namespace bnn
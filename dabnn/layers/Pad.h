@@ -23,6 +23,8 @@ class Pad : public Layer {
           pad_w(pad_w),
           val(val) {}
     virtual void forward_impl() const;
+    virtual size_t output_elems() const { return elems(*output_mat); }
+    virtual Work work() const;
 };
 }  // namespace bnn
 
@@ -8,6 +8,16 @@
 
 namespace bnn {
 void Relu::forward_impl() const {
+    if (data_mat->data_type == DataType::Half) {
+        // The sign bit alone decides relu, no conversion is needed
+        auto *ptr = static_cast<half_t *>(*data_mat);
+        FORZ(i, data_mat->total()) {
+            if (ptr[i] & 0x8000) {
+                ptr[i] = 0;
+            }
+        }
+        return;
+    }
 #if __ARM_NEON
     float32x4_t _zero = vdupq_n_f32(0.f);
     float *ptr = static_cast<float *>(*data_mat);
@@ -26,4 +36,13 @@ void Relu::forward_impl() const {
     }
 #endif  // __ARM_NEON
 }
+
+Layer::Work Relu::work() const {
+    Work work;
+    work.flops = static_cast<int64_t>(elems(*data_mat));
+    work.bytes_read = bytes(*data_mat);
+    work.bytes_written = bytes(*data_mat);
+    return work;
+}
+
 }  // namespace bnn
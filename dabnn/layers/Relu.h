@@ -13,6 +13,8 @@ class Relu : public Layer {
     Relu(NetCP net, const std::string &name, css data)
         : Layer(net, name, "Relu"), data_mat(mat(data)) {}
     virtual void forward_impl() const;
+    virtual size_t output_elems() const { return elems(*data_mat); }
+    virtual Work work() const;
 };
 }  // namespace bnn
 
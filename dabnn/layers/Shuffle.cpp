@@ -38,4 +38,12 @@ void Shuffle::forward_impl() const {
         }
     }
 }
+
+Layer::Work Shuffle::work() const {
+    Work work;
+    work.bytes_read = bytes(*data_mat);
+    work.bytes_written = bytes(*data_mat);
+    return work;
+}
+
 }  // namespace bnn
@@ -18,6 +18,8 @@ class Shuffle : public Layer {
                    data_mat->elem_c);
     }
     virtual void forward_impl() const;
+    virtual size_t output_elems() const { return elems(*data_mat); }
+    virtual Work work() const;
 };
 }  // namespace bnn
 
@@ -0,0 +1,32 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#include "Softmax.h"
+
+#include <dabnn/softmax.h>
+
+namespace bnn {
+void Softmax::forward_impl() const {
+    const auto &input = *input_mat;
+    auto &output = *output_mat;
+    BNN_ASSERT(input.c == output.c, input.c, output.c);
+    FORZ(h, input.h) {
+        FORZ(w, input.w) {
+            softmax(static_cast<const float *>(input) + h * input.hstep +
+                        w * input.c,
+                    input.c,
+                    static_cast<float *>(output) + h * output.hstep +
+                        w * output.c);
+        }
+    }
+}
+
+Layer::Work Softmax::work() const {
+    Work work;
+    // The exp, the sum and the division
+    work.flops = 3 * static_cast<int64_t>(elems(*output_mat));
+    work.bytes_read = bytes(*input_mat);
+    work.bytes_written = bytes(*output_mat);
+    return work;
+}
+
+}  // namespace bnn
@@ -0,0 +1,27 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#ifndef BNN_SOFTMAX_LAYER_H
+#define BNN_SOFTMAX_LAYER_H
+
+#include <dabnn/layer.h>
+
+namespace bnn {
+/**
+ * Softmax over the channels of every pixel
+ */
+class Softmax : public Layer {
+   public:
+    MatCP input_mat;
+    MatCP output_mat;
+
+    Softmax(NetCP net, const std::string &name, css input, css output)
+        : Layer(net, name, "Softmax"),
+          input_mat(mat(input)),
+          output_mat(mat(output)) {}
+    virtual void forward_impl() const;
+    virtual size_t output_elems() const { return elems(*output_mat); }
+    virtual Work work() const;
+};
+}  // namespace bnn
+
+#endif /* BNN_SOFTMAX_LAYER_H */
@@ -20,4 +20,12 @@ void Split::forward_impl() const {
         ptr += c_per_output;
     }
 }
+
+Layer::Work Split::work() const {
+    Work work;
+    work.bytes_read = bytes(*input_mat);
+    work.bytes_written = bytes(*output_mat1) + bytes(*output_mat2);
+    return work;
+}
+
 }  // namespace bnn
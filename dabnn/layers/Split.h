@@ -23,6 +23,10 @@ class Split : public Layer {
                    input_mat->elem_c);
     }
     virtual void forward_impl() const;
+    virtual size_t output_elems() const {
+        return elems(*output_mat1) + elems(*output_mat2);
+    }
+    virtual Work work() const;
 };
 }  // namespace bnn
 
@@ -27,10 +27,25 @@
 #endif
 #include <common/helper.h>
 #include "allocator.h"
+#include "fp16.h"
 
 namespace bnn {
 
-enum class DataType { Float, Bit };
+// Half is fp16 storage of float activations, Int8 is a quantized weight
+enum class DataType { Float, Bit, Half, Int8 };
+
+inline size_t data_type_size(const DataType data_type) {
+    switch (data_type) {
+        case DataType::Float:
+            return sizeof(float);
+        case DataType::Half:
+            return sizeof(half_t);
+        case DataType::Int8:
+            return sizeof(int8_t);
+        default:
+            return sizeof(uint64_t);
+    }
+}
 
 // the three dimension matrix
 // ncnn Mat is CHW, our mat is NHWC
@@ -62,6 +77,8 @@ class Mat {
         size_t data_num, bool require_align = true);
 
     Mat subMat(int w1, int w2, int h1, int h2);
+    // view of the i-th image of a batch
+    Mat image(int i) const;
     // release
     ~Mat();
     // delete copy constructor and copy assignment
@@ -209,7 +226,7 @@ inline Mat::Mat(int _w, void *_data, DataType data_type)
     w = _w;
     h = 1;
     c = 1;
-    elemsize = data_type == DataType::Float ? sizeof(float) : sizeof(uint64_t);
+    elemsize = data_type_size(data_type);
 
     hstep = w;
 
@@ -222,7 +239,7 @@ inline Mat::Mat(int _w, int _h, void *_data, DataType data_type)
     w = _w;
     h = _h;
     c = 1;
-    elemsize = data_type == DataType::Float ? sizeof(float) : sizeof(uint64_t);
+    elemsize = data_type_size(data_type);
 
     hstep = w * 1;
 
@@ -239,7 +256,7 @@ inline Mat::Mat(int _w, int _h, int _c, void *_data, DataType data_type)
     if (data_type == DataType::Bit) {
         c /= 64;
     }
-    elemsize = data_type == DataType::Float ? sizeof(float) : sizeof(uint64_t);
+    elemsize = data_type_size(data_type);
 
     std::stringstream ss;
     ss << "Not align, w: " << w << ", c: " << c << ", elemsize: " << elemsize;
@@ -272,7 +289,7 @@ inline Mat::Mat(int _n, int _w, int _h, int _c, void *_data, DataType data_type,
                    " should be not smaller than n * w * h * c, ", n, ", ", w,
                    ", ", h, ", ", c);
     }
-    elemsize = data_type == DataType::Float ? sizeof(float) : sizeof(uint64_t);
+    elemsize = data_type_size(data_type);
     std::stringstream ss;
     ss << "Not align, w: " << w << ", c: " << c << ", elemsize: " << elemsize;
     BNN_ASSERT(!require_align || w * c == 1 || w * c * elemsize % 16 == 0,
@@ -324,6 +341,24 @@ inline bool Mat::operator==(const Mat &m) const {
                 return false;
             }
         }
+    } else if (m.data_type == DataType::Half) {
+        FORZ(i, total()) {
+            const auto elem = static_cast<half_t *>(data)[i];
+            const auto m_elem = static_cast<half_t *>(m.data)[i];
+            if (elem != m_elem) {
+                PNT(i, half_to_float(elem), half_to_float(m_elem));
+                return false;
+            }
+        }
+    } else if (m.data_type == DataType::Int8) {
+        FORZ(i, total()) {
+            const int elem = static_cast<int8_t *>(data)[i];
+            const int m_elem = static_cast<int8_t *>(m.data)[i];
+            if (elem != m_elem) {
+                PNT(i, elem, m_elem);
+                return false;
+            }
+        }
     } else {
         throw std::invalid_argument("Unknown datatype");
     }
@@ -337,6 +372,18 @@ inline std::ostream &operator<<(std::ostream &os, const Mat &mat) {
         return os << binrep(static_cast<char *>(mat.data),
                             std::min(mat.total(), size_t{10}) * mat.elemsize,
                             true);
+    } else if (mat.data_type == DataType::Half) {
+        FORZ(i, std::min(mat.total(), size_t{10})) {
+            os << half_to_float(static_cast<const half_t *>(mat.data)[i])
+               << ", ";
+        }
+        return os;
+    } else if (mat.data_type == DataType::Int8) {
+        FORZ(i, std::min(mat.total(), size_t{10})) {
+            os << static_cast<int>(static_cast<const int8_t *>(mat.data)[i])
+               << ", ";
+        }
+        return os;
     } else {
         for (size_t i = 0;
              i < std::min(static_cast<decltype(mat.total())>(10), mat.total());
@@ -352,6 +399,7 @@ template <>
 inline void Mat::fill(float _v) {
     int size = total();
     float *ptr = (float *)data;
+    ncnn::observe_touch(data, size * sizeof(float));
 
 #if __ARM_NEON
     int nn = size >> 2;
@@ -399,6 +447,7 @@ template <>
 inline void Mat::fill(int _v) {
     int size = total();
     int *ptr = (int *)data;
+    ncnn::observe_touch(data, size * sizeof(int));
 
 #if __ARM_NEON
     int nn = size >> 2;
@@ -446,6 +495,7 @@ template <typename T>
 inline void Mat::fill(T _v) {
     int size = total();
     T *ptr = (T *)data;
+    ncnn::observe_touch(data, size * sizeof(T));
     for (int i = 0; i < size; i++) {
         ptr[i] = _v;
     }
@@ -478,7 +528,7 @@ inline void Mat::create(int _w, DataType _data_type) {
     release();
 
     data_type = _data_type;
-    elemsize = data_type == DataType::Float ? sizeof(float) : sizeof(uint64_t);
+    elemsize = data_type_size(data_type);
 
     dims = 1;
     n = 1;
@@ -500,7 +550,7 @@ inline void Mat::create(int _w, int _h, DataType _data_type) {
     release();
 
     data_type = _data_type;
-    elemsize = data_type == DataType::Float ? sizeof(float) : sizeof(uint64_t);
+    elemsize = data_type_size(data_type);
 
     dims = 2;
     n = 1;
@@ -523,7 +573,7 @@ inline void Mat::create(int _w, int _h, int _c, DataType _data_type) {
     release();
 
     data_type = _data_type;
-    elemsize = data_type == DataType::Float ? sizeof(float) : sizeof(uint64_t);
+    elemsize = data_type_size(data_type);
 
     dims = 3;
     n = 1;
@@ -548,7 +598,7 @@ inline void Mat::create(int _n, int _w, int _h, int _c, DataType _data_type,
     release();
 
     data_type = _data_type;
-    elemsize = data_type == DataType::Float ? sizeof(float) : sizeof(uint64_t);
+    elemsize = data_type_size(data_type);
 
     dims = 0;
     n = _n;
@@ -648,6 +698,17 @@ inline const float &Mat::operator[](int i) const {
 
 inline Mat Mat::flatten() { return Mat(total(), data, data_type); }
 
+inline Mat Mat::image(int i) const {
+    BNN_ASSERT(i >= 0 && i < n, i, n);
+    // require_align reproduces this hstep, both are w * c when w * c is
+    // aligned
+    auto *ptr = static_cast<char *>(data) + i * h * hstep * elemsize;
+    Mat m(1, w, h, data_type == DataType::Bit ? c * 64 : c, ptr, data_type,
+          hstep != static_cast<size_t>(w) * c);
+    m.name = name;
+    return m;
+}
+
 inline void Mat::dump(css &filename) {
     std::ofstream ofs(filename);
     FORZ(i, total()) { ofs << (*this)[i] << std::endl; }
@@ -0,0 +1,305 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#include "memory_trace.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <utility>
+
+#include <common/helper.h>
+
+namespace bnn {
+
+namespace {
+
+const char *kind_str(const MemoryTrace::Kind kind) {
+    switch (kind) {
+        case MemoryTrace::Kind::Alloc:
+            return "alloc";
+        case MemoryTrace::Kind::Free:
+            return "free";
+        case MemoryTrace::Kind::Scratch:
+            return "scratch";
+        case MemoryTrace::Kind::Touch:
+            return "touch";
+    }
+    return "";
+}
+
+std::string or_default(const std::string &s, const std::string &other) {
+    return s.empty() ? other : s;
+}
+
+std::string csv_field(const std::string &s) {
+    if (s.find_first_of(",\"\n") == std::string::npos) {
+        return s;
+    }
+    std::string quoted = "\"";
+    for (const char ch : s) {
+        quoted += ch;
+        if (ch == '"') {
+            quoted += ch;
+        }
+    }
+    return quoted + "\"";
+}
+
+double to_kb(const int64_t bytes) { return bytes / 1024.; }
+
+/**
+ * The number and the bytes of the events of every layer and blob, the most
+ * bytes first
+ */
+std::string group_table(const std::vector<MemoryTrace::Event> &events) {
+    std::map<std::pair<std::string, std::string>, std::pair<int64_t, int64_t>>
+        groups;
+    for (const auto &event : events) {
+        auto &group = groups[{event.layer, event.blob}];
+        group.first++;
+        group.second += event.bytes;
+    }
+    std::vector<std::pair<std::pair<std::string, std::string>,
+                          std::pair<int64_t, int64_t>>>
+        sorted(groups.begin(), groups.end());
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const decltype(sorted)::value_type &a,
+                        const decltype(sorted)::value_type &b) {
+                         return a.second.second > b.second.second;
+                     });
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1);
+    for (const auto &group : sorted) {
+        ss << "  " << std::right << std::setw(10) << to_kb(group.second.second)
+           << " KB in " << std::setw(4) << group.second.first << " x  "
+           << or_default(group.first.first, "(net)") << ": "
+           << or_default(group.first.second, "(unnamed)") << std::endl;
+    }
+    return ss.str();
+}
+
+std::string section(const std::string &title,
+                    const std::vector<MemoryTrace::Event> &events) {
+    if (events.empty()) {
+        return title + ": none\n";
+    }
+    return title + ":\n" + group_table(events);
+}
+
+}  // namespace
+
+MemoryTrace::Scope::Scope(MemoryTrace *trace, const bool run)
+    : trace_(trace), previous_(ncnn::memory_observer) {
+    if (trace_ == nullptr) {
+        return;
+    }
+    trace_->run_ = run ? trace_->runs_++ : -1;
+    trace_->layer_.clear();
+    ncnn::memory_observer = trace_;
+}
+
+MemoryTrace::Scope::~Scope() {
+    if (trace_ == nullptr) {
+        return;
+    }
+    trace_->layer_.clear();
+    ncnn::memory_observer = previous_;
+}
+
+MemoryTrace::MemoryTrace() : start_(Clock::now()) {}
+
+void MemoryTrace::record(const Kind kind, const void *ptr, const int64_t bytes,
+                         std::string blob) {
+    Event event;
+    event.kind = kind;
+    event.run = run_;
+    event.layer = layer_;
+    event.blob = std::move(blob);
+    event.ptr = ptr;
+    event.bytes = bytes;
+    event.live_bytes = live_bytes_;
+    event.time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        Clock::now() - start_)
+                        .count();
+    events_.push_back(std::move(event));
+}
+
+void MemoryTrace::on_alloc(const void *ptr, const size_t size,
+                           const char *name) {
+    if (ptr == nullptr) {
+        return;
+    }
+    const auto it = live_.find(ptr);
+    if (it != live_.end()) {
+        // Freed while the thread was not traced
+        live_bytes_ -= events_[it->second].bytes;
+        live_.erase(it);
+    }
+    live_bytes_ += static_cast<int64_t>(size);
+    live_[ptr] = events_.size();
+    record(Kind::Alloc, ptr, static_cast<int64_t>(size),
+           name == nullptr ? "" : name);
+}
+
+void MemoryTrace::on_free(const void *ptr) {
+    const auto it = live_.find(ptr);
+    if (it == live_.end()) {
+        // Allocated before the trace
+        return;
+    }
+    const auto &alloc = events_[it->second];
+    const auto bytes = alloc.bytes;
+    auto blob = alloc.blob;
+    live_bytes_ -= bytes;
+    live_.erase(it);
+    record(Kind::Free, ptr, bytes, std::move(blob));
+}
+
+void MemoryTrace::on_scratch(const size_t size, const char *name) {
+    live_bytes_ += static_cast<int64_t>(size);
+    record(Kind::Scratch, nullptr, static_cast<int64_t>(size), name);
+    live_bytes_ -= static_cast<int64_t>(size);
+}
+
+void MemoryTrace::on_touch(const void *ptr, const size_t size) {
+    const auto it = live_.find(ptr);
+    record(Kind::Touch, ptr, static_cast<int64_t>(size),
+           it == live_.end() ? "" : events_[it->second].blob);
+}
+
+void MemoryTrace::name(const void *ptr, const std::string &blob) {
+    const auto it = live_.find(ptr);
+    if (it == live_.end()) {
+        return;
+    }
+    for (size_t i = it->second; i < events_.size(); i++) {
+        if (events_[i].ptr == ptr) {
+            events_[i].blob = blob;
+        }
+    }
+}
+
+void MemoryTrace::clear() {
+    events_.clear();
+    live_.clear();
+    live_bytes_ = 0;
+    runs_ = 0;
+    start_ = Clock::now();
+}
+
+const MemoryTrace::Event *MemoryTrace::peak_event() const {
+    const Event *peak = nullptr;
+    for (const auto &event : events_) {
+        if (peak == nullptr || event.live_bytes > peak->live_bytes) {
+            peak = &event;
+        }
+    }
+    return peak;
+}
+
+int64_t MemoryTrace::peak_bytes() const {
+    const auto *peak = peak_event();
+    return peak == nullptr ? 0 : peak->live_bytes;
+}
+
+std::vector<MemoryTrace::Buffer> MemoryTrace::peak_buffers() const {
+    const auto *peak = peak_event();
+    if (peak == nullptr) {
+        return {};
+    }
+    // Replay the events up to the peak
+    std::map<const void *, const Event *> live;
+    for (const auto *event = events_.data(); event <= peak; event++) {
+        if (event->kind == Kind::Alloc) {
+            live[event->ptr] = event;
+        } else if (event->kind == Kind::Free) {
+            live.erase(event->ptr);
+        }
+    }
+    std::vector<Buffer> buffers;
+    for (const auto &kv : live) {
+        const auto &alloc = *kv.second;
+        buffers.push_back({alloc.blob, alloc.layer, alloc.run, alloc.bytes});
+    }
+    if (peak->kind == Kind::Scratch) {
+        buffers.push_back({peak->blob, peak->layer, peak->run, peak->bytes});
+    }
+    std::stable_sort(buffers.begin(), buffers.end(),
+                     [](const Buffer &a, const Buffer &b) {
+                         return a.bytes > b.bytes;
+                     });
+    return buffers;
+}
+
+std::vector<MemoryTrace::Event> MemoryTrace::run_allocations(
+    const int from_run) const {
+    std::vector<Event> allocations;
+    for (const auto &event : events_) {
+        if (event.run >= from_run &&
+            (event.kind == Kind::Alloc || event.kind == Kind::Scratch)) {
+            allocations.push_back(event);
+        }
+    }
+    return allocations;
+}
+
+std::string MemoryTrace::summary(const size_t max_buffers) const {
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1);
+    ss << "memory trace: " << events_.size() << " events over the prepare and "
+       << runs_ << " runs" << std::endl;
+    const auto *peak = peak_event();
+    if (peak == nullptr) {
+        return ss.str();
+    }
+    ss << "peak: " << to_kb(peak->live_bytes) << " KB in "
+       << (peak->run < 0 ? std::string("the prepare")
+                         : "run " + std::to_string(peak->run))
+       << " at " << or_default(peak->layer, "(net)") << ", the buffers alive:"
+       << std::endl;
+    const auto buffers = peak_buffers();
+    FORZ(i, std::min(buffers.size(), max_buffers)) {
+        const auto &buffer = buffers[i];
+        ss << "  " << std::right << std::setw(10) << to_kb(buffer.bytes)
+           << " KB  " << or_default(buffer.blob, "(unnamed)")
+           << ", allocated by " << or_default(buffer.layer, "(net)")
+           << (buffer.run < 0 ? "" : " in run " + std::to_string(buffer.run))
+           << std::endl;
+    }
+    if (buffers.size() > max_buffers) {
+        ss << "  and " << buffers.size() - max_buffers << " more" << std::endl;
+    }
+    if (runs_ == 0) {
+        return ss.str();
+    }
+    std::vector<Event> first_run, touches;
+    for (const auto &event : events_) {
+        if (event.run == 0 &&
+            (event.kind == Kind::Alloc || event.kind == Kind::Scratch)) {
+            first_run.push_back(event);
+        }
+        if (event.run == runs_ - 1 && event.kind == Kind::Touch) {
+            touches.push_back(event);
+        }
+    }
+    ss << section("allocations of the first run", first_run)
+       << section("allocations of the later runs (steady state)",
+                  run_allocations(1))
+       << section("filled by the last run", touches);
+    return ss.str();
+}
+
+std::string MemoryTrace::timeline_csv() const {
+    std::stringstream ss;
+    ss << "time_us,run,layer,event,blob,bytes,live_bytes" << std::endl;
+    ss << std::fixed << std::setprecision(3);
+    for (const auto &event : events_) {
+        ss << event.time_ns / 1e3 << "," << event.run << ","
+           << csv_field(event.layer) << "," << kind_str(event.kind) << ","
+           << csv_field(event.blob) << "," << event.bytes << ","
+           << event.live_bytes << std::endl;
+    }
+    return ss.str();
+}
+
+}  // namespace bnn
@@ -0,0 +1,126 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#ifndef BNN_MEMORY_TRACE_H
+#define BNN_MEMORY_TRACE_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "allocator.h"
+
+namespace bnn {
+
+/**
+ * Every allocation, free and fill of the buffers of a net over its prepare,
+ * reshapes and runs, recorded when Net::trace_memory is set. It finds the
+ * peak of the live memory with the buffers which make it up, and the
+ * allocations of the runs, which should be none after the first run.
+ *
+ * The buffers of Mat and the scratch of the net are traced. The std::vector
+ * scratch of the kernels is reported as a scratch event when it is created.
+ */
+class MemoryTrace : public ncnn::MemoryObserver {
+   public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Kind { Alloc, Free, Scratch, Touch };
+    struct Event {
+        Kind kind;
+        // -1 for prepare() and reshape(), otherwise the traced run
+        int run;
+        // The layer running or being planned, empty for the net itself
+        std::string layer;
+        // The name of the blob, the net scratch or the kernel scratch
+        std::string blob;
+        const void *ptr;
+        int64_t bytes;
+        // The bytes of the traced buffers alive after the event, and during
+        // it for a scratch
+        int64_t live_bytes;
+        int64_t time_ns;
+    };
+    /**
+     * A buffer alive at the peak
+     */
+    struct Buffer {
+        std::string blob;
+        std::string layer;
+        int run;
+        int64_t bytes;
+    };
+
+    /**
+     * Trace the calling thread until the scope ends, as a run or as the
+     * prepare when run is false. A null trace traces nothing.
+     */
+    class Scope {
+       public:
+        Scope(MemoryTrace *trace, bool run);
+        ~Scope();
+
+       private:
+        MemoryTrace *trace_;
+        ncnn::MemoryObserver *previous_;
+    };
+
+    MemoryTrace();
+
+    void set_layer(const std::string &layer) { layer_ = layer; }
+    /**
+     * Name the live buffer at ptr and the events of it so far
+     */
+    void name(const void *ptr, const std::string &blob);
+    void clear();
+
+    const std::vector<Event> &events() const { return events_; }
+    int runs() const { return runs_; }
+    int64_t live_bytes() const { return live_bytes_; }
+    int64_t peak_bytes() const;
+    /**
+     * The event at the peak, or nullptr if nothing is traced
+     */
+    const Event *peak_event() const;
+    /**
+     * The buffers alive at the peak, the largest first
+     */
+    std::vector<Buffer> peak_buffers() const;
+    /**
+     * The allocations and scratch of the runs from from_run on, the
+     * allocations of the steady state by default
+     */
+    std::vector<Event> run_allocations(int from_run = 1) const;
+
+    /**
+     * The peak, its buffers, the allocations of the runs and the bytes
+     * filled by the last run
+     */
+    std::string summary(size_t max_buffers = 10) const;
+    /**
+     * Every event with the live bytes after it, one line per event
+     */
+    std::string timeline_csv() const;
+
+    virtual void on_alloc(const void *ptr, size_t size, const char *name);
+    virtual void on_free(const void *ptr);
+    virtual void on_scratch(size_t size, const char *name);
+    virtual void on_touch(const void *ptr, size_t size);
+
+   private:
+    void record(Kind kind, const void *ptr, int64_t bytes, std::string blob);
+
+    std::vector<Event> events_;
+    // The traced buffers alive, and the index of the event allocating them
+    std::map<const void *, size_t> live_;
+    int64_t live_bytes_ = 0;
+    std::string layer_;
+    int run_ = -1;
+    int runs_ = 0;
+    Clock::time_point start_;
+};
+
+}  // namespace bnn
+
+#endif /* BNN_MEMORY_TRACE_H */
@@ -0,0 +1,238 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+#include <common/helper.h>
+#include "layer.h"
+
+namespace bnn {
+
+namespace {
+
+constexpr int kSubBuckets = 1 << Histogram::kSubBucketBits;
+// Up to the bucket of the largest int64_t value, whose highest bit is 62
+constexpr int kBuckets = (63 - Histogram::kSubBucketBits + 1) * kSubBuckets;
+
+double to_ms(const double ns) { return ns / 1e6; }
+
+std::string histogram_json(const Histogram &h) {
+    std::stringstream ss;
+    ss << "{\"count\": " << h.count() << ", \"mean\": " << h.mean()
+       << ", \"min\": " << h.min() << ", \"p50\": " << h.percentile(50.)
+       << ", \"p90\": " << h.percentile(90.)
+       << ", \"p99\": " << h.percentile(99.) << ", \"max\": " << h.max()
+       << ", \"buckets\": [";
+    const auto buckets = h.buckets();
+    FORZ(i, buckets.size()) {
+        ss << (i == 0 ? "" : ", ") << "[" << buckets[i].first << ", "
+           << buckets[i].second << "]";
+    }
+    ss << "]}";
+    return ss.str();
+}
+
+}  // namespace
+
+int Histogram::bucket(const int64_t value) {
+    const auto v = static_cast<uint64_t>(std::max<int64_t>(value, 0));
+    if (v < static_cast<uint64_t>(kSubBuckets)) {
+        return static_cast<int>(v);
+    }
+    // The top kSubBucketBits bits after the highest one pick the linear
+    // bucket within [2^e, 2^(e+1))
+    const int e = 63 - __builtin_clzll(v);
+    const int sub =
+        static_cast<int>(v >> (e - kSubBucketBits)) - kSubBuckets;
+    return (e - kSubBucketBits + 1) * kSubBuckets + sub;
+}
+
+int64_t Histogram::bucket_max(const int index) {
+    if (index < kSubBuckets) {
+        return index;
+    }
+    const int e = index / kSubBuckets + kSubBucketBits - 1;
+    const int sub = index % kSubBuckets;
+    const uint64_t width = uint64_t{1} << (e - kSubBucketBits);
+    const uint64_t lowest = static_cast<uint64_t>(kSubBuckets + sub)
+                            << (e - kSubBucketBits);
+    return static_cast<int64_t>(std::min<uint64_t>(
+        lowest + width - 1, std::numeric_limits<int64_t>::max()));
+}
+
+void Histogram::record(const int64_t value) {
+    if (counts_.empty()) {
+        counts_.resize(kBuckets);
+    }
+    counts_[bucket(value)]++;
+    min_ = count_ == 0 ? value : std::min(min_, value);
+    max_ = count_ == 0 ? value : std::max(max_, value);
+    count_++;
+    sum_ += value;
+}
+
+void Histogram::merge(const Histogram &other) {
+    if (other.count_ == 0) {
+        return;
+    }
+    if (counts_.empty()) {
+        counts_.resize(kBuckets);
+    }
+    FORZ(i, other.counts_.size()) { counts_[i] += other.counts_[i]; }
+    min_ = count_ == 0 ? other.min_ : std::min(min_, other.min_);
+    max_ = count_ == 0 ? other.max_ : std::max(max_, other.max_);
+    count_ += other.count_;
+    sum_ += other.sum_;
+}
+
+int64_t Histogram::percentile(const double p) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    const auto rank = std::max<int64_t>(
+        static_cast<int64_t>(std::ceil(p / 100. * count_)), 1);
+    int64_t seen = 0;
+    FORZ(i, counts_.size()) {
+        seen += counts_[i];
+        if (seen >= rank) {
+            return std::min(bucket_max(static_cast<int>(i)), max_);
+        }
+    }
+    return max_;
+}
+
+std::vector<std::pair<int64_t, int64_t>> Histogram::buckets() const {
+    std::vector<std::pair<int64_t, int64_t>> buckets;
+    FORZ(i, counts_.size()) {
+        if (counts_[i] != 0) {
+            buckets.emplace_back(bucket_max(static_cast<int>(i)), counts_[i]);
+        }
+    }
+    return buckets;
+}
+
+Metrics::Snapshot Metrics::snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return data_;
+}
+
+void Metrics::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    data_ = Snapshot();
+    started_.store(0, std::memory_order_relaxed);
+}
+
+bool Metrics::sample_next() {
+    if (sample_every <= 0) {
+        return false;
+    }
+    return started_.fetch_add(1, std::memory_order_relaxed) % sample_every ==
+           0;
+}
+
+void Metrics::record_run(const Clock::duration duration, const int images,
+                         const int64_t activation_bytes,
+                         const int64_t allocated_bytes) {
+    const int64_t ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+            .count();
+    std::lock_guard<std::mutex> lock(mutex_);
+    data_.runs++;
+    data_.images += images;
+    data_.latency_ns.record(ns);
+    data_.peak_activation_bytes =
+        std::max(data_.peak_activation_bytes, activation_bytes);
+    data_.run_allocated_bytes += allocated_bytes;
+}
+
+void Metrics::record_error() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    data_.errors++;
+}
+
+void Metrics::record_layers(const std::vector<std::shared_ptr<Layer>> &layers,
+                            const std::vector<int64_t> &layer_ns) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    data_.sampled_runs++;
+    auto &stats = data_.layers;
+    if (stats.size() < layers.size()) {
+        stats.resize(layers.size());
+    }
+    FORZ(i, layers.size()) {
+        auto &s = stats[i];
+        const auto &layer = *layers[i];
+        if (s.name != layer.name_ || s.type != layer.type_) {
+            // Another plan with other layers at this position
+            s = LayerStats();
+            s.index = static_cast<int>(i);
+            s.name = layer.name_;
+            s.type = layer.type_;
+        }
+        s.latency_ns.record(layer_ns[i]);
+    }
+}
+
+std::string Metrics::Snapshot::to_str() const {
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(3);
+    ss << "runs: " << runs << ", errors: " << errors << ", images: " << images
+       << std::endl;
+    ss << "latency(ms): mean " << to_ms(latency_ns.mean()) << ", p50 "
+       << to_ms(latency_ns.percentile(50.)) << ", p90 "
+       << to_ms(latency_ns.percentile(90.)) << ", p99 "
+       << to_ms(latency_ns.percentile(99.)) << ", max "
+       << to_ms(latency_ns.max()) << std::endl;
+    ss << "peak activation memory: " << peak_activation_bytes / 1024.
+       << " KB, allocated by the runs: " << run_allocated_bytes / 1024.
+       << " KB" << std::endl;
+    if (sampled_runs == 0) {
+        return ss.str();
+    }
+    ss << "layers of " << sampled_runs << " sampled runs:" << std::endl;
+    size_t name_width = 4;
+    for (const auto &layer : layers) {
+        name_width = std::max(name_width, layer.name.size());
+    }
+    ss << std::left << std::setw(6) << "index" << std::setw(name_width + 2)
+       << "name" << std::setw(16) << "type" << std::right << std::setw(10)
+       << "mean(ms)" << std::setw(10) << "p50(ms)" << std::setw(10)
+       << "p99(ms)" << std::setw(10) << "max(ms)" << std::endl;
+    for (const auto &layer : layers) {
+        const auto &h = layer.latency_ns;
+        ss << std::left << std::setw(6) << layer.index
+           << std::setw(name_width + 2) << layer.name << std::setw(16)
+           << layer.type << std::right << std::setw(10) << to_ms(h.mean())
+           << std::setw(10) << to_ms(h.percentile(50.)) << std::setw(10)
+           << to_ms(h.percentile(99.)) << std::setw(10) << to_ms(h.max())
+           << std::endl;
+    }
+    return ss.str();
+}
+
+std::string Metrics::Snapshot::to_json() const {
+    std::stringstream ss;
+    ss << std::setprecision(6);
+    ss << "{\"runs\": " << runs << ", \"errors\": " << errors
+       << ", \"images\": " << images
+       << ", \"latency_ns\": " << histogram_json(latency_ns)
+       << ", \"peak_activation_bytes\": " << peak_activation_bytes
+       << ", \"run_allocated_bytes\": " << run_allocated_bytes
+       << ", \"sampled_runs\": " << sampled_runs << ", \"layers\": [";
+    FORZ(i, layers.size()) {
+        const auto &layer = layers[i];
+        ss << (i == 0 ? "" : ", ") << "{\"index\": " << layer.index
+           << ", \"name\": \"" << json_escape(layer.name) << "\", \"type\": \""
+           << json_escape(layer.type)
+           << "\", \"latency_ns\": " << histogram_json(layer.latency_ns)
+           << "}";
+    }
+    ss << "]}";
+    return ss.str();
+}
+
+}  // namespace bnn
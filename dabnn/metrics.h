@@ -0,0 +1,129 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#ifndef BNN_METRICS_H
+#define BNN_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace bnn {
+
+class Layer;
+
+/**
+ * A histogram of non-negative values (e.g., durations in ns) with the
+ * buckets of HdrHistogram: every power of two is split into 2^kSubBucketBits
+ * linear buckets, so a percentile is within 1 / 2^kSubBucketBits of the
+ * recorded value. The buckets are allocated by the first record.
+ */
+class Histogram {
+   public:
+    static constexpr int kSubBucketBits = 3;
+
+    void record(int64_t value);
+    void merge(const Histogram &other);
+
+    int64_t count() const { return count_; }
+    int64_t sum() const { return sum_; }
+    int64_t min() const { return min_; }
+    int64_t max() const { return max_; }
+    double mean() const {
+        return count_ == 0 ? 0. : static_cast<double>(sum_) / count_;
+    }
+    /**
+     * The largest value of the bucket of the nearest rank p-th percentile,
+     * at most the max, or 0 for an empty histogram
+     */
+    int64_t percentile(double p) const;
+    /**
+     * The largest value and the count of every non-empty bucket
+     */
+    std::vector<std::pair<int64_t, int64_t>> buckets() const;
+
+    static int bucket(int64_t value);
+    static int64_t bucket_max(int index);
+
+   private:
+    std::vector<int64_t> counts_;
+    int64_t count_ = 0;
+    int64_t sum_ = 0;
+    int64_t min_ = 0;
+    int64_t max_ = 0;
+};
+
+/**
+ * The always-on metrics of the runs of a net, for monitoring in production.
+ * A run costs two clock reads and an uncontended lock, and every layer is
+ * also timed in 1 of sample_every runs. A snapshot can be taken from
+ * another thread while the net runs.
+ */
+class Metrics {
+   public:
+    using Clock = std::chrono::steady_clock;
+
+    struct LayerStats {
+        // The position of the layer in the net
+        int index = 0;
+        std::string name;
+        std::string type;
+        Histogram latency_ns;
+    };
+    struct Snapshot {
+        // The runs which returned, an image run or a batch run is one run
+        int64_t runs = 0;
+        // The runs which threw
+        int64_t errors = 0;
+        int64_t images = 0;
+        Histogram latency_ns;
+        int64_t sampled_runs = 0;
+        // Of the sampled runs
+        std::vector<LayerStats> layers;
+        // The bytes of the blobs and the scratch mats of the plan and the
+        // shared fp32 scratch, the largest of all runs
+        int64_t peak_activation_bytes = 0;
+        // The bytes of the mats allocated by the runs, which stays 0 when
+        // all blobs are allocated by the plans
+        int64_t run_allocated_bytes = 0;
+
+        std::string to_str() const;
+        std::string to_json() const;
+    };
+
+    /**
+     * Time every layer in 1 of sample_every runs, 0 for never. The first
+     * run is sampled.
+     */
+    int sample_every = 0;
+
+    Snapshot snapshot() const;
+    void clear();
+
+    /**
+     * Whether the run about to start should time its layers
+     */
+    bool sample_next();
+    void record_run(Clock::duration duration, int images,
+                    int64_t activation_bytes, int64_t allocated_bytes);
+    void record_error();
+    /**
+     * The times of the layers of a sampled run, layer_ns[i] of layers[i]
+     */
+    void record_layers(const std::vector<std::shared_ptr<Layer>> &layers,
+                       const std::vector<int64_t> &layer_ns);
+
+   private:
+    mutable std::mutex mutex_;
+    Snapshot data_;
+    // The runs started since the last clear, which clear() resets from
+    // another thread
+    std::atomic<int64_t> started_{0};
+};
+
+}  // namespace bnn
+
+#endif /* BNN_METRICS_H */
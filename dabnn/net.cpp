@@ -5,22 +5,30 @@
 #include <fcntl.h>
 #include <glog/logging.h>
 #include <sys/mman.h>
+#include <algorithm>
 #include <chrono>
+#include <string>
 #include <vector>
 
 #include <common/flatbuffers_helper.h>
 #include <common/macros.h>
 #include <dabnn/bitpack.h>
+#include <dabnn/qgemm.h>
+#include <dabnn/softmax.h>
 #include <dabnn/layers/Add.h>
 #include <dabnn/layers/Affine.h>
 #include <dabnn/layers/AvePool.h>
 #include <dabnn/layers/BinConv.h>
 #include <dabnn/layers/Binarize.h>
+#include <dabnn/layers/ClassifierHead.h>
 #include <dabnn/layers/Concat.h>
+#include <dabnn/layers/FC.h>
 #include <dabnn/layers/FloatConv.h>
 #include <dabnn/layers/MaxPool.h>
+#include <dabnn/layers/MultiBitConv.h>
 #include <dabnn/layers/Relu.h>
 #include <dabnn/layers/Shuffle.h>
+#include <dabnn/layers/Softmax.h>
 #include <dabnn/layers/Split.h>
 #include <dabnn/layers/PRelu.h>
 
@@ -29,6 +37,103 @@ using std::vector;
 
 namespace bnn {
 
+namespace {
+
+/**
+ * Resize a scratch vector of the net, and report it to the memory trace
+ * when it moves to a larger buffer
+ */
+template <typename T>
+void resize_traced(std::vector<T> &v, const size_t size, const char *name) {
+    const auto *old = v.data();
+    v.resize(size);
+    if (v.data() != old) {
+        ncnn::observe_free(old);
+        ncnn::observe_alloc(v.data(), v.capacity() * sizeof(T), name);
+    }
+}
+
+/**
+ * The blobs a layer of the model reads
+ */
+std::vector<std::string> layer_inputs(const flatbnn::Layer &layer) {
+    switch (layer.type()) {
+        case flatbnn::LayerType::FpConv2D:
+            return {layer.fp_conv2d_param()->input()->str()};
+        case flatbnn::LayerType::AvePool:
+            return {layer.avepool_param()->input()->str()};
+        case flatbnn::LayerType::MaxPool:
+            return {layer.maxpool_param()->input()->str()};
+        case flatbnn::LayerType::Relu:
+            return {layer.relu_param()->input()->str()};
+        case flatbnn::LayerType::Softmax:
+            return {layer.softmax_param()->input()->str()};
+        case flatbnn::LayerType::FC:
+            return {layer.fc_param()->input()->str()};
+        case flatbnn::LayerType::Add:
+            return {layer.add_param()->input1()->str(),
+                    layer.add_param()->input2()->str()};
+        case flatbnn::LayerType::Concat: {
+            std::vector<std::string> inputs;
+            for (const auto *input : *layer.concat_param()->inputs()) {
+                inputs.push_back(input->str());
+            }
+            return inputs;
+        }
+        case flatbnn::LayerType::BinConv2D:
+            return {layer.bin_conv2d_param()->input()->str()};
+        case flatbnn::LayerType::Affine:
+            return {layer.affine_param()->input()->str()};
+        case flatbnn::LayerType::Binarize:
+            return {layer.binarize_param()->input()->str()};
+        case flatbnn::LayerType::Split:
+            return {layer.split_param()->input()->str()};
+        case flatbnn::LayerType::Shuffle:
+            return {layer.shuffle_param()->input()->str()};
+        case flatbnn::LayerType::PRelu:
+            return {layer.prelu_param()->input()->str()};
+        case flatbnn::LayerType::MultiBitConv2D:
+            return {layer.multibit_conv2d_param()->input()->str()};
+    }
+    return {};
+}
+
+/**
+ * Point the activations at one image of the batch at a time, and back at the
+ * whole batch when the scope ends, even if a layer throws
+ */
+class ImageScope {
+   public:
+    ImageScope(const std::vector<Mat *> &activations,
+               std::vector<void *> &batch_data, const int batch)
+        : activations_(activations), batch_data_(batch_data), batch_(batch) {
+        FORZ(j, activations_.size()) { batch_data_[j] = activations_[j]->data; }
+    }
+
+    ~ImageScope() {
+        FORZ(j, activations_.size()) {
+            activations_[j]->n = batch_;
+            activations_[j]->data = batch_data_[j];
+        }
+    }
+
+    void select(const int i) {
+        FORZ(j, activations_.size()) {
+            auto &mat = *activations_[j];
+            mat.n = 1;
+            mat.data = static_cast<char *>(batch_data_[j]) +
+                       i * mat.h * mat.hstep * mat.elemsize;
+        }
+    }
+
+   private:
+    const std::vector<Mat *> &activations_;
+    std::vector<void *> &batch_data_;
+    const int batch_;
+};
+
+}  // namespace
+
 void Net::read(const std::string &path) {
     auto fd = open(path.c_str(), O_RDONLY);
     if (fd == -1) {
@@ -52,19 +157,14 @@ void Net::read_impl(const void *ptr) {
 }
 
 void Net::prepare() {
+    MemoryTrace::Scope trace_scope(memory_trace_if_set(), false);
     BNN_ASSERT(!(strict && !run_fconv), "fconv must be run in strict mode");
     BNN_ASSERT(model_->version() == BNN_LATEST_MODEL_VERSION,
                "The model version should be ", BNN_LATEST_MODEL_VERSION,
                ", got ", model_->version(), " instead.");
     for (const auto &tensor : *model_->inputs()) {
-        Shaper::Shape shape(tensor->shape()->begin(), tensor->shape()->end());
-        const auto name = tensor->name()->str();
-
-        shaper.AddShape(name, shape);
-        add_mat(name, std::make_shared<Mat>(shape[1], shape[2], shape[3],
-                                            bnn::DataType::Float));
-
-        input_name_ = name;
+        input_shape_.assign(tensor->shape()->begin(), tensor->shape()->end());
+        input_name_ = tensor->name()->str();
 
         break;
     }
@@ -133,7 +233,72 @@ void Net::prepare() {
                 add_mat(name, std::make_shared<Mat>(shape[0], buf->data(),
                                                     DataType::Float));
                 float_bufs_.push_back(buf);
+            } else if (shape.size() == 2) {
+                // fc weight
+                add_mat(name, std::make_shared<Mat>(
+                                  shape[0], 1, 1, shape[1],
+                                  const_cast<uint8_t *>(data),
+                                  bnn::DataType::Float, false));
             }
+        } else if (tensor->data_type() == flatbnn::DataType::Int8) {
+            Shaper::Shape shape(tensor->shape()->begin(),
+                                tensor->shape()->end());
+            auto *data = const_cast<int8_t *>(tensor->int8_data()->data());
+            const auto name = tensor->name()->str();
+            BNN_ASSERT(shape.size() == 4 || shape.size() == 2,
+                       "Only conv and fc weights can be int8, got ", shape);
+            BNN_ASSERT(tensor->scales() != nullptr &&
+                           tensor->scales()->size() == shape[0],
+                       "An int8 weight needs the scale of every output");
+
+            shaper.AddShape(name, shape);
+
+            if (shape.size() == 4) {
+                add_mat(name, std::make_shared<Mat>(shape[0], shape[1],
+                                                    shape[2], shape[3], data,
+                                                    DataType::Int8, false));
+            } else {
+                add_mat(name,
+                        std::make_shared<Mat>(shape[0], 1, 1, shape[1], data,
+                                              DataType::Int8, false));
+            }
+            add_mat(name + "_scales",
+                    std::make_shared<Mat>(
+                        shape[0],
+                        const_cast<float *>(tensor->scales()->data()),
+                        DataType::Float));
+        }
+    }
+
+    weight_map_ = mat_map_;
+    weight_shaper_ = shaper;
+    build_plan();
+}
+
+void Net::build_plan() {
+    mat_map_ = weight_map_;
+    shaper = weight_shaper_;
+    layers.clear();
+    activations_.clear();
+    blob_sources_.clear();
+    planning_layer_ = {"", "input", "Input"};
+
+    BNN_ASSERT(max_batch >= 1, max_batch);
+    // The shapes of all activations follow the batch of the input
+    batch_capacity_ = std::max<int>(max_batch, input_shape_[0]);
+    batch_ = batch_capacity_;
+    auto input_shape = input_shape_;
+    input_shape[0] = batch_capacity_;
+    shaper.AddShape(input_name_, input_shape);
+    add_activation(input_name_, input_shape, bnn::DataType::Float);
+    plan_half_activations();
+    plan_bit_activations();
+    input_readers_ = 0;
+    for (const auto *layer : *model_->layers()) {
+        const auto inputs = layer_inputs(*layer);
+        if (std::find(inputs.begin(), inputs.end(), input_name_) !=
+            inputs.end()) {
+            input_readers_++;
         }
     }
 
@@ -141,6 +306,11 @@ void Net::prepare() {
         VLOG(5) << layer_type_to_str(layer->type());
         const std::string name =
             layer->name() != nullptr ? layer->name()->str() : "";
+        planning_layer_ = {"", name, layer_type_to_str(layer->type())};
+        if (trace_memory) {
+            memory_trace.set_layer(
+                name.empty() ? layer_type_to_str(layer->type()) : name);
+        }
         switch (layer->type()) {
             case flatbnn::LayerType::FpConv2D: {
                 ADD_LAYER(fp_conv2d, Conv, input, strides, dilations, pads,
@@ -154,23 +324,35 @@ void Net::prepare() {
                                                    strides[1] == strides[3]),
                            strides);
 
+                BNN_ASSERT(
+                    dilations.size() == 2 && dilations[0] == dilations[1],
+                    dilations);
+
                 if (run_fconv) {
                     if (bias != "") {
                         layers.push_back(std::make_shared<FloatConv>(
                             get_weak(), name, input, weight, bias, output,
-                            pads[0], pads[1], strides[0], strides[1], 1));
+                            pads[0], pads[1], strides[0], strides[1],
+                            dilations[0]));
                     } else {
                         layers.push_back(std::make_shared<FloatConv>(
                             get_weak(), name, input, weight, output, pads[0],
-                            pads[1], strides[0], strides[1], 1));
+                            pads[1], strides[0], strides[1], dilations[0]));
+                    }
+                    if (mat_map_[weight]->data_type == DataType::Int8) {
+                        std::static_pointer_cast<FloatConv>(layers.back())
+                            ->set_int8_scale(param->int8_scale());
                     }
                 }
 
                 break;
             }
             case flatbnn::LayerType::BinConv2D: {
-                ADD_LAYER(bin_conv2d, Conv, input, strides, dilations, pads,
-                          weight, output);
+                // The output is float even if the input is fp16
+                ADD_LAYER_WITH_DATA_TYPE(bin_conv2d, GroupConv,
+                                         DataType::Float, input, strides,
+                                         dilations, pads, weight, group,
+                                         output);
                 BNN_ASSERT(pads.size() == 2 ||
                                (pads.size() == 4 && pads[0] == pads[2] &&
                                 pads[1] == pads[3]),
@@ -180,9 +362,45 @@ void Net::prepare() {
                                                    strides[1] == strides[3]),
                            strides);
 
+                BNN_ASSERT(dilations.size() == 2, dilations);
+
                 layers.push_back(std::make_shared<BinConv>(
                     get_weak(), name, input, weight, output, pads[0], pads[1],
-                    strides[0], strides[1]));
+                    strides[0], strides[1], dilations[0], dilations[1],
+                    group));
+                const auto scale = unpack_fbs(param->scale());
+                const auto offset = unpack_fbs(param->offset());
+                BNN_ASSERT(offset == "" || scale != "",
+                           "The offset of a binary conv needs a scale");
+                if (scale != "") {
+                    std::static_pointer_cast<BinConv>(layers.back())
+                        ->set_scale(mat_map_[scale],
+                                    offset == "" ? nullptr : mat_map_[offset]);
+                }
+                break;
+            }
+            case flatbnn::LayerType::MultiBitConv2D: {
+                // The output is float even if the input is fp16
+                ADD_LAYER_WITH_DATA_TYPE(multibit_conv2d, Conv,
+                                         DataType::Float, input, strides,
+                                         dilations, pads, weight, bias,
+                                         output);
+                BNN_ASSERT(pads.size() == 2 ||
+                               (pads.size() == 4 && pads[0] == pads[2] &&
+                                pads[1] == pads[3]),
+                           pads);
+                BNN_ASSERT(strides.size() == 2 || (strides.size() == 4 &&
+                                                   strides[0] == strides[2] &&
+                                                   strides[1] == strides[3]),
+                           strides);
+
+                BNN_ASSERT(dilations.size() == 2, dilations);
+
+                layers.push_back(std::make_shared<MultiBitConv>(
+                    get_weak(), name, input, weight, bias, output, pads[0],
+                    pads[1], strides[0], strides[1], dilations[0],
+                    dilations[1], param->weight_bits(),
+                    param->activation_bits(), param->activation_scale()));
                 break;
             }
             case flatbnn::LayerType::Affine: {
@@ -210,8 +428,12 @@ void Net::prepare() {
                 break;
             }
             case flatbnn::LayerType::MaxPool: {
-                ADD_LAYER(maxpool, Pool, input, strides, pads, kernel_shape,
-                          output);
+                // The sign of the max is the or of the signs
+                ADD_LAYER_WITH_DATA_TYPE(
+                    maxpool, Pool,
+                    bit_blobs_.count(output) > 0 ? DataType::Bit
+                                                 : mat_map_[input]->data_type,
+                    input, strides, pads, kernel_shape, output);
 
                 layers.push_back(std::make_shared<MaxPool>(
                     get_weak(), name, input, output, kernel_shape[0],
@@ -228,7 +450,12 @@ void Net::prepare() {
                 break;
             }
             case flatbnn::LayerType::Concat: {
-                ADD_LAYER(concat, Concat, inputs, axis, output);
+                ADD_LAYER_WITH_DATA_TYPE(
+                    concat, Concat,
+                    bit_concat(inputs, output)
+                        ? DataType::Bit
+                        : mat_map_[inputs[0]]->data_type,
+                    inputs, axis, output);
                 BNN_ASSERT(axis == 3, "");
 
                 layers.push_back(std::make_shared<Concat>(
@@ -260,6 +487,29 @@ void Net::prepare() {
                     std::make_shared<PRelu>(get_weak(), name, input, slope));
                 break;
             }
+            case flatbnn::LayerType::FC: {
+                ADD_LAYER(fc, FC, input, weight, bias, output);
+                layers.push_back(std::make_shared<FC>(get_weak(), name, input,
+                                                      weight, bias, output));
+                if (mat_map_[weight]->data_type == DataType::Int8) {
+                    std::static_pointer_cast<FC>(layers.back())
+                        ->set_int8_scale(param->int8_scale());
+                }
+                break;
+            }
+            case flatbnn::LayerType::Binarize: {
+                ADD_LAYER_WITH_DATA_TYPE(binarize, Binarize, DataType::Bit,
+                                         input, output);
+                layers.push_back(std::make_shared<Binarize>(get_weak(), name,
+                                                            input, output));
+                break;
+            }
+            case flatbnn::LayerType::Softmax: {
+                ADD_LAYER(softmax, Softmax, input, output);
+                layers.push_back(
+                    std::make_shared<Softmax>(get_weak(), name, input, output));
+                break;
+            }
             default: {
                 throw std::runtime_error("Not supported op " +
                                          layer_type_to_str(layer->type()));
@@ -267,32 +517,637 @@ void Net::prepare() {
             }
         }
     }
+    if (trace_memory) {
+        memory_trace.set_layer("");
+    }
+    if (optimize) {
+        fuse_float_conv_epilogue();
+        fuse_bin_conv_epilogue();
+        fuse_classifier_head();
+    }
+    plan_bytes_ = plan_bytes();
+    if (trace_memory) {
+        name_traced_blobs();
+    }
+}
+
+int64_t Net::plan_bytes() const {
+    // A mat shared by in-place layers is counted once
+    std::set<const void *> counted;
+    int64_t bytes = 0;
+    for (const auto &kv : mat_map_) {
+        const auto &mat = *kv.second;
+        if (weight_map_.has(kv.first) || mat.external_memory ||
+            mat.data == nullptr || !counted.insert(mat.data).second) {
+            continue;
+        }
+        bytes += static_cast<int64_t>(mat.total() * mat.elemsize);
+    }
+    return bytes;
+}
+
+void Net::plan_half_activations() {
+    half_blobs_.clear();
+#ifndef BNN_CHECK_CONSISTENCY
+    if (!half_activations) {
+        return;
+    }
+    // A blob written by an in-place layer is the blob of its input, which
+    // root maps it to
+    std::map<std::string, std::string> root;
+    const auto root_of = [&root](const std::string &name) {
+        const auto it = root.find(name);
+        return it == root.end() ? name : it->second;
+    };
+    // The outputs of binary convs, and whether all their readers take fp16
+    std::map<std::string, bool> candidates;
+    // The names read by a layer, before they are mapped to their root
+    std::set<std::string> read;
+    const auto add_reader = [&](const std::string &input,
+                                const bool takes_half) {
+        read.insert(input);
+        const auto blob = root_of(input);
+        const auto it = candidates.find(blob);
+        if (it != candidates.end() && !takes_half) {
+            it->second = false;
+        }
+    };
+    const auto alias = [&](const std::string &output,
+                           const std::string &input) {
+        root[output] = root_of(input);
+    };
+    for (const auto *layer : *model_->layers()) {
+        switch (layer->type()) {
+            case flatbnn::LayerType::BinConv2D: {
+                const auto *param = layer->bin_conv2d_param();
+                add_reader(param->input()->str(), true);
+                // Rows of 8 halves keep the rows of the blob aligned
+                const auto &weight_shape =
+                    weight_shaper_[param->weight()->str()];
+                candidates[param->output()->str()] = weight_shape[0] % 8 == 0;
+                break;
+            }
+            case flatbnn::LayerType::MultiBitConv2D:
+                add_reader(layer->multibit_conv2d_param()->input()->str(),
+                           true);
+                break;
+            case flatbnn::LayerType::Affine: {
+                const auto *param = layer->affine_param();
+                add_reader(param->input()->str(), true);
+                alias(param->output()->str(), param->input()->str());
+                break;
+            }
+            case flatbnn::LayerType::Relu: {
+                const auto *param = layer->relu_param();
+                add_reader(param->input()->str(), true);
+                alias(param->output()->str(), param->input()->str());
+                break;
+            }
+            case flatbnn::LayerType::PRelu: {
+                const auto *param = layer->prelu_param();
+                add_reader(param->input()->str(), true);
+                alias(param->output()->str(), param->input()->str());
+                break;
+            }
+            case flatbnn::LayerType::Add: {
+                const auto *param = layer->add_param();
+                add_reader(param->input1()->str(), true);
+                add_reader(param->input2()->str(), true);
+                alias(param->output()->str(), param->input1()->str());
+                break;
+            }
+            case flatbnn::LayerType::Binarize:
+                add_reader(layer->binarize_param()->input()->str(), true);
+                break;
+            case flatbnn::LayerType::Shuffle: {
+                const auto *param = layer->shuffle_param();
+                add_reader(param->input()->str(), false);
+                alias(param->output()->str(), param->input()->str());
+                break;
+            }
+            case flatbnn::LayerType::Concat: {
+                for (const auto *input : *layer->concat_param()->inputs()) {
+                    add_reader(input->str(), false);
+                }
+                break;
+            }
+            case flatbnn::LayerType::FpConv2D:
+                add_reader(layer->fp_conv2d_param()->input()->str(), false);
+                break;
+            case flatbnn::LayerType::MaxPool:
+                add_reader(layer->maxpool_param()->input()->str(), false);
+                break;
+            case flatbnn::LayerType::AvePool:
+                add_reader(layer->avepool_param()->input()->str(), false);
+                break;
+            case flatbnn::LayerType::Split:
+                add_reader(layer->split_param()->input()->str(), false);
+                break;
+            case flatbnn::LayerType::FC:
+                add_reader(layer->fc_param()->input()->str(), false);
+                break;
+            case flatbnn::LayerType::Softmax:
+                add_reader(layer->softmax_param()->input()->str(), false);
+                break;
+            default:
+                break;
+        }
+    }
+    // A name nobody reads is an output of the model, which is kept fp32,
+    // and so is the blob an in-place layer writes it into
+    std::set<std::string> outputs;
+    for (const auto &kv : root) {
+        if (read.count(kv.first) == 0) {
+            outputs.insert(kv.second);
+        }
+    }
+    for (const auto &kv : candidates) {
+        if (kv.second && read.count(kv.first) > 0 &&
+            outputs.count(kv.first) == 0) {
+            half_blobs_.insert(kv.first);
+        }
+    }
+#endif  // BNN_CHECK_CONSISTENCY
 }
 
-void Net::run(void *input) {
+void Net::plan_bit_activations() {
+    bit_blobs_.clear();
+#ifndef BNN_CHECK_CONSISTENCY
+    if (!optimize) {
+        return;
+    }
+    // The outputs of max pools and concats, and whether all their readers
+    // are binary convs with a multiple of 64 input channels
+    std::map<std::string, bool> candidates;
+    std::set<std::string> read;
+    const auto add_reader = [&](const std::string &input,
+                                const bool takes_bits) {
+        read.insert(input);
+        const auto it = candidates.find(input);
+        if (it != candidates.end() && !takes_bits) {
+            it->second = false;
+        }
+    };
+    for (const auto *layer : *model_->layers()) {
+        switch (layer->type()) {
+            case flatbnn::LayerType::BinConv2D: {
+                const auto *param = layer->bin_conv2d_param();
+                const auto &weight_shape =
+                    weight_shaper_[param->weight()->str()];
+                add_reader(param->input()->str(),
+                           Shaper::c(weight_shape) % 64 == 0);
+                break;
+            }
+            case flatbnn::LayerType::MaxPool: {
+                const auto *param = layer->maxpool_param();
+                add_reader(param->input()->str(), false);
+                candidates[param->output()->str()] = true;
+                break;
+            }
+            case flatbnn::LayerType::Concat: {
+                const auto *param = layer->concat_param();
+                for (const auto *input : *param->inputs()) {
+                    add_reader(input->str(), false);
+                }
+                candidates[param->output()->str()] = true;
+                break;
+            }
+            case flatbnn::LayerType::FpConv2D:
+                add_reader(layer->fp_conv2d_param()->input()->str(), false);
+                break;
+            case flatbnn::LayerType::MultiBitConv2D:
+                add_reader(layer->multibit_conv2d_param()->input()->str(),
+                           false);
+                break;
+            case flatbnn::LayerType::Affine:
+                add_reader(layer->affine_param()->input()->str(), false);
+                break;
+            case flatbnn::LayerType::Add:
+                add_reader(layer->add_param()->input1()->str(), false);
+                add_reader(layer->add_param()->input2()->str(), false);
+                break;
+            case flatbnn::LayerType::AvePool:
+                add_reader(layer->avepool_param()->input()->str(), false);
+                break;
+            case flatbnn::LayerType::Relu:
+                add_reader(layer->relu_param()->input()->str(), false);
+                break;
+            case flatbnn::LayerType::PRelu:
+                add_reader(layer->prelu_param()->input()->str(), false);
+                break;
+            case flatbnn::LayerType::Binarize:
+                add_reader(layer->binarize_param()->input()->str(), false);
+                break;
+            case flatbnn::LayerType::Shuffle:
+                add_reader(layer->shuffle_param()->input()->str(), false);
+                break;
+            case flatbnn::LayerType::Split:
+                add_reader(layer->split_param()->input()->str(), false);
+                break;
+            case flatbnn::LayerType::FC:
+                add_reader(layer->fc_param()->input()->str(), false);
+                break;
+            case flatbnn::LayerType::Softmax:
+                add_reader(layer->softmax_param()->input()->str(), false);
+                break;
+            default:
+                break;
+        }
+    }
+    // A blob nobody reads is an output of the model, which is kept float
+    for (const auto &kv : candidates) {
+        if (kv.second && read.count(kv.first) > 0) {
+            bit_blobs_.insert(kv.first);
+        }
+    }
+#endif  // BNN_CHECK_CONSISTENCY
+}
+
+bool Net::bit_concat(const std::vector<std::string> &inputs,
+                     const std::string &output) {
+    if (bit_blobs_.count(output) == 0) {
+        return false;
+    }
+    // Every input is packed into whole words of the output, the shapes of
+    // the inputs are only known when the concat is added
+    for (const auto &input : inputs) {
+        if (Shaper::c(shaper[input]) % 64 != 0) {
+            bit_blobs_.erase(output);
+            return false;
+        }
+    }
+    return true;
+}
+
+float *Net::float_scratch(const size_t len) {
+    if (float_scratch_.size() < len) {
+        resize_traced(float_scratch_, len, "float_scratch");
+    }
+    return float_scratch_.data();
+}
+
+void Net::reshape(int h, int w) {
+    BNN_ASSERT(h > 0 && w > 0, h, w);
+    BNN_ASSERT(model_ != nullptr, "Read the model first");
+    if (static_cast<int>(input_shape_[1]) == h &&
+        static_cast<int>(input_shape_[2]) == w) {
+        return;
+    }
+    MemoryTrace::Scope trace_scope(memory_trace_if_set(), false);
+    // Keep the current plan for a later reshape back to its resolution
+    plans_.emplace_front();
+    auto &current = plans_.front();
+    current.h = input_shape_[1];
+    current.w = input_shape_[2];
+    current.shaper = std::move(shaper);
+    current.mat_map = std::move(mat_map_);
+    current.layers = std::move(layers);
+    current.activations = std::move(activations_);
+    current.bytes = plan_bytes_;
+
+    input_shape_[1] = h;
+    input_shape_[2] = w;
+    const auto cached =
+        std::find_if(plans_.begin(), plans_.end(), [h, w](const Plan &plan) {
+            return plan.h == h && plan.w == w;
+        });
+    if (cached != plans_.end()) {
+        shaper = std::move(cached->shaper);
+        mat_map_ = std::move(cached->mat_map);
+        layers = std::move(cached->layers);
+        activations_ = std::move(cached->activations);
+        plan_bytes_ = cached->bytes;
+        plans_.erase(cached);
+        set_batch(batch_capacity_);
+    } else {
+        build_plan();
+    }
+    while (plans_.size() > max_cached_plans) {
+        plans_.pop_back();
+    }
+}
+
+void Net::fuse_float_conv_epilogue() {
+#ifndef BNN_CHECK_CONSISTENCY
+    // Fold the in-place affine (bn) and relu right after a float conv into
+    // the store of the conv output
+    std::vector<std::shared_ptr<Layer>> fused;
+    for (size_t i = 0; i < layers.size(); i++) {
+        fused.push_back(layers[i]);
+        const auto conv = std::dynamic_pointer_cast<FloatConv>(layers[i]);
+        if (conv == nullptr) {
+            continue;
+        }
+        if (i + 1 < layers.size()) {
+            const auto affine =
+                std::dynamic_pointer_cast<Affine>(layers[i + 1]);
+            if (affine != nullptr && affine->data_mat == conv->output_mat) {
+                conv->fuse_affine(affine->a_mat, affine->b_mat);
+                i++;
+            }
+        }
+        if (i + 1 < layers.size()) {
+            const auto relu = std::dynamic_pointer_cast<Relu>(layers[i + 1]);
+            if (relu != nullptr && relu->data_mat == conv->output_mat) {
+                conv->fuse_relu();
+                i++;
+            }
+        }
+    }
+    layers = fused;
+#endif  // BNN_CHECK_CONSISTENCY
+}
+
+void Net::fuse_bin_conv_epilogue() {
+#ifndef BNN_CHECK_CONSISTENCY
+    // Fold the in-place affine (bn) right after a binary conv into the
+    // scale of its popcount
+    std::vector<std::shared_ptr<Layer>> fused;
+    for (size_t i = 0; i < layers.size(); i++) {
+        fused.push_back(layers[i]);
+        const auto conv = std::dynamic_pointer_cast<BinConv>(layers[i]);
+        if (conv == nullptr || i + 1 == layers.size()) {
+            continue;
+        }
+        const auto affine = std::dynamic_pointer_cast<Affine>(layers[i + 1]);
+        if (affine != nullptr && affine->data_mat == conv->output_mat) {
+            conv->fuse_affine(affine->a_mat, affine->b_mat);
+            i++;
+        }
+    }
+    layers = fused;
+#endif  // BNN_CHECK_CONSISTENCY
+}
+
+void Net::fuse_classifier_head() {
+    // Global average pooling -> FC -> Softmax at the end of the net
+    if (layers.size() < 3) {
+        return;
+    }
+    const auto pool =
+        std::dynamic_pointer_cast<AvePool>(layers[layers.size() - 3]);
+    const auto fc = std::dynamic_pointer_cast<FC>(layers[layers.size() - 2]);
+    const auto softmax =
+        std::dynamic_pointer_cast<Softmax>(layers[layers.size() - 1]);
+    if (pool == nullptr || fc == nullptr || softmax == nullptr) {
+        return;
+    }
+    const auto &input = *pool->input_mat;
+    if (pool->kernel_h != input.h || pool->kernel_w != input.w ||
+        pool->pad_h != 0 || pool->pad_w != 0 ||
+        fc->input_mat != pool->output_mat ||
+        softmax->input_mat != fc->output_mat ||
+        input.data_type != DataType::Float) {
+        return;
+    }
+    const auto head = std::make_shared<ClassifierHead>(
+        get_weak(), softmax->name_, *pool, fc, *softmax);
+    layers.resize(layers.size() - 3);
+    layers.push_back(head);
+}
+
+void Net::run(void *input) { run(input, 1); }
+
+void Net::run(void *input, int batch) {
+    run_and_record(batch, [&]() { run_float(input, batch); });
+}
+
+void Net::run_and_record(const int batch, const std::function<void()> &run) {
+    MemoryTrace::Scope trace_scope(memory_trace_if_set(), true);
+    const auto allocated = ncnn::malloc_bytes;
+    const auto start = Metrics::Clock::now();
+    try {
+        run();
+    } catch (...) {
+        metrics.record_error();
+        throw;
+    }
+    const auto end = Metrics::Clock::now();
+    const auto scratch_bytes =
+        (float_scratch_.capacity() + uint8_input_buf_.capacity()) *
+        sizeof(float);
+    metrics.record_run(end - start, batch,
+                       plan_bytes_ + static_cast<int64_t>(scratch_bytes),
+                       static_cast<int64_t>(ncnn::malloc_bytes - allocated));
+}
+
+void Net::run_float(void *input, int batch) {
     BNN_ASSERT(!(strict && !run_fconv), "fconv must be run in strict mode");
     uint64_t t = 0;
 
+    set_batch(batch);
     mat_map_[input_name_]->external_memory = true;
     mat_map_[input_name_]->data = input;
 
+    run_layers();
+
+    VLOG(2) << "t = " << t;
+    VLOG(2) << "-------";
+}
+
+void Net::run(const uint8_t *input) { run(input, 1); }
+
+void Net::run(const uint8_t *input, int batch) {
+    run_and_record(batch, [&]() { run_uint8(input, batch); });
+}
+
+void Net::run_uint8(const uint8_t *input, int batch) {
+    BNN_ASSERT(!(strict && !run_fconv), "fconv must be run in strict mode");
+    set_batch(batch);
+    const auto &input_mat = mat_map_[input_name_];
+    const int c = input_mat->c;
+    BNN_ASSERT(input_mean.size() == static_cast<size_t>(c) &&
+                   input_std.size() == static_cast<size_t>(c),
+               "input_mean and input_std should have ", c, " values");
+    input_scale_.resize(c);
+    FORZ(i, c) { input_scale_[i] = 1.f / input_std[i]; }
+
+    std::shared_ptr<FloatConv> stem;
+    if (!layers.empty()) {
+        stem = std::dynamic_pointer_cast<FloatConv>(layers[0]);
+    }
+    // The float input is calibrated rather than the uint8 image
+    if (optimize && !calibrate_int8 && stem != nullptr &&
+        stem->input_mat == input_mat && input_readers_ == 1) {
+        stem->uint8_input = input;
+        stem->input_mean = input_mean.data();
+        stem->input_scale = input_scale_.data();
+        run_layers();
+        stem->uint8_input = nullptr;
+        return;
+    }
+
+    // The images are contiguous in both buffers, so their rows are
+    // converted as the rows of one tall image
+    resize_traced(uint8_input_buf_, batch * input_mat->h * input_mat->hstep,
+                  "uint8_input_buf");
+    FORZ(h, batch * input_mat->h) {
+        FORZ(i, input_mat->w * c) {
+            uint8_input_buf_[h * input_mat->hstep + i] =
+                (input[h * input_mat->w * c + i] - input_mean[i % c]) *
+                input_scale_[i % c];
+        }
+    }
+    run_float(uint8_input_buf_.data(), batch);
+}
+
+void Net::set_batch(int batch) {
+    BNN_ASSERT(batch >= 1 && batch <= batch_capacity_,
+               "The batch should be in [1, ", batch_capacity_, "], got ",
+               batch);
+    batch_ = batch;
+    for (auto *mat : activations_) {
+        mat->n = batch;
+    }
+    resize_traced(batch_data_, activations_.size(), "batch_data");
+}
+
+void Net::run_layers() {
+    if (profile) {
+        // A layer is timed over all the images of the batch
+        auto *counters = perf_counters();
+        const auto run_start = Profiler::Clock::now();
+        FORZ(i, layers.size()) {
+            const auto start = Profiler::Clock::now();
+            if (counters == nullptr) {
+                run_layer(layers[i]);
+                profiler.record(layers[i], static_cast<int>(i), start,
+                                Profiler::Clock::now());
+                continue;
+            }
+            counters->start();
+            run_layer(layers[i]);
+            const auto values = counters->stop();
+            profiler.record(layers[i], static_cast<int>(i), start,
+                            Profiler::Clock::now(), &values);
+        }
+        profiler.record_run(run_start, Profiler::Clock::now());
+        return;
+    }
+    if (metrics.sample_next()) {
+        layer_ns_.resize(layers.size());
+        FORZ(i, layers.size()) {
+            const auto start = Metrics::Clock::now();
+            run_layer(layers[i]);
+            const auto duration = Metrics::Clock::now() - start;
+            layer_ns_[i] =
+                std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+                    .count();
+        }
+        metrics.record_layers(layers, layer_ns_);
+        return;
+    }
     for (const auto &layer : layers) {
-        VLOG(5) << layer->to_str();
+        run_layer(layer);
+    }
+}
+
+PerfCounters *Net::perf_counters() {
+    if (!profile_counters) {
+        return nullptr;
+    }
+    if (perf_counters_ == nullptr) {
+        perf_counters_.reset(new PerfCounters());
+        if (!perf_counters_->error().empty()) {
+            LOG(WARNING) << "Some hardware counters are not available: "
+                         << perf_counters_->error();
+        }
+    }
+    return perf_counters_->available() ? perf_counters_.get() : nullptr;
+}
+
+void Net::run_layer(const std::shared_ptr<Layer> &layer) {
+    VLOG(5) << layer->to_str();
+    if (trace_memory) {
+        memory_trace.set_layer(layer->name_.empty() ? layer->type_
+                                                    : layer->name_);
+    }
+    if (batch_ == 1 || layer->batch_aware()) {
+        layer->forward();
+        return;
+    }
+    ImageScope scope(activations_, batch_data_, batch_);
+    FORZ(i, batch_) {
+        scope.select(i);
         layer->forward();
     }
+}
 
-    VLOG(2) << "t = " << t;
-    VLOG(2) << "-------";
+void Net::record_int8_range(const std::string &name, const Mat &input) {
+    BNN_ASSERT(input.data_type == DataType::Float, "Only float inputs");
+    float range = 0.f;
+    FORZ(i, input.n * input.h) {
+        range = std::max(range,
+                         max_abs(static_cast<const float *>(input.data) +
+                                     i * input.hstep,
+                                 input.w * input.c));
+    }
+    auto &recorded = int8_ranges[name];
+    recorded = std::max(recorded, range);
+}
+
+MemoryTrace *Net::memory_trace_if_set() {
+    return trace_memory ? &memory_trace : nullptr;
+}
+
+void Net::name_traced_blobs() {
+    for (const auto &kv : mat_map_) {
+        if (kv.second != nullptr && !kv.second->external_memory) {
+            memory_trace.name(kv.second->data, kv.first);
+        }
+    }
 }
 
 std::shared_ptr<Mat> Net::get_blob(const std::string &name) {
     return mat_map_.at(name);
 }
 
+std::vector<std::pair<int, float>> Net::top_k(const std::string &name,
+                                              const int k, const int image) {
+    const auto &blob = *get_blob(name);
+    BNN_ASSERT(blob.data_type == DataType::Float, "Only float blobs");
+    BNN_ASSERT(blob.h * blob.w == 1, "Only blobs with one pixel");
+    BNN_ASSERT(image >= 0 && image < blob.n, image, blob.n);
+    return bnn::top_k(static_cast<const float *>(blob) + image * blob.hstep,
+                      blob.c, k);
+}
+
 void Net::add_mat(const std::string &name, std::shared_ptr<Mat> mat) {
     mat_map_[name] = mat;
 }
 
+void Net::add_activation(const std::string &name, const Shaper::Shape &shape,
+                         DataType data_type) {
+    if (data_type == DataType::Float && half_blobs_.count(name) > 0) {
+        data_type = DataType::Half;
+    }
+    // The shape is nhwc, while the w of Mat comes before its h
+    std::shared_ptr<Mat> mat;
+    if (shape[0] == 1) {
+        mat = std::make_shared<Mat>(shape[2], shape[1], shape[3], data_type,
+                                    name);
+    } else {
+        // The images follow each other without a gap, a blob like the
+        // output of fc has rows that are not aligned
+        const size_t row_elems = shape[2] * shape[3];
+        const size_t row_bytes = data_type == DataType::Bit
+                                     ? row_elems / 8
+                                     : row_elems * data_type_size(data_type);
+        mat = std::make_shared<Mat>(shape[0], shape[2], shape[1], shape[3],
+                                    data_type, row_bytes % 16 == 0);
+        mat->name = name;
+    }
+    activations_.push_back(mat.get());
+    blob_sources_.push_back(
+        {name, planning_layer_.layer, planning_layer_.type});
+    add_mat(name, mat);
+}
+
+void Net::add_weight(const std::string &name, std::shared_ptr<Mat> mat) {
+    weight_map_[name] = mat;
+    add_mat(name, mat);
+}
+
 std::weak_ptr<Net> Net::get_weak() { return shared_from_this(); }
 
 std::shared_ptr<Net> Net::create() {
@@ -3,8 +3,13 @@
 #ifndef BNN_NET_H
 #define BNN_NET_H
 
+#include <functional>
+#include <list>
 #include <map>
 #include <memory>
+#include <set>
+#include <utility>
+#include <vector>
 
 #include <common/Shaper.h>
 #include <common/dab_generated.h>
@@ -13,12 +18,28 @@
 #include <dabnn/layers/Affine.h>
 #include <dabnn/layers/AvePool.h>
 #include <dabnn/layers/BinConv.h>
+#include <dabnn/layers/FC.h>
 #include <dabnn/layers/FloatConv.h>
 #include <dabnn/layers/MaxPool.h>
 #include "layer.h"
 #include "mat.h"
+#include "memory_trace.h"
+#include "metrics.h"
+#include "profiler.h"
 
 namespace bnn {
+/**
+ * An activation and the layer of the model which allocates it, i.e., the
+ * first layer writing it
+ */
+struct BlobSource {
+    std::string blob;
+    // The name and the type of the layer in the model, "input" for the
+    // input
+    std::string layer;
+    std::string type;
+};
+
 class Net : public std::enable_shared_from_this<Net> {
    private:
 #ifdef BNN_BENCHMARK
@@ -27,6 +48,64 @@ class Net : public std::enable_shared_from_this<Net> {
     StrKeyMap<std::shared_ptr<Mat>> mat_map_;
     Shaper shaper;
     void add_mat(const std::string &name, std::shared_ptr<Mat> mat);
+    /**
+     * Add the blob of an activation, which holds batch_capacity_ images
+     */
+    void add_activation(const std::string &name, const Shaper::Shape &shape,
+                        DataType data_type);
+    /**
+     * Add a mat derived from the weights (e.g. a packed weight), which is
+     * shared by the plans of all resolutions
+     */
+    void add_weight(const std::string &name, std::shared_ptr<Mat> mat);
+    // The activations, whose n is the batch of the current run
+    std::vector<Mat *> activations_;
+    // The data of the activations while run_layer points them at one image
+    std::vector<void *> batch_data_;
+    // The layer being planned, which add_activation records as the source
+    // of the blobs it adds
+    BlobSource planning_layer_;
+    std::vector<BlobSource> blob_sources_;
+    int batch_capacity_ = 1;
+    int batch_ = 1;
+
+    /**
+     * The shapes, blobs and layers of an input resolution
+     */
+    struct Plan {
+        int h;
+        int w;
+        Shaper shaper;
+        StrKeyMap<std::shared_ptr<Mat>> mat_map;
+        std::vector<std::shared_ptr<Layer>> layers;
+        std::vector<Mat *> activations;
+        int64_t bytes;
+    };
+    // The weights and their shapes, which every plan starts from
+    StrKeyMap<std::shared_ptr<Mat>> weight_map_;
+    Shaper weight_shaper_;
+    // The nhwc input shape of the current plan
+    Shaper::Shape input_shape_;
+    // The plans of the previous resolutions, the most recently used first
+    std::list<Plan> plans_;
+    void build_plan();
+    // The bytes of the blobs and the scratch mats of the current plan
+    int64_t plan_bytes_ = 0;
+    int64_t plan_bytes() const;
+    // The blobs stored as fp16 when half_activations is set
+    std::set<std::string> half_blobs_;
+    void plan_half_activations();
+    // The outputs of max pools and concats only read by binary convs, which
+    // are stored as bits when optimize is set
+    std::set<std::string> bit_blobs_;
+    void plan_bit_activations();
+    // Whether the concat writing output stores bits, which needs a multiple
+    // of 64 channels in every input
+    bool bit_concat(const std::vector<std::string> &inputs,
+                    const std::string &output);
+    // fp32 scratch of the layers writing fp16 blobs, shared by all of them
+    std::vector<float> float_scratch_;
+    float *float_scratch(size_t len);
     // The lifecycle of float_bufs_ is the same as Net object
     std::vector<std::shared_ptr<std::vector<float>>> float_bufs_;
     std::vector<std::shared_ptr<Layer>> layers;
@@ -44,21 +123,150 @@ class Net : public std::enable_shared_from_this<Net> {
     friend class AvePool;
     friend class MaxPool;
     friend class FloatConv;
+    friend class MultiBitConv;
     friend class Affine;
     friend class Add;
+    friend class FC;
+
+    // The layers of the model reading the input, a stem conv normalizes a
+    // uint8 image itself only if it is the one reader
+    int input_readers_ = 0;
+    // 1 / input_std of the uint8 input
+    std::vector<float> input_scale_;
+    std::vector<float> uint8_input_buf_;
+
+    void set_batch(int batch);
+    /**
+     * Call run and record it into metrics
+     */
+    void run_and_record(int batch, const std::function<void()> &run);
+    void run_float(void *input, int batch);
+    void run_uint8(const uint8_t *input, int batch);
+    void run_layers();
+    // The times of the layers of a run sampled by metrics
+    std::vector<int64_t> layer_ns_;
+    void run_layer(const std::shared_ptr<Layer> &layer);
+    MemoryTrace *memory_trace_if_set();
+    // Name the buffers of the blobs of the plan in memory_trace
+    void name_traced_blobs();
+    // Opened by the first run with profile_counters
+    std::unique_ptr<PerfCounters> perf_counters_;
+    PerfCounters *perf_counters();
+    void fuse_float_conv_epilogue();
+    void fuse_bin_conv_epilogue();
+    void fuse_classifier_head();
+    void record_int8_range(const std::string &name, const Mat &input);
 
    public:
     void read(const std::string &path);
     void read_buf(const void *ptr);
     void prepare();
+    /**
+     * Change the h and w of the input. The shapes, blobs and layers are
+     * planned again for them, while the weights and the data packed from
+     * them are kept. The plans of the last max_cached_plans resolutions are
+     * kept as well, so alternating between them does not plan again.
+     */
+    void reshape(int h, int w);
     void run(void *input);
+    /**
+     * Run on batch NHWC images stored one after another, batch is at most
+     * the capacity given by max_batch. The blobs hold the batch images after
+     * it.
+     */
+    void run(void *input, int batch);
+    /**
+     * Run on an NHWC uint8 image, (v - input_mean[c]) / input_std[c] is the
+     * float input of the model. When the optimized net starts with a float
+     * conv that is the only reader of the input, the conv normalizes the
+     * image while packing it. Otherwise the image is converted to the float
+     * input first.
+     */
+    void run(const uint8_t *input);
+    void run(const uint8_t *input, int batch);
     static std::shared_ptr<Net> create();
-    const flatbnn::Model *model_;
+    const flatbnn::Model *model_ = nullptr;
 
     std::shared_ptr<Mat> get_blob(const std::string &name);
+    /**
+     * The activations in the order of the layers allocating them, the
+     * input first. A blob written in place (e.g., by bn, relu or a
+     * residual add) is listed once, at the layer allocating it.
+     */
+    const std::vector<BlobSource> &blob_sources() const {
+        return blob_sources_;
+    }
+    /**
+     * The layers of the current plan, after the fusions of optimize
+     */
+    const std::vector<std::shared_ptr<Layer>> &get_layers() const {
+        return layers;
+    }
+    /**
+     * The k largest values of a blob as (index, value) pairs, e.g., the top-k
+     * classes of the softmax output
+     */
+    std::vector<std::pair<int, float>> top_k(const std::string &name,
+                                             const int k, const int image = 0);
     bool optimize = true;
+    /**
+     * The largest batch of run(), set before reading the model. The blobs
+     * are allocated for it (or for the batch of the model input if it is
+     * larger). Convs fold the images into the pixel dimension of their
+     * gemm, the other layers run once per image.
+     */
+    int max_batch = 1;
+    size_t max_cached_plans = 4;
+    /**
+     * Store the float blobs between binary convs (the output of a binary
+     * conv, the in-place bn, relu and residual add on it) as fp16, set
+     * before reading the model. It halves their memory traffic, all
+     * arithmetic stays fp32. The other blobs (e.g. the model output) are
+     * fp32.
+     */
+    bool half_activations = false;
+    /**
+     * Record the largest |x| of the float input of every float conv and fc
+     * into int8_ranges, keyed by the output of the layer. The ranges of the
+     * float model over calibration images give onnx2bnn the input scales of
+     * its int8 layers.
+     */
+    bool calibrate_int8 = false;
+    std::map<std::string, float> int8_ranges;
+    /**
+     * Record the time of every layer of every run into profiler, it can be
+     * switched on and off between runs. The table of profiler tells the
+     * slowest layers and its Chrome trace shows the runs on a timeline.
+     */
+    bool profile = false;
+    /**
+     * Also read the hardware counters (cycles, instructions, cache and
+     * branch misses) of every layer when profile is set. It needs Linux and
+     * a perf_event_paranoid that permits it, otherwise a warning is logged
+     * and only the time is recorded.
+     */
+    bool profile_counters = false;
+    Profiler profiler;
+    /**
+     * The runs, the errors, the latency and the memory of all runs, and the
+     * latency of every layer in 1 of metrics.sample_every runs. They are
+     * always recorded, and metrics.snapshot() reads them while the net runs
+     * in another thread.
+     */
+    Metrics metrics;
+    /**
+     * Record every allocation, free and fill of the buffers of the net into
+     * memory_trace, set before reading the model to trace the prepare as
+     * well. memory_trace.summary() tells the peak memory with the blobs
+     * which make it up and the allocations of the steady-state runs, and
+     * memory_trace.timeline_csv() the live memory over time.
+     */
+    bool trace_memory = false;
+    MemoryTrace memory_trace;
     bool run_fconv = true;
     bool strict = true;
+    std::vector<float> input_mean;
+    std::vector<float> input_std;
 
 #ifdef BNN_BENCHMARK
     void print_time();
@@ -0,0 +1,177 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#include "perf_counters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif  // __linux__
+
+#include <cerrno>
+#include <cstring>
+
+namespace bnn {
+
+#ifdef __linux__
+namespace {
+
+perf_event_attr counter_attr(const PerfCounters::Counter counter) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.disabled = 1;
+    // User space only, which perf_event_paranoid 2 still allows
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    const auto cache = [&attr](const uint64_t id, const uint64_t op) {
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = id | (op << 8) |
+                      (static_cast<uint64_t>(PERF_COUNT_HW_CACHE_RESULT_MISS)
+                       << 16);
+    };
+    switch (counter) {
+        case PerfCounters::kCycles:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PerfCounters::kInstructions:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PerfCounters::kL1dMisses:
+            cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ);
+            break;
+        case PerfCounters::kLlcMisses:
+            cache(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ);
+            break;
+        case PerfCounters::kBranchMisses:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        default:
+            break;
+    }
+    return attr;
+}
+
+}  // namespace
+#endif  // __linux__
+
+PerfCounters::PerfCounters() {
+    fds_.fill(-1);
+    grouped_.fill(false);
+#ifdef __linux__
+    const auto open = [](perf_event_attr &attr, const int group_fd) {
+        return static_cast<int>(
+            syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0));
+    };
+    for (int i = 0; i < kNumCounters; i++) {
+        const auto counter = static_cast<Counter>(i);
+        auto attr = counter_attr(counter);
+        const int leader = fds_[kCycles];
+        if (counter != kCycles && leader >= 0) {
+            // The group is scheduled together and follows its leader
+            attr.disabled = 0;
+            fds_[i] = open(attr, leader);
+            grouped_[i] = fds_[i] >= 0;
+            if (fds_[i] < 0) {
+                // e.g. the PMU cannot count it together with the others
+                attr.disabled = 1;
+            }
+        }
+        if (fds_[i] < 0) {
+            fds_[i] = open(attr, -1);
+        }
+        if (fds_[i] < 0) {
+            error_ += std::string(error_.empty() ? "" : ", ") + name(counter) +
+                      ": " + strerror(errno);
+        }
+    }
+#else
+    error_ = "perf_event_open is only on Linux";
+#endif  // __linux__
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+    for (const int fd : fds_) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+#endif  // __linux__
+}
+
+bool PerfCounters::available() const {
+    for (const int fd : fds_) {
+        if (fd >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *PerfCounters::name(const Counter counter) {
+    switch (counter) {
+        case kCycles:
+            return "cycles";
+        case kInstructions:
+            return "instructions";
+        case kL1dMisses:
+            return "L1D misses";
+        case kLlcMisses:
+            return "LLC misses";
+        case kBranchMisses:
+            return "branch misses";
+        default:
+            return "";
+    }
+}
+
+void PerfCounters::start() {
+#ifdef __linux__
+    for (int i = 0; i < kNumCounters; i++) {
+        if (fds_[i] >= 0 && !grouped_[i]) {
+            const int flags = i == kCycles ? PERF_IOC_FLAG_GROUP : 0;
+            ioctl(fds_[i], PERF_EVENT_IOC_RESET, flags);
+            ioctl(fds_[i], PERF_EVENT_IOC_ENABLE, flags);
+        }
+    }
+#endif  // __linux__
+}
+
+PerfCounters::Values PerfCounters::stop() {
+    Values values;
+    values.fill(-1);
+#ifdef __linux__
+    for (int i = 0; i < kNumCounters; i++) {
+        if (fds_[i] >= 0 && !grouped_[i]) {
+            ioctl(fds_[i], PERF_EVENT_IOC_DISABLE,
+                  i == kCycles ? PERF_IOC_FLAG_GROUP : 0);
+        }
+    }
+    for (int i = 0; i < kNumCounters; i++) {
+        if (fds_[i] < 0) {
+            continue;
+        }
+        // value, time enabled and time running
+        uint64_t buf[3];
+        if (read(fds_[i], buf, sizeof(buf)) != sizeof(buf) || buf[2] == 0) {
+            // Never scheduled on the cpu, e.g. all taken by other events
+            continue;
+        }
+        values[i] = static_cast<int64_t>(buf[0]);
+        if (buf[2] < buf[1]) {
+            values[i] = static_cast<int64_t>(static_cast<double>(buf[0]) *
+                                             buf[1] / buf[2]);
+        }
+    }
+#endif  // __linux__
+    return values;
+}
+
+}  // namespace bnn
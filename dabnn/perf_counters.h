@@ -0,0 +1,60 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#ifndef BNN_PERF_COUNTERS_H
+#define BNN_PERF_COUNTERS_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace bnn {
+
+/**
+ * The hardware counters of the calling thread in user space, read with
+ * perf_event_open on Linux. A counter the kernel or the cpu refuses (e.g.,
+ * by perf_event_paranoid or in a VM) reads -1, the others still count.
+ *
+ * The counters are one group led by cycles, so they count over the same
+ * time and their ratios hold when the kernel multiplexes them.
+ */
+class PerfCounters {
+   public:
+    enum Counter {
+        kCycles = 0,
+        kInstructions,
+        kL1dMisses,
+        kLlcMisses,
+        kBranchMisses,
+        kNumCounters
+    };
+    using Values = std::array<int64_t, kNumCounters>;
+
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    // Whether any counter is open
+    bool available() const;
+    // Why the counters are not open, empty if all of them are
+    const std::string &error() const { return error_; }
+    static const char *name(Counter counter);
+
+    void start();
+    /**
+     * The counts since start(), scaled up if the counters were multiplexed,
+     * and -1 for a counter which was never scheduled
+     */
+    Values stop();
+
+   private:
+    std::array<int, kNumCounters> fds_;
+    // Whether the counter is in the group of cycles, which starts and stops
+    // it
+    std::array<bool, kNumCounters> grouped_;
+    std::string error_;
+};
+
+}  // namespace bnn
+
+#endif /* BNN_PERF_COUNTERS_H */
@@ -0,0 +1,237 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <common/helper.h>
+#include "layer.h"
+
+namespace bnn {
+
+namespace {
+
+double to_ms(const int64_t ns) { return static_cast<double>(ns) / 1e6; }
+
+/**
+ * num / den, or "-" if a counter was refused
+ */
+std::string ratio(const int64_t num, const int64_t den, const double scale) {
+    if (num < 0 || den <= 0) {
+        return "-";
+    }
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(3)
+       << scale * static_cast<double>(num) / static_cast<double>(den);
+    return ss.str();
+}
+
+/**
+ * The work done per ns, i.e., per second in G
+ */
+std::string rate(const int64_t work, const int64_t calls,
+                 const int64_t total_ns) {
+    return work == 0 ? "-" : ratio(work * calls, total_ns, 1.);
+}
+
+}  // namespace
+
+Profiler::Profiler() : origin_(Clock::now()) {}
+
+int64_t Profiler::since_origin(const Clock::time_point t) const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t - origin_)
+        .count();
+}
+
+void Profiler::add_event(const int entry, const Clock::time_point start,
+                         const Clock::time_point end) {
+    if (events_.size() < max_events) {
+        const int64_t start_ns = since_origin(start);
+        events_.push_back({entry, start_ns, since_origin(end) - start_ns});
+    }
+}
+
+void Profiler::record(const std::shared_ptr<Layer> &layer, const int index,
+                      const Clock::time_point start,
+                      const Clock::time_point end,
+                      const PerfCounters::Values *counters) {
+    const auto it = index_.find(layer.get());
+    size_t i;
+    if (it != index_.end() && layers_[it->second].lock() == layer) {
+        i = it->second;
+    } else {
+        i = entries_.size();
+        Entry entry;
+        entry.index = index;
+        entry.name = layer->name_;
+        entry.type = layer->type_;
+        entry.detail = layer->to_str();
+        entry.work = layer->work();
+        entries_.push_back(entry);
+        layers_.push_back(layer);
+        index_[layer.get()] = i;
+    }
+    const int64_t ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+            .count();
+    auto &entry = entries_[i];
+    entry.min_ns = entry.calls == 0 ? ns : std::min(entry.min_ns, ns);
+    entry.max_ns = entry.calls == 0 ? ns : std::max(entry.max_ns, ns);
+    entry.calls++;
+    entry.total_ns += ns;
+    entry.output_elems += static_cast<int64_t>(layer->output_elems());
+    if (counters != nullptr) {
+        FORZ(k, counters->size()) {
+            auto &sum = entry.counters[k];
+            sum = (*counters)[k] < 0 || sum < 0 ? -1 : sum + (*counters)[k];
+        }
+        entry.has_counters = true;
+    }
+    add_event(static_cast<int>(i), start, end);
+}
+
+void Profiler::record_run(const Clock::time_point start,
+                          const Clock::time_point end) {
+    runs_++;
+    add_event(-1, start, end);
+}
+
+void Profiler::clear() {
+    origin_ = Clock::now();
+    entries_.clear();
+    events_.clear();
+    index_.clear();
+    layers_.clear();
+    runs_ = 0;
+}
+
+std::string Profiler::chrome_trace() const {
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(3);
+    ss << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    FORZ(i, events_.size()) {
+        const auto &event = events_[i];
+        ss << (i == 0 ? "\n" : ",\n");
+        std::string name = "run", type = "Net", detail;
+        if (event.entry >= 0) {
+            const auto &entry = entries_[event.entry];
+            name = entry.name.empty()
+                       ? entry.type + " #" + std::to_string(entry.index)
+                       : entry.name;
+            type = entry.type;
+            detail = entry.detail;
+        }
+        // The timestamps of the trace event format are in us
+        ss << "{\"name\": \"" << json_escape(name) << "\", \"cat\": \""
+           << json_escape(type) << "\", \"ph\": \"X\", \"pid\": 0, "
+           << "\"tid\": 0, \"ts\": " << event.start_ns / 1e3
+           << ", \"dur\": " << event.dur_ns / 1e3 << ", \"args\": {"
+           << "\"detail\": \"" << json_escape(detail) << "\"}}";
+    }
+    ss << "\n]}\n";
+    return ss.str();
+}
+
+void Profiler::save_chrome_trace(const std::string &path) const {
+    std::ofstream ofs(path);
+    BNN_ASSERT(ofs, "Cannot open ", path);
+    ofs << chrome_trace();
+}
+
+std::string Profiler::table() const {
+    std::vector<size_t> order(entries_.size());
+    FORZ(i, order.size()) { order[i] = i; }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return entries_[a].total_ns > entries_[b].total_ns;
+    });
+    int64_t total_ns = 0;
+    bool has_counters = false;
+    for (const auto &entry : entries_) {
+        total_ns += entry.total_ns;
+        has_counters = has_counters || entry.has_counters;
+    }
+    using PC = PerfCounters;
+    const bool has_peaks = peak_gflops > 0 || peak_gbops > 0 || peak_gbps > 0;
+    // The least time of a work by the peaks, in ns
+    const auto roofline_ns = [this](const Layer::Work &work) {
+        double ns = 0.;
+        if (peak_gflops > 0) {
+            ns = std::max(ns, work.flops / peak_gflops);
+        }
+        if (peak_gbops > 0) {
+            ns = std::max(ns, work.bit_ops / peak_gbops);
+        }
+        if (peak_gbps > 0) {
+            ns = std::max(ns,
+                          (work.bytes_read + work.bytes_written) / peak_gbps);
+        }
+        return ns;
+    };
+
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(3);
+    ss << std::right << std::setw(4) << "#" << "  " << std::left
+       << std::setw(24) << "name" << std::setw(12) << "type"
+       << std::right << std::setw(8) << "calls" << std::setw(12)
+       << "total(ms)" << std::setw(11) << "mean(ms)" << std::setw(11)
+       << "min(ms)" << std::setw(11) << "max(ms)" << std::setw(8) << "%"
+       << std::setw(10) << "gflop/s" << std::setw(10) << "gbop/s"
+       << std::setw(9) << "gb/s" << std::setw(9) << "op/B";
+    if (has_peaks) {
+        ss << std::setw(8) << "%roof";
+    }
+    if (has_counters) {
+        ss << std::setw(8) << "ipc" << std::setw(10) << "l1d/elem"
+           << std::setw(10) << "llc/elem" << std::setw(10) << "br/kinst";
+    }
+    ss << "  detail\n";
+    for (const auto i : order) {
+        const auto &entry = entries_[i];
+        const double percent =
+            total_ns == 0 ? 0. : 100. * entry.total_ns / total_ns;
+        ss << std::right << std::setw(4) << entry.index << "  " << std::left
+           << std::setw(24) << entry.name << std::setw(12)
+           << entry.type << std::right << std::setw(8) << entry.calls
+           << std::setw(12) << to_ms(entry.total_ns) << std::setw(11)
+           << to_ms(entry.total_ns) / std::max<int64_t>(entry.calls, 1)
+           << std::setw(11) << to_ms(entry.min_ns) << std::setw(11)
+           << to_ms(entry.max_ns) << std::setw(8) << std::setprecision(1)
+           << percent << std::setprecision(3);
+        const auto &work = entry.work;
+        const auto bytes = work.bytes_read + work.bytes_written;
+        ss << std::setw(10) << rate(work.flops, entry.calls, entry.total_ns)
+           << std::setw(10) << rate(work.bit_ops, entry.calls, entry.total_ns)
+           << std::setw(9) << rate(bytes, entry.calls, entry.total_ns)
+           << std::setw(9) << ratio(work.flops + work.bit_ops, bytes, 1.);
+        if (has_peaks) {
+            ss << std::setw(8)
+               << ratio(static_cast<int64_t>(roofline_ns(work) * entry.calls),
+                        entry.total_ns, 100.);
+        }
+        if (has_counters) {
+            const auto &counters = entry.counters;
+            const auto instructions =
+                entry.has_counters ? counters[PC::kInstructions] : -1;
+            const auto per_elem = [&](const PC::Counter counter) {
+                return ratio(entry.has_counters ? counters[counter] : -1,
+                             entry.output_elems, 1.);
+            };
+            ss << std::setw(8)
+               << ratio(instructions,
+                        entry.has_counters ? counters[PC::kCycles] : -1, 1.)
+               << std::setw(10) << per_elem(PC::kL1dMisses) << std::setw(10)
+               << per_elem(PC::kLlcMisses) << std::setw(10)
+               << ratio(entry.has_counters ? counters[PC::kBranchMisses] : -1,
+                        instructions, 1e3);
+        }
+        ss << "  " << entry.detail << "\n";
+    }
+    ss << "runs: " << runs_ << ", layers total: " << to_ms(total_ns)
+       << " ms\n";
+    return ss.str();
+}
+
+}  // namespace bnn
@@ -0,0 +1,110 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#ifndef BNN_PROFILER_H
+#define BNN_PROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "layer.h"
+#include "perf_counters.h"
+
+namespace bnn {
+
+/**
+ * The time of every layer instance of the runs of a net, recorded when
+ * Net::profile is set
+ */
+class Profiler {
+   public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * The times of a layer, the layers of all cached plans are kept apart
+     */
+    struct Entry {
+        // The position of the layer in the net, which tells the layers
+        // without a name apart
+        int index = 0;
+        std::string name;
+        std::string type;
+        // Layer::to_str(), e.g., the shapes and the method of a conv
+        std::string detail;
+        int64_t calls = 0;
+        int64_t total_ns = 0;
+        int64_t min_ns = 0;
+        int64_t max_ns = 0;
+        // The work of a call, from the shapes of the plan of the layer
+        Layer::Work work;
+        // The output values of all calls, and the sums of the hardware
+        // counters of them if they were read (-1 for a refused counter)
+        int64_t output_elems = 0;
+        bool has_counters = false;
+        PerfCounters::Values counters{};
+    };
+    /**
+     * A span of a layer (or of a whole run, whose entry is -1) in the
+     * trace, in ns since the profiler started
+     */
+    struct Event {
+        int entry;
+        int64_t start_ns;
+        int64_t dur_ns;
+    };
+
+    Profiler();
+
+    void record(const std::shared_ptr<Layer> &layer, int index,
+                Clock::time_point start, Clock::time_point end,
+                const PerfCounters::Values *counters = nullptr);
+    void record_run(Clock::time_point start, Clock::time_point end);
+    void clear();
+
+    const std::vector<Entry> &entries() const { return entries_; }
+    const std::vector<Event> &events() const { return events_; }
+    int64_t runs() const { return runs_; }
+
+    /**
+     * The events in the Chrome trace event format, which chrome://tracing
+     * and Perfetto open
+     */
+    std::string chrome_trace() const;
+    void save_chrome_trace(const std::string &path) const;
+    /**
+     * The entries sorted by their total time, the slowest first. With the
+     * counters it also has the instructions per cycle, the L1D and LLC
+     * misses per output value and the branch misses per 1k instructions.
+     * The flops, the bit ops and the bytes of the work of the layers per
+     * second are compared with the roofline of the peaks if any is set.
+     */
+    std::string table() const;
+
+    // The peaks of the machine in G/s, 0 for unknown
+    double peak_gflops = 0.;
+    double peak_gbops = 0.;
+    double peak_gbps = 0.;
+
+    // The events kept for the trace, the entries are updated after it
+    size_t max_events = 1 << 20;
+
+   private:
+    Clock::time_point origin_;
+    std::vector<Entry> entries_;
+    std::vector<Event> events_;
+    // The layer of every entry, whose address may be reused after a plan is
+    // dropped
+    std::map<const Layer *, size_t> index_;
+    std::vector<std::weak_ptr<Layer>> layers_;
+    int64_t runs_ = 0;
+
+    int64_t since_origin(Clock::time_point t) const;
+    void add_event(int entry, Clock::time_point start, Clock::time_point end);
+};
+
+}  // namespace bnn
+
+#endif /* BNN_PROFILER_H */
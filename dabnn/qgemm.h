@@ -0,0 +1,381 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#ifndef BNN_QGEMM_H
+#define BNN_QGEMM_H
+
+#if __ARM_NEON
+#include <arm_neon.h>
+#endif  // __ARM_NEON
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif  // __AVX2__
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <common/helper.h>
+#include <dabnn/cpu_info.h>
+#include "fgemm.h"
+
+namespace bnn {
+
+// A micro tile is kQgemmNR pixels * kQgemmMR output channels like fgemm.
+// The products of two consecutive depths are summed in 16 bits and then
+// accumulated in 32 bits (pmaddwd on x86, smull + sadalp on arm), which
+// cannot overflow since the int8 values are in [-127, 127].
+constexpr int kQgemmMR = kFgemmMR;
+#if defined(__aarch64__) || defined(__AVX2__)
+constexpr int kQgemmNR = 8;
+#else
+constexpr int kQgemmNR = 4;
+#endif
+// The capacity (in depth) of the packed pixel panel on the stack
+constexpr int kQgemmMaxKC = 2048;
+
+/**
+ * round(v * inv_scale) clamped to [-127, 127], the symmetric int8 of v
+ */
+inline int8_t quantize_int8(const float v, const float inv_scale) {
+    const float q = std::nearbyint(v * inv_scale);
+    return static_cast<int8_t>(std::max(-127.f, std::min(127.f, q)));
+}
+
+inline void quantize_int8(const float *src, int8_t *dst, const size_t n,
+                          const float inv_scale) {
+    FORZ(i, n) { dst[i] = quantize_int8(src[i], inv_scale); }
+}
+
+/**
+ * The int8 of (v - mean[c]) * scale[c] for the pixels of a uint8 image
+ */
+inline void quantize_int8(const uint8_t *src, int8_t *dst,
+                          const size_t pixels, const int c, const float *mean,
+                          const float *scale, const float inv_scale) {
+    FORZ(i, pixels) {
+        FORZ(j, c) {
+            dst[j] = quantize_int8((src[j] - mean[j]) * scale[j], inv_scale);
+        }
+        src += c;
+        dst += c;
+    }
+}
+
+inline float max_abs(const float *data, const size_t n) {
+    float ret = 0.f;
+    FORZ(i, n) { ret = std::max(ret, std::abs(data[i])); }
+    return ret;
+}
+
+/**
+ * The depth of packed panels is rounded up to pairs
+ */
+inline size_t qgemm_packed_size(const int m, const int k) {
+    return static_cast<size_t>((m + kQgemmMR - 1) / kQgemmMR) * kQgemmMR *
+           ((k + 1) / 2 * 2);
+}
+
+/**
+ * Pack the row-major m*k int8 weight into panels of kQgemmMR rows. A panel
+ * stores the pairs of depths (2j, 2j + 1) of its rows one after another,
+ * the rows beyond m and the depth beyond k are zero.
+ */
+inline void qgemm_pack_weight(const int m, const int k, const int8_t *w,
+                              const int ldw, int8_t *packed) {
+    for (int m0 = 0; m0 < m; m0 += kQgemmMR) {
+        for (int j = 0; j < k; j += 2) {
+            FORZ(r, kQgemmMR) {
+                const int8_t *row = w + (m0 + r) * ldw;
+                const bool valid = m0 + r < m;
+                *packed++ = valid ? row[j] : 0;
+                *packed++ = valid && j + 1 < k ? row[j + 1] : 0;
+            }
+        }
+    }
+}
+
+namespace qgemm_detail {
+
+/**
+ * The offset of depth j of pixel i in a packed pixel panel, which has the
+ * pair layout of the weight panels
+ */
+inline int panel_index(const int j, const int i) {
+    return (j >> 1) * 2 * kQgemmNR + 2 * i + (j & 1);
+}
+
+/**
+ * Pack the [k0, k0 + kc) slice of nr int8 pixels, row(p) returns the k
+ * values of pixel p. The missing pixels are zero.
+ */
+template <typename RowFn>
+inline void pack_pixels(const int kc, const int nr, RowFn &&row, const int p0,
+                        const int k0, int8_t *packed) {
+    FORZ(i, kQgemmNR) {
+        const int8_t *src = i < nr ? row(p0 + i) + k0 : nullptr;
+        FORZ(j, kc) {
+            packed[panel_index(j, i)] = src != nullptr ? src[j] : 0;
+        }
+    }
+}
+
+/**
+ * acc[i * kQgemmMR + r] = sum_j b[j][i] * a[j][r] over kp pairs of depths
+ */
+inline void micro_kernel(const int kp, const int8_t *a, const int8_t *b,
+                         int32_t *acc) {
+#if defined(__AVX2__)
+    static_assert(kQgemmNR == 8, "A pair of depths of the pixels is 16 bytes");
+    __m256i c[kQgemmNR];
+    FORZ(i, kQgemmNR) { c[i] = _mm256_setzero_si256(); }
+    FORZ(j, kp) {
+        // The 8 channels of a pair of depths as 8 int16 pairs, and the 8
+        // pixels of it
+        const __m256i _a = _mm256_cvtepi8_epi16(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(a)));
+        const __m256i _b = _mm256_cvtepi8_epi16(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(b)));
+        FORZ(i, kQgemmNR) {
+            const __m256i bi =
+                _mm256_permutevar8x32_epi32(_b, _mm256_set1_epi32(i));
+            c[i] = _mm256_add_epi32(c[i], _mm256_madd_epi16(_a, bi));
+        }
+        a += 2 * kQgemmMR;
+        b += 2 * kQgemmNR;
+    }
+    FORZ(i, kQgemmNR) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(acc + i * kQgemmMR),
+                            c[i]);
+    }
+#elif __ARM_NEON
+    int32x4_t c[kQgemmNR][2];
+    FORZ(i, kQgemmNR) {
+        c[i][0] = vdupq_n_s32(0);
+        c[i][1] = vdupq_n_s32(0);
+    }
+    FORZ(j, kp) {
+        const int8x16_t _a = vld1q_s8(a);
+        FORZ(i, kQgemmNR) {
+            int16_t pair;
+            memcpy(&pair, b + 2 * i, sizeof(pair));
+            const int8x16_t bi = vreinterpretq_s8_s16(vdupq_n_s16(pair));
+            c[i][0] = vpadalq_s16(c[i][0],
+                                  vmull_s8(vget_low_s8(_a), vget_low_s8(bi)));
+            c[i][1] = vpadalq_s16(
+                c[i][1], vmull_s8(vget_high_s8(_a), vget_high_s8(bi)));
+        }
+        a += 2 * kQgemmMR;
+        b += 2 * kQgemmNR;
+    }
+    FORZ(i, kQgemmNR) {
+        vst1q_s32(acc + i * kQgemmMR, c[i][0]);
+        vst1q_s32(acc + i * kQgemmMR + 4, c[i][1]);
+    }
+#elif defined(__SSE2__)
+    static_assert(kQgemmNR == 4, "A pair of depths of the pixels is 8 bytes");
+    // int8 to int16 by interleaving the bytes with themselves
+    const auto widen_lo = [](const __m128i x) {
+        return _mm_srai_epi16(_mm_unpacklo_epi8(x, x), 8);
+    };
+    const auto widen_hi = [](const __m128i x) {
+        return _mm_srai_epi16(_mm_unpackhi_epi8(x, x), 8);
+    };
+    __m128i c[kQgemmNR][2];
+    FORZ(i, kQgemmNR) {
+        c[i][0] = _mm_setzero_si128();
+        c[i][1] = _mm_setzero_si128();
+    }
+    FORZ(j, kp) {
+        const __m128i _a =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(a));
+        const __m128i a0 = widen_lo(_a);
+        const __m128i a1 = widen_hi(_a);
+        const __m128i _b = widen_lo(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i *>(b)));
+        const __m128i bs[kQgemmNR] = {
+            _mm_shuffle_epi32(_b, 0x00), _mm_shuffle_epi32(_b, 0x55),
+            _mm_shuffle_epi32(_b, 0xaa), _mm_shuffle_epi32(_b, 0xff)};
+        FORZ(i, kQgemmNR) {
+            c[i][0] = _mm_add_epi32(c[i][0], _mm_madd_epi16(a0, bs[i]));
+            c[i][1] = _mm_add_epi32(c[i][1], _mm_madd_epi16(a1, bs[i]));
+        }
+        a += 2 * kQgemmMR;
+        b += 2 * kQgemmNR;
+    }
+    FORZ(i, kQgemmNR) {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(acc + i * kQgemmMR),
+                         c[i][0]);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(acc + i * kQgemmMR + 4),
+                         c[i][1]);
+    }
+#else
+    int32_t c[kQgemmNR][kQgemmMR] = {};
+    FORZ(j, kp) {
+        FORZ(i, kQgemmNR) {
+            const int32_t b0 = b[2 * i];
+            const int32_t b1 = b[2 * i + 1];
+            FORZ(r, kQgemmMR) {
+                c[i][r] += a[2 * r] * b0 + a[2 * r + 1] * b1;
+            }
+        }
+        a += 2 * kQgemmMR;
+        b += 2 * kQgemmNR;
+    }
+    FORZ(i, kQgemmNR) {
+        FORZ(r, kQgemmMR) { acc[i * kQgemmMR + r] = c[i][r]; }
+    }
+#endif
+}
+
+}  // namespace qgemm_detail
+
+/**
+ * A kc*kQgemmMR panel of the weight and a kc*kQgemmNR panel of the pixels
+ * are expected to stay in L1
+ */
+inline int qgemm_kc(const CacheInfo &cache) {
+    const int kc =
+        static_cast<int>(cache.l1d / 2 / (kQgemmMR + kQgemmNR)) / 8 * 8;
+    return std::max(8, kc < kQgemmMaxKC ? kc : kQgemmMaxKC);
+}
+
+/**
+ * out(p)[i] = epilogue(dequant[i] * sum_j x(p)[j] * w[i][j]), the int8
+ * counterpart of fgemm_packed_gather. packed_a is the weight packed by
+ * qgemm_pack_weight, pack(p0, nr, k0, kc, packed) writes the [k0, k0 + kc)
+ * slice of the nr int8 pixels from p0 at qgemm_detail::panel_index(j, i)
+ * (zero for the pixels beyond nr). dequant[i] turns the int32 sums of
+ * channel i back to float, e.g. the product of the scales of the weight and
+ * the input.
+ */
+template <typename PackFn, typename OutFn>
+inline void qgemm_packed_gather(const int m, const int n, const int k,
+                                const int8_t *packed_a, const float *dequant,
+                                PackFn &&pack, OutFn &&out,
+                                const FgemmEpilogue &epilogue) {
+    BNN_ASSERT(m > 0 && k > 0, m, k);
+    const int kp = (k + 1) / 2 * 2;
+    const int kc = qgemm_kc(cache_info());
+    alignas(32) int8_t packed_b[kQgemmMaxKC * kQgemmNR];
+    alignas(32) int32_t iacc[kQgemmNR * kQgemmMR];
+    alignas(16) float acc[kQgemmNR * kQgemmMR];
+    for (int k0 = 0; k0 < k; k0 += kc) {
+        const int kb = k - k0 < kc ? k - k0 : kc;
+        const bool first = k0 == 0;
+        const bool last = k0 + kb == k;
+        for (int p0 = 0; p0 < n; p0 += kQgemmNR) {
+            const int nr = n - p0 < kQgemmNR ? n - p0 : kQgemmNR;
+            pack(p0, nr, k0, kb, packed_b);
+            if (kb % 2 != 0) {
+                // The second depth of the last pair
+                FORZ(i, kQgemmNR) {
+                    packed_b[qgemm_detail::panel_index(kb, i)] = 0;
+                }
+            }
+            for (int m0 = 0; m0 < m; m0 += kQgemmMR) {
+                const int mr = m - m0 < kQgemmMR ? m - m0 : kQgemmMR;
+                const int8_t *a = packed_a + m0 * kp + k0 * kQgemmMR;
+                qgemm_detail::micro_kernel((kb + 1) / 2, a, packed_b, iacc);
+                FORZ(i, nr) {
+                    FORZ(r, mr) {
+                        acc[i * kQgemmMR + r] =
+                            iacc[i * kQgemmMR + r] * dequant[m0 + r];
+                    }
+                }
+                fgemm_detail::store_tile(acc, nr, mr, !first, last, p0, m0,
+                                         epilogue, out);
+            }
+        }
+    }
+}
+
+/**
+ * qgemm_packed_gather on int8 pixels stored as rows, row(p) returns the k
+ * values of pixel p
+ */
+template <typename RowFn, typename OutFn>
+inline void qgemm_packed(const int m, const int n, const int k,
+                         const int8_t *packed_a, const float *dequant,
+                         RowFn &&row, OutFn &&out,
+                         const FgemmEpilogue &epilogue) {
+    qgemm_packed_gather(
+        m, n, k, packed_a, dequant,
+        [&](const int p0, const int nr, const int k0, const int kc,
+            int8_t *packed) {
+            qgemm_detail::pack_pixels(kc, nr, row, p0, k0, packed);
+        },
+        out, epilogue);
+}
+
+namespace qgemm_detail {
+
+inline int32_t dot(const int k, const int8_t *a, const int8_t *x) {
+    int j = 0;
+    int32_t sum = 0;
+#if defined(__AVX2__)
+    __m256i acc = _mm256_setzero_si256();
+    for (; j + 16 <= k; j += 16) {
+        const __m256i _a = _mm256_cvtepi8_epi16(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + j)));
+        const __m256i _x = _mm256_cvtepi8_epi16(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(x + j)));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_a, _x));
+    }
+    alignas(32) int32_t lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), acc);
+    FORZ(l, 8) { sum += lanes[l]; }
+#elif defined(__SSE2__)
+    __m128i acc = _mm_setzero_si128();
+    for (; j + 16 <= k; j += 16) {
+        const __m128i _a =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + j));
+        const __m128i _x =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(x + j));
+        // int8 to int16 by interleaving the bytes with themselves
+        acc = _mm_add_epi32(
+            acc, _mm_madd_epi16(_mm_srai_epi16(_mm_unpacklo_epi8(_a, _a), 8),
+                                _mm_srai_epi16(_mm_unpacklo_epi8(_x, _x), 8)));
+        acc = _mm_add_epi32(
+            acc, _mm_madd_epi16(_mm_srai_epi16(_mm_unpackhi_epi8(_a, _a), 8),
+                                _mm_srai_epi16(_mm_unpackhi_epi8(_x, _x), 8)));
+    }
+    alignas(16) int32_t lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i *>(lanes), acc);
+    FORZ(l, 4) { sum += lanes[l]; }
+#elif __ARM_NEON
+    int32x4_t acc = vdupq_n_s32(0);
+    for (; j + 16 <= k; j += 16) {
+        const int8x16_t _a = vld1q_s8(a + j);
+        const int8x16_t _x = vld1q_s8(x + j);
+        acc = vpadalq_s16(acc, vmull_s8(vget_low_s8(_a), vget_low_s8(_x)));
+        acc = vpadalq_s16(acc, vmull_s8(vget_high_s8(_a), vget_high_s8(_x)));
+    }
+    const int32x2_t s = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+    sum = vget_lane_s32(vpadd_s32(s, s), 0);
+#endif
+    for (; j < k; j++) {
+        sum += a[j] * x[j];
+    }
+    return sum;
+}
+
+}  // namespace qgemm_detail
+
+/**
+ * y[i] = dequant[i] * dot(a + i * lda, x) + bias[i], i in [0, m), the int8
+ * counterpart of fgemv. bias can be nullptr.
+ */
+inline void qgemv(const int m, const int k, const int8_t *a, const int lda,
+                  const int8_t *x, const float *dequant, const float *bias,
+                  float *y) {
+    FORZ(i, m) {
+        y[i] = qgemm_detail::dot(k, a + i * lda, x) * dequant[i] +
+               (bias == nullptr ? 0.f : bias[i]);
+    }
+}
+
+}  // namespace bnn
+
+#endif /* BNN_QGEMM_H */
@@ -0,0 +1,51 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#ifndef BNN_SOFTMAX_H
+#define BNN_SOFTMAX_H
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include <common/helper.h>
+
+namespace bnn {
+
+/**
+ * y = softmax(x) over n elements, x and y can be the same buffer
+ */
+inline void softmax(const float *x, const int n, float *y) {
+    BNN_ASSERT(n > 0, n);
+    const float max = *std::max_element(x, x + n);
+    float sum = 0.f;
+    FORZ(i, n) {
+        y[i] = std::exp(x[i] - max);
+        sum += y[i];
+    }
+    const float scale = 1.f / sum;
+    FORZ(i, n) { y[i] *= scale; }
+}
+
+/**
+ * The k largest elements of x as (index, value) pairs in descending order
+ */
+inline std::vector<std::pair<int, float>> top_k(const float *x, const int n,
+                                                const int k) {
+    std::vector<std::pair<int, float>> result;
+    result.reserve(n);
+    FORZ(i, n) { result.emplace_back(i, x[i]); }
+    const int len = std::min(k, n);
+    std::partial_sort(result.begin(), result.begin() + len, result.end(),
+                      [](const std::pair<int, float> &a,
+                         const std::pair<int, float> &b) {
+                          return a.second > b.second ||
+                                 (a.second == b.second && a.first < b.first);
+                      });
+    result.resize(len);
+    return result;
+}
+
+}  // namespace bnn
+
+#endif /* BNN_SOFTMAX_H */
@@ -0,0 +1,164 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#include <vector>
+
+#include <common/helper.h>
+#include <dabnn/net.h>
+#include <gtest/gtest.h>
+#include "test_model.h"
+
+namespace {
+
+const int kSize = 8;
+const int kInputC = 4;
+const int kStemC = 128;
+const int kBinC = 64;
+const int kConvC = 32;
+const int kUnits = 10;
+
+/**
+ * input [1, 8, 8, 4] -> FpConv2D 3x3 -> BinConv2D 3x3 -> Affine -> Relu ->
+ * FpConv2D 1x1 -> global AvePool -> FC -> Softmax
+ */
+std::vector<uint8_t> build_model() {
+    bnn::TestModel model({1, kSize, kSize, kInputC});
+    std::vector<float> stem_weight(kStemC * 3 * 3 * kInputC),
+        conv_weight(kConvC * kBinC), fc_weight(kUnits * kConvC),
+        fc_bias(kUnits), a(kBinC), b(kBinC);
+    std::vector<uint64_t> bin_weight(kBinC * 3 * 3 * kStemC / 64);
+    for (auto *weight : {&stem_weight, &conv_weight, &fc_weight, &fc_bias, &a,
+                         &b}) {
+        fill_rand_float(weight->data(), weight->size());
+    }
+    fill_rand_uint64(bin_weight.data(), bin_weight.size());
+    model.add_float("stem_weight", {kStemC, 3, 3, kInputC}, stem_weight);
+    model.add_bit("bin_weight", {kBinC, 3, 3, kStemC}, bin_weight, true);
+    model.add_float("a", {kBinC}, a);
+    model.add_float("b", {kBinC}, b);
+    model.add_float("conv_weight", {kConvC, 1, 1, kBinC}, conv_weight);
+    model.add_float("fc_weight", {kUnits, kConvC}, fc_weight);
+    model.add_float("fc_bias", {kUnits}, fc_bias);
+
+    model.fp_conv("input", "stem_weight", nullptr, "stem", 1, 1);
+    model.bin_conv("stem", "bin_weight", "bconv", 1, 1);
+    model.affine("bconv", "a", "b", "bn");
+    model.relu("bn", "relu");
+    model.fp_conv("relu", "conv_weight", nullptr, "conv", 0, 1);
+    model.ave_pool("conv", kSize, 0, 1, "pooled");
+    model.fc("pooled", "fc_weight", "fc_bias", "logits");
+    model.softmax("logits", "prob");
+    return model.finish();
+}
+
+/**
+ * Image i of the batched blob equals the blob of the single image run
+ */
+void expect_image_eq(const bnn::Mat &batched, const int i,
+                     const bnn::Mat &single) {
+    ASSERT_EQ(batched.h, single.h);
+    ASSERT_EQ(batched.w, single.w);
+    ASSERT_EQ(batched.c, single.c);
+    const auto image = batched.image(i);
+    FORZ(y, single.h) {
+        const auto *ptr = static_cast<const float *>(image.data) +
+                          y * image.hstep;
+        const auto *expected = static_cast<const float *>(single.data) +
+                               y * single.hstep;
+        FORZ(x, single.w * single.c) { ASSERT_FLOAT_EQ(ptr[x], expected[x]); }
+    }
+}
+
+const std::vector<std::string> kBlobs{"stem", "bconv", "conv", "prob"};
+
+}  // namespace
+
+/**
+ * The convs fold the images into their gemm (the bgemm of the reference net
+ * included), the other layers run once per image
+ */
+TEST(batch, float_input) {
+    const auto buf = build_model();
+    const int batch = 3;
+    const int image_len = kSize * kSize * kInputC;
+    std::vector<float> input(batch * image_len);
+    fill_rand_float(input.data(), input.size());
+
+    for (const bool optimize : {false, true}) {
+        auto single = bnn::Net::create();
+        single->optimize = optimize;
+        single->read_buf(buf.data());
+        auto batched = bnn::Net::create();
+        batched->optimize = optimize;
+        batched->max_batch = 4;
+        batched->read_buf(buf.data());
+
+        batched->run(input.data(), batch);
+        ASSERT_EQ(batched->get_blob("prob")->n, batch);
+        FORZ(i, batch) {
+            single->run(input.data() + i * image_len);
+            for (const auto &name : kBlobs) {
+                expect_image_eq(*batched->get_blob(name), i,
+                                *single->get_blob(name));
+            }
+            const auto top = batched->top_k("prob", 3, i);
+            const auto expected_top = single->top_k("prob", 3);
+            ASSERT_EQ(top, expected_top);
+        }
+
+        // A smaller batch reuses the blobs
+        batched->run(input.data() + image_len, 1);
+        ASSERT_EQ(batched->get_blob("prob")->n, 1);
+        single->run(input.data() + image_len);
+        for (const auto &name : kBlobs) {
+            expect_image_eq(*batched->get_blob(name), 0,
+                            *single->get_blob(name));
+        }
+    }
+}
+
+/**
+ * The stem of the optimized net normalizes the batch of uint8 images in its
+ * gemm
+ */
+TEST(batch, uint8_input) {
+    const auto buf = build_model();
+    const int batch = 2;
+    const int image_len = kSize * kSize * kInputC;
+    std::vector<uint8_t> images(batch * image_len);
+    FORZ(i, images.size()) { images[i] = static_cast<uint8_t>(i * 37 % 256); }
+    const std::vector<float> mean{124.f, 116.f, 104.f, 100.f};
+    const std::vector<float> std{58.f, 57.f, 57.5f, 50.f};
+
+    for (const bool optimize : {false, true}) {
+        auto single = bnn::Net::create();
+        single->optimize = optimize;
+        single->input_mean = mean;
+        single->input_std = std;
+        single->read_buf(buf.data());
+        auto batched = bnn::Net::create();
+        batched->optimize = optimize;
+        batched->input_mean = mean;
+        batched->input_std = std;
+        batched->max_batch = batch;
+        batched->read_buf(buf.data());
+
+        batched->run(images.data(), batch);
+        FORZ(i, batch) {
+            single->run(images.data() + i * image_len);
+            for (const auto &name : kBlobs) {
+                expect_image_eq(*batched->get_blob(name), i,
+                                *single->get_blob(name));
+            }
+        }
+    }
+}
+
+TEST(batch, exceeds_capacity) {
+    const auto buf = build_model();
+    auto net = bnn::Net::create();
+    net->max_batch = 2;
+    net->read_buf(buf.data());
+    std::vector<float> input(3 * kSize * kSize * kInputC);
+    ASSERT_ANY_THROW(net->run(input.data(), 3));
+    ASSERT_ANY_THROW(net->run(input.data(), 0));
+}
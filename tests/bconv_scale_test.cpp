@@ -0,0 +1,173 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#include <cmath>
+#include <vector>
+
+#include <common/helper.h>
+#include <dabnn/net.h>
+#include <gtest/gtest.h>
+#include "test_model.h"
+
+using namespace bnn;
+
+namespace {
+
+const int kSize = 6;
+const int kC = 64;
+const int kKernel = 3;
+
+struct Weights {
+    bool depthwise;
+    int m;
+    std::vector<uint64_t> bin;
+    std::vector<float> scale, offset, a, b;
+
+    explicit Weights(const bool depthwise)
+        : depthwise(depthwise),
+          m(depthwise ? kC : 32),
+          bin((depthwise ? 1 : m) * kKernel * kKernel * kC / 64),
+          scale(m),
+          offset(m),
+          a(m),
+          b(m) {
+        fill_rand_uint64(bin.data(), bin.size());
+        for (auto *weight : {&scale, &offset, &a, &b}) {
+            fill_rand_float(weight->data(), weight->size());
+        }
+    }
+
+    /**
+     * The sign of channel ch of tap t of filter o, a set bit is +1
+     */
+    int sign(const int o, const int t, const int ch) const {
+        const size_t bit =
+            depthwise ? t * kC + o : (o * kKernel * kKernel + t) * kC + ch;
+        return (bin[bit / 64] >> (bit % 64)) & 1 ? 1 : -1;
+    }
+};
+
+/**
+ * input [1, 6, 6, 64] -> BinConv2D 3x3 "bconv", carrying scale and offset
+ * if scaled, and then Affine "bn" if affine
+ */
+std::vector<uint8_t> build_model(const Weights &weights, const bool scaled,
+                                 const bool affine) {
+    TestModel model({1, kSize, kSize, kC});
+    const auto m = static_cast<uint32_t>(weights.m);
+    const uint32_t filters = weights.depthwise ? 1 : m;
+    model.add_bit("bin_weight", {filters, kKernel, kKernel, kC}, weights.bin);
+    model.add_float("scale", {m}, weights.scale);
+    model.add_float("offset", {m}, weights.offset);
+    model.add_float("a", {m}, weights.a);
+    model.add_float("b", {m}, weights.b);
+
+    model.bin_conv("input", "bin_weight", "bconv", 0, 1,
+                   weights.depthwise ? kC : 1, scaled ? "scale" : nullptr,
+                   scaled ? "offset" : nullptr);
+    if (affine) {
+        model.affine("bconv", "a", "b", "bn");
+    }
+    return model.finish();
+}
+
+/**
+ * The xnor dot products of the signs of the input and the weight
+ */
+std::vector<float> xnor_conv(const std::vector<float> &input,
+                             const Weights &weights) {
+    const int output_size = kSize - kKernel + 1;
+    std::vector<float> output;
+    FORZ(oy, output_size) {
+        FORZ(ox, output_size) {
+            FORZ(o, weights.m) {
+                int dot = 0;
+                FORZ(ky, kKernel) {
+                    FORZ(kx, kKernel) {
+                        const int t = ky * kKernel + kx;
+                        const float *pixel =
+                            &input[((oy + ky) * kSize + ox + kx) * kC];
+                        if (weights.depthwise) {
+                            dot += (pixel[o] > 0 ? 1 : -1) *
+                                   weights.sign(o, t, o);
+                            continue;
+                        }
+                        FORZ(ch, kC) {
+                            dot += (pixel[ch] > 0 ? 1 : -1) *
+                                   weights.sign(o, t, ch);
+                        }
+                    }
+                }
+                output.push_back(static_cast<float>(dot));
+            }
+        }
+    }
+    return output;
+}
+
+void expect_near(const Mat &actual, const std::vector<float> &expected) {
+    ASSERT_EQ(actual.total(), expected.size());
+    FORZ(i, expected.size()) {
+        ASSERT_NEAR(actual[i], expected[i], 1e-4 * (std::abs(expected[i]) + 1))
+            << i;
+    }
+}
+
+}  // namespace
+
+TEST(bconv_scale, scale_and_offset) {
+    std::vector<float> input(kSize * kSize * kC);
+    fill_rand_float(input.data(), input.size());
+    for (const bool depthwise : {false, true}) {
+        const Weights weights(depthwise);
+        const auto dot = xnor_conv(input, weights);
+        const auto buf = build_model(weights, true, false);
+        for (const bool optimize : {false, true}) {
+            auto net = Net::create();
+            net->optimize = optimize;
+            net->read_buf(buf.data());
+            net->run(input.data());
+            std::vector<float> expected(dot.size());
+            FORZ(i, dot.size()) {
+                const int o = i % weights.m;
+                expected[i] = weights.scale[o] * dot[i] + weights.offset[o];
+            }
+            expect_near(*net->get_blob("bconv"), expected);
+        }
+    }
+}
+
+/**
+ * The affine after the conv is folded into its scale, with or without the
+ * scale of the model
+ */
+TEST(bconv_scale, fused_affine) {
+    std::vector<float> input(kSize * kSize * kC);
+    fill_rand_float(input.data(), input.size());
+    const Weights weights(false);
+    for (const bool scaled : {false, true}) {
+        const auto buf = build_model(weights, scaled, true);
+        auto reference = Net::create();
+        reference->optimize = false;
+        reference->read_buf(buf.data());
+        reference->run(input.data());
+        auto net = Net::create();
+        net->read_buf(buf.data());
+        net->run(input.data());
+        const auto &expected = *reference->get_blob("bn");
+        std::vector<float> expected_vec(expected.total());
+        FORZ(i, expected.total()) { expected_vec[i] = expected[i]; }
+        expect_near(*net->get_blob("bn"), expected_vec);
+    }
+}
+
+TEST(bconv_scale, offset_without_scale) {
+    const Weights weights(false);
+    TestModel model({1, kSize, kSize, kC});
+    model.add_bit("bin_weight", {32, kKernel, kKernel, kC}, weights.bin);
+    model.add_float("offset", {32}, weights.offset);
+    model.bin_conv("input", "bin_weight", "bconv", 0, 1, 1, nullptr,
+                   "offset");
+    const auto buf = model.finish();
+    auto net = Net::create();
+    ASSERT_ANY_THROW(net->read_buf(buf.data()));
+}
@@ -8,8 +8,10 @@
 #include <common/baseline.h>
 #include <common/helper.h>
 #include <dabnn/bitpack.h>
+#include <dabnn/net.h>
 #include <dabnn/pad.h>
 #include <gtest/gtest.h>
+#include "test_model.h"
 
 /*
 // TODO: reuse the code
@@ -429,3 +431,432 @@ TEST(bconv_test, bconv_test_3x3_512_s2) {
 
     ASSERT_EQ(c, expected);
 }
+
+TEST(bconv_test, bconv_test_3x3_192) {
+    const size_t AHEIGHT = 28;
+    const size_t AWIDTH = 28;
+    const size_t CHANNEL = 192;
+
+    const size_t BHEIGHT = 3;
+    const size_t BWIDTH = 3;
+    const size_t NUM_OUTPUT = 192;
+
+    const size_t CHEIGHT = AHEIGHT;
+    const size_t CWIDTH = AWIDTH;
+
+    const size_t ALEN = AHEIGHT * AWIDTH * CHANNEL / sizeof(uint64_t);
+    const size_t BLEN =
+        NUM_OUTPUT * BHEIGHT * BWIDTH * CHANNEL / sizeof(uint64_t);
+
+    uint64_t a_data[ALEN];
+    uint64_t b_data[BLEN];
+    fill_rand_uint64(a_data, ALEN);
+    fill_rand_uint64(b_data, BLEN);
+
+    const bnn::Mat a(AHEIGHT, AWIDTH, CHANNEL, a_data, bnn::DataType::Bit);
+    bnn::Mat padded(AHEIGHT + 2, AWIDTH + 2, CHANNEL, bnn::DataType::Bit);
+    pad(a, 1, 1, padded);
+    const bnn::Mat b(NUM_OUTPUT, BHEIGHT, BWIDTH, CHANNEL, b_data,
+                     bnn::DataType::Bit, false);
+
+    bnn::Mat c(CHEIGHT, CWIDTH, NUM_OUTPUT, bnn::DataType::Float);
+    c.fill<uint32_t>(0);
+    bnn::bconv_3x3(padded, b, c);
+
+    bnn::Mat c_64(CHEIGHT, CWIDTH, NUM_OUTPUT, bnn::DataType::Float);
+    c_64.fill<uint32_t>(0);
+    bnn::bconv_3x3_direct<1>(padded, b, c_64);
+
+    bnn::Mat expected(CHEIGHT, CWIDTH, NUM_OUTPUT, bnn::DataType::Float);
+    expected.fill<uint32_t>(0);
+    bnn::baseline_bconv(a, b, 3, 3, 1, 1, 1, 1, 1, 1, NUM_OUTPUT, expected);
+
+    ASSERT_EQ(c, expected);
+    ASSERT_EQ(c_64, expected);
+}
+
+TEST(bconv_test, bconv_test_3x3_384_s2) {
+    const size_t AHEIGHT = 15;
+    const size_t AWIDTH = 15;
+    const size_t CHANNEL = 384;
+
+    const size_t BHEIGHT = 3;
+    const size_t BWIDTH = 3;
+    const size_t NUM_OUTPUT = 130;
+
+    const size_t CHEIGHT = (AHEIGHT - 1) / 2 + 1;
+    const size_t CWIDTH = (AWIDTH - 1) / 2 + 1;
+
+    const size_t ALEN = AHEIGHT * AWIDTH * CHANNEL / sizeof(uint64_t);
+    const size_t BLEN =
+        NUM_OUTPUT * BHEIGHT * BWIDTH * CHANNEL / sizeof(uint64_t);
+
+    uint64_t a_data[ALEN];
+    uint64_t b_data[BLEN];
+    fill_rand_uint64(a_data, ALEN);
+    fill_rand_uint64(b_data, BLEN);
+
+    const bnn::Mat a(AHEIGHT, AWIDTH, CHANNEL, a_data, bnn::DataType::Bit);
+    bnn::Mat padded(AHEIGHT + 2, AWIDTH + 2, CHANNEL, bnn::DataType::Bit);
+    pad(a, 1, 1, padded);
+    const bnn::Mat b(NUM_OUTPUT, BHEIGHT, BWIDTH, CHANNEL, b_data,
+                     bnn::DataType::Bit, false);
+
+    bnn::Mat c(CHEIGHT, CWIDTH, NUM_OUTPUT, bnn::DataType::Float);
+    c.fill<uint32_t>(0);
+    bnn::bconv_3x3(padded, b, c, 2);
+
+    bnn::Mat expected(CHEIGHT, CWIDTH, NUM_OUTPUT, bnn::DataType::Float);
+    expected.fill<uint32_t>(0);
+    bnn::baseline_bconv(a, b, 3, 3, 1, 1, 2, 2, 1, 1, NUM_OUTPUT, expected);
+
+    ASSERT_EQ(c, expected);
+}
+
+TEST(bconv_test, bconv_test_3x3_64_converted) {
+    // onnx2bnn pads every output channel of the weight to 128 bits, the 576
+    // bits of a 3x3x64 filter are stored in 10 words
+    const size_t AHEIGHT = 10;
+    const size_t AWIDTH = 10;
+    const size_t CHANNEL = 64;
+
+    const size_t NUM_OUTPUT = 20;
+    const size_t FILTER_LEN = 3 * 3;
+    const size_t PADDED_LEN = 10;
+
+    const size_t ALEN = AHEIGHT * AWIDTH * CHANNEL / 64;
+    const size_t BLEN = NUM_OUTPUT * FILTER_LEN;
+
+    uint64_t a_data[ALEN];
+    uint64_t b_data[BLEN];
+    uint64_t b_padded_data[NUM_OUTPUT * PADDED_LEN];
+    fill_rand_uint64(a_data, ALEN);
+    fill_rand_uint64(b_data, BLEN);
+    fill_rand_uint64(b_padded_data, NUM_OUTPUT * PADDED_LEN);
+    FORZ(i, NUM_OUTPUT) {
+        FORZ(j, FILTER_LEN) {
+            b_padded_data[i * PADDED_LEN + j] = b_data[i * FILTER_LEN + j];
+        }
+    }
+
+    const bnn::Mat a(AHEIGHT, AWIDTH, CHANNEL, a_data, bnn::DataType::Bit);
+    bnn::Mat padded(AHEIGHT + 2, AWIDTH + 2, CHANNEL, bnn::DataType::Bit);
+    pad(a, 1, 1, padded);
+    const bnn::Mat b(NUM_OUTPUT, 3, 3, CHANNEL, b_data, bnn::DataType::Bit,
+                     false);
+    const bnn::Mat b_padded(NUM_OUTPUT, 3, 3, CHANNEL, b_padded_data,
+                            bnn::DataType::Bit, NUM_OUTPUT * PADDED_LEN,
+                            false);
+
+    bnn::Mat c(AHEIGHT, AWIDTH, NUM_OUTPUT, bnn::DataType::Float);
+    c.fill<uint32_t>(0);
+    bnn::bconv_3x3(padded, b_padded, c);
+
+    bnn::Mat expected(AHEIGHT, AWIDTH, NUM_OUTPUT, bnn::DataType::Float);
+    expected.fill<uint32_t>(0);
+    bnn::baseline_bconv(a, b, 3, 3, 1, 1, 1, 1, 1, 1, NUM_OUTPUT, expected);
+
+    ASSERT_EQ(c, expected);
+}
+
+TEST(bconv_test, bconv_test_5x5_128) {
+    const size_t AHEIGHT = 18;
+    const size_t AWIDTH = 18;
+    const size_t CHANNEL = 128;
+
+    const size_t BHEIGHT = 5;
+    const size_t BWIDTH = 5;
+    const size_t NUM_OUTPUT = 64;
+
+    const size_t CHEIGHT = AHEIGHT;
+    const size_t CWIDTH = AWIDTH;
+
+    const size_t ALEN = AHEIGHT * AWIDTH * CHANNEL / sizeof(uint64_t);
+    const size_t BLEN =
+        NUM_OUTPUT * BHEIGHT * BWIDTH * CHANNEL / sizeof(uint64_t);
+
+    uint64_t a_data[ALEN];
+    uint64_t b_data[BLEN];
+    fill_rand_uint64(a_data, ALEN);
+    fill_rand_uint64(b_data, BLEN);
+
+    const bnn::Mat a(AHEIGHT, AWIDTH, CHANNEL, a_data, bnn::DataType::Bit);
+    bnn::Mat padded(AHEIGHT + 4, AWIDTH + 4, CHANNEL, bnn::DataType::Bit);
+    pad(a, 2, 2, padded);
+    const bnn::Mat b(NUM_OUTPUT, BHEIGHT, BWIDTH, CHANNEL, b_data,
+                     bnn::DataType::Bit, false);
+
+    bnn::Mat c(CHEIGHT, CWIDTH, NUM_OUTPUT, bnn::DataType::Float);
+    c.fill<uint32_t>(0);
+    bnn::bconv_direct(padded, b, c, 1);
+
+    bnn::Mat expected(CHEIGHT, CWIDTH, NUM_OUTPUT, bnn::DataType::Float);
+    expected.fill<uint32_t>(0);
+    bnn::baseline_bconv(a, b, 5, 5, 2, 2, 1, 1, 1, 1, NUM_OUTPUT, expected);
+
+    ASSERT_EQ(c, expected);
+}
+
+TEST(bconv_test, bconv_test_7x7_192_s2) {
+    const size_t AHEIGHT = 20;
+    const size_t AWIDTH = 20;
+    const size_t CHANNEL = 192;
+
+    const size_t BHEIGHT = 7;
+    const size_t BWIDTH = 7;
+    const size_t NUM_OUTPUT = 70;
+
+    const size_t CHEIGHT = AHEIGHT / 2;
+    const size_t CWIDTH = AWIDTH / 2;
+
+    const size_t ALEN = AHEIGHT * AWIDTH * CHANNEL / sizeof(uint64_t);
+    const size_t BLEN =
+        NUM_OUTPUT * BHEIGHT * BWIDTH * CHANNEL / sizeof(uint64_t);
+
+    uint64_t a_data[ALEN];
+    uint64_t b_data[BLEN];
+    fill_rand_uint64(a_data, ALEN);
+    fill_rand_uint64(b_data, BLEN);
+
+    const bnn::Mat a(AHEIGHT, AWIDTH, CHANNEL, a_data, bnn::DataType::Bit);
+    bnn::Mat padded(AHEIGHT + 6, AWIDTH + 6, CHANNEL, bnn::DataType::Bit);
+    pad(a, 3, 3, padded);
+    const bnn::Mat b(NUM_OUTPUT, BHEIGHT, BWIDTH, CHANNEL, b_data,
+                     bnn::DataType::Bit, false);
+
+    bnn::Mat c(CHEIGHT, CWIDTH, NUM_OUTPUT, bnn::DataType::Float);
+    c.fill<uint32_t>(0);
+    bnn::bconv_direct(padded, b, c, 2);
+
+    bnn::Mat expected(CHEIGHT, CWIDTH, NUM_OUTPUT, bnn::DataType::Float);
+    expected.fill<uint32_t>(0);
+    bnn::baseline_bconv(a, b, 7, 7, 3, 3, 2, 2, 1, 1, NUM_OUTPUT, expected);
+
+    ASSERT_EQ(c, expected);
+}
+
+TEST(bconv_test, bconv_test_3x3_128_dilation_2) {
+    const size_t AHEIGHT = 20;
+    const size_t AWIDTH = 20;
+    const size_t CHANNEL = 128;
+
+    const size_t BHEIGHT = 3;
+    const size_t BWIDTH = 3;
+    const size_t NUM_OUTPUT = 64;
+
+    const size_t CHEIGHT = AHEIGHT;
+    const size_t CWIDTH = AWIDTH;
+
+    const size_t ALEN = AHEIGHT * AWIDTH * CHANNEL / sizeof(uint64_t);
+    const size_t BLEN =
+        NUM_OUTPUT * BHEIGHT * BWIDTH * CHANNEL / sizeof(uint64_t);
+
+    uint64_t a_data[ALEN];
+    uint64_t b_data[BLEN];
+    fill_rand_uint64(a_data, ALEN);
+    fill_rand_uint64(b_data, BLEN);
+
+    const bnn::Mat a(AHEIGHT, AWIDTH, CHANNEL, a_data, bnn::DataType::Bit);
+    bnn::Mat padded(AHEIGHT + 4, AWIDTH + 4, CHANNEL, bnn::DataType::Bit);
+    pad(a, 2, 2, padded);
+    const bnn::Mat b(NUM_OUTPUT, BHEIGHT, BWIDTH, CHANNEL, b_data,
+                     bnn::DataType::Bit, false);
+
+    bnn::Mat c(CHEIGHT, CWIDTH, NUM_OUTPUT, bnn::DataType::Float);
+    c.fill<uint32_t>(0);
+    bnn::bconv_direct(padded, b, c, 1, 2, 2);
+
+    bnn::Mat expected(CHEIGHT, CWIDTH, NUM_OUTPUT, bnn::DataType::Float);
+    expected.fill<uint32_t>(0);
+    bnn::baseline_bconv(a, b, 3, 3, 2, 2, 1, 1, 2, 2, NUM_OUTPUT, expected);
+
+    ASSERT_EQ(c, expected);
+}
+
+TEST(bconv_test, bconv_test_depthwise_3x3_192) {
+    const size_t AHEIGHT = 14;
+    const size_t AWIDTH = 14;
+    const size_t CHANNEL = 192;
+
+    const size_t BHEIGHT = 3;
+    const size_t BWIDTH = 3;
+
+    const size_t CHEIGHT = AHEIGHT;
+    const size_t CWIDTH = AWIDTH;
+
+    const size_t ALEN = AHEIGHT * AWIDTH * CHANNEL / sizeof(uint64_t);
+    const size_t BLEN = BHEIGHT * BWIDTH * CHANNEL / sizeof(uint64_t);
+
+    uint64_t a_data[ALEN];
+    uint64_t b_data[BLEN];
+    fill_rand_uint64(a_data, ALEN);
+    fill_rand_uint64(b_data, BLEN);
+
+    const bnn::Mat a(AHEIGHT, AWIDTH, CHANNEL, a_data, bnn::DataType::Bit);
+    bnn::Mat padded(AHEIGHT + 2, AWIDTH + 2, CHANNEL, bnn::DataType::Bit);
+    pad(a, 1, 1, padded);
+    const bnn::Mat b(1, BHEIGHT, BWIDTH, CHANNEL, b_data, bnn::DataType::Bit,
+                     false);
+
+    bnn::Mat c(CHEIGHT, CWIDTH, CHANNEL, bnn::DataType::Float);
+    c.fill<uint32_t>(0);
+    bnn::bconv_group(padded, b, c, CHANNEL, 1, 1);
+
+    bnn::Mat expected(CHEIGHT, CWIDTH, CHANNEL, bnn::DataType::Float);
+    expected.fill<uint32_t>(0);
+    bnn::baseline_bconv_group(a, b, 3, 3, 1, 1, 1, 1, 1, 1, CHANNEL,
+                              expected);
+
+    ASSERT_EQ(c, expected);
+}
+
+TEST(bconv_test, bconv_test_depthwise_5x5_128_s2) {
+    const size_t AHEIGHT = 15;
+    const size_t AWIDTH = 15;
+    const size_t CHANNEL = 128;
+
+    const size_t BHEIGHT = 5;
+    const size_t BWIDTH = 5;
+
+    const size_t CHEIGHT = (AHEIGHT + 4 - BHEIGHT) / 2 + 1;
+    const size_t CWIDTH = (AWIDTH + 4 - BWIDTH) / 2 + 1;
+
+    const size_t ALEN = AHEIGHT * AWIDTH * CHANNEL / sizeof(uint64_t);
+    const size_t BLEN = BHEIGHT * BWIDTH * CHANNEL / sizeof(uint64_t);
+
+    uint64_t a_data[ALEN];
+    uint64_t b_data[BLEN];
+    fill_rand_uint64(a_data, ALEN);
+    fill_rand_uint64(b_data, BLEN);
+
+    const bnn::Mat a(AHEIGHT, AWIDTH, CHANNEL, a_data, bnn::DataType::Bit);
+    bnn::Mat padded(AHEIGHT + 4, AWIDTH + 4, CHANNEL, bnn::DataType::Bit);
+    pad(a, 2, 2, padded);
+    const bnn::Mat b(1, BHEIGHT, BWIDTH, CHANNEL, b_data, bnn::DataType::Bit,
+                     false);
+
+    bnn::Mat c(CHEIGHT, CWIDTH, CHANNEL, bnn::DataType::Float);
+    c.fill<uint32_t>(0);
+    bnn::bconv_group(padded, b, c, CHANNEL, 2, 2);
+
+    bnn::Mat expected(CHEIGHT, CWIDTH, CHANNEL, bnn::DataType::Float);
+    expected.fill<uint32_t>(0);
+    bnn::baseline_bconv_group(a, b, 5, 5, 2, 2, 2, 2, 1, 1, CHANNEL,
+                              expected);
+
+    ASSERT_EQ(c, expected);
+}
+
+TEST(bconv_test, bconv_test_group_3x3_256_g2) {
+    const size_t AHEIGHT = 14;
+    const size_t AWIDTH = 14;
+    const size_t CHANNEL = 256;
+    const size_t GROUP = 2;
+
+    const size_t BHEIGHT = 3;
+    const size_t BWIDTH = 3;
+    const size_t NUM_OUTPUT = 100;
+
+    const size_t CHEIGHT = AHEIGHT;
+    const size_t CWIDTH = AWIDTH;
+
+    const size_t ALEN = AHEIGHT * AWIDTH * CHANNEL / sizeof(uint64_t);
+    const size_t BLEN =
+        NUM_OUTPUT * BHEIGHT * BWIDTH * CHANNEL / GROUP / sizeof(uint64_t);
+
+    uint64_t a_data[ALEN];
+    uint64_t b_data[BLEN];
+    fill_rand_uint64(a_data, ALEN);
+    fill_rand_uint64(b_data, BLEN);
+
+    const bnn::Mat a(AHEIGHT, AWIDTH, CHANNEL, a_data, bnn::DataType::Bit);
+    bnn::Mat padded(AHEIGHT + 2, AWIDTH + 2, CHANNEL, bnn::DataType::Bit);
+    pad(a, 1, 1, padded);
+    const bnn::Mat b(NUM_OUTPUT, BHEIGHT, BWIDTH, CHANNEL / GROUP, b_data,
+                     bnn::DataType::Bit, false);
+
+    bnn::Mat c(CHEIGHT, CWIDTH, NUM_OUTPUT, bnn::DataType::Float);
+    c.fill<uint32_t>(0);
+    bnn::bconv_group(padded, b, c, GROUP, 1, 1);
+
+    bnn::Mat expected(CHEIGHT, CWIDTH, NUM_OUTPUT, bnn::DataType::Float);
+    expected.fill<uint32_t>(0);
+    bnn::baseline_bconv_group(a, b, 3, 3, 1, 1, 1, 1, 1, 1, GROUP, expected);
+
+    ASSERT_EQ(c, expected);
+
+    // The window of a layer instead of one allocated by the call
+    std::vector<uint64_t> window(bnn::bconv_window_len(b, GROUP, 1));
+    ASSERT_EQ(window.size(), BHEIGHT * BWIDTH * CHANNEL / GROUP / 64);
+    c.fill<uint32_t>(0);
+    bnn::bconv_group(padded, b, c, GROUP, 1, 1, 1, 1, window.data());
+    ASSERT_EQ(c, expected);
+}
+
+TEST(bconv_test, bconv_test_group_3x3_128_g2_aligned_weight) {
+    // The converter pads the weight of every output channel to 128 bits
+    const size_t AHEIGHT = 10;
+    const size_t AWIDTH = 10;
+    const size_t CHANNEL = 128;
+    const size_t GROUP = 2;
+
+    const size_t BHEIGHT = 3;
+    const size_t BWIDTH = 3;
+    const size_t NUM_OUTPUT = 16;
+
+    const size_t CHEIGHT = AHEIGHT / 2;
+    const size_t CWIDTH = AWIDTH / 2;
+
+    const size_t ALEN = AHEIGHT * AWIDTH * CHANNEL / sizeof(uint64_t);
+    // 9 uint64_t are padded to 10
+    const size_t BLEN = NUM_OUTPUT * 10;
+
+    uint64_t a_data[ALEN];
+    uint64_t b_data[BLEN];
+    fill_rand_uint64(a_data, ALEN);
+    fill_rand_uint64(b_data, BLEN);
+
+    const bnn::Mat a(AHEIGHT, AWIDTH, CHANNEL, a_data, bnn::DataType::Bit);
+    bnn::Mat padded(AHEIGHT + 2, AWIDTH + 2, CHANNEL, bnn::DataType::Bit);
+    pad(a, 1, 1, padded);
+    const bnn::Mat b(NUM_OUTPUT, BHEIGHT, BWIDTH, CHANNEL / GROUP, b_data,
+                     bnn::DataType::Bit, BLEN, false);
+
+    bnn::Mat c(CHEIGHT, CWIDTH, NUM_OUTPUT, bnn::DataType::Float);
+    c.fill<uint32_t>(0);
+    bnn::bconv_group(padded, b, c, GROUP, 2, 2);
+
+    bnn::Mat expected(CHEIGHT, CWIDTH, NUM_OUTPUT, bnn::DataType::Float);
+    expected.fill<uint32_t>(0);
+    bnn::baseline_bconv_group(a, b, 3, 3, 1, 1, 2, 2, 1, 1, GROUP, expected);
+
+    ASSERT_EQ(c, expected);
+}
+
+TEST(bconv_test, bconv_test_group_net_reference) {
+    // The reference net runs the grouped conv bit by bit
+    bnn::TestModel model({1, 6, 6, 256});
+    std::vector<uint64_t> weight(64 * 3 * 3 * 128 / 64);
+    fill_rand_uint64(weight.data(), weight.size());
+    model.add_bit("weight", {64, 3, 3, 128}, weight);
+    model.bin_conv("input", "weight", "bconv", 1, 1, 2);
+    const auto buf = model.finish();
+    std::vector<float> input(6 * 6 * 256);
+    fill_rand_float(input.data(), input.size());
+
+    auto reference = bnn::Net::create();
+    reference->optimize = false;
+    reference->profile = true;
+    reference->read_buf(buf.data());
+    reference->run(input.data());
+    auto net = bnn::Net::create();
+    net->profile = true;
+    net->read_buf(buf.data());
+    net->run(input.data());
+
+    ASSERT_NE(reference->profiler.entries()[0].detail.find("group naive"),
+              std::string::npos);
+    ASSERT_EQ(net->profiler.entries()[0].detail.find("naive"),
+              std::string::npos);
+    ASSERT_EQ(*net->get_blob("bconv"), *reference->get_blob("bconv"));
+}
@@ -2,6 +2,7 @@
 
 #include <common/baseline.h>
 #include <dabnn/bgemm.h>
+#include <dabnn/fused_binarize_im2col.h>
 #include <dabnn/im2col.h>
 #include <dabnn/mat.h>
 
@@ -179,3 +180,91 @@ TEST(bgemm, bgemm_512) {
 
     ASSERT_EQ(std::memcmp(c, c_navie, sizeof(c)), 0);
 }
+
+TEST(bgemm, bgemm_blocking) {
+    const int m = 128;
+    const int n = 56 * 56;
+    const int k = 18;
+
+    uint64_t a[m * k];
+    uint64_t b[k * n];
+    fill_rand_uint64(a, m * k);
+    fill_rand_uint64(b, k * n);
+    float c[m * n] = {};
+    float c_navie[m * n] = {};
+    // Small blocks so that every level of blocking has a tail
+    bgemm(m, n, k, a, m, b, k, c, m, BgemmBlocking{4, 48, 90});
+    bgemm_naive(m, n, k, a, m, b, k, c_navie, m);
+
+    ASSERT_EQ(std::memcmp(c, c_navie, sizeof(c)), 0);
+}
+
+TEST(bgemm, bgemm_blocking_from_cache) {
+    bnn::CacheInfo a53;
+    a53.l1d = 32 * 1024;
+    a53.l2 = 512 * 1024;
+    bnn::CacheInfo server;
+    server.l1d = 64 * 1024;
+    server.l2 = 1024 * 1024;
+    server.l3 = 32 * 1024 * 1024;
+    for (const auto &cache : {a53, server, bnn::cache_info()}) {
+        for (const int k : {18, 36, 72, 100, 1024}) {
+            const auto blocking = bgemm_blocking(cache, 256, 112 * 112, k);
+            ASSERT_EQ(blocking.kc % 2, 0);
+            ASSERT_GT(blocking.mc, 0);
+            ASSERT_GT(blocking.nc, 0);
+            const int kc = std::min(k, blocking.kc);
+            ASSERT_LE(blocking.mc * kc, 128000);
+            ASSERT_LE(blocking.nc * kc, 128000);
+        }
+    }
+}
+
+TEST(bgemm, bconv_dilation_2) {
+    const size_t AHEIGHT = 16;
+    const size_t AWIDTH = 16;
+    const size_t CHANNEL = 128;
+
+    const size_t BHEIGHT = 3;
+    const size_t BWIDTH = 3;
+    const size_t NUM_OUTPUT = 64;
+
+    const size_t CHEIGHT = AHEIGHT - 4;
+    const size_t CWIDTH = AWIDTH - 4;
+
+    const size_t ALEN = AHEIGHT * AWIDTH * CHANNEL;
+    const size_t BLEN = NUM_OUTPUT * BHEIGHT * BWIDTH * CHANNEL / 64;
+
+    float a_data[ALEN];
+    uint64_t b_data[BLEN];
+    fill_rand_float(a_data, ALEN);
+    fill_rand_uint64(b_data, BLEN);
+
+    const bnn::Mat a(AHEIGHT, AWIDTH, CHANNEL, a_data, bnn::DataType::Float);
+    bnn::Mat a_binary(AHEIGHT, AWIDTH, CHANNEL, bnn::DataType::Bit);
+    const bnn::Mat b(NUM_OUTPUT, BHEIGHT, BWIDTH, CHANNEL, b_data,
+                     bnn::DataType::Bit, false);
+    bnn::Mat expected(CHEIGHT, CWIDTH, NUM_OUTPUT, bnn::DataType::Float);
+    expected.fill<uint32_t>(0);
+    bnn::baseline_bconv_float(a, a_binary, b, 3, 3, 0, 0, 1, 1, 2, 2,
+                              NUM_OUTPUT, expected);
+
+    const int m = NUM_OUTPUT;
+    const int n = CHEIGHT * CWIDTH;
+    const int k = BHEIGHT * BWIDTH * CHANNEL / 64;
+    uint64_t b_data_[BLEN];
+    FORZ(i, k) {
+        FORZ(j, m) { b_data_[i * m + j] = b_data[j * k + i]; }
+    }
+
+    bnn::Mat a_col(CHEIGHT * CWIDTH * BHEIGHT * BWIDTH * CHANNEL,
+                   bnn::DataType::Bit);
+    bnn::fused_binarize_im2col(a, BHEIGHT, BWIDTH, 0, 0, 1, 1, 2, 2, a_col);
+
+    bnn::Mat c(CHEIGHT, CWIDTH, NUM_OUTPUT, bnn::DataType::Float);
+    c.fill<float>(0.f);
+    bgemm(m, n, k, b_data_, m, static_cast<uint64_t *>(a_col.data), k,
+          static_cast<float *>(c.data), m);
+
+    ASSERT_EQ(c, expected);
+}
@@ -0,0 +1,111 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#include <vector>
+
+#include <common/helper.h>
+#include <dabnn/net.h>
+#include <gtest/gtest.h>
+#include "test_model.h"
+
+using namespace bnn;
+
+namespace {
+
+/**
+ * input [n, 8, 8, 64] -> MaxPool 3x3/2 "pool" -> BinConv2D 3x3 "bconv1"
+ *                                             -> depthwise BinConv2D "dw"
+ *                     -> MaxPool 2x2/2 "pool2"
+ * Concat(pool2, bconv1) "cat" -> BinConv2D 2x2 "bconv2"
+ *
+ * pool and cat are only read by binary convs, pool2 is read by the concat.
+ * The convs cover the direct conv, the group conv and the bgemm.
+ */
+std::vector<uint8_t> build_model(const uint32_t n) {
+    TestModel model({n, 8, 8, 64});
+    std::vector<uint64_t> w1(64 * 3 * 3), dw(3 * 3), w2(32 * 2 * 2 * 2);
+    for (auto *weight : {&w1, &dw, &w2}) {
+        fill_rand_uint64(weight->data(), weight->size());
+    }
+    model.add_bit("w1", {64, 3, 3, 64}, w1);
+    model.add_bit("dw_weight", {1, 3, 3, 64}, dw);
+    model.add_bit("w2", {32, 2, 2, 128}, w2);
+
+    model.max_pool("input", 3, 1, 2, "pool");
+    model.bin_conv("pool", "w1", "bconv1", 1, 1);
+    model.bin_conv("pool", "dw_weight", "dw", 1, 1, 64);
+    model.max_pool("input", 2, 0, 2, "pool2");
+    model.concat({"pool2", "bconv1"}, 3, "cat");
+    model.bin_conv("cat", "w2", "bconv2", 0, 1);
+    return model.finish();
+}
+
+/**
+ * input [1, 4, 4, 32] -> MaxPool 3x3 "pool1"
+ *                     -> MaxPool 1x1 "pool2"
+ * Concat(pool1, pool2) "cat" -> BinConv2D 3x3 "bconv"
+ *
+ * cat has 64 channels but its inputs have 32, so it stays float
+ */
+std::vector<uint8_t> build_narrow_concat_model() {
+    TestModel model({1, 4, 4, 32});
+    std::vector<uint64_t> weight(64 * 3 * 3);
+    fill_rand_uint64(weight.data(), weight.size());
+    model.add_bit("weight", {64, 3, 3, 64}, weight);
+
+    model.max_pool("input", 3, 1, 1, "pool1");
+    model.max_pool("input", 1, 0, 1, "pool2");
+    model.concat({"pool1", "pool2"}, 3, "cat");
+    model.bin_conv("cat", "weight", "bconv", 1, 1);
+    return model.finish();
+}
+
+void expect_equal(const Mat &actual, const Mat &expected) {
+    ASSERT_EQ(actual.data_type, DataType::Float);
+    ASSERT_EQ(actual.total(), expected.total());
+    FORZ(i, expected.total()) { ASSERT_FLOAT_EQ(actual[i], expected[i]) << i; }
+}
+
+}  // namespace
+
+TEST(bit_pool, same_as_float) {
+    for (const uint32_t n : {1u, 2u}) {
+        const auto buf = build_model(n);
+        std::vector<float> input(n * 8 * 8 * 64);
+        fill_rand_float(input.data(), input.size());
+        // Some ties and zeros, which are -1 as bits
+        FORZS(i, input.size(), 7) { input[i] = 0.f; }
+
+        auto reference = Net::create();
+        reference->optimize = false;
+        reference->read_buf(buf.data());
+        reference->run(input.data(), n);
+        auto net = Net::create();
+        net->read_buf(buf.data());
+        net->run(input.data(), n);
+
+        ASSERT_EQ(reference->get_blob("pool")->data_type, DataType::Float);
+        ASSERT_EQ(net->get_blob("pool")->data_type, DataType::Bit);
+        ASSERT_EQ(net->get_blob("cat")->data_type, DataType::Bit);
+        ASSERT_EQ(net->get_blob("pool2")->data_type, DataType::Float);
+        for (const auto *name : {"bconv1", "dw", "bconv2"}) {
+            expect_equal(*net->get_blob(name), *reference->get_blob(name));
+        }
+    }
+}
+
+TEST(bit_pool, narrow_concat_inputs) {
+    const auto buf = build_narrow_concat_model();
+    std::vector<float> input(4 * 4 * 32);
+    fill_rand_float(input.data(), input.size());
+
+    auto reference = Net::create();
+    reference->optimize = false;
+    reference->read_buf(buf.data());
+    reference->run(input.data());
+    auto net = Net::create();
+    net->read_buf(buf.data());
+    net->run(input.data());
+
+    ASSERT_EQ(net->get_blob("cat")->data_type, DataType::Float);
+    expect_equal(*net->get_blob("bconv"), *reference->get_blob("bconv"));
+}
@@ -0,0 +1,146 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#include <dabnn/gemv.h>
+
+#include <cmath>
+#include <vector>
+
+#include <common/helper.h>
+#include <dabnn/net.h>
+#include <dabnn/softmax.h>
+#include <gtest/gtest.h>
+#include "test_model.h"
+
+namespace {
+
+const int kUnits = 10;
+
+/**
+ * input [1, 4, 4, channels] -> global AvePool -> FC -> Softmax
+ */
+std::vector<uint8_t> build_head_model(const int channels, const bool binary,
+                                      std::vector<float> &weight,
+                                      std::vector<float> &bias) {
+    const auto c = static_cast<uint32_t>(channels);
+    bnn::TestModel model({1, 4, 4, c});
+    weight.resize(kUnits * channels);
+    bias.resize(kUnits);
+    fill_rand_float(weight.data(), weight.size());
+    fill_rand_float(bias.data(), bias.size());
+    if (binary) {
+        // Like onnx2bnn, every unit is padded to 128 bits
+        const int words = (channels + 127) / 128 * 2;
+        std::vector<uint64_t> bin_weight(kUnits * words);
+        FORZ(u, kUnits) {
+            FORZ(i, channels / 64) {
+                pack_64_bitfield(&weight[u * channels + i * 64],
+                                 &bin_weight[u * words + i]);
+            }
+        }
+        model.add_bit("weight", {kUnits, 1, 1, c}, bin_weight, true);
+    } else {
+        model.add_float("weight", {kUnits, c}, weight);
+    }
+    model.add_float("bias", {kUnits}, bias);
+
+    model.ave_pool("input", 4, 0, 1, "pooled");
+    model.fc("pooled", "weight", "bias", "logits");
+    model.softmax("logits", "prob");
+    return model.finish();
+}
+
+std::vector<float> expected_head(const std::vector<float> &input,
+                                 const int channels, const bool binary,
+                                 const std::vector<float> &weight,
+                                 const std::vector<float> &bias) {
+    std::vector<float> pooled(channels);
+    FORZ(i, 16) {
+        FORZ(c, channels) { pooled[c] += input[i * channels + c] / 16; }
+    }
+    std::vector<float> prob(kUnits);
+    FORZ(u, kUnits) {
+        float sum = bias[u];
+        FORZ(c, channels) {
+            const float w = weight[u * channels + c];
+            if (binary) {
+                sum += (pooled[c] < 0) == (w < 0) ? 1 : -1;
+            } else {
+                sum += pooled[c] * w;
+            }
+        }
+        prob[u] = sum;
+    }
+    bnn::softmax(prob.data(), kUnits, prob.data());
+    return prob;
+}
+
+void test_head(const int channels, const bool binary) {
+    std::vector<float> weight, bias;
+    const auto buf = build_head_model(channels, binary, weight, bias);
+    std::vector<float> input(16 * channels);
+    fill_rand_float(input.data(), input.size());
+    const auto expected = expected_head(input, channels, binary, weight, bias);
+
+    for (const bool optimize : {false, true}) {
+        auto net = bnn::Net::create();
+        net->optimize = optimize;
+        net->read_buf(buf.data());
+        net->run(input.data());
+        const auto &prob = *net->get_blob("prob");
+        FORZ(u, kUnits) { ASSERT_NEAR(prob[u], expected[u], 1e-5); }
+        const auto top = net->top_k("prob", 3);
+        ASSERT_EQ(top.size(), 3u);
+        ASSERT_GE(top[0].second, top[1].second);
+        ASSERT_GE(top[1].second, top[2].second);
+        FORZ(u, kUnits) { ASSERT_LE(prob[u], top[0].second); }
+    }
+}
+
+}  // namespace
+
+TEST(fc_test, fgemv) {
+    const int m = 13, k = 129;
+    std::vector<float> a(m * k), x(k), bias(m), y(m);
+    fill_rand_float(a.data(), a.size());
+    fill_rand_float(x.data(), x.size());
+    fill_rand_float(bias.data(), bias.size());
+    bnn::fgemv(m, k, a.data(), k, x.data(), bias.data(), y.data());
+    FORZ(i, m) {
+        float expected = bias[i];
+        FORZ(j, k) { expected += a[i * k + j] * x[j]; }
+        ASSERT_NEAR(y[i], expected, 1e-4);
+    }
+}
+
+TEST(fc_test, bgemv) {
+    const int m = 13, k = 7, lda = 8;
+    std::vector<uint64_t> a(m * lda), x(k);
+    std::vector<float> y(m);
+    fill_rand_uint64(a.data(), a.size());
+    fill_rand_uint64(x.data(), x.size());
+    bnn::bgemv(m, k, a.data(), lda, x.data(), y.data());
+    FORZ(i, m) {
+        uint32_t expected = 0;
+        FORZ(j, k) { expected += bitcount(a[i * lda + j] ^ x[j]); }
+        ASSERT_EQ(y[i], expected);
+    }
+}
+
+TEST(fc_test, softmax) {
+    const std::vector<float> x{1.f, 2.f, 3.f, 4.f};
+    std::vector<float> y(x.size());
+    bnn::softmax(x.data(), x.size(), y.data());
+    ASSERT_NEAR(y[0] + y[1] + y[2] + y[3], 1.f, 1e-6);
+    ASSERT_NEAR(y[1] / y[0], std::exp(1.f), 1e-4);
+    // No overflow for large inputs
+    const std::vector<float> large{1000.f, 1000.f};
+    bnn::softmax(large.data(), large.size(), y.data());
+    ASSERT_NEAR(y[0], 0.5f, 1e-6);
+    const auto top = bnn::top_k(x.data(), x.size(), 2);
+    ASSERT_EQ(top[0].first, 3);
+    ASSERT_EQ(top[1].first, 2);
+}
+
+TEST(fc_test, float_classifier_head) { test_head(128, false); }
+
+TEST(fc_test, binary_classifier_head) { test_head(192, true); }
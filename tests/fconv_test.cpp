@@ -2,12 +2,16 @@
 
 #include <dabnn/fconv.h>
 
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include <common/baseline.h>
 #include <common/helper.h>
 #include <common/log_helper.h>
 #include <dabnn/mat.h>
+#include <dabnn/net.h>
+#include "test_model.h"
 
 namespace bnn {
 
@@ -173,4 +177,328 @@ TEST(fconv, fconv_dilated) {
     ASSERT_EQ(output, output_expected.flatten());
 }
 
+TEST(fconv, fconv_1x1) {
+    const int in_c = 32;
+    const int out_c = 20;
+    const int h = 7;
+    const int w = 7;
+    const size_t len = h * w * in_c;
+    float data[len];
+    fill_rand_float(data, len);
+    Mat im(h, w, in_c, data, DataType::Float);
+
+    const size_t w_len = out_c * in_c;
+    float weight_data[w_len];
+    fill_rand_float(weight_data, w_len);
+    Mat weight(w_len, weight_data, DataType::Float);
+
+    const size_t output_len = h * w * out_c;
+    Mat output(output_len, DataType::Float);
+    Mat output_expected(h, w, out_c, DataType::Float);
+    output_expected.fill<float>(0);
+
+    fconv(im, weight, 1, 1, 0, 0, 1, 1, 1, 1, out_c, output);
+
+    baseline_fconv(im, weight, 1, 1, 0, 0, 1, 1, 1, 1, out_c,
+                   output_expected);
+
+    ASSERT_EQ(output, output_expected.flatten());
+}
+
+TEST(fconv, fconv_1x1_stride) {
+    const int in_c = 16;
+    const int out_c = 24;
+    const int h = 8;
+    const int w = 8;
+    const size_t len = h * w * in_c;
+    float data[len];
+    fill_rand_float(data, len);
+    Mat im(h, w, in_c, data, DataType::Float);
+
+    const size_t w_len = out_c * in_c;
+    float weight_data[w_len];
+    fill_rand_float(weight_data, w_len);
+    Mat weight(w_len, weight_data, DataType::Float);
+
+    const size_t output_len = h / 2 * w / 2 * out_c;
+    Mat output(output_len, DataType::Float);
+    Mat output_expected(h / 2, w / 2, out_c, DataType::Float);
+    output_expected.fill<float>(0);
+
+    fconv(im, weight, 1, 1, 0, 0, 2, 2, 1, 1, out_c, output);
+
+    baseline_fconv(im, weight, 1, 1, 0, 0, 2, 2, 1, 1, out_c,
+                   output_expected);
+
+    ASSERT_EQ(output, output_expected.flatten());
+}
+
+TEST(fconv, fconv_deep) {
+    // The depth 3 * 3 * 96 is split into several blocks
+    const int in_c = 96;
+    const int out_c = 13;
+    const int h = 4;
+    const int w = 4;
+    const size_t len = h * w * in_c;
+    float data[len];
+    fill_rand_float(data, len);
+    Mat im(h, w, in_c, data, DataType::Float);
+
+    const size_t w_len = out_c * 3 * 3 * in_c;
+    float weight_data[w_len];
+    fill_rand_float(weight_data, w_len);
+    Mat weight(w_len, weight_data, DataType::Float);
+
+    const size_t output_len = h * w * out_c;
+    Mat output(output_len, DataType::Float);
+    Mat output_expected(h, w, out_c, DataType::Float);
+    output_expected.fill<float>(0);
+
+    fconv(im, weight, 3, 3, 1, 1, 1, 1, 1, 1, out_c, output);
+
+    baseline_fconv(im, weight, 3, 3, 1, 1, 1, 1, 1, 1, out_c,
+                   output_expected);
+
+    ASSERT_EQ(output, output_expected.flatten());
+}
+
+TEST(fconv, fconv_packed_epilogue) {
+    const int in_c = 8;
+    const int out_c = 12;
+    const int h = 6;
+    const int w = 6;
+    const size_t len = h * w * in_c;
+    float data[len];
+    fill_rand_float(data, len);
+    Mat im(h, w, in_c, data, DataType::Float);
+
+    const int k = 3 * 3 * in_c;
+    const size_t w_len = out_c * k;
+    float weight_data[w_len];
+    fill_rand_float(weight_data, w_len);
+    Mat weight(w_len, weight_data, DataType::Float);
+    std::vector<float> packed_weight(fgemm_packed_size(out_c, k));
+    fgemm_pack_weight(out_c, k, weight_data, k, packed_weight.data());
+
+    float bias[out_c], scale[out_c], shift[out_c];
+    fill_rand_float(bias, out_c);
+    fill_rand_float(scale, out_c);
+    fill_rand_float(shift, out_c);
+    FgemmEpilogue epilogue;
+    epilogue.bias = bias;
+    epilogue.scale = scale;
+    epilogue.shift = shift;
+    epilogue.relu = true;
+
+    Mat output(h, w, out_c, DataType::Float);
+    fconv_packed(im, packed_weight.data(), 3, 3, 1, 1, 1, 1, 1, 1, out_c,
+                 epilogue, output);
+
+    Mat output_expected(h, w, out_c, DataType::Float);
+    output_expected.fill<float>(0);
+    baseline_fconv(im, weight, 3, 3, 1, 1, 1, 1, 1, 1, out_c,
+                   output_expected);
+    FORZ(i, h * w) {
+        FORZ(j, out_c) {
+            auto &v = output_expected[i * out_c + j];
+            v = std::max((v + bias[j]) * scale[j] + shift[j], 0.f);
+        }
+    }
+
+    ASSERT_EQ(output, output_expected);
+}
+
+TEST(fconv, fconv_uint8_stem) {
+    // A 7x7 stride 2 stem on a uint8 image
+    const int in_c = 3;
+    const int out_c = 20;
+    const int h = 16;
+    const int w = 16;
+    const int k = 7 * 7 * in_c;
+    std::vector<uint8_t> image(h * w * in_c);
+    FORZ(i, image.size()) { image[i] = static_cast<uint8_t>(i * 37 % 256); }
+    const float mean[in_c] = {124.f, 116.f, 104.f};
+    const float scale[in_c] = {1 / 58.f, 1 / 57.f, 1 / 57.5f};
+    std::vector<float> input(image.size());
+    FORZ(i, image.size()) {
+        input[i] = (image[i] - mean[i % in_c]) * scale[i % in_c];
+    }
+    const Mat im(h, w, in_c, input.data(), DataType::Float);
+
+    std::vector<float> weight_data(out_c * k);
+    fill_rand_float(weight_data.data(), weight_data.size());
+    Mat weight(weight_data.size(), weight_data.data(), DataType::Float);
+    std::vector<float> packed_weight(fgemm_packed_size(out_c, k));
+    fgemm_pack_weight(out_c, k, weight_data.data(), k, packed_weight.data());
+
+    const int output_h = fconv_output_size(h, 7, 3, 2, 1);
+    const int output_w = fconv_output_size(w, 7, 3, 2, 1);
+    Mat output(output_h, output_w, out_c, DataType::Float);
+    fconv_packed_uint8(image.data(), 1, h, w, in_c, mean, scale,
+                       packed_weight.data(), 7, 7, 3, 3, 2, 2, 1, 1, out_c,
+                       FgemmEpilogue(), output);
+
+    Mat output_expected(output_h, output_w, out_c, DataType::Float);
+    output_expected.fill<float>(0);
+    baseline_fconv(im, weight, 7, 7, 3, 3, 2, 2, 1, 1, out_c,
+                   output_expected);
+
+    ASSERT_EQ(output, output_expected);
+}
+
+/**
+ * input [1, h, w, in_c] -> FpConv2D with bias -> Affine -> Relu
+ */
+std::vector<uint8_t> build_conv_model(
+    const int h, const int w, const int in_c, const int out_c,
+    const int kernel, const int stride, const std::vector<float> &weight,
+    const std::vector<float> &bias, const std::vector<float> &a,
+    const std::vector<float> &b) {
+    TestModel model({1, static_cast<uint32_t>(h), static_cast<uint32_t>(w),
+                     static_cast<uint32_t>(in_c)});
+    const auto m = static_cast<uint32_t>(out_c);
+    const auto k = static_cast<uint32_t>(kernel);
+    model.add_float("weight", {m, k, k, static_cast<uint32_t>(in_c)}, weight);
+    model.add_float("bias", {m}, bias);
+    model.add_float("a", {m}, a);
+    model.add_float("b", {m}, b);
+
+    model.fp_conv("input", "weight", "bias", "conv", kernel / 2, stride);
+    model.affine("conv", "a", "b", "bn");
+    model.relu("bn", "relu");
+    return model.finish();
+}
+
+/**
+ * The output of build_conv_model computed by baseline_fconv
+ */
+void expected_conv_model(const Mat &input, const int out_c, const int kernel,
+                         const int stride, const std::vector<float> &weight,
+                         const std::vector<float> &bias,
+                         const std::vector<float> &a,
+                         const std::vector<float> &b, Mat &expected) {
+    const Mat weight_mat(weight.size(), const_cast<float *>(weight.data()),
+                         DataType::Float);
+    expected.fill<float>(0);
+    const int pad = kernel / 2;
+    baseline_fconv(input, weight_mat, kernel, kernel, pad, pad, stride, stride,
+                   1, 1, out_c, expected);
+    FORZ(i, expected.h * expected.w) {
+        FORZ(j, out_c) {
+            auto &v = expected[i * out_c + j];
+            v = std::max(a[j] * (v + bias[j]) + b[j], 0.f);
+        }
+    }
+}
+
+/**
+ * The affine and relu are fused into the conv when the net is optimized
+ */
+TEST(fconv, float_conv_fused_epilogue) {
+    const int in_c = 8;
+    const int out_c = 16;
+    const int h = 6;
+    const int w = 6;
+    std::vector<float> weight(out_c * 3 * 3 * in_c), bias(out_c), a(out_c),
+        b(out_c);
+    fill_rand_float(weight.data(), weight.size());
+    fill_rand_float(bias.data(), bias.size());
+    fill_rand_float(a.data(), a.size());
+    fill_rand_float(b.data(), b.size());
+    const auto buf =
+        build_conv_model(h, w, in_c, out_c, 3, 1, weight, bias, a, b);
+
+    std::vector<float> input(h * w * in_c);
+    fill_rand_float(input.data(), input.size());
+    const Mat im(h, w, in_c, input.data(), DataType::Float);
+    Mat expected(h, w, out_c, DataType::Float);
+    expected_conv_model(im, out_c, 3, 1, weight, bias, a, b, expected);
+
+    for (const bool optimize : {false, true}) {
+        auto net = Net::create();
+        net->optimize = optimize;
+        net->read_buf(buf.data());
+        net->run(input.data());
+        ASSERT_EQ(*net->get_blob("relu"), expected);
+    }
+}
+
+/**
+ * The optimized net normalizes a uint8 image in the stem, the reference net
+ * converts it to float first
+ */
+TEST(fconv, float_conv_uint8_input) {
+    const int in_c = 3;
+    const int out_c = 8;
+    const int h = 16;
+    const int w = 16;
+    std::vector<float> weight(out_c * 7 * 7 * in_c), bias(out_c), a(out_c),
+        b(out_c);
+    fill_rand_float(weight.data(), weight.size());
+    fill_rand_float(bias.data(), bias.size());
+    fill_rand_float(a.data(), a.size());
+    fill_rand_float(b.data(), b.size());
+    const auto buf =
+        build_conv_model(h, w, in_c, out_c, 7, 2, weight, bias, a, b);
+
+    std::vector<uint8_t> image(h * w * in_c);
+    FORZ(i, image.size()) { image[i] = static_cast<uint8_t>(i * 91 % 256); }
+    const std::vector<float> mean{124.f, 116.f, 104.f};
+    const std::vector<float> std{58.f, 57.f, 57.5f};
+    std::vector<float> input(image.size());
+    FORZ(i, image.size()) {
+        input[i] = (image[i] - mean[i % in_c]) / std[i % in_c];
+    }
+    const Mat im(h, w, in_c, input.data(), DataType::Float);
+    Mat expected(h / 2, w / 2, out_c, DataType::Float);
+    expected_conv_model(im, out_c, 7, 2, weight, bias, a, b, expected);
+
+    for (const bool optimize : {false, true}) {
+        auto net = Net::create();
+        net->optimize = optimize;
+        net->input_mean = mean;
+        net->input_std = std;
+        net->read_buf(buf.data());
+        net->run(image.data());
+        ASSERT_EQ(*net->get_blob("relu"), expected);
+    }
+}
+
+/**
+ * input [1, 16, 16, 3] -> 7x7/2 FpConv2D "conv"
+ *                      -> AvePool 2x2/2 "pool"
+ * The stem conv cannot normalize the uint8 image itself, the pool reads the
+ * normalized input as well
+ */
+TEST(fconv, float_conv_uint8_input_other_reader) {
+    const int in_c = 3;
+    const int out_c = 8;
+    const int h = 16;
+    const int w = 16;
+    std::vector<float> weight(out_c * 7 * 7 * in_c), bias(out_c);
+    fill_rand_float(weight.data(), weight.size());
+    fill_rand_float(bias.data(), bias.size());
+    TestModel model({1, h, w, in_c});
+    model.add_float("weight", {out_c, 7, 7, in_c}, weight);
+    model.add_float("bias", {out_c}, bias);
+    model.fp_conv("input", "weight", "bias", "conv", 3, 2);
+    model.ave_pool("input", 2, 0, 2, "pool");
+    const auto buf = model.finish();
+
+    std::vector<uint8_t> image(h * w * in_c);
+    FORZ(i, image.size()) { image[i] = static_cast<uint8_t>(i * 91 % 256); }
+    std::vector<std::shared_ptr<Net>> nets;
+    for (const bool optimize : {false, true}) {
+        auto net = Net::create();
+        net->optimize = optimize;
+        net->input_mean = {124.f, 116.f, 104.f};
+        net->input_std = {58.f, 57.f, 57.5f};
+        net->read_buf(buf.data());
+        net->run(image.data());
+        nets.push_back(net);
+    }
+    ASSERT_EQ(*nets[1]->get_blob("conv"), *nets[0]->get_blob("conv"));
+    ASSERT_EQ(*nets[1]->get_blob("pool"), *nets[0]->get_blob("pool"));
+}
+
 }  // namespace bnn
@@ -0,0 +1,243 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include <common/common_bitpack.h>
+#include <common/helper.h>
+#include <dabnn/bitpack.h>
+#include <dabnn/fp16.h>
+#include <dabnn/net.h>
+#include <gtest/gtest.h>
+#include "test_model.h"
+
+using namespace bnn;
+
+TEST(fp16, round_to_nearest_even) {
+    ASSERT_EQ(float_to_half(1.f), 0x3c00);
+    ASSERT_EQ(float_to_half(-2.f), 0xc000);
+    ASSERT_EQ(float_to_half(65504.f), 0x7bff);
+    ASSERT_EQ(float_to_half(65520.f), 0x7c00);
+    ASSERT_EQ(float_to_half(-1e10f), 0xfc00);
+    // The ties between 1 and its neighbours go to the even mantissa
+    ASSERT_EQ(float_to_half(1.f + std::ldexp(1.f, -11)), 0x3c00);
+    ASSERT_EQ(float_to_half(1.f + 3 * std::ldexp(1.f, -11)), 0x3c02);
+    ASSERT_EQ(float_to_half(std::ldexp(1.f, -24)), 0x0001);
+    ASSERT_EQ(float_to_half(std::ldexp(1.f, -25)), 0x0000);
+    ASSERT_EQ(float_to_half(std::ldexp(3.f, -25)), 0x0002);
+    ASSERT_EQ(float_to_half(-0.f), 0x8000);
+    ASSERT_TRUE(std::isnan(half_to_float(float_to_half(std::nanf("")))));
+}
+
+TEST(fp16, round_trip) {
+    // Every half but nan survives half -> float -> half, in bulk as well
+    std::vector<half_t> halves;
+    FORZ(i, 1 << 16) {
+        if ((i & 0x7c00) != 0x7c00 || (i & 0x3ff) == 0) {
+            halves.push_back(static_cast<half_t>(i));
+        }
+    }
+    std::vector<float> floats(halves.size());
+    std::vector<half_t> back(halves.size());
+    half_to_float(halves.data(), floats.data(), halves.size());
+    float_to_half(floats.data(), back.data(), floats.size());
+    FORZ(i, halves.size()) {
+        ASSERT_EQ(half_to_float(halves[i]), floats[i]);
+        ASSERT_EQ(float_to_half(floats[i]), halves[i]);
+        ASSERT_EQ(back[i], halves[i]);
+    }
+}
+
+TEST(fp16, pack_64_half) {
+    const size_t len = 64 * 16;
+    std::vector<float> floats(len);
+    fill_rand_float(floats.data(), len);
+    floats[3] = 0.f;
+    floats[5] = -0.f;
+    std::vector<half_t> halves(len);
+    float_to_half(floats.data(), halves.data(), len);
+    // The fp16 values have the signs of the floats
+    half_to_float(halves.data(), floats.data(), len);
+    std::vector<uint64_t> expected(len / 64), packed(len / 64);
+    pack_64(floats.data(), expected.data(), len);
+    pack_64_half(halves.data(), packed.data(), len);
+    ASSERT_EQ(packed, expected);
+}
+
+namespace {
+
+const int kSize = 6;
+const int kInputC = 128;
+const int kBinC = 64;
+const int kConvC = 16;
+
+/**
+ * input [1, 6, 6, 128] -> BinConv2D "bconv" -> Affine "bn" -> BinConv2D
+ * "bconv2" -> Affine "bn2" -> Add(bn2, bn) "res" -> Relu -> BinConv2D
+ * "bconv3" -> FpConv2D 1x1 "conv", a residual block whose blobs (but the
+ * output of bconv3) can be fp16
+ */
+std::vector<uint8_t> build_model(std::vector<float> &conv_weight) {
+    TestModel model({1, kSize, kSize, kInputC});
+    std::vector<uint64_t> bin_weight(kBinC * 3 * 3 * kInputC / 64),
+        bin_weight2(kBinC * 3 * 3 * kBinC / 64),
+        bin_weight3(kBinC * 3 * 3 * kBinC / 64);
+    std::vector<float> a(kBinC), b(kBinC), a2(kBinC), b2(kBinC);
+    conv_weight.resize(kConvC * kBinC);
+    for (auto *weight : {&bin_weight, &bin_weight2, &bin_weight3}) {
+        fill_rand_uint64(weight->data(), weight->size());
+    }
+    for (auto *weight : {&a, &b, &a2, &b2, &conv_weight}) {
+        fill_rand_float(weight->data(), weight->size());
+    }
+    model.add_bit("bin_weight", {kBinC, 3, 3, kInputC}, bin_weight, true);
+    model.add_bit("bin_weight2", {kBinC, 3, 3, kBinC}, bin_weight2, true);
+    model.add_bit("bin_weight3", {kBinC, 3, 3, kBinC}, bin_weight3, true);
+    model.add_float("a", {kBinC}, a);
+    model.add_float("b", {kBinC}, b);
+    model.add_float("a2", {kBinC}, a2);
+    model.add_float("b2", {kBinC}, b2);
+    model.add_float("conv_weight", {kConvC, 1, 1, kBinC}, conv_weight);
+
+    model.bin_conv("input", "bin_weight", "bconv", 1, 1);
+    model.affine("bconv", "a", "b", "bn");
+    model.bin_conv("bn", "bin_weight2", "bconv2", 1, 1);
+    model.affine("bconv2", "a2", "b2", "bn2");
+    model.add("bn2", "bn", "res");
+    model.relu("res", "relu");
+    model.bin_conv("relu", "bin_weight3", "bconv3", 1, 1);
+    model.fp_conv("bconv3", "conv_weight", nullptr, "conv", 0, 1);
+    return model.finish();
+}
+
+/**
+ * input [1, 6, 6, 128] -> BinConv2D "bconv" -> Relu "relu", the relu writes
+ * the model output into the blob of bconv
+ */
+std::vector<uint8_t> build_inplace_output_model() {
+    TestModel model({1, kSize, kSize, kInputC});
+    std::vector<uint64_t> bin_weight(kBinC * 3 * 3 * kInputC / 64);
+    fill_rand_uint64(bin_weight.data(), bin_weight.size());
+    model.add_bit("bin_weight", {kBinC, 3, 3, kInputC}, bin_weight, true);
+    model.bin_conv("input", "bin_weight", "bconv", 1, 1);
+    model.relu("bconv", "relu");
+    return model.finish();
+}
+
+float value(const Mat &mat, const size_t i) {
+    return mat.data_type == DataType::Half
+               ? half_to_float(static_cast<const half_t *>(mat.data)[i])
+               : static_cast<const float *>(mat.data)[i];
+}
+
+}  // namespace
+
+TEST(fp16, half_activations) {
+    std::vector<float> conv_weight;
+    const auto buf = build_model(conv_weight);
+    std::vector<float> input(kSize * kSize * kInputC);
+    fill_rand_float(input.data(), input.size());
+
+    for (const int batch : {1, 2}) {
+        auto reference = Net::create();
+        reference->max_batch = batch;
+        reference->read_buf(buf.data());
+        auto net = Net::create();
+        net->half_activations = true;
+        net->max_batch = batch;
+        net->read_buf(buf.data());
+        std::vector<float> images;
+        FORZ(i, batch) {
+            images.insert(images.end(), input.begin(), input.end());
+        }
+        reference->run(images.data(), batch);
+        net->run(images.data(), batch);
+
+        ASSERT_EQ(net->get_blob("bconv")->data_type, DataType::Half);
+        ASSERT_EQ(net->get_blob("res")->data_type, DataType::Half);
+        ASSERT_EQ(net->get_blob("bconv3")->data_type, DataType::Float);
+        ASSERT_EQ(net->get_blob("conv")->data_type, DataType::Float);
+        // A value of res within the error of fp16 from 0 may binarize to
+        // the other sign. It changes the popcount of every bconv3 output
+        // reading it by 1, and conv by the weights of those outputs.
+        const auto &expected_res = *reference->get_blob("res");
+        const auto &actual_res = *net->get_blob("res");
+        std::vector<int> pixel_flips(batch * kSize * kSize);
+        FORZ(i, expected_res.total()) {
+            pixel_flips[i / kBinC] +=
+                (value(actual_res, i) > 0) != (value(expected_res, i) > 0);
+        }
+        const int flips =
+            std::accumulate(pixel_flips.begin(), pixel_flips.end(), 0);
+        ASSERT_LE(flips, expected_res.total() / 100);
+        // The flips in the 3x3 window of every pixel of bconv3
+        std::vector<int> window_flips(pixel_flips.size());
+        FORZ(i, window_flips.size()) {
+            const int y = i / kSize % kSize;
+            const int x = i % kSize;
+            for (int dy = std::max(-y, -1); dy <= std::min(kSize - 1 - y, 1);
+                 dy++) {
+                for (int dx = std::max(-x, -1);
+                     dx <= std::min(kSize - 1 - x, 1); dx++) {
+                    window_flips[i] += pixel_flips[i + dy * kSize + dx];
+                }
+            }
+        }
+        const auto &expected_bconv3 = *reference->get_blob("bconv3");
+        const auto &actual_bconv3 = *net->get_blob("bconv3");
+        const auto flip_error = [&](const std::string &name, const size_t i) {
+            if (name == "bconv3") {
+                return static_cast<float>(window_flips[i / kBinC]);
+            }
+            if (name != "conv") {
+                return 0.f;
+            }
+            const size_t pixel = i / kConvC;
+            float error = 0.f;
+            FORZ(c, kBinC) {
+                const size_t j = pixel * kBinC + c;
+                error += std::abs(conv_weight[i % kConvC * kBinC + c]) *
+                         std::abs(value(actual_bconv3, j) -
+                                  value(expected_bconv3, j));
+            }
+            return error;
+        };
+        for (const std::string name : {"bn", "res", "bconv3", "conv"}) {
+            const auto &expected = *reference->get_blob(name);
+            const auto &actual = *net->get_blob(name);
+            ASSERT_EQ(actual.total(), expected.total());
+            // The error of fp16 follows the magnitude of the operands (e.g.
+            // of the add), rather than of the result
+            float max_abs = 0.f;
+            FORZ(i, expected.total()) {
+                max_abs = std::max(max_abs, std::abs(value(expected, i)));
+            }
+            FORZ(i, expected.total()) {
+                ASSERT_NEAR(value(actual, i), value(expected, i),
+                            2e-3 * max_abs + flip_error(name, i))
+                    << name << " " << i << ", " << flips << " flips";
+            }
+        }
+    }
+}
+
+TEST(fp16, inplace_output_is_float) {
+    const auto buf = build_inplace_output_model();
+    std::vector<float> input(kSize * kSize * kInputC);
+    fill_rand_float(input.data(), input.size());
+
+    auto reference = Net::create();
+    reference->read_buf(buf.data());
+    reference->run(input.data());
+    auto net = Net::create();
+    net->half_activations = true;
+    net->read_buf(buf.data());
+    net->run(input.data());
+
+    const auto &actual = *net->get_blob("relu");
+    ASSERT_EQ(actual.data_type, DataType::Float);
+    ASSERT_EQ(actual, *reference->get_blob("relu"));
+}
@@ -0,0 +1,93 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <common/helper.h>
+#include <dabnn/mat.h>
+#include <dabnn/net.h>
+#include <gtest/gtest.h>
+#include "test_model.h"
+
+using namespace bnn;
+
+TEST(memory_trace, mats) {
+    MemoryTrace trace;
+    {
+        MemoryTrace::Scope scope(&trace, false);
+        Mat m(4, 4, 16, DataType::Float, "m");
+        trace.name(m.data, "m");
+        ASSERT_EQ(trace.live_bytes(), 4 * 4 * 16 * 4);
+        m.fill<float>(0.f);
+        ncnn::observe_scratch(1024, "tmp");
+    }
+    // Not traced after the scope
+    Mat untraced(16, DataType::Float);
+
+    const auto &events = trace.events();
+    ASSERT_EQ(events.size(), 4u);
+    ASSERT_EQ(events[0].kind, MemoryTrace::Kind::Alloc);
+    ASSERT_EQ(events[0].blob, "m");
+    ASSERT_EQ(events[1].kind, MemoryTrace::Kind::Touch);
+    ASSERT_EQ(events[1].blob, "m");
+    ASSERT_EQ(events[1].bytes, 4 * 4 * 16 * 4);
+    ASSERT_EQ(events[2].kind, MemoryTrace::Kind::Scratch);
+    ASSERT_EQ(events[3].kind, MemoryTrace::Kind::Free);
+    ASSERT_EQ(trace.live_bytes(), 0);
+
+    // The peak is during the scratch
+    ASSERT_EQ(trace.peak_bytes(), 4 * 4 * 16 * 4 + 1024);
+    const auto buffers = trace.peak_buffers();
+    ASSERT_EQ(buffers.size(), 2u);
+    ASSERT_EQ(buffers[0].blob, "m");
+    ASSERT_EQ(buffers[1].blob, "tmp");
+    ASSERT_TRUE(trace.run_allocations(0).empty());
+}
+
+TEST(memory_trace, net) {
+    const auto buf = pool_bconv_model();
+    auto net = Net::create();
+    net->trace_memory = true;
+    net->read_buf(buf.data());
+    std::vector<float> input(6 * 6 * 64);
+    fill_rand_float(input.data(), input.size());
+    FORZ(i, 3) { net->run(input.data()); }
+
+    const auto &trace = net->memory_trace;
+    ASSERT_EQ(trace.runs(), 3);
+    // The blobs are allocated by the prepare and named after them
+    const auto buffers = trace.peak_buffers();
+    const auto has_blob = [&buffers](const std::string &blob,
+                                     const std::string &layer) {
+        return std::any_of(buffers.begin(), buffers.end(),
+                           [&](const MemoryTrace::Buffer &b) {
+                               return b.blob == blob && b.layer == layer &&
+                                      b.run == -1;
+                           });
+    };
+    ASSERT_TRUE(has_blob("pool", "maxpool"));
+    ASSERT_TRUE(has_blob("bconv", "binconv"));
+    ASSERT_GE(trace.peak_bytes(), 6 * 6 * 64 * 4 * 2);
+    // No allocation after the first run
+    ASSERT_TRUE(trace.run_allocations(1).empty());
+
+    const auto summary = trace.summary();
+    ASSERT_NE(summary.find("3 runs"), std::string::npos) << summary;
+    ASSERT_NE(summary.find("(steady state): none"), std::string::npos)
+        << summary;
+    const auto csv = trace.timeline_csv();
+    ASSERT_EQ(csv.find("time_us,run,layer,event,blob,bytes,live_bytes"), 0u);
+    ASSERT_NE(csv.find(",alloc,pool,"), std::string::npos) << csv;
+}
+
+TEST(memory_trace, off) {
+    const auto buf = pool_bconv_model();
+    auto net = Net::create();
+    net->read_buf(buf.data());
+    std::vector<float> input(6 * 6 * 64);
+    fill_rand_float(input.data(), input.size());
+    net->run(input.data());
+    ASSERT_TRUE(net->memory_trace.events().empty());
+    ASSERT_EQ(ncnn::memory_observer, nullptr);
+}
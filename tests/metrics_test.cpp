@@ -0,0 +1,99 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <common/helper.h>
+#include <dabnn/net.h>
+#include <gtest/gtest.h>
+#include "test_model.h"
+
+using namespace bnn;
+
+TEST(metrics, histogram_buckets) {
+    // Every value is in a bucket whose largest value is at least it and
+    // within 1 / 2^kSubBucketBits of it
+    const double error = 1. / (1 << Histogram::kSubBucketBits);
+    for (int64_t v = 0; v < (int64_t{1} << 40); v = v * 3 / 2 + 1) {
+        const int i = Histogram::bucket(v);
+        ASSERT_GE(Histogram::bucket_max(i), v);
+        ASSERT_LE(Histogram::bucket_max(i) - v, error * v) << v;
+        if (i > 0) {
+            ASSERT_LT(Histogram::bucket_max(i - 1), v) << v;
+        }
+    }
+}
+
+TEST(metrics, histogram_percentiles) {
+    Histogram h;
+    ASSERT_EQ(h.percentile(50.), 0);
+    FORZ(i, 1000) { h.record(1000 + i); }
+    ASSERT_EQ(h.count(), 1000);
+    ASSERT_EQ(h.min(), 1000);
+    ASSERT_EQ(h.max(), 1999);
+    ASSERT_DOUBLE_EQ(h.mean(), 1499.5);
+    ASSERT_NEAR(h.percentile(50.), 1500, 1500 / 8);
+    ASSERT_NEAR(h.percentile(99.), 1990, 1990 / 8);
+    ASSERT_EQ(h.percentile(100.), 1999);
+
+    Histogram other;
+    other.record(5);
+    h.merge(other);
+    ASSERT_EQ(h.count(), 1001);
+    ASSERT_EQ(h.min(), 5);
+    ASSERT_EQ(h.percentile(0.), 5);
+}
+
+TEST(metrics, runs_and_errors) {
+    const auto buf = pool_bconv_model();
+    auto net = Net::create();
+    net->read_buf(buf.data());
+    std::vector<float> input(6 * 6 * 64);
+    fill_rand_float(input.data(), input.size());
+
+    FORZ(i, 5) { net->run(input.data()); }
+    ASSERT_THROW(net->run(input.data(), 2), std::runtime_error);
+    const auto s = net->metrics.snapshot();
+    ASSERT_EQ(s.runs, 5);
+    ASSERT_EQ(s.errors, 1);
+    ASSERT_EQ(s.images, 5);
+    ASSERT_EQ(s.latency_ns.count(), 5);
+    ASSERT_GT(s.latency_ns.max(), 0);
+    // At least the input, the pooled bits and the output
+    ASSERT_GE(s.peak_activation_bytes, 6 * 6 * 64 * 4 + 6 * 6 * 64 * 4);
+    // The blobs are allocated by the plan, not by the runs
+    ASSERT_EQ(s.run_allocated_bytes, 0);
+    ASSERT_EQ(s.sampled_runs, 0);
+    ASSERT_TRUE(s.layers.empty());
+
+    net->metrics.clear();
+    ASSERT_EQ(net->metrics.snapshot().runs, 0);
+}
+
+TEST(metrics, sampled_layers) {
+    const auto buf = pool_bconv_model();
+    auto net = Net::create();
+    net->read_buf(buf.data());
+    std::vector<float> input(6 * 6 * 64);
+    fill_rand_float(input.data(), input.size());
+
+    net->metrics.sample_every = 3;
+    FORZ(i, 7) { net->run(input.data()); }
+    const auto s = net->metrics.snapshot();
+    ASSERT_EQ(s.runs, 7);
+    // The 1st, the 4th and the 7th runs
+    ASSERT_EQ(s.sampled_runs, 3);
+    ASSERT_EQ(s.layers.size(), 2u);
+    ASSERT_EQ(s.layers[0].type, "MaxPool");
+    ASSERT_EQ(s.layers[1].type, "Bin Conv");
+    ASSERT_EQ(s.layers[1].index, 1);
+    ASSERT_EQ(s.layers[1].latency_ns.count(), 3);
+
+    const auto str = s.to_str();
+    ASSERT_NE(str.find("runs: 7"), std::string::npos) << str;
+    ASSERT_NE(str.find("Bin Conv"), std::string::npos) << str;
+    const auto json = s.to_json();
+    ASSERT_NE(json.find("\"sampled_runs\": 3"), std::string::npos) << json;
+    ASSERT_NE(json.find("\"type\": \"MaxPool\""), std::string::npos) << json;
+}
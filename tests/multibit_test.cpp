@@ -0,0 +1,193 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <common/helper.h>
+#include <dabnn/bitplane.h>
+#include <dabnn/net.h>
+#include <gtest/gtest.h>
+#include "test_model.h"
+
+using namespace bnn;
+
+TEST(multibit, quantize_level) {
+    // The levels of 2 bits are -3, -1, 1 and 3
+    ASSERT_EQ(quantize_level(-3.f, 1.f, 2), 0);
+    ASSERT_EQ(quantize_level(-1.2f, 1.f, 2), 1);
+    ASSERT_EQ(quantize_level(0.8f, 1.f, 2), 2);
+    ASSERT_EQ(quantize_level(10.f, 1.f, 2), 3);
+    ASSERT_EQ(quantize_level(-10.f, 1.f, 2), 0);
+    ASSERT_EQ(quantize_level(1.4f, 5.f, 3), 7);
+    ASSERT_EQ(quantize_level(0.3f, 1.f, 1), 1);
+    ASSERT_EQ(quantize_level(-0.3f, 1.f, 1), 0);
+}
+
+namespace {
+
+struct Case {
+    int n, h, w, c, m, kernel, pad, stride, dilation;
+    int weight_bits, activation_bits;
+};
+
+/**
+ * input -> MultiBitConv2D "conv", the levels of the weight are random and
+ * the input is on the grid of the activation levels
+ */
+std::vector<uint8_t> build_model(const Case &cs,
+                                 const std::vector<int8_t> &levels,
+                                 const std::vector<float> &scales,
+                                 const std::vector<float> &bias,
+                                 const float activation_scale) {
+    TestModel model({static_cast<uint32_t>(cs.n), static_cast<uint32_t>(cs.h),
+                     static_cast<uint32_t>(cs.w),
+                     static_cast<uint32_t>(cs.c)});
+    const auto m = static_cast<uint32_t>(cs.m);
+    const auto k = static_cast<uint32_t>(cs.kernel);
+    model.add_int8("weight", {m, k, k, static_cast<uint32_t>(cs.c)}, levels,
+                   scales);
+    model.add_float("bias", {m}, bias);
+    model.multibit_conv("input", "weight", "bias", "conv", cs.pad, cs.stride,
+                        cs.dilation, cs.weight_bits, cs.activation_bits,
+                        activation_scale);
+    return model.finish();
+}
+
+void expect_multibit_conv(const Case &cs) {
+    const int top_w = max_level(cs.weight_bits);
+    const int top_x = max_level(cs.activation_bits);
+    std::vector<int8_t> levels(cs.m * cs.kernel * cs.kernel * cs.c);
+    for (auto &v : levels) {
+        v = static_cast<int8_t>(2 * (random_uint64() % (top_w + 1)) - top_w);
+    }
+    std::vector<float> scales(cs.m), bias(cs.m);
+    FORZ(i, cs.m) {
+        scales[i] = 0.01f * static_cast<float>(1 + random_uint64() % 100);
+    }
+    fill_rand_float(bias.data(), bias.size());
+    const float activation_scale = 0.25f;
+    std::vector<int> input_levels(cs.n * cs.h * cs.w * cs.c);
+    std::vector<float> input(input_levels.size());
+    FORZ(i, input.size()) {
+        input_levels[i] =
+            static_cast<int>(2 * (random_uint64() % (top_x + 1))) - top_x;
+        input[i] = input_levels[i] * activation_scale;
+    }
+
+    const auto buf =
+        build_model(cs, levels, scales, bias, activation_scale);
+    auto net = Net::create();
+    net->read_buf(buf.data());
+    net->run(input.data(), cs.n);
+    const auto &output = *net->get_blob("conv");
+    const int dilated = (cs.kernel - 1) * cs.dilation + 1;
+    const int output_h = (cs.h + 2 * cs.pad - dilated) / cs.stride + 1;
+    const int output_w = (cs.w + 2 * cs.pad - dilated) / cs.stride + 1;
+    ASSERT_EQ(output.h, output_h);
+    ASSERT_EQ(output.w, output_w);
+    ASSERT_EQ(output.c, cs.m);
+
+    FORZ(b, cs.n) {
+        FORZ(oy, output_h) {
+            FORZ(ox, output_w) {
+                FORZ(o, cs.m) {
+                    int sum = 0;
+                    FORZ(ky, cs.kernel) {
+                        FORZ(kx, cs.kernel) {
+                            const int y =
+                                oy * cs.stride - cs.pad + ky * cs.dilation;
+                            const int x =
+                                ox * cs.stride - cs.pad + kx * cs.dilation;
+                            if (y < 0 || y >= cs.h || x < 0 || x >= cs.w) {
+                                continue;
+                            }
+                            FORZ(ch, cs.c) {
+                                sum += input_levels[((b * cs.h + y) * cs.w +
+                                                     x) *
+                                                        cs.c +
+                                                    ch] *
+                                       levels[((o * cs.kernel + ky) *
+                                                   cs.kernel +
+                                               kx) *
+                                                  cs.c +
+                                              ch];
+                            }
+                        }
+                    }
+                    const float expected =
+                        sum * scales[o] * activation_scale + bias[o];
+                    const float actual =
+                        output.point<float>(b, oy, ox)[o];
+                    ASSERT_NEAR(actual, expected,
+                                1e-5 * (std::abs(expected) + 1))
+                        << b << " " << oy << " " << ox << " " << o;
+                }
+            }
+        }
+    }
+}
+
+}  // namespace
+
+TEST(multibit, conv_1x1) {
+    expect_multibit_conv({1, 5, 3, 64, 12, 1, 0, 1, 1, 2, 2});
+    expect_multibit_conv({2, 4, 6, 128, 16, 1, 0, 2, 1, 3, 4});
+}
+
+TEST(multibit, conv_3x3) {
+    // The padded taps are zero rather than the lowest level
+    expect_multibit_conv({1, 6, 7, 64, 20, 3, 1, 1, 1, 2, 2});
+    expect_multibit_conv({2, 8, 8, 128, 8, 3, 1, 2, 1, 4, 3});
+    expect_multibit_conv({1, 9, 9, 64, 4, 3, 2, 1, 2, 1, 2});
+}
+
+TEST(multibit, invalid_level) {
+    // 4 is not a level, and 5 is not one of 2 bits
+    for (const int8_t bad : {4, 5}) {
+        const Case cs{1, 2, 2, 64, 1, 1, 0, 1, 1, 2, 2};
+        std::vector<int8_t> levels(64, 1);
+        levels[3] = bad;
+        const auto buf = build_model(cs, levels, {1.f}, {0.f}, 1.f);
+        auto net = Net::create();
+        ASSERT_ANY_THROW(net->read_buf(buf.data()));
+    }
+}
+
+/**
+ * input [1, 6, 6, 64] -> BinConv2D "bconv" -> MultiBitConv2D "conv", the
+ * output of bconv is fp16 with half_activations and is exact in it
+ */
+TEST(multibit, half_input) {
+    TestModel model({1, 6, 6, 64});
+    std::vector<uint64_t> bin_weight(64 * 3 * 3);
+    fill_rand_uint64(bin_weight.data(), bin_weight.size());
+    std::vector<int8_t> levels(16 * 3 * 3 * 64);
+    for (auto &v : levels) {
+        v = static_cast<int8_t>(2 * (random_uint64() % 4) - 3);
+    }
+    std::vector<float> scales(16, 0.5f), bias(16);
+    fill_rand_float(bias.data(), bias.size());
+    model.add_bit("bin_weight", {64, 3, 3, 64}, bin_weight, true);
+    model.add_int8("weight", {16, 3, 3, 64}, levels, scales);
+    model.add_float("bias", {16}, bias);
+    model.bin_conv("input", "bin_weight", "bconv", 1, 1);
+    model.multibit_conv("bconv", "weight", "bias", "conv", 1, 1, 1, 2, 2,
+                        64.f);
+    const auto buf = model.finish();
+
+    std::vector<float> input(6 * 6 * 64);
+    fill_rand_float(input.data(), input.size());
+    auto reference = Net::create();
+    reference->read_buf(buf.data());
+    reference->run(input.data());
+    auto net = Net::create();
+    net->half_activations = true;
+    net->read_buf(buf.data());
+    net->run(input.data());
+    ASSERT_EQ(net->get_blob("bconv")->data_type, DataType::Half);
+    const auto &expected = *reference->get_blob("conv");
+    const auto &actual = *net->get_blob("conv");
+    ASSERT_EQ(actual.total(), expected.total());
+    FORZ(i, expected.total()) { ASSERT_FLOAT_EQ(actual[i], expected[i]); }
+}
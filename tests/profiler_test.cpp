@@ -0,0 +1,130 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#include <string>
+#include <vector>
+
+#include <common/helper.h>
+#include <dabnn/net.h>
+#include <gtest/gtest.h>
+#include "test_model.h"
+
+using namespace bnn;
+
+namespace {
+
+size_t count(const std::string &s, const std::string &sub) {
+    size_t n = 0;
+    for (auto pos = s.find(sub); pos != std::string::npos;
+         pos = s.find(sub, pos + 1)) {
+        n++;
+    }
+    return n;
+}
+
+}  // namespace
+
+TEST(profiler, layers_of_runs) {
+    const auto buf = pool_bconv_model();
+    auto net = Net::create();
+    net->read_buf(buf.data());
+    std::vector<float> input(8 * 8 * 64);
+    fill_rand_float(input.data(), input.size());
+    net->run(input.data());
+    ASSERT_TRUE(net->profiler.entries().empty());
+
+    net->profile = true;
+    FORZ(i, 3) { net->run(input.data()); }
+    const auto &profiler = net->profiler;
+    ASSERT_EQ(profiler.runs(), 3);
+    ASSERT_EQ(profiler.entries().size(), 2u);
+    // The layers of the model have no names
+    ASSERT_EQ(profiler.entries()[0].type, "MaxPool");
+    ASSERT_EQ(profiler.entries()[1].type, "Bin Conv");
+    ASSERT_EQ(profiler.entries()[1].index, 1);
+    for (const auto &entry : profiler.entries()) {
+        ASSERT_EQ(entry.calls, 3);
+        ASSERT_LE(entry.min_ns, entry.max_ns);
+        ASSERT_LE(entry.max_ns, entry.total_ns);
+    }
+    ASSERT_NE(profiler.entries()[1].detail.find("method: "),
+              std::string::npos);
+    // A span per layer and one per run
+    ASSERT_EQ(profiler.events().size(), 9u);
+
+    const auto trace = profiler.chrome_trace();
+    ASSERT_EQ(trace.find("{\"displayTimeUnit\""), 0u);
+    ASSERT_EQ(count(trace, "\"ph\": \"X\""), 9u);
+    ASSERT_EQ(count(trace, "\"name\": \"Bin Conv #1\""), 3u);
+    ASSERT_EQ(count(trace, "\"name\": \"run\""), 3u);
+    const auto table = profiler.table();
+    ASSERT_NE(table.find("Bin Conv"), std::string::npos);
+    ASSERT_NE(table.find("runs: 3"), std::string::npos);
+
+    // The layers of another resolution are other entries
+    net->reshape(8, 8);
+    net->run(input.data());
+    ASSERT_EQ(profiler.entries().size(), 4u);
+    ASSERT_EQ(profiler.entries()[3].calls, 1);
+
+    net->profile = false;
+    net->run(input.data());
+    ASSERT_EQ(profiler.runs(), 4);
+    net->profiler.clear();
+    ASSERT_TRUE(profiler.entries().empty());
+    ASSERT_TRUE(profiler.events().empty());
+}
+
+TEST(profiler, counters) {
+    const auto buf = pool_bconv_model();
+    auto net = Net::create();
+    net->read_buf(buf.data());
+    std::vector<float> input(6 * 6 * 64);
+    fill_rand_float(input.data(), input.size());
+    net->profile = true;
+    net->profile_counters = true;
+    FORZ(i, 2) { net->run(input.data()); }
+
+    // The counters are refused without perf_event_open, the time is still
+    // recorded
+    const bool available = PerfCounters().available();
+    const auto &entries = net->profiler.entries();
+    ASSERT_EQ(entries.size(), 2u);
+    for (const auto &entry : entries) {
+        ASSERT_EQ(entry.calls, 2);
+        ASSERT_EQ(entry.output_elems, 2 * 6 * 6 * 64);
+        ASSERT_EQ(entry.has_counters, available);
+    }
+    const auto table = net->profiler.table();
+    ASSERT_EQ(table.find("ipc") != std::string::npos, available);
+    if (available) {
+        const auto instructions =
+            entries[1].counters[PerfCounters::kInstructions];
+        ASSERT_TRUE(instructions == -1 || instructions > 0) << instructions;
+    }
+}
+
+TEST(profiler, work) {
+    const auto buf = pool_bconv_model();
+    auto net = Net::create();
+    net->read_buf(buf.data());
+    std::vector<float> input(6 * 6 * 64);
+    fill_rand_float(input.data(), input.size());
+    net->profile = true;
+    net->run(input.data());
+
+    const auto &entries = net->profiler.entries();
+    ASSERT_EQ(entries.size(), 2u);
+    // The pool may write the signs only, which are bit ops
+    const auto &pool = entries[0].work;
+    ASSERT_EQ(pool.flops + pool.bit_ops, 6 * 6 * 64 * 9);
+    ASSERT_EQ(pool.bytes_read, 6 * 6 * 64 * 4);
+    const auto &bconv = entries[1].work;
+    ASSERT_EQ(bconv.bit_ops, 2 * 6 * 6 * 64 * (3 * 3 * 64));
+    ASSERT_EQ(bconv.bytes_read, pool.bytes_written + 64 * 3 * 3 * 64 / 8);
+    ASSERT_EQ(bconv.bytes_written, 6 * 6 * 64 * 4);
+
+    ASSERT_EQ(net->profiler.table().find("%roof"), std::string::npos);
+    net->profiler.peak_gbops = 100.;
+    net->profiler.peak_gbps = 10.;
+    ASSERT_NE(net->profiler.table().find("%roof"), std::string::npos);
+}
@@ -0,0 +1,276 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <common/helper.h>
+#include <dabnn/fconv.h>
+#include <dabnn/net.h>
+#include <dabnn/qgemm.h>
+#include <gtest/gtest.h>
+#include "test_model.h"
+
+using namespace bnn;
+
+namespace {
+
+std::vector<int8_t> rand_int8(const size_t len) {
+    std::vector<int8_t> ret(len);
+    FORZ(i, len) {
+        ret[i] = static_cast<int8_t>(random_uint64() % 255) - 127;
+    }
+    return ret;
+}
+
+std::vector<float> rand_positive(const size_t len) {
+    std::vector<float> ret(len);
+    fill_rand_float(ret.data(), len);
+    for (auto &v : ret) {
+        v = std::abs(v) + 0.01f;
+    }
+    return ret;
+}
+
+/**
+ * The nhwc int8 conv in int32, dequantized and biased like the kernels do
+ */
+std::vector<float> naive_qconv(const std::vector<int8_t> &input, const int n,
+                               const int h, const int w, const int c,
+                               const std::vector<int8_t> &weight,
+                               const int kernel, const int pad,
+                               const int stride, const int m,
+                               const std::vector<float> &dequant,
+                               const std::vector<float> &bias) {
+    const int output_h = (h + 2 * pad - kernel) / stride + 1;
+    const int output_w = (w + 2 * pad - kernel) / stride + 1;
+    std::vector<float> output(n * output_h * output_w * m);
+    size_t idx = 0;
+    FORZ(b, n) {
+        FORZ(oy, output_h) {
+            FORZ(ox, output_w) {
+                FORZ(o, m) {
+                    int32_t sum = 0;
+                    FORZ(ky, kernel) {
+                        FORZ(kx, kernel) {
+                            const int y = oy * stride - pad + ky;
+                            const int x = ox * stride - pad + kx;
+                            if (y < 0 || y >= h || x < 0 || x >= w) {
+                                continue;
+                            }
+                            FORZ(ch, c) {
+                                sum += input[((b * h + y) * w + x) * c + ch] *
+                                       weight[((o * kernel + ky) * kernel +
+                                               kx) *
+                                                  c +
+                                              ch];
+                            }
+                        }
+                    }
+                    output[idx++] = sum * dequant[o] + bias[o];
+                }
+            }
+        }
+    }
+    return output;
+}
+
+void expect_qconv(const int n, const int h, const int w, const int c,
+                  const int kernel, const int pad, const int stride,
+                  const int m) {
+    const int k = kernel * kernel * c;
+    const auto input = rand_int8(n * h * w * c);
+    const auto weight = rand_int8(m * k);
+    const auto dequant = rand_positive(m);
+    std::vector<float> bias(m);
+    fill_rand_float(bias.data(), m);
+    std::vector<int8_t> packed(qgemm_packed_size(m, k));
+    qgemm_pack_weight(m, k, weight.data(), k, packed.data());
+
+    const auto expected = naive_qconv(input, n, h, w, c, weight, kernel, pad,
+                                      stride, m, dequant, bias);
+    Mat output(static_cast<int>(expected.size()), DataType::Float);
+    FgemmEpilogue epilogue;
+    epilogue.bias = bias.data();
+    fconv_packed_int8(input.data(), n, h, w, c, packed.data(), dequant.data(),
+                      kernel, kernel, pad, pad, stride, stride, 1, 1, m,
+                      epilogue, output);
+    // The int32 sums of the kc blocks are dequantized one by one
+    const float range = max_abs(expected.data(), expected.size());
+    FORZ(i, expected.size()) {
+        ASSERT_NEAR(static_cast<float *>(output.data)[i], expected[i],
+                    1e-5 * range)
+            << i;
+    }
+}
+
+}  // namespace
+
+TEST(qgemm, quantize) {
+    ASSERT_EQ(quantize_int8(0.5f, 10.f), 5);
+    ASSERT_EQ(quantize_int8(-0.25f, 2.f), 0);
+    ASSERT_EQ(quantize_int8(0.75f, 2.f), 2);
+    ASSERT_EQ(quantize_int8(100.f, 2.f), 127);
+    ASSERT_EQ(quantize_int8(-100.f, 2.f), -127);
+}
+
+/**
+ * The depth of the panels is odd, and m and the pixels are not multiples of
+ * the micro tile
+ */
+TEST(qgemm, fconv_1x1) {
+    expect_qconv(1, 5, 3, 13, 1, 0, 1, 11);
+    expect_qconv(2, 6, 7, 64, 1, 0, 2, 24);
+}
+
+TEST(qgemm, fconv_3x3) {
+    expect_qconv(1, 7, 9, 3, 3, 1, 1, 17);
+    expect_qconv(2, 8, 8, 5, 3, 1, 2, 8);
+    // Deep enough to be split into several kc blocks
+    expect_qconv(1, 4, 4, 512, 3, 1, 1, 9);
+}
+
+TEST(qgemm, qgemv) {
+    const int m = 13;
+    const int k = 531;
+    const auto a = rand_int8(m * k);
+    const auto x = rand_int8(k);
+    const auto dequant = rand_positive(m);
+    std::vector<float> bias(m), y(m);
+    fill_rand_float(bias.data(), m);
+    qgemv(m, k, a.data(), k, x.data(), dequant.data(), bias.data(), y.data());
+    FORZ(i, m) {
+        int32_t sum = 0;
+        FORZ(j, k) { sum += a[i * k + j] * x[j]; }
+        ASSERT_FLOAT_EQ(y[i], sum * dequant[i] + bias[i]);
+    }
+}
+
+namespace {
+
+const int kSize = 8;
+const int kInputC = 3;
+const int kStemC = 16;
+const int kUnits = 10;
+
+struct Weights {
+    std::vector<float> stem, stem_bias, fc, fc_bias;
+
+    Weights()
+        : stem(kStemC * 3 * 3 * kInputC),
+          stem_bias(kStemC),
+          fc(kUnits * kStemC),
+          fc_bias(kUnits) {
+        for (auto *weight : {&stem, &stem_bias, &fc, &fc_bias}) {
+            fill_rand_float(weight->data(), weight->size());
+        }
+    }
+};
+
+/**
+ * The per output channel int8 of a weight, like onnx2bnn does
+ */
+void quantize_weight(const std::vector<float> &weight, const int m,
+                     std::vector<int8_t> &q, std::vector<float> &scales) {
+    const size_t k = weight.size() / m;
+    q.resize(weight.size());
+    scales.resize(m);
+    FORZ(i, m) {
+        const float range = max_abs(weight.data() + i * k, k);
+        scales[i] = range > 0 ? range / 127 : 1.f;
+        quantize_int8(weight.data() + i * k, q.data() + i * k, k,
+                      1.f / scales[i]);
+    }
+}
+
+/**
+ * input [1, 8, 8, 3] -> FpConv2D 3x3 "stem" -> global AvePool "pooled" ->
+ * FC "logits", whose weights are int8 if ranges are given
+ */
+std::vector<uint8_t> build_model(const Weights &weights,
+                                 const std::map<std::string, float> &ranges) {
+    TestModel model({1, kSize, kSize, kInputC});
+    const bool int8 = !ranges.empty();
+    const auto add_weight = [&](const char *name,
+                                const std::vector<uint32_t> &shape,
+                                const std::vector<float> &weight,
+                                const int rows) {
+        if (!int8) {
+            model.add_float(name, shape, weight);
+            return;
+        }
+        std::vector<int8_t> q;
+        std::vector<float> scales;
+        quantize_weight(weight, rows, q, scales);
+        model.add_int8(name, shape, q, scales);
+    };
+    add_weight("stem_weight", {kStemC, 3, 3, kInputC}, weights.stem, kStemC);
+    model.add_float("stem_bias", {kStemC}, weights.stem_bias);
+    add_weight("fc_weight", {kUnits, kStemC}, weights.fc, kUnits);
+    model.add_float("fc_bias", {kUnits}, weights.fc_bias);
+
+    const auto input_scale = [&](const std::string &name) {
+        return int8 ? ranges.at(name) / 127 : 0.f;
+    };
+    model.fp_conv("input", "stem_weight", "stem_bias", "stem", 1, 1,
+                  input_scale("stem"));
+    model.ave_pool("stem", kSize, 0, 1, "pooled");
+    model.fc("pooled", "fc_weight", "fc_bias", "logits",
+             input_scale("logits"));
+    return model.finish();
+}
+
+void expect_near(const Mat &actual, const Mat &expected, const float ratio) {
+    ASSERT_EQ(actual.total(), expected.total());
+    float range = 0.f;
+    FORZ(i, expected.total()) {
+        range = std::max(range, std::abs(expected[i]));
+    }
+    FORZ(i, expected.total()) {
+        ASSERT_NEAR(actual[i], expected[i], ratio * range) << i;
+    }
+}
+
+}  // namespace
+
+/**
+ * The ranges calibrated on the float model make the int8 model close to it
+ */
+TEST(qgemm, int8_net) {
+    const Weights weights;
+    std::vector<float> input(kSize * kSize * kInputC);
+    fill_rand_float(input.data(), input.size());
+
+    const auto float_buf = build_model(weights, {});
+    auto reference = Net::create();
+    reference->calibrate_int8 = true;
+    reference->read_buf(float_buf.data());
+    reference->run(input.data());
+    const auto ranges = reference->int8_ranges;
+    ASSERT_EQ(ranges.size(), 2u);
+    ASSERT_FLOAT_EQ(ranges.at("stem"), max_abs(input.data(), input.size()));
+    const auto &pooled = *reference->get_blob("pooled");
+    ASSERT_FLOAT_EQ(ranges.at("logits"),
+                    max_abs(static_cast<const float *>(pooled.data),
+                            pooled.total()));
+
+    const auto int8_buf = build_model(weights, ranges);
+    for (const bool optimize : {false, true}) {
+        auto net = Net::create();
+        net->optimize = optimize;
+        net->read_buf(int8_buf.data());
+        ASSERT_EQ(net->get_blob("stem_weight")->data_type, DataType::Int8);
+        net->run(input.data());
+        expect_near(*net->get_blob("stem"), *reference->get_blob("stem"),
+                    0.03f);
+        expect_near(*net->get_blob("logits"), *reference->get_blob("logits"),
+                    0.03f);
+    }
+}
+
+TEST(qgemm, missing_int8_scale) {
+    const Weights weights;
+    const auto buf = build_model(weights, {{"stem", 0.f}, {"logits", 1.f}});
+    auto net = Net::create();
+    ASSERT_ANY_THROW(net->read_buf(buf.data()));
+}
@@ -0,0 +1,155 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#include <vector>
+
+#include <common/baseline.h>
+#include <common/helper.h>
+#include <dabnn/net.h>
+#include <gtest/gtest.h>
+#include "test_model.h"
+
+using namespace bnn;
+
+namespace {
+
+const int kInputC = 4;
+const int kStemC = 128;
+const int kBinC = 64;
+const int kConvC = 32;
+
+struct Weights {
+    std::vector<float> stem, conv, a, b;
+    std::vector<uint64_t> bin;
+
+    Weights()
+        : stem(kStemC * 3 * 3 * kInputC),
+          conv(kConvC * kBinC),
+          a(kBinC),
+          b(kBinC),
+          bin(kBinC * 3 * 3 * kStemC / 64) {
+        fill_rand_float(stem.data(), stem.size());
+        fill_rand_float(conv.data(), conv.size());
+        fill_rand_float(a.data(), a.size());
+        fill_rand_float(b.data(), b.size());
+        fill_rand_uint64(bin.data(), bin.size());
+    }
+};
+
+/**
+ * input [1, h, w, 4] -> FpConv2D 3x3 s2 -> BinConv2D 3x3 -> Affine -> Relu
+ * -> MaxPool 3x3 s2 -> FpConv2D 1x1, a backbone without a head
+ */
+std::vector<uint8_t> build_model(const int h, const int w,
+                                 const Weights &weights) {
+    TestModel model({1, static_cast<uint32_t>(h), static_cast<uint32_t>(w),
+                     kInputC});
+    model.add_float("stem_weight", {kStemC, 3, 3, kInputC}, weights.stem);
+    model.add_bit("bin_weight", {kBinC, 3, 3, kStemC}, weights.bin, true);
+    model.add_float("a", {kBinC}, weights.a);
+    model.add_float("b", {kBinC}, weights.b);
+    model.add_float("conv_weight", {kConvC, 1, 1, kBinC}, weights.conv);
+
+    model.fp_conv("input", "stem_weight", nullptr, "stem", 1, 2);
+    model.bin_conv("stem", "bin_weight", "bconv", 1, 1);
+    model.affine("bconv", "a", "b", "bn");
+    model.relu("bn", "relu");
+    model.max_pool("relu", 3, 1, 2, "pool");
+    model.fp_conv("pool", "conv_weight", nullptr, "conv", 0, 1);
+    return model.finish();
+}
+
+const std::vector<std::string> kBlobs{"stem", "bconv", "pool", "conv"};
+
+/**
+ * The net reshaped to h * w computes the same blobs as a net whose model
+ * is declared with h * w
+ */
+void expect_same_as_declared(Net &net, const int h, const int w,
+                             const Weights &weights) {
+    const auto buf = build_model(h, w, weights);
+    auto declared = Net::create();
+    declared->optimize = net.optimize;
+    declared->read_buf(buf.data());
+
+    std::vector<float> input(h * w * kInputC);
+    fill_rand_float(input.data(), input.size());
+    net.reshape(h, w);
+    net.run(input.data());
+    declared->run(input.data());
+    for (const auto &name : kBlobs) {
+        ASSERT_EQ(*net.get_blob(name), *declared->get_blob(name));
+    }
+}
+
+}  // namespace
+
+TEST(reshape, same_as_declared) {
+    const Weights weights;
+    const auto buf = build_model(16, 16, weights);
+    for (const bool optimize : {false, true}) {
+        auto net = Net::create();
+        net->optimize = optimize;
+        net->read_buf(buf.data());
+        expect_same_as_declared(*net, 12, 20, weights);
+        expect_same_as_declared(*net, 20, 8, weights);
+        expect_same_as_declared(*net, 16, 16, weights);
+    }
+}
+
+/**
+ * The h and w of a non-square input are not swapped
+ */
+TEST(reshape, non_square_stem) {
+    const Weights weights;
+    const auto buf = build_model(16, 16, weights);
+    const int h = 6;
+    const int w = 12;
+    std::vector<float> input(h * w * kInputC);
+    fill_rand_float(input.data(), input.size());
+    const Mat im(w, h, kInputC, input.data(), DataType::Float);
+    const Mat weight_mat(weights.stem.size(),
+                         const_cast<float *>(weights.stem.data()),
+                         DataType::Float);
+    Mat expected(w / 2, h / 2, kStemC, DataType::Float);
+    expected.fill<float>(0);
+    baseline_fconv(im, weight_mat, 3, 3, 1, 1, 2, 2, 1, 1, kStemC, expected);
+
+    auto net = Net::create();
+    net->read_buf(buf.data());
+    net->reshape(h, w);
+    net->run(input.data());
+    const auto &stem = *net->get_blob("stem");
+    ASSERT_EQ(stem.h, h / 2);
+    ASSERT_EQ(stem.w, w / 2);
+    FORZ(i, expected.total()) { ASSERT_NEAR(stem[i], expected[i], 1e-4); }
+}
+
+/**
+ * Going back to a recent resolution reuses its plan, the packed weights are
+ * shared by all plans
+ */
+TEST(reshape, cached_plans) {
+    const Weights weights;
+    const auto buf = build_model(16, 16, weights);
+    auto net = Net::create();
+    net->max_cached_plans = 1;
+    net->read_buf(buf.data());
+    const auto packed = net->get_blob("packed_stem_weight");
+    const auto *blob_16 = net->get_blob("conv").get();
+
+    net->reshape(8, 24);
+    const auto *blob_8 = net->get_blob("conv").get();
+    ASSERT_NE(blob_8, blob_16);
+    ASSERT_EQ(net->get_blob("packed_stem_weight"), packed);
+
+    net->reshape(16, 16);
+    ASSERT_EQ(net->get_blob("conv").get(), blob_16);
+    net->reshape(8, 24);
+    ASSERT_EQ(net->get_blob("conv").get(), blob_8);
+
+    // Only one other plan is kept, 16 * 16 is planned again
+    net->reshape(24, 8);
+    net->reshape(16, 16);
+    expect_same_as_declared(*net, 16, 16, weights);
+    ASSERT_EQ(net->get_blob("packed_stem_weight"), packed);
+}
@@ -0,0 +1,75 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#include <cmath>
+#include <vector>
+
+#include <common/helper.h>
+#include <common/synthetic_model.h>
+#include <dabnn/net.h>
+#include <gtest/gtest.h>
+
+namespace {
+
+bnn::SyntheticModel small_model(const bnn::SyntheticModel::Arch arch,
+                                const bool binary) {
+    bnn::SyntheticModel model;
+    model.arch = arch;
+    model.stages = 2;
+    model.blocks_per_stage = 2;
+    model.width = 128;
+    model.resolution = 32;
+    model.classes = 10;
+    model.binary = binary;
+    return model;
+}
+
+/**
+ * The model runs and its output is a distribution over the classes
+ */
+void check_runs(const bnn::SyntheticModel &model) {
+    const auto buf = model.build();
+    auto net = bnn::Net::create();
+    net->read_buf(buf.data());
+    std::vector<float> input(model.resolution * model.resolution * 3);
+    fill_rand_float(input.data(), input.size());
+    net->run(input.data());
+
+    const auto &prob = *net->get_blob("prob");
+    ASSERT_EQ(prob.c, model.classes) << model.name();
+    float sum = 0.f;
+    FORZ(i, model.classes) {
+        const float p = static_cast<float *>(prob.data)[i];
+        ASSERT_TRUE(std::isfinite(p)) << model.name();
+        sum += p;
+    }
+    ASSERT_NEAR(sum, 1.f, 1e-4) << model.name();
+}
+
+}  // namespace
+
+TEST(synthetic_model, bireal) {
+    check_runs(small_model(bnn::SyntheticModel::Arch::kBiReal, true));
+}
+
+TEST(synthetic_model, resnet) {
+    check_runs(small_model(bnn::SyntheticModel::Arch::kResNet, true));
+}
+
+TEST(synthetic_model, shufflenet) {
+    check_runs(small_model(bnn::SyntheticModel::Arch::kShuffleNet, true));
+}
+
+TEST(synthetic_model, float_convs) {
+    auto model = small_model(bnn::SyntheticModel::Arch::kBiReal, false);
+    model.width = 16;
+    check_runs(model);
+}
+
+TEST(synthetic_model, seed) {
+    auto model = small_model(bnn::SyntheticModel::Arch::kBiReal, true);
+    ASSERT_EQ(model.name(), "bireal_2x2_w128_r32");
+    const auto buf = model.build();
+    ASSERT_EQ(model.build(), buf);
+    model.seed = 1;
+    ASSERT_NE(model.build(), buf);
+}
@@ -0,0 +1,182 @@
+// Copyright 2019 JD.com Inc. JD AI
+
+#ifndef BNN_TEST_MODEL_H
+#define BNN_TEST_MODEL_H
+
+#include <string>
+#include <vector>
+
+#include <common/dab_generated.h>
+#include <common/helper.h>
+#include <common/macros.h>
+
+namespace bnn {
+
+/**
+ * A dabnn model built in memory for the tests. The convs and pools have
+ * square kernels, pads and strides.
+ */
+class TestModel {
+   public:
+    explicit TestModel(const std::vector<uint32_t> &input_shape) {
+        inputs_.push_back(
+            flatbnn::CreateInputDirect(builder_, &input_shape, "input"));
+    }
+
+    void add_float(const char *name, const std::vector<uint32_t> &shape,
+                   const std::vector<float> &data) {
+        tensors_.push_back(flatbnn::CreateTensorDirect(
+            builder_, flatbnn::DataType::Float32, nullptr, &data, &shape,
+            name));
+    }
+    void add_bit(const char *name, const std::vector<uint32_t> &shape,
+                 const std::vector<uint64_t> &data,
+                 const bool align_hwc_to_128 = false) {
+        tensors_.push_back(flatbnn::CreateTensorDirect(
+            builder_, flatbnn::DataType::Bit, &data, nullptr, &shape, name,
+            align_hwc_to_128));
+    }
+    void add_int8(const char *name, const std::vector<uint32_t> &shape,
+                  const std::vector<int8_t> &data,
+                  const std::vector<float> &scales) {
+        tensors_.push_back(flatbnn::CreateTensorDirect(
+            builder_, flatbnn::DataType::Int8, nullptr, nullptr, &shape, name,
+            false, &data, &scales));
+    }
+
+    void fp_conv(const char *input, const char *weight, const char *bias,
+                 const char *output, const int pad, const int stride,
+                 const float int8_scale = 0.f) {
+        const auto pads = square(pad, 4), strides = square(stride);
+        const auto dilations = square(1);
+        push(flatbnn::CreateLayer(
+            builder_, flatbnn::LayerType::FpConv2D,
+            flatbnn::CreateFpConv2DDirect(builder_, input, weight, bias,
+                                          &pads, &strides, &dilations, output,
+                                          int8_scale)));
+    }
+    void bin_conv(const char *input, const char *weight, const char *output,
+                  const int pad, const int stride, const int group = 1,
+                  const char *scale = nullptr, const char *offset = nullptr) {
+        const auto pads = square(pad, 4), strides = square(stride);
+        const auto dilations = square(1);
+        push(flatbnn::CreateLayer(
+            builder_, flatbnn::LayerType::BinConv2D, 0,
+            flatbnn::CreateBinConv2DDirect(builder_, input, weight, nullptr,
+                                           &pads, &strides, &dilations,
+                                           output, group, scale, offset)));
+    }
+    void multibit_conv(const char *input, const char *weight, const char *bias,
+                       const char *output, const int pad, const int stride,
+                       const int dilation, const int weight_bits,
+                       const int activation_bits,
+                       const float activation_scale) {
+        const auto pads = square(pad, 4), strides = square(stride);
+        const auto dilations = square(dilation);
+        push(flatbnn::CreateLayer(
+            builder_, flatbnn::LayerType::MultiBitConv2D, 0, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 0,
+            flatbnn::CreateMultiBitConv2DDirect(
+                builder_, input, weight, bias, &pads, &strides, &dilations,
+                output, weight_bits, activation_bits, activation_scale)));
+    }
+    void max_pool(const char *input, const int kernel, const int pad,
+                  const int stride, const char *output) {
+        const auto kernel_shape = square(kernel), pads = square(pad, 4),
+                   strides = square(stride);
+        push(flatbnn::CreateLayer(
+            builder_, flatbnn::LayerType::MaxPool, 0, 0, 0,
+            flatbnn::CreateMaxPoolDirect(builder_, input, &kernel_shape, &pads,
+                                         &strides, output)));
+    }
+    void ave_pool(const char *input, const int kernel, const int pad,
+                  const int stride, const char *output) {
+        const auto kernel_shape = square(kernel), pads = square(pad, 4),
+                   strides = square(stride);
+        push(flatbnn::CreateLayer(
+            builder_, flatbnn::LayerType::AvePool, 0, 0,
+            flatbnn::CreateAvePoolDirect(builder_, input, &kernel_shape, &pads,
+                                         &strides, output)));
+    }
+    void affine(const char *input, const char *a, const char *b,
+                const char *output) {
+        push(flatbnn::CreateLayer(
+            builder_, flatbnn::LayerType::Affine, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            flatbnn::CreateAffineDirect(builder_, input, a, b, output)));
+    }
+    void relu(const char *input, const char *output) {
+        push(flatbnn::CreateLayer(
+            builder_, flatbnn::LayerType::Relu, 0, 0, 0, 0,
+            flatbnn::CreateReluDirect(builder_, input, output)));
+    }
+    void add(const char *input1, const char *input2, const char *output) {
+        push(flatbnn::CreateLayer(
+            builder_, flatbnn::LayerType::Add, 0, 0, 0, 0, 0, 0, 0,
+            flatbnn::CreateAddDirect(builder_, input1, input2, output)));
+    }
+    void concat(const std::vector<std::string> &inputs, const int axis,
+                const char *output) {
+        std::vector<flatbuffers::Offset<flatbuffers::String>> names;
+        for (const auto &input : inputs) {
+            names.push_back(builder_.CreateString(input));
+        }
+        push(flatbnn::CreateLayer(
+            builder_, flatbnn::LayerType::Concat, 0, 0, 0, 0, 0, 0, 0, 0,
+            flatbnn::CreateConcatDirect(builder_, &names, axis, output)));
+    }
+    void fc(const char *input, const char *weight, const char *bias,
+            const char *output, const float int8_scale = 0.f) {
+        push(flatbnn::CreateLayer(
+            builder_, flatbnn::LayerType::FC, 0, 0, 0, 0, 0, 0,
+            flatbnn::CreateFCDirect(builder_, input, weight, bias, output,
+                                    int8_scale)));
+    }
+    void softmax(const char *input, const char *output) {
+        push(flatbnn::CreateLayer(
+            builder_, flatbnn::LayerType::Softmax, 0, 0, 0, 0, 0,
+            flatbnn::CreateSoftmaxDirect(builder_, input, output)));
+    }
+
+    /**
+     * The serialized model, the layers cannot be added after it
+     */
+    std::vector<uint8_t> finish() {
+        builder_.Finish(flatbnn::CreateModel(
+            builder_, builder_.CreateVector(layers_),
+            builder_.CreateVector(tensors_), builder_.CreateVector(inputs_),
+            BNN_LATEST_MODEL_VERSION));
+        const auto *ptr = builder_.GetBufferPointer();
+        return std::vector<uint8_t>(ptr, ptr + builder_.GetSize());
+    }
+
+   private:
+    static std::vector<int32_t> square(const int value, const int n = 2) {
+        return std::vector<int32_t>(n, value);
+    }
+    void push(const flatbuffers::Offset<flatbnn::Layer> layer) {
+        layers_.push_back(layer);
+    }
+
+    flatbuffers::FlatBufferBuilder builder_;
+    std::vector<flatbuffers::Offset<flatbnn::Input>> inputs_;
+    std::vector<flatbuffers::Offset<flatbnn::Tensor>> tensors_;
+    std::vector<flatbuffers::Offset<flatbnn::Layer>> layers_;
+};
+
+/**
+ * input [1, 6, 6, 64] -> MaxPool 3x3 "pool" -> BinConv2D 3x3 "bconv", a net
+ * of a float and a binary layer
+ */
+inline std::vector<uint8_t> pool_bconv_model() {
+    TestModel model({1, 6, 6, 64});
+    std::vector<uint64_t> weight(64 * 3 * 3);
+    fill_rand_uint64(weight.data(), weight.size());
+    model.add_bit("weight", {64, 3, 3, 64}, weight);
+    model.max_pool("input", 3, 1, 1, "pool");
+    model.bin_conv("pool", "weight", "bconv", 1, 1);
+    return model.finish();
+}
+
+}  // namespace bnn
+
+#endif /* BNN_TEST_MODEL_H */
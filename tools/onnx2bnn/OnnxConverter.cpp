@@ -2,7 +2,9 @@
 
 #include "OnnxConverter.h"
 
+#include <algorithm>
 #include <bitset>
+#include <cmath>
 #include <fstream>
 #include <map>
 #include <memory>
@@ -42,11 +44,20 @@ void OnnxConverter::AddBinConv(const std::string &input_name,
                                const std::vector<int> &dilations, int group,
                                const std::string &weight_name,
                                const std::string &output_name,
-                               BTensor bin_weight) {
-    BNN_ASSERT(group == 1, "Group != 1 is not supported");
+                               BTensor bin_weight, const bool scaled) {
+    if (group != 1 && Shaper::kc(bin_weight.shape) % 64 != 0) {
+        // A uint64_t cannot hold the channels of more than one group
+        throw std::invalid_argument(
+            "Binary conv with group != 1 should be depthwise or have a "
+            "multiple of 64 input channels per group");
+    }
+    const auto scale_name = output_name + "_scale";
+    const auto offset_name = output_name + "_offset";
     const auto param = flatbnn::CreateBinConv2DDirect(
         builder_, input_name.c_str(), weight_name.c_str(), nullptr, &pads,
-        &strides, &dilations, output_name.c_str());
+        &strides, &dilations, output_name.c_str(), group,
+        scaled ? scale_name.c_str() : nullptr,
+        scaled ? offset_name.c_str() : nullptr);
     const auto layer =
         flatbnn::CreateLayer(builder_, flatbnn::LayerType::BinConv2D, 0, param);
     const auto flat_tensor = flatbnn::CreateTensorDirect(
@@ -56,6 +67,59 @@ void OnnxConverter::AddBinConv(const std::string &input_name,
     layers_.push_back(layer);
 }
 
+void OnnxConverter::AddBinConvScale(
+    const ONNX_NAMESPACE::NodeProto &node,
+    const nonstd::optional<std::string> &bias_name) {
+    const auto &output = node.output(0);
+    const auto channels =
+        Shaper::onnx_kn(onnx_float_tensors_.at(m(node.input(1))).shape);
+    FTensor scale{std::vector<float>(channels, 1.f), Shape{channels}, false};
+    FTensor offset{std::vector<float>(channels, 0.f), Shape{channels}, false};
+    if (bias_name) {
+        offset.data = bnn_tensors_.at(bias_name.value()).data;
+    }
+
+    const ONNX_NAMESPACE::NodeProto *mul = nullptr;
+    int readers = 0;
+    for (const auto &node2 : model_proto_.graph().node()) {
+        for (const auto &input : node2.input()) {
+            if (input == output) {
+                readers++;
+                if (node2.op_type() == "Mul" && node2.input(0) == output) {
+                    mul = &node2;
+                }
+            }
+        }
+    }
+    if (mul != nullptr && readers == 1 &&
+        onnx_float_tensors_.find(mul->input(1)) != onnx_float_tensors_.end()) {
+        // A scalar, or [(1,) c, 1, 1] broadcast along h and w
+        const auto &alpha = onnx_float_tensors_.at(mul->input(1));
+        const auto &shape = alpha.shape;
+        const auto len = Product(shape);
+        if (len == 1 || (len == channels && shape.size() >= 3 &&
+                         shape[shape.size() - 1] == 1 &&
+                         shape[shape.size() - 2] == 1)) {
+            FORZ(i, channels) {
+                const float a = alpha.data[len == 1 ? 0 : i];
+                scale.data[i] = a;
+                offset.data[i] *= a;
+            }
+            folded_muls_.insert(mul->output(0));
+        }
+    }
+
+    const auto output_name = m(output);
+    for (const auto &kv : {std::make_pair(output_name + "_scale", &scale),
+                           std::make_pair(output_name + "_offset", &offset)}) {
+        bnn_tensors_[kv.first] = *kv.second;
+        tensors_.push_back(flatbnn::CreateTensorDirect(
+            builder_, flatbnn::DataType::Float32, nullptr,
+            &bnn_tensors_.at(kv.first).data, &bnn_tensors_.at(kv.first).shape,
+            kv.first.c_str()));
+    }
+}
+
 void OnnxConverter::AddFloatConv(
     const string &input_name, const std::vector<int> &strides,
     const std::vector<int> &pads, const std::vector<int> &dilations, int group,
@@ -71,41 +135,96 @@ void OnnxConverter::AddFloatConv(
 
     bnn_tensors_[weight_name] = float_weight;
 
+    float int8_scale = 0.f;
+    if (int8_ranges_.find(output_name) != int8_ranges_.end()) {
+        std::vector<int8_t> int8_data;
+        std::vector<float> scales;
+        int8_scale =
+            QuantizeToInt8(output_name, float_weight, int8_data, scales);
+        flat_tensor = flatbnn::CreateTensorDirect(
+            builder_, flatbnn::DataType::Int8, nullptr, nullptr,
+            &float_weight.shape, weight_name.c_str(), false, &int8_data,
+            &scales);
+    } else {
+        flat_tensor = flatbnn::CreateTensorDirect(
+            builder_, flatbnn::DataType::Float32, nullptr, &float_weight.data,
+            &float_weight.shape, weight_name.c_str());
+    }
     auto param = flatbnn::CreateFpConv2DDirect(
         builder_, input_name.c_str(), weight_name.c_str(),
         bias_name ? bias_name.value().c_str() : nullptr, &pads, &strides,
-        &dilations, output_name.c_str());
+        &dilations, output_name.c_str(), int8_scale);
     layer = flatbnn::CreateLayer(builder_, flatbnn::LayerType::FpConv2D, param);
-    flat_tensor = flatbnn::CreateTensorDirect(
-        builder_, flatbnn::DataType::Float32, nullptr, &float_weight.data,
-        &float_weight.shape, weight_name.c_str());
     tensors_.push_back(flat_tensor);
     layers_.push_back(layer);
 }
 
+float OnnxConverter::QuantizeToInt8(const std::string &output_name,
+                                    const FTensor &float_weight,
+                                    std::vector<int8_t> &data,
+                                    std::vector<float> &scales) {
+    const auto range = int8_ranges_.at(output_name);
+    if (!(range > 0)) {
+        throw std::invalid_argument("The int8 range of " + output_name +
+                                    " should be positive");
+    }
+    const auto m = float_weight.shape[0];
+    const auto k = float_weight.data.size() / m;
+    data.resize(float_weight.data.size());
+    scales.resize(m);
+    FORZ(i, m) {
+        const auto *row = float_weight.data.data() + i * k;
+        float max_abs = 0.f;
+        FORZ(j, k) { max_abs = std::max(max_abs, std::abs(row[j])); }
+        scales[i] = max_abs > 0 ? max_abs / 127 : 1.f;
+        FORZ(j, k) {
+            const float q = std::nearbyint(row[j] / scales[i]);
+            data[i * k + j] =
+                static_cast<int8_t>(std::max(-127.f, std::min(127.f, q)));
+        }
+    }
+    VLOG(5) << "The weight of " << output_name << " is int8";
+    return range / 127;
+}
+
 void OnnxConverter::AddConv(const string &input_name,
                             const std::vector<int> &strides,
                             const std::vector<int> &pads,
                             const std::vector<int> &dilations, int group,
                             const string &ori_weight_name,
                             const nonstd::optional<std::string> &bias_name,
-                            const string &output_name, const bool binary) {
+                            const string &output_name, const bool binary,
+                            const bool scaled) {
     flatbuffers::Offset<flatbnn::Layer> layer;
 
     flatbuffers::Offset<flatbnn::Tensor> flat_tensor;
     const auto &onnx_weight = onnx_float_tensors_.at(ori_weight_name);
 
-    FTensor bnn_float_tensor = OnnxToBnn(onnx_weight);
+    // The weight of depthwise binary conv is [1, kh, kw, c] so that a
+    // uint64_t holds 64 channels
+    const bool depthwise = binary && group != 1 &&
+                           Shaper::onnx_kc(onnx_weight.shape) == 1 &&
+                           Shaper::onnx_kn(onnx_weight.shape) ==
+                               static_cast<Shaper::len_t>(group);
+    FTensor bnn_float_tensor =
+        depthwise ? OnnxToNnapiDw(onnx_weight) : OnnxToBnn(onnx_weight);
     string weight_name = ori_weight_name + "_conv_w";
     shaper_.AddShape(weight_name, bnn_float_tensor.shape);
-    shaper_.Conv(input_name, strides[1], strides[0], 1, 1, pads[2], pads[3],
-                 pads[0], pads[1], weight_name, output_name);
+    if (depthwise) {
+        shaper_.DepthwiseConv(input_name, strides[1], strides[0],
+                              dilations[1], dilations[0], pads[2], pads[3],
+                              pads[0], pads[1], weight_name, output_name);
+    } else {
+        shaper_.Conv(input_name, strides[1], strides[0], dilations[1],
+                     dilations[0], pads[2], pads[3], pads[0], pads[1],
+                     weight_name, output_name);
+    }
 
     if (binary) {
         VLOG(5) << "Binary conv" + weight_name;
         BTensor weight_tensor = bitpack(bnn_float_tensor);
         AddBinConv(input_name, strides, pads, dilations, group, weight_name,
-                   output_name, weight_tensor);
+                   output_name, weight_tensor, scaled);
     } else {
         AddFloatConv(input_name, strides, pads, dilations, group, weight_name,
                      bias_name, output_name, bnn_float_tensor);
@@ -184,8 +303,10 @@ std::vector<OnnxConverter::BTensor> OnnxConverter::split(
 std::vector<std::string> OnnxConverter::Convert(
     const ONNX_NAMESPACE::ModelProto &model_proto, const std::string &filepath,
     const OnnxConverter::Level level,
-    const std::vector<std::string> &expected_binary_conv_outputs) {
+    const std::vector<std::string> &expected_binary_conv_outputs,
+    const std::map<std::string, float> &int8_ranges) {
     GOOGLE_PROTOBUF_VERIFY_VERSION;
+    int8_ranges_ = int8_ranges;
 
     // We recognize binary convolutions in our custom ONNX optimizers.
     // Please check out "dabnn_*" pases in
@@ -250,9 +371,9 @@ std::vector<std::string> OnnxConverter::Convert(
     vector<string> skipped_act;
     bool has_reshape = false;
     for (const auto &node : model_proto_.graph().node()) {
-        if (has_reshape) {
+        if (has_reshape && node.op_type() != "Gemm") {
             throw std::invalid_argument(
-                "Reshape can only be the last layer for now");
+                "Reshape can only be the last layer or precede Gemm for now");
         }
         NodeAttrHelper helper(node);
         const auto &op = node.op_type();
@@ -281,6 +402,7 @@ std::vector<std::string> OnnxConverter::Convert(
             }
 
             auto ori_weight_name = m(node.input(1));
+            bool scaled = false;
             const bool binary_conv =
                 (node.domain() == "dabnn") ||
                 (std::find(expected_binary_conv_outputs.begin(),
@@ -298,12 +420,14 @@ std::vector<std::string> OnnxConverter::Convert(
                     }
                 }
                 if (!precede_bn) {
-                    throw std::invalid_argument(
-                        "Binary convolutions should precede BatchNorm");
+                    // The bn folds the xnor correction otherwise
+                    AddBinConvScale(node, bias_name);
+                    scaled = true;
                 }
             }
             AddConv(m(node.input(0)), strides, pads, dilations, group,
-                    ori_weight_name, bias_name, m(node.output(0)), binary_conv);
+                    ori_weight_name, bias_name, m(node.output(0)), binary_conv,
+                    scaled);
             VLOG(5) << "Converting Conv completed";
         } else if (op == "AveragePool" || op == "MaxPool" ||
                    op == "GlobalAveragePool" || op == "GlobalMaxPool") {
@@ -414,17 +538,50 @@ std::vector<std::string> OnnxConverter::Convert(
             auto alpha = helper.get("alpha", 1.0f);
             auto beta = helper.get("beta", 1.0f);
             if (transA == 0 && transB == 1 && alpha == 1.f && beta == 1.f) {
+                has_reshape = false;
                 auto input_name = m(node.input(0));
                 auto weight_name = m(node.input(1));
+                const bool binary_fc =
+                    (node.domain() == "dabnn") ||
+                    (std::find(expected_binary_conv_outputs.begin(),
+                               expected_binary_conv_outputs.end(),
+                               node.output(0)) !=
+                     expected_binary_conv_outputs.end());
+                float fc_int8_scale = 0.f;
                 {
                     bnn_tensors_[weight_name] =
-                        onnx_float_tensors_.at(weight_name);
+                        FlattenToBnn(onnx_float_tensors_.at(weight_name),
+                                     shaper_[input_name]);
                     const auto &weight_tensor = bnn_tensors_[weight_name];
                     shaper_.AddShape(weight_name, weight_tensor.shape);
-                    auto flat_tensor = flatbnn::CreateTensorDirect(
-                        builder_, flatbnn::DataType::Float32, nullptr,
-                        &weight_tensor.data, &weight_tensor.shape,
-                        weight_name.c_str());
+                    flatbuffers::Offset<flatbnn::Tensor> flat_tensor;
+                    const auto output_name = m(node.output(0));
+                    if (!binary_fc && int8_ranges_.find(output_name) !=
+                                          int8_ranges_.end()) {
+                        std::vector<int8_t> int8_data;
+                        std::vector<float> scales;
+                        fc_int8_scale = QuantizeToInt8(
+                            output_name, weight_tensor, int8_data, scales);
+                        flat_tensor = flatbnn::CreateTensorDirect(
+                            builder_, flatbnn::DataType::Int8, nullptr,
+                            nullptr, &weight_tensor.shape,
+                            weight_name.c_str(), false, &int8_data, &scales);
+                    } else if (binary_fc) {
+                        binary_conv_outputs.push_back(node.output(0));
+                        FTensor tmp = weight_tensor;
+                        tmp.shape = {weight_tensor.shape[0], 1, 1,
+                                     weight_tensor.shape[1]};
+                        const auto bin_weight = bitpack(tmp);
+                        flat_tensor = flatbnn::CreateTensorDirect(
+                            builder_, flatbnn::DataType::Bit,
+                            &bin_weight.data, nullptr, &bin_weight.shape,
+                            weight_name.c_str(), bin_weight.align_hwc_to_128);
+                    } else {
+                        flat_tensor = flatbnn::CreateTensorDirect(
+                            builder_, flatbnn::DataType::Float32, nullptr,
+                            &weight_tensor.data, &weight_tensor.shape,
+                            weight_name.c_str());
+                    }
                     tensors_.push_back(flat_tensor);
                 }
                 string bias_name;
@@ -443,7 +600,7 @@ std::vector<std::string> OnnxConverter::Convert(
                 auto param = flatbnn::CreateFCDirect(
                     builder_, input_name.c_str(), weight_name.c_str(),
                     node.input_size() >= 3 ? bias_name.c_str() : nullptr,
-                    output_name.c_str());
+                    output_name.c_str(), fc_int8_scale);
                 auto layer =
                     flatbnn::CreateLayer(builder_, flatbnn::LayerType::FC, 0, 0,
                                          0, 0, 0, 0, param, 0);
@@ -488,14 +645,25 @@ std::vector<std::string> OnnxConverter::Convert(
                                      0, 0, 0, 0, 0, 0, param);
             layers_.push_back(layer);
             VLOG(5) << "Converting Concat completed";
+        } else if (op == "Mul") {
+            VLOG(5) << "Start converting Mul";
+            // Only the per channel scale of a binary conv, which is folded
+            // into the conv
+            if (folded_muls_.find(node.output(0)) == folded_muls_.end()) {
+                throw std::invalid_argument("Unsupported operator " + op);
+            }
+            name_map_[node.output(0)] = m(node.input(0));
+            VLOG(5) << "Converting Mul completed";
         } else if (op == "Dropout") {
             VLOG(5) << "Start converting Dropout";
             // Dropout does nothing, so the output is the same as the input
             name_map_[node.output(0)] = m(node.input(0));
             VLOG(5) << "Converting Dropout completed";
-        } else if (op == "Reshape") {
+        } else if (op == "Reshape" || op == "Flatten") {
             VLOG(5) << "Start converting Reshape";
+            // The flatten is folded into the weight of the following Gemm
             has_reshape = true;
+            name_map_[node.output(0)] = m(node.input(0));
             VLOG(5) << "Converting Reshape completed";
         } else if (op == "BatchNormalization") {
             VLOG(5) << "Start converting BatchNormalization";
@@ -3,6 +3,7 @@
 #ifndef BNN_ONNXCONVERTER_H
 #define BNN_ONNXCONVERTER_H
 
+#include <map>
 #include <set>
 #include "optional.h"
 
@@ -62,6 +63,18 @@ class OnnxConverter {
 
     std::vector<flatbuffers::Offset<flatbnn::Tensor>> tensors_;
 
+    // The largest |x| of the input of float convs and fcs, keyed by their
+    // output. The weights of the layers in it are stored as int8.
+    std::map<std::string, float> int8_ranges_;
+
+    /**
+     * The weight as int8 with a scale per output channel (the first
+     * dimension), returning the scale of the int8 input of the layer
+     */
+    float QuantizeToInt8(const std::string &output_name,
+                         const FTensor &float_weight, std::vector<int8_t> &data,
+                         std::vector<float> &scales);
+
     BTensor bitpack(FTensor ftensor);
 
     std::vector<BTensor> split(BTensor input, int num);
@@ -71,7 +84,18 @@ class OnnxConverter {
                     const std::vector<int> &pads,
                     const std::vector<int> &dilations, int group,
                     const std::string &weight_name,
-                    const std::string &output_name, BTensor bin_weight);
+                    const std::string &output_name, BTensor bin_weight,
+                    const bool scaled = false);
+
+    /**
+     * The scale and offset of a binary conv which does not precede a bn,
+     * named output + "_scale" and output + "_offset". A per channel Mul
+     * following the conv (e.g. the alpha of XNOR-Net) is folded into them.
+     */
+    void AddBinConvScale(const ONNX_NAMESPACE::NodeProto &node,
+                         const nonstd::optional<std::string> &bias_name);
+    // The outputs of the Mul folded into the scale of binary convs
+    std::set<std::string> folded_muls_;
 
     void AddFloatConv(const std::string &input_name,
                       const std::vector<int> &strides,
@@ -87,7 +111,7 @@ class OnnxConverter {
                  const std::string &ori_weight_name,
                  const nonstd::optional<std::string> &bias_name,
                  const std::string &output_name,
-                 const bool binary);
+                 const bool binary, const bool scaled = false);
 
     void CalculateCoeff(const ONNX_NAMESPACE::NodeProto &node,
                         const std::string &coeff_a_name,
@@ -95,6 +119,35 @@ class OnnxConverter {
 
     void GetBinTensors();
 
+    /**
+     * onnx: [num_units, input_size], the input is flattened in NCHW order
+     * bnn: [num_units, input_size], the input is flattened in NHWC order
+     */
+    template <typename T>
+    Tensor<T> FlattenToBnn(const Tensor<T> &src,
+                           const Shaper::Shape &input_shape) {
+        const auto units = src.shape[0];
+        const auto h_t = Shaper::h(input_shape), w_t = Shaper::w(input_shape),
+                   c_t = Shaper::c(input_shape);
+        CHECK_EQ(src.shape[1], h_t * w_t * c_t);
+        Tensor<T> dest;
+        dest.data.resize(src.data.size());
+        for (uint32_t u = 0; u < units; u++) {
+            for (uint32_t c = 0; c < c_t; c++) {
+                for (uint32_t h = 0; h < h_t; h++) {
+                    for (uint32_t w = 0; w < w_t; w++) {
+                        const auto onnx_idx = c * h_t * w_t + h * w_t + w;
+                        const auto bnn_idx = h * w_t * c_t + w * c_t + c;
+                        dest.data[u * src.shape[1] + bnn_idx] =
+                            src.data[u * src.shape[1] + onnx_idx];
+                    }
+                }
+            }
+        }
+        dest.shape = src.shape;
+        return dest;
+    }
+
     /**
      * onnx: [filter_out_channel, filter_in_channel / group, height, width]
      * nnapi: [1, height, width, depth_out]
@@ -159,7 +212,8 @@ class OnnxConverter {
     };
     std::vector<std::string> Convert(const ONNX_NAMESPACE::ModelProto &model,
                  const std::string &filepath,
-                 const Level level, const std::vector<std::string> &expected_binary_conv_outputs);
+                 const Level level, const std::vector<std::string> &expected_binary_conv_outputs,
+                 const std::map<std::string, float> &int8_ranges = {});
 };
 
 template <>
@@ -19,7 +19,7 @@ void usage(const std::string &filename) {
     std::cout << "Usage:" << std::endl;
     std::cout << "  " << filename
               << " onnx_model output_filename [ --strict | --moderate | "
-                 "--aggressive ] [--binary-list] [--verbose]"
+                 "--aggressive ] [--binary-list] [--int8-ranges] [--verbose]"
               << std::endl;
     std::cout << std::endl;
     std::cout << "Options:" << std::endl;
@@ -46,6 +46,12 @@ void usage(const std::string &filename) {
            "names** of some convolutions, which will be treated as binary "
            "convlutions unconditionally. It is mainly for benchmark purpose."
         << std::endl;
+    std::cout
+        << "  --int8-ranges   A text file of \"output_name max_abs\" lines "
+           "written by calibrate_int8 from the dabnn model converted without "
+           "this option. The weights of the float convolutions and fully "
+           "connected layers in it will be stored as int8."
+        << std::endl;
     std::cout << std::endl;
     std::cout << "Example:" << std::endl;
     std::cout << "  " << filename
@@ -61,6 +67,7 @@ void usage(const std::string &filename) {
 int main(int argc, char **argv) {
     argh::parser cmdl;
     cmdl.add_param("--binary-list");
+    cmdl.add_param("--int8-ranges");
     cmdl.parse(argc, argv);
     google::InitGoogleLogging(cmdl[0].c_str());
     FLAGS_alsologtostderr = true;
@@ -103,6 +110,21 @@ int main(int argc, char **argv) {
         }
     }
 
+    const auto int8_ranges_filepath = cmdl("int8-ranges").str();
+    std::map<string, float> int8_ranges;
+    if (!int8_ranges_filepath.empty()) {
+        std::ifstream ifs(int8_ranges_filepath);
+        if (!ifs.is_open()) {
+            std::cout << "Cannot open " << int8_ranges_filepath << std::endl;
+            return -3;
+        }
+        string output_name;
+        float range;
+        while (ifs >> output_name >> range) {
+            int8_ranges[output_name] = range;
+        }
+    }
+
     ONNX_NAMESPACE::ModelProto model_proto;
     {
         std::ifstream ifs(cmdl[1], std::ios::in | std::ios::binary);
@@ -112,7 +134,8 @@ int main(int argc, char **argv) {
 
     bnn::OnnxConverter converter;
     const auto binary_conv_outputs = converter.Convert(
-        model_proto, cmdl[2], opt_level, expected_binary_conv_outputs);
+        model_proto, cmdl[2], opt_level, expected_binary_conv_outputs,
+        int8_ranges);
 
     LOG(INFO) << "Conversion completed! Found " << binary_conv_outputs.size()
               << " binary convolutions. Add --verbose to get what they are.";